@@ -0,0 +1,182 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Query tool for cell division logs (divisions.dat files), for offline analysis of many simulations.
+ *
+ * Usage:
+ *   QueryDivisionLogs -logs <file> [<file> ...] [-time <min> <max>] [-x <min> <max>] [-y <min> <max>]
+ *                     [-histogram <time|x|y|age> <min> <max> <bins> | -rows] [-cache_index]
+ *
+ * For each log, prints its path followed by a tab and the number of divisions within the given time window
+ * and x/y bands (by default, all of them); or the counts in each histogram bin, tab-separated; or, with
+ * -rows, the matching divisions themselves.  Logs are memory-mapped and indexed by time (see
+ * DivisionLogReader), so queries for a time window don't read the rest of the file.  With -cache_index, each
+ * log's index is saved alongside it as <file>.index, so later queries needn't scan the log to rebuild it.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "DivisionLogReader.hpp"
+
+#include "CommandLineArguments.hpp"
+#include "ExecutableSupport.hpp"
+#include "Exception.hpp"
+#include "PetscTools.hpp"
+
+/**
+ * Print usage information.
+ */
+void PrintUsage()
+{
+    std::cout << "Usage: QueryDivisionLogs -logs <file> [<file> ...] [-time <min> <max>] [-x <min> <max>]\n"
+              << "                         [-y <min> <max>] [-histogram <time|x|y|age> <min> <max> <bins> | -rows]\n"
+              << "                         [-cache_index]\n";
+}
+
+/**
+ * Read a range from the command line, if given.
+ *
+ * @param rOption  the option
+ * @param rMin  set to the first value following the option
+ * @param rMax  set to the second value following the option
+ */
+void ReadRange(const std::string& rOption, double& rMin, double& rMax)
+{
+    CommandLineArguments* p_args = CommandLineArguments::Instance();
+    if (p_args->OptionExists(rOption))
+    {
+        rMin = p_args->GetDoubleCorrespondingToOption(rOption, 1);
+        rMax = p_args->GetDoubleCorrespondingToOption(rOption, 2);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    ExecutableSupport::StartupWithoutShowingCopyright(&argc, &argv);
+    int exit_code = ExecutableSupport::EXIT_OK;
+    try
+    {
+        CommandLineArguments* p_args = CommandLineArguments::Instance();
+        if (!p_args->OptionExists("-logs"))
+        {
+            PrintUsage();
+            exit_code = ExecutableSupport::EXIT_BAD_ARGUMENTS;
+        }
+        else if (PetscTools::AmMaster())
+        {
+            DivisionQuery query;
+            ReadRange("-time", query.mMinTime, query.mMaxTime);
+            ReadRange("-x", query.mMinX, query.mMaxX);
+            ReadRange("-y", query.mMinY, query.mMaxY);
+
+            bool histogram = p_args->OptionExists("-histogram");
+            DivisionLogReader::Column column = DivisionLogReader::Y;
+            double min = 0.0, max = 0.0;
+            unsigned num_bins = 0u;
+            if (histogram)
+            {
+                std::string column_name = p_args->GetStringCorrespondingToOption("-histogram", 1);
+                if (column_name == "time")
+                {
+                    column = DivisionLogReader::TIME;
+                }
+                else if (column_name == "x")
+                {
+                    column = DivisionLogReader::X;
+                }
+                else if (column_name == "age")
+                {
+                    column = DivisionLogReader::PARENT_AGE;
+                }
+                else if (column_name != "y")
+                {
+                    EXCEPTION("Unknown division log column '" << column_name << "'; use time, x, y or age.");
+                }
+                min = p_args->GetDoubleCorrespondingToOption("-histogram", 2);
+                max = p_args->GetDoubleCorrespondingToOption("-histogram", 3);
+                num_bins = p_args->GetUnsignedCorrespondingToOption("-histogram", 4);
+            }
+            bool rows = p_args->OptionExists("-rows");
+            bool cache_index = p_args->OptionExists("-cache_index");
+
+            std::vector<std::string> logs = p_args->GetStringsCorrespondingToOption("-logs");
+            for (unsigned i=0; i<logs.size(); i++)
+            {
+                DivisionLogReader reader(logs[i], DivisionLogReader::DEFAULT_INDEX_STRIDE,
+                                         cache_index ? logs[i] + ".index" : "");
+                if (histogram)
+                {
+                    std::vector<unsigned> counts = reader.Histogram(query, column, min, max, num_bins);
+                    std::cout << logs[i];
+                    for (unsigned bin=0; bin<counts.size(); bin++)
+                    {
+                        std::cout << "\t" << counts[bin];
+                    }
+                    std::cout << "\n";
+                }
+                else if (rows)
+                {
+                    std::vector<DivisionRecord> records = reader.Query(query);
+                    std::cout << "# " << logs[i] << "\n";
+                    for (unsigned j=0; j<records.size(); j++)
+                    {
+                        std::cout << records[j].mTime << "\t" << records[j].mX << "\t" << records[j].mY;
+                        if (reader.GetNumColumns() > 3u)
+                        {
+                            std::cout << "\t" << records[j].mParentAge;
+                        }
+                        std::cout << "\n";
+                    }
+                }
+                else
+                {
+                    std::cout << logs[i] << "\t" << reader.Count(query) << "\n";
+                }
+            }
+        }
+    }
+    catch (const Exception& e)
+    {
+        ExecutableSupport::PrintError(e.GetMessage());
+        exit_code = ExecutableSupport::EXIT_ERROR;
+    }
+
+    ExecutableSupport::FinalizePetsc();
+    return exit_code;
+}
@@ -0,0 +1,127 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+/*
+ * Long-running server for crypt simulation jobs, so that many short jobs needn't each pay for process start-up,
+ * PETSc initialisation and protocol conversion.
+ *
+ * Usage:
+ *   mpirun -np <workers+1> ServeCryptJobs -jobs <folder> [-workers <max>] [-poll <seconds>] [-exit_when_idle]
+ *                                         [-cache <bypass|use|refresh>]
+ *
+ * Jobs are files placed in <folder>/incoming, relative to CHASTE_TEST_OUTPUT, each giving a model type, a
+ * protocol and protocol input overrides; results appear in <folder>/results/<job name>, and each job's start and
+ * finish is logged in <folder>/server_log.txt.  See CryptJobServer for details.  Every process except the first
+ * runs jobs, up to -workers of them at once.  The server runs until a file named 'stop' is created in the job
+ * folder or, with -exit_when_idle, until there are no jobs left.
+ */
+
+#include <iostream>
+#include <string>
+
+#include "CryptJobServer.hpp"
+
+#include "CommandLineArguments.hpp"
+#include "ExecutableSupport.hpp"
+#include "Exception.hpp"
+#include "PetscTools.hpp"
+
+/**
+ * Print usage information.
+ */
+void PrintUsage()
+{
+    std::cout << "Usage: ServeCryptJobs -jobs <folder> [-workers <max>] [-poll <seconds>] [-exit_when_idle]\n"
+              << "                      [-cache <bypass|use|refresh>]\n";
+}
+
+int main(int argc, char *argv[])
+{
+    ExecutableSupport::StartupWithoutShowingCopyright(&argc, &argv);
+    int exit_code = ExecutableSupport::EXIT_OK;
+    try
+    {
+        CommandLineArguments* p_args = CommandLineArguments::Instance();
+        if (!p_args->OptionExists("-jobs"))
+        {
+            PrintUsage();
+            exit_code = ExecutableSupport::EXIT_BAD_ARGUMENTS;
+        }
+        else
+        {
+            CryptJobServer server(p_args->GetStringCorrespondingToOption("-jobs"));
+            if (p_args->OptionExists("-workers"))
+            {
+                server.SetMaxWorkers(p_args->GetUnsignedCorrespondingToOption("-workers"));
+            }
+            if (p_args->OptionExists("-poll"))
+            {
+                server.SetPollInterval(p_args->GetDoubleCorrespondingToOption("-poll"));
+            }
+            server.SetExitWhenIdle(p_args->OptionExists("-exit_when_idle"));
+            if (p_args->OptionExists("-cache"))
+            {
+                std::string mode = p_args->GetStringCorrespondingToOption("-cache");
+                if (mode == "use")
+                {
+                    server.SetResultCacheMode(ResultCache::USE);
+                }
+                else if (mode == "refresh")
+                {
+                    server.SetResultCacheMode(ResultCache::REFRESH);
+                }
+                else if (mode != "bypass")
+                {
+                    EXCEPTION("Unknown cache mode '" << mode << "'; use bypass, use or refresh.");
+                }
+            }
+
+            unsigned num_jobs = server.Serve();
+            if (PetscTools::AmMaster())
+            {
+                std::cout << "Finished " << num_jobs << " jobs." << std::endl;
+            }
+        }
+    }
+    catch (const Exception& e)
+    {
+        ExecutableSupport::PrintError(e.GetMessage());
+        exit_code = ExecutableSupport::EXIT_ERROR;
+    }
+
+    ExecutableSupport::FinalizePetsc();
+    return exit_code;
+}
@@ -0,0 +1,504 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "DivisionLogReader.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Exception.hpp"
+
+/** The longest line that will be parsed; division log lines are well under this. */
+static const unsigned MAX_LINE_LENGTH = 255u;
+
+/** Visitor collecting matching events. */
+struct CollectDivisions
+{
+    /** The events seen. */
+    std::vector<DivisionRecord> mRecords;
+
+    /** @param rRecord  an event */
+    void operator()(const DivisionRecord& rRecord)
+    {
+        mRecords.push_back(rRecord);
+    }
+};
+
+/** Visitor counting matching events. */
+struct CountDivisions
+{
+    /** Constructor. */
+    CountDivisions()
+        : mCount(0u)
+    {
+    }
+
+    /** The number of events seen. */
+    unsigned mCount;
+
+    /** @param rRecord  an event */
+    void operator()(const DivisionRecord& rRecord)
+    {
+        mCount++;
+    }
+};
+
+/** Visitor histogramming one column of matching events. */
+struct HistogramDivisions
+{
+    /**
+     * Constructor.
+     *
+     * @param column  the column to histogram
+     * @param min  the lower edge of the first bin
+     * @param max  the upper edge of the last bin
+     * @param numBins  the number of bins
+     */
+    HistogramDivisions(DivisionLogReader::Column column, double min, double max, unsigned numBins)
+        : mColumn(column),
+          mMin(min),
+          mMax(max),
+          mCounts(numBins, 0u)
+    {
+    }
+
+    /** The column to histogram. */
+    DivisionLogReader::Column mColumn;
+    /** The lower edge of the first bin. */
+    double mMin;
+    /** The upper edge of the last bin. */
+    double mMax;
+    /** The number of events in each bin. */
+    std::vector<unsigned> mCounts;
+
+    /** @param rRecord  an event */
+    void operator()(const DivisionRecord& rRecord)
+    {
+        double value;
+        switch (mColumn)
+        {
+            case DivisionLogReader::TIME:
+                value = rRecord.mTime;
+                break;
+            case DivisionLogReader::X:
+                value = rRecord.mX;
+                break;
+            case DivisionLogReader::Y:
+                value = rRecord.mY;
+                break;
+            default:
+                value = rRecord.mParentAge;
+                break;
+        }
+        if (value >= mMin && value < mMax)
+        {
+            // Guard against rounding putting a value just below mMax past the last bin
+            unsigned bin = std::min((unsigned)((value - mMin)/(mMax - mMin)*mCounts.size()), (unsigned)mCounts.size() - 1u);
+            mCounts[bin]++;
+        }
+    }
+};
+
+DivisionLogReader::DivisionLogReader(const std::string& rPath, unsigned indexStride, const std::string& rIndexPath)
+    : mPath(rPath),
+      mpData(NULL),
+      mFileSize(0u),
+      mNumColumns(0u),
+      mIndexLoaded(false),
+      mLastTime(0.0),
+      mNumBytesParsed(0u)
+{
+    if (indexStride == 0u)
+    {
+        EXCEPTION("The division log index stride must be positive.");
+    }
+    int fd = open(rPath.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        EXCEPTION("Unable to open division log " << rPath << ": " << strerror(errno));
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0)
+    {
+        int error = errno;
+        close(fd);
+        EXCEPTION("Unable to read division log " << rPath << ": " << strerror(error));
+    }
+    mFileSize = file_stat.st_size;
+    if (mFileSize > 0u)
+    {
+        void* p_map = mmap(NULL, mFileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p_map == MAP_FAILED)
+        {
+            int error = errno;
+            close(fd);
+            EXCEPTION("Unable to map division log " << rPath << ": " << strerror(error));
+        }
+        mpData = static_cast<const char*>(p_map);
+    }
+    // The mapping stays valid after the file is closed
+    close(fd);
+
+    if (!rIndexPath.empty() && LoadIndex(rIndexPath, indexStride, file_stat.st_mtime))
+    {
+        mIndexLoaded = true;
+        return;
+    }
+    try
+    {
+        BuildIndex(indexStride);
+    }
+    catch (const Exception&)
+    {
+        if (mpData != NULL)
+        {
+            munmap(const_cast<char*>(mpData), mFileSize);
+        }
+        throw;
+    }
+    if (!rIndexPath.empty())
+    {
+        SaveIndex(rIndexPath, indexStride, file_stat.st_mtime);
+    }
+}
+
+DivisionLogReader::~DivisionLogReader()
+{
+    if (mpData != NULL)
+    {
+        munmap(const_cast<char*>(mpData), mFileSize);
+    }
+}
+
+template<typename VISITOR>
+void DivisionLogReader::Visit(const DivisionQuery& rQuery, VISITOR& rVisitor) const
+{
+    DivisionRecord record;
+    unsigned num_values;
+    for (unsigned segment=0; segment<mSegmentStarts.size(); segment++)
+    {
+        bool is_last = (segment + 1u == mSegmentStarts.size());
+        std::vector<double>::const_iterator p_first = mIndexTimes.begin() + mSegmentStarts[segment];
+        std::vector<double>::const_iterator p_end = is_last ? mIndexTimes.end()
+                                                            : mIndexTimes.begin() + mSegmentStarts[segment + 1u];
+        uint64_t end_offset = is_last ? mFileSize : mIndexOffsets[mSegmentStarts[segment + 1u]];
+
+        // Every line before the last indexed line earlier than the window is also earlier than it
+        std::vector<double>::const_iterator p_start = std::lower_bound(p_first, p_end, rQuery.mMinTime);
+        if (p_start != p_first)
+        {
+            --p_start;
+        }
+        uint64_t position = mIndexOffsets[p_start - mIndexTimes.begin()];
+        while (position < end_offset)
+        {
+            uint64_t line_start = position;
+            position = ParseLine(line_start, record, num_values);
+            mNumBytesParsed += position - line_start;
+            if (num_values < 3u)
+            {
+                continue;
+            }
+            if (record.mTime > rQuery.mMaxTime)
+            {
+                break;
+            }
+            if (record.mTime >= rQuery.mMinTime
+                && record.mX >= rQuery.mMinX && record.mX <= rQuery.mMaxX
+                && record.mY >= rQuery.mMinY && record.mY <= rQuery.mMaxY)
+            {
+                rVisitor(record);
+            }
+        }
+    }
+}
+
+unsigned DivisionLogReader::GetNumColumns() const
+{
+    return mNumColumns;
+}
+
+unsigned DivisionLogReader::GetNumSegments() const
+{
+    return mSegmentStarts.size();
+}
+
+bool DivisionLogReader::WasIndexLoaded() const
+{
+    return mIndexLoaded;
+}
+
+double DivisionLogReader::GetFirstTime() const
+{
+    return mIndexTimes.empty() ? 0.0 : mIndexTimes[0];
+}
+
+double DivisionLogReader::GetLastTime() const
+{
+    return mLastTime;
+}
+
+unsigned DivisionLogReader::GetIndexSize() const
+{
+    return mIndexOffsets.size();
+}
+
+std::vector<DivisionRecord> DivisionLogReader::Query(const DivisionQuery& rQuery) const
+{
+    CollectDivisions collector;
+    Visit(rQuery, collector);
+    return collector.mRecords;
+}
+
+unsigned DivisionLogReader::Count(const DivisionQuery& rQuery) const
+{
+    CountDivisions counter;
+    Visit(rQuery, counter);
+    return counter.mCount;
+}
+
+std::vector<unsigned> DivisionLogReader::Histogram(const DivisionQuery& rQuery, Column column, double min, double max,
+                                                   unsigned numBins) const
+{
+    if (numBins == 0u || !(max > min))
+    {
+        EXCEPTION("A histogram needs at least one bin, and max greater than min.");
+    }
+    if (column == PARENT_AGE && mNumColumns < 4u)
+    {
+        EXCEPTION("Division log " << mPath << " doesn't record parent cell ages.");
+    }
+    HistogramDivisions histogram(column, min, max, numBins);
+    Visit(rQuery, histogram);
+    return histogram.mCounts;
+}
+
+uint64_t DivisionLogReader::GetNumBytesParsed() const
+{
+    return mNumBytesParsed;
+}
+
+uint64_t DivisionLogReader::GetFileSize() const
+{
+    return mFileSize;
+}
+
+uint64_t DivisionLogReader::ParseLine(uint64_t offset, DivisionRecord& rRecord, unsigned& rNumValues) const
+{
+    const char* p_start = mpData + offset;
+    const char* p_newline = static_cast<const char*>(memchr(p_start, '\n', mFileSize - offset));
+    uint64_t next_line = (p_newline == NULL) ? mFileSize : (p_newline - mpData) + 1u;
+
+    // The mapping isn't null-terminated, so copy the line before handing it to strtod
+    char buffer[MAX_LINE_LENGTH + 1u];
+    unsigned length = std::min((uint64_t)MAX_LINE_LENGTH, next_line - offset);
+    memcpy(buffer, p_start, length);
+    buffer[length] = '\0';
+
+    double values[4] = {0.0, 0.0, 0.0, 0.0};
+    rNumValues = 0u;
+    char* p_parse = buffer;
+    while (rNumValues < 4u)
+    {
+        char* p_end;
+        double value = strtod(p_parse, &p_end);
+        if (p_end == p_parse)
+        {
+            break;
+        }
+        values[rNumValues++] = value;
+        p_parse = p_end;
+    }
+    rRecord.mTime = values[0];
+    rRecord.mX = values[1];
+    rRecord.mY = values[2];
+    rRecord.mParentAge = values[3];
+    return next_line;
+}
+
+void DivisionLogReader::BuildIndex(unsigned indexStride)
+{
+    DivisionRecord record;
+    unsigned num_values;
+    uint64_t position = 0u;
+    unsigned line_number = 0u;
+    while (position < mFileSize)
+    {
+        uint64_t line_start = position;
+        position = ParseLine(line_start, record, num_values);
+        line_number++;
+        if (num_values < 3u)
+        {
+            for (uint64_t i=line_start; i<position; i++)
+            {
+                if (!isspace(mpData[i]))
+                {
+                    EXCEPTION("File " << mPath << " is not a division log: line " << line_number
+                              << " doesn't hold 3 or 4 numbers.");
+                }
+            }
+            continue;
+        }
+        if (mIndexOffsets.empty())
+        {
+            mNumColumns = std::min(num_values, 4u);
+            mSegmentStarts.push_back(0u);
+            mIndexOffsets.push_back(line_start);
+            mIndexTimes.push_back(record.mTime);
+        }
+        else if (record.mTime < mLastTime)
+        {
+            // Time has gone back, e.g. at the start of another run's log
+            mSegmentStarts.push_back(mIndexOffsets.size());
+            mIndexOffsets.push_back(line_start);
+            mIndexTimes.push_back(record.mTime);
+        }
+        else if (line_start >= mIndexOffsets.back() + indexStride)
+        {
+            mIndexOffsets.push_back(line_start);
+            mIndexTimes.push_back(record.mTime);
+        }
+        mLastTime = record.mTime;
+    }
+}
+
+/** Identifies a division log index file, and its format version. */
+static const char INDEX_MAGIC[8] = {'D', 'I', 'V', 'I', 'D', 'X', '0', '1'};
+
+bool DivisionLogReader::LoadIndex(const std::string& rIndexPath, unsigned indexStride, int64_t modificationTime)
+{
+    FILE* p_file = fopen(rIndexPath.c_str(), "rb");
+    if (p_file == NULL)
+    {
+        return false;
+    }
+    char magic[8];
+    uint64_t file_size, num_entries, num_segments;
+    int64_t modification_time;
+    uint32_t stride, num_columns;
+    double last_time;
+    bool ok = (fread(magic, sizeof(magic), 1u, p_file) == 1u
+               && memcmp(magic, INDEX_MAGIC, sizeof(magic)) == 0
+               && fread(&file_size, sizeof(file_size), 1u, p_file) == 1u && file_size == mFileSize
+               && fread(&modification_time, sizeof(modification_time), 1u, p_file) == 1u
+               && modification_time == modificationTime
+               && fread(&stride, sizeof(stride), 1u, p_file) == 1u && stride == indexStride
+               && fread(&num_columns, sizeof(num_columns), 1u, p_file) == 1u
+               && fread(&last_time, sizeof(last_time), 1u, p_file) == 1u
+               && fread(&num_entries, sizeof(num_entries), 1u, p_file) == 1u
+               && num_entries <= mFileSize);
+    std::vector<uint64_t> offsets;
+    std::vector<double> times;
+    std::vector<uint64_t> segment_starts;
+    if (ok && num_entries > 0u)
+    {
+        offsets.resize(num_entries);
+        times.resize(num_entries);
+        ok = (fread(&offsets[0], sizeof(uint64_t), num_entries, p_file) == num_entries
+              && fread(&times[0], sizeof(double), num_entries, p_file) == num_entries);
+    }
+    ok = ok && fread(&num_segments, sizeof(num_segments), 1u, p_file) == 1u && num_segments <= num_entries;
+    if (ok && num_segments > 0u)
+    {
+        segment_starts.resize(num_segments);
+        ok = (fread(&segment_starts[0], sizeof(uint64_t), num_segments, p_file) == num_segments);
+    }
+    fclose(p_file);
+    for (unsigned i=0; ok && i<num_entries; i++)
+    {
+        ok = (offsets[i] < mFileSize);
+    }
+    for (unsigned i=0; ok && i<num_segments; i++)
+    {
+        ok = (segment_starts[i] < num_entries);
+    }
+    if (!ok)
+    {
+        return false;
+    }
+    mNumColumns = num_columns;
+    mLastTime = last_time;
+    mIndexOffsets.swap(offsets);
+    mIndexTimes.swap(times);
+    mSegmentStarts.swap(segment_starts);
+    return true;
+}
+
+void DivisionLogReader::SaveIndex(const std::string& rIndexPath, unsigned indexStride, int64_t modificationTime) const
+{
+    // Write to a temporary file then rename, so a concurrent reader never sees a partial index
+    std::string temp_path = rIndexPath + ".tmp";
+    FILE* p_file = fopen(temp_path.c_str(), "wb");
+    if (p_file == NULL)
+    {
+        return;
+    }
+    uint32_t stride = indexStride;
+    uint32_t num_columns = mNumColumns;
+    uint64_t num_entries = mIndexOffsets.size();
+    uint64_t num_segments = mSegmentStarts.size();
+    bool ok = (fwrite(INDEX_MAGIC, sizeof(INDEX_MAGIC), 1u, p_file) == 1u
+               && fwrite(&mFileSize, sizeof(mFileSize), 1u, p_file) == 1u
+               && fwrite(&modificationTime, sizeof(modificationTime), 1u, p_file) == 1u
+               && fwrite(&stride, sizeof(stride), 1u, p_file) == 1u
+               && fwrite(&num_columns, sizeof(num_columns), 1u, p_file) == 1u
+               && fwrite(&mLastTime, sizeof(mLastTime), 1u, p_file) == 1u
+               && fwrite(&num_entries, sizeof(num_entries), 1u, p_file) == 1u
+               && (num_entries == 0u
+                   || (fwrite(&mIndexOffsets[0], sizeof(uint64_t), num_entries, p_file) == num_entries
+                       && fwrite(&mIndexTimes[0], sizeof(double), num_entries, p_file) == num_entries))
+               && fwrite(&num_segments, sizeof(num_segments), 1u, p_file) == 1u
+               && (num_segments == 0u
+                   || fwrite(&mSegmentStarts[0], sizeof(uint64_t), num_segments, p_file) == num_segments));
+    ok = (fclose(p_file) == 0) && ok;
+    if (ok)
+    {
+        rename(temp_path.c_str(), rIndexPath.c_str());
+    }
+    else
+    {
+        remove(temp_path.c_str());
+    }
+}
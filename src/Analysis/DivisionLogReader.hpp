@@ -0,0 +1,269 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef DIVISIONLOGREADER_HPP_
+#define DIVISIONLOGREADER_HPP_
+
+#include <limits>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/utility.hpp>
+
+/**
+ * A cell division event, as recorded in a divisions.dat log.
+ */
+struct DivisionRecord
+{
+    /** The time of the division. */
+    double mTime;
+    /** The x co-ordinate of the parent cell. */
+    double mX;
+    /** The y co-ordinate (height) of the parent cell. */
+    double mY;
+    /** The age of the parent cell, or zero if the log doesn't record it. */
+    double mParentAge;
+};
+
+/**
+ * The events to select from a division log: those whose time, x and y co-ordinates all lie within the given
+ * closed intervals.  By default every event is selected.
+ */
+struct DivisionQuery
+{
+    /** Constructor, selecting every event. */
+    DivisionQuery()
+        : mMinTime(-std::numeric_limits<double>::max()),
+          mMaxTime(std::numeric_limits<double>::max()),
+          mMinX(-std::numeric_limits<double>::max()),
+          mMaxX(std::numeric_limits<double>::max()),
+          mMinY(-std::numeric_limits<double>::max()),
+          mMaxY(std::numeric_limits<double>::max())
+    {
+    }
+
+    /** The earliest time to select. */
+    double mMinTime;
+    /** The latest time to select. */
+    double mMaxTime;
+    /** The smallest x co-ordinate to select. */
+    double mMinX;
+    /** The largest x co-ordinate to select. */
+    double mMaxX;
+    /** The smallest y co-ordinate to select. */
+    double mMinY;
+    /** The largest y co-ordinate to select. */
+    double mMaxY;
+};
+
+/**
+ * Answers queries on a cell division log (divisions.dat, as written by CryptProliferationSimulation) without
+ * parsing the whole file, for offline analysis of many long simulations.
+ *
+ * The file is memory-mapped, and a sparse time index is built, recording the time of the first line after
+ * every so many bytes.  Divisions are logged as they happen, so times never decrease within the log of one
+ * simulation; logs concatenated from several runs are split into segments at each point where the time goes
+ * back.  A query for a time window then only parses the lines in (or just before) that window in each segment.
+ *
+ * Building the index means reading the whole log once.  To avoid even that when a log is queried repeatedly, the index can be saved to a file, and is reloaded from it as long as the log
+ * hasn't changed size or modification time since.  Index files are a local cache, written in the machine's
+ * native byte order.
+ *
+ * Lines hold whitespace-separated columns: time, x, y, and (in newer logs) the parent cell's age.
+ */
+class DivisionLogReader : private boost::noncopyable
+{
+public:
+    /** The columns of a division log. */
+    enum Column
+    {
+        TIME,
+        X,
+        Y,
+        PARENT_AGE
+    };
+
+    /** The default number of bytes between time index entries. */
+    static const unsigned DEFAULT_INDEX_STRIDE = 65536u;
+
+    /**
+     * Map a division log into memory, and load or build its time index.
+     *
+     * @param rPath  the absolute path to the log
+     * @param indexStride  the number of bytes between time index entries
+     * @param rIndexPath  the absolute path of a file to save the index in, and load it from if it is up to date;
+     *     empty to always build the index afresh
+     */
+    DivisionLogReader(const std::string& rPath, unsigned indexStride=DEFAULT_INDEX_STRIDE,
+                      const std::string& rIndexPath="");
+
+    /**
+     * Destructor.  Unmaps the file.
+     */
+    ~DivisionLogReader();
+
+    /** @return  the number of columns in the log (3 or 4), or 0 if it is empty. */
+    unsigned GetNumColumns() const;
+
+    /** @return  the number of segments of the log within which times never decrease. */
+    unsigned GetNumSegments() const;
+
+    /** @return  whether the index was loaded from an index file, rather than built. */
+    bool WasIndexLoaded() const;
+
+    /** @return  the time of the first event, or 0 if the log is empty. */
+    double GetFirstTime() const;
+
+    /** @return  the time of the last event, or 0 if the log is empty. */
+    double GetLastTime() const;
+
+    /** @return  the number of entries in the time index. */
+    unsigned GetIndexSize() const;
+
+    /**
+     * Find the events matching a query.
+     *
+     * @param rQuery  the query
+     * @return  the matching events, in the order they appear in the log
+     */
+    std::vector<DivisionRecord> Query(const DivisionQuery& rQuery) const;
+
+    /**
+     * Count the events matching a query.
+     *
+     * @param rQuery  the query
+     * @return  the number of matching events
+     */
+    unsigned Count(const DivisionQuery& rQuery) const;
+
+    /**
+     * Histogram one column of the events matching a query, with equal-width bins spanning [min, max).
+     * Values outside this range aren't counted.
+     *
+     * @param rQuery  the query
+     * @param column  the column to histogram
+     * @param min  the lower edge of the first bin
+     * @param max  the upper edge of the last bin
+     * @param numBins  the number of bins
+     * @return  the number of events in each bin
+     */
+    std::vector<unsigned> Histogram(const DivisionQuery& rQuery, Column column, double min, double max,
+                                    unsigned numBins) const;
+
+    /** @return  the total number of bytes of lines parsed so far by queries. */
+    uint64_t GetNumBytesParsed() const;
+
+    /** @return  the size of the log in bytes. */
+    uint64_t GetFileSize() const;
+
+private:
+    /**
+     * Parse the line starting at a given offset.
+     *
+     * @param offset  the start of the line
+     * @param rRecord  filled in with the event on the line
+     * @param rNumValues  set to the number of values on the line
+     * @return  the offset of the start of the next line
+     */
+    uint64_t ParseLine(uint64_t offset, DivisionRecord& rRecord, unsigned& rNumValues) const;
+
+    /**
+     * Build the time index by scanning the log.
+     *
+     * @param indexStride  the number of bytes between time index entries
+     */
+    void BuildIndex(unsigned indexStride);
+
+    /**
+     * Load the time index from a file, if it exists and matches the log.
+     *
+     * @param rIndexPath  the path to the index file
+     * @param indexStride  the number of bytes between time index entries
+     * @param modificationTime  the modification time of the log
+     * @return  whether the index was loaded
+     */
+    bool LoadIndex(const std::string& rIndexPath, unsigned indexStride, int64_t modificationTime);
+
+    /**
+     * Save the time index to a file.  Failure is ignored, as the index can always be rebuilt.
+     *
+     * @param rIndexPath  the path to the index file
+     * @param indexStride  the number of bytes between time index entries
+     * @param modificationTime  the modification time of the log
+     */
+    void SaveIndex(const std::string& rIndexPath, unsigned indexStride, int64_t modificationTime) const;
+
+    /**
+     * Call a visitor for each event matching a query.
+     *
+     * @param rQuery  the query
+     * @param rVisitor  the visitor; its operator() is called with each matching DivisionRecord
+     */
+    template<typename VISITOR>
+    void Visit(const DivisionQuery& rQuery, VISITOR& rVisitor) const;
+
+    /** The path of the log, for error messages. */
+    std::string mPath;
+
+    /** The mapped file, or NULL if it is empty. */
+    const char* mpData;
+
+    /** The size of the file. */
+    uint64_t mFileSize;
+
+    /** The number of columns in the log. */
+    unsigned mNumColumns;
+
+    /** Whether the index was loaded from a file. */
+    bool mIndexLoaded;
+
+    /** The time of the last event. */
+    double mLastTime;
+
+    /** The offset of each line in the time index. */
+    std::vector<uint64_t> mIndexOffsets;
+
+    /** The time of each line in the time index. */
+    std::vector<double> mIndexTimes;
+
+    /** The position in the time index of the first line of each segment. */
+    std::vector<uint64_t> mSegmentStarts;
+
+    /** The number of bytes parsed; updated by queries, which are otherwise const. */
+    mutable uint64_t mNumBytesParsed;
+};
+
+#endif // DIVISIONLOGREADER_HPP_
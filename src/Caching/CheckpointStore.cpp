@@ -0,0 +1,159 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "CheckpointStore.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+
+#include "ResultCache.hpp"
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+#include "Exception.hpp"
+
+const std::string CheckpointStore::LATEST_FOLDER_NAME = "latest";
+const std::string CheckpointStore::PREVIOUS_FOLDER_NAME = "previous";
+const std::string CheckpointStore::KEY_FILE_NAME = "checkpoint_key.txt";
+const std::string CheckpointStore::TIME_FILE_NAME = "checkpoint_time.txt";
+
+CheckpointStore::CheckpointStore(const FileFinder& rStoreFolder, const std::string& rKeyText)
+    : mStoreFolder(rStoreFolder),
+      mKeyText(rKeyText),
+      mHash(ResultCache::Hash(rKeyText))
+{
+}
+
+bool CheckpointStore::IsCheckpointFor(const FileFinder& rCheckpointFolder) const
+{
+    // The time file is written last, so its presence marks the checkpoint as complete
+    FileFinder key_file(KEY_FILE_NAME, rCheckpointFolder);
+    if (!key_file.IsFile() || !FileFinder(TIME_FILE_NAME, rCheckpointFolder).IsFile())
+    {
+        return false;
+    }
+    std::ifstream key_stream(key_file.GetAbsolutePath().c_str());
+    std::stringstream stored_key;
+    stored_key << key_stream.rdbuf();
+    return stored_key.str() == mKeyText;
+}
+
+bool CheckpointStore::HasCheckpoint() const
+{
+    return IsCheckpointFor(FileFinder(mHash + "/" + LATEST_FOLDER_NAME, mStoreFolder))
+           || IsCheckpointFor(FileFinder(mHash + "/" + PREVIOUS_FOLDER_NAME, mStoreFolder));
+}
+
+FileFinder CheckpointStore::GetCheckpointFolder() const
+{
+    FileFinder latest(mHash + "/" + LATEST_FOLDER_NAME, mStoreFolder);
+    if (IsCheckpointFor(latest))
+    {
+        return latest;
+    }
+    // We were killed while replacing the latest checkpoint, after moving it out of the way
+    FileFinder previous(mHash + "/" + PREVIOUS_FOLDER_NAME, mStoreFolder);
+    if (!IsCheckpointFor(previous))
+    {
+        EXCEPTION("There is no checkpoint in " << mStoreFolder.GetAbsolutePath() << mHash);
+    }
+    return previous;
+}
+
+double CheckpointStore::GetCheckpointTime() const
+{
+    FileFinder time_file(TIME_FILE_NAME, GetCheckpointFolder());
+    std::ifstream time_stream(time_file.GetAbsolutePath().c_str());
+    double time;
+    time_stream >> time;
+    if (!time_stream)
+    {
+        EXCEPTION("Unable to read the checkpoint time from " << time_file.GetAbsolutePath());
+    }
+    return time;
+}
+
+FileFinder CheckpointStore::BeginCheckpoint()
+{
+    std::stringstream temp_name;
+    temp_name << mHash << ".tmp" << PetscTools::GetMyRank() << "_" << getpid();
+    mNewCheckpointFolder = FileFinder(temp_name.str(), mStoreFolder);
+    // Clear out anything left by an earlier checkpoint that didn't complete
+    OutputFileHandler temp_handler(mNewCheckpointFolder);
+    return mNewCheckpointFolder;
+}
+
+void CheckpointStore::CommitCheckpoint(double time)
+{
+    if (!mNewCheckpointFolder.IsPathSet() || !mNewCheckpointFolder.IsDir())
+    {
+        EXCEPTION("BeginCheckpoint must be called before CommitCheckpoint.");
+    }
+    OutputFileHandler temp_handler(mNewCheckpointFolder, false);
+    out_stream p_key_file = temp_handler.OpenOutputFile(KEY_FILE_NAME);
+    *p_key_file << mKeyText;
+    p_key_file->close();
+    out_stream p_time_file = temp_handler.OpenOutputFile(TIME_FILE_NAME);
+    *p_time_file << std::setprecision(17) << time << std::endl;
+    p_time_file->close();
+
+    // Move the latest checkpoint aside, so there is always a complete one to resume from
+    OutputFileHandler entry_handler(FileFinder(mHash, mStoreFolder), false);
+    FileFinder latest = entry_handler.FindFile(LATEST_FOLDER_NAME);
+    FileFinder previous = entry_handler.FindFile(PREVIOUS_FOLDER_NAME);
+    if (latest.Exists())
+    {
+        if (previous.Exists())
+        {
+            previous.Remove();
+        }
+        if (rename(latest.GetAbsolutePath().c_str(), previous.GetAbsolutePath().c_str()) != 0)
+        {
+            EXCEPTION("Unable to move the previous checkpoint aside in " << entry_handler.GetOutputDirectoryFullPath());
+        }
+    }
+    if (rename(mNewCheckpointFolder.GetAbsolutePath().c_str(), latest.GetAbsolutePath().c_str()) != 0)
+    {
+        EXCEPTION("Unable to move the new checkpoint into place in " << entry_handler.GetOutputDirectoryFullPath());
+    }
+    if (previous.Exists())
+    {
+        previous.Remove();
+    }
+    mNewCheckpointFolder = FileFinder();
+}
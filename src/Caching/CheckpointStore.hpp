@@ -0,0 +1,124 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef CHECKPOINTSTORE_HPP_
+#define CHECKPOINTSTORE_HPP_
+
+#include <string>
+
+#include "FileFinder.hpp"
+
+/**
+ * An on-disk store of the latest checkpoint of a long simulation, so that a run which is killed part way
+ * through can carry on from where it got to, and a finished run can be extended to a later end time.
+ *
+ * As for ResultCache, checkpoints are identified by a key text describing everything that can affect the
+ * simulation, except that the end time must be left out, and are stored in a sub-folder of the store folder
+ * named after a hash of this text.  Each checkpoint is a folder of files, filled in by the caller, along with
+ * the key text and the simulated time it was taken at.
+ *
+ * Only the latest checkpoint is kept.  A new checkpoint is assembled in a temporary folder, and then renamed
+ * into place, with the previous checkpoint only being deleted once the new one is complete, so a process
+ * killed at any point always leaves a complete checkpoint behind.  Only one process at a time may write
+ * checkpoints for a given key.
+ */
+class CheckpointStore
+{
+public:
+    /**
+     * Create a store accessor for a particular key.
+     *
+     * @param rStoreFolder  the folder containing all checkpoints; must be within CHASTE_TEST_OUTPUT
+     * @param rKeyText  text describing everything other than the end time that can affect the simulation
+     */
+    CheckpointStore(const FileFinder& rStoreFolder, const std::string& rKeyText);
+
+    /** @return  whether there is a checkpoint for our key. */
+    bool HasCheckpoint() const;
+
+    /** @return  the folder holding the latest checkpoint; HasCheckpoint must be true. */
+    FileFinder GetCheckpointFolder() const;
+
+    /** @return  the simulated time of the latest checkpoint; HasCheckpoint must be true. */
+    double GetCheckpointTime() const;
+
+    /**
+     * Start a new checkpoint, in an empty temporary folder unique to this process.
+     *
+     * @return  the folder in which to write the checkpoint's files
+     */
+    FileFinder BeginCheckpoint();
+
+    /**
+     * Make the checkpoint started by BeginCheckpoint the latest one, replacing any previous checkpoint.
+     *
+     * @param time  the simulated time the checkpoint was taken at
+     */
+    void CommitCheckpoint(double time);
+
+private:
+    /** The folder containing all checkpoints. */
+    FileFinder mStoreFolder;
+
+    /** Text describing the simulation checkpointed. */
+    std::string mKeyText;
+
+    /** Hash of mKeyText, which names the folder holding our checkpoints. */
+    std::string mHash;
+
+    /** The folder in which a new checkpoint is being written, if BeginCheckpoint has been called. */
+    FileFinder mNewCheckpointFolder;
+
+    /**
+     * @param rCheckpointFolder  a checkpoint's folder
+     * @return  whether it holds a complete checkpoint for our key
+     */
+    bool IsCheckpointFor(const FileFinder& rCheckpointFolder) const;
+
+    /** Name of the folder holding the latest checkpoint. */
+    static const std::string LATEST_FOLDER_NAME;
+
+    /** Name of the folder holding the previous checkpoint while the latest is being replaced. */
+    static const std::string PREVIOUS_FOLDER_NAME;
+
+    /** Name of the file in each checkpoint holding its key text. */
+    static const std::string KEY_FILE_NAME;
+
+    /** Name of the file in each checkpoint holding its simulated time. */
+    static const std::string TIME_FILE_NAME;
+};
+
+#endif // CHECKPOINTSTORE_HPP_
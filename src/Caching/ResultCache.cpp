@@ -0,0 +1,150 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "ResultCache.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <unistd.h>
+#include <boost/cstdint.hpp>
+#include <boost/foreach.hpp>
+
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+#include "Exception.hpp"
+
+const std::string ResultCache::KEY_FILE_NAME = "cache_key.txt";
+
+ResultCache::ResultCache(const FileFinder& rCacheFolder, const std::string& rKeyText)
+    : mCacheFolder(rCacheFolder),
+      mKeyText(rKeyText),
+      mHash(Hash(rKeyText))
+{
+}
+
+std::string ResultCache::Hash(const std::string& rText)
+{
+    boost::uint64_t hash = 14695981039346656037ull; // FNV offset basis
+    for (std::string::const_iterator it = rText.begin(); it != rText.end(); ++it)
+    {
+        hash ^= (unsigned char)(*it);
+        hash *= 1099511628211ull; // FNV prime
+    }
+    std::stringstream hex;
+    hex << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return hex.str();
+}
+
+ResultCache::Mode ResultCache::GetModeFromEnvironment(Mode defaultMode)
+{
+    Mode mode = defaultMode;
+    const char* p_setting = getenv("CRYPT_RESULT_CACHE");
+    if (p_setting)
+    {
+        std::string setting(p_setting);
+        if (setting == "bypass")
+        {
+            mode = BYPASS;
+        }
+        else if (setting == "use")
+        {
+            mode = USE;
+        }
+        else if (setting == "refresh")
+        {
+            mode = REFRESH;
+        }
+        else if (!setting.empty())
+        {
+            EXCEPTION("CRYPT_RESULT_CACHE must be one of bypass, use or refresh; not '" << setting << "'.");
+        }
+    }
+    return mode;
+}
+
+const std::string& ResultCache::rGetHash() const
+{
+    return mHash;
+}
+
+bool ResultCache::Contains() const
+{
+    FileFinder key_file = GetEntryFile(KEY_FILE_NAME);
+    if (!key_file.IsFile())
+    {
+        return false;
+    }
+    std::ifstream key_stream(key_file.GetAbsolutePath().c_str());
+    std::stringstream stored_key;
+    stored_key << key_stream.rdbuf();
+    return stored_key.str() == mKeyText;
+}
+
+FileFinder ResultCache::GetEntryFile(const std::string& rLeafName) const
+{
+    return FileFinder(mHash + "/" + rLeafName, mCacheFolder);
+}
+
+void ResultCache::Store(const std::vector<FileFinder>& rFiles) const
+{
+    // Assemble the entry in a folder unique to this process
+    std::stringstream temp_name;
+    temp_name << mHash << ".tmp" << PetscTools::GetMyRank() << "_" << getpid();
+    FileFinder temp_folder(temp_name.str(), mCacheFolder);
+    OutputFileHandler temp_handler(temp_folder);
+    BOOST_FOREACH(const FileFinder& r_file, rFiles)
+    {
+        r_file.CopyTo(temp_handler.FindFile(r_file.GetLeafName()));
+    }
+    // Write the key last, since its presence marks the entry as complete
+    out_stream p_key_file = temp_handler.OpenOutputFile(KEY_FILE_NAME);
+    *p_key_file << mKeyText;
+    p_key_file->close();
+
+    // Replace any existing entry
+    FileFinder entry_folder(mHash, mCacheFolder);
+    if (entry_folder.Exists())
+    {
+        entry_folder.Remove();
+    }
+    if (rename(temp_folder.GetAbsolutePath().c_str(), entry_folder.GetAbsolutePath().c_str()) != 0)
+    {
+        // Another process stored this entry first
+        temp_folder.Remove();
+    }
+}
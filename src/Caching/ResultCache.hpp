@@ -0,0 +1,127 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef RESULTCACHE_HPP_
+#define RESULTCACHE_HPP_
+
+#include <string>
+#include <vector>
+
+#include "FileFinder.hpp"
+
+/**
+ * An on-disk, content-addressed cache of simulation results, so that re-running an analysis after changing
+ * only post-processing or plotting doesn't repeat expensive simulations.
+ *
+ * An entry is identified by a key text, which must describe everything that can affect the results: all
+ * the model parameters, the model type, the random seed, and the code version.  The entry is stored in a
+ * sub-folder of the cache folder named after a hash of this text, along with a copy of the text itself,
+ * which is checked on lookup so that hash collisions can never return the wrong results.
+ *
+ * Entries are written to a temporary folder then renamed into place, so concurrent processes never see a
+ * partial entry.  If two processes store the same entry at once, the first to finish wins.
+ */
+class ResultCache
+{
+public:
+    /** How a simulation should use the cache. */
+    enum Mode
+    {
+        BYPASS = 0, ///< Neither read from nor write to the cache
+        USE,        ///< Return cached results if present, otherwise simulate and store the results
+        REFRESH     ///< Always simulate, replacing any cached results
+    };
+
+    /**
+     * Create a cache accessor for a particular entry.
+     *
+     * @param rCacheFolder  the folder containing all cache entries; must be within CHASTE_TEST_OUTPUT
+     * @param rKeyText  text describing everything that can affect the cached results
+     */
+    ResultCache(const FileFinder& rCacheFolder, const std::string& rKeyText);
+
+    /**
+     * Compute a 64-bit FNV-1a hash of some text.
+     *
+     * @param rText  the text
+     * @return  the hash as 16 hexadecimal digits
+     */
+    static std::string Hash(const std::string& rText);
+
+    /**
+     * Determine the cache mode from the CRYPT_RESULT_CACHE environment variable, which may be set to
+     * "bypass", "use" or "refresh".  This allows the cache to be cleared for a run without recompiling.
+     *
+     * @param defaultMode  the mode to use if the variable isn't set
+     * @return  the mode to use
+     */
+    static Mode GetModeFromEnvironment(Mode defaultMode);
+
+    /** @return  the hash of the key text, which names the entry's folder. */
+    const std::string& rGetHash() const;
+
+    /** @return  whether the cache holds an entry for our key. */
+    bool Contains() const;
+
+    /**
+     * Find a file within our cache entry.
+     *
+     * @param rLeafName  the file name
+     * @return  its location
+     */
+    FileFinder GetEntryFile(const std::string& rLeafName) const;
+
+    /**
+     * Store files as the entry for our key, replacing any existing entry.
+     *
+     * @param rFiles  the files to copy into the cache
+     */
+    void Store(const std::vector<FileFinder>& rFiles) const;
+
+private:
+    /** The folder containing all cache entries. */
+    FileFinder mCacheFolder;
+
+    /** Text describing the cached results. */
+    std::string mKeyText;
+
+    /** Hash of mKeyText. */
+    std::string mHash;
+
+    /** Name of the file in each entry holding its key text. */
+    static const std::string KEY_FILE_NAME;
+};
+
+#endif // RESULTCACHE_HPP_
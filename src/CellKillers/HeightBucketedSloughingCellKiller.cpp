@@ -0,0 +1,183 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "HeightBucketedSloughingCellKiller.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+#include "Exception.hpp"
+
+template<unsigned DIM>
+HeightBucketedSloughingCellKiller<DIM>::HeightBucketedSloughingCellKiller(AbstractCellPopulation<DIM>* pCellPopulation,
+                                                                          double sloughHeight,
+                                                                          double bandHeight,
+                                                                          double maxDisplacementPerStep)
+    : AbstractCellKiller<DIM>(pCellPopulation),
+      mSloughHeight(sloughHeight),
+      mBandHeight(bandHeight),
+      mMaxDisplacementPerStep(maxDisplacementPerStep),
+      mStep(-1),
+      mNumCellsInspected(0u)
+{
+    if (!(bandHeight > 0.0) || !(maxDisplacementPerStep > 0.0))
+    {
+        EXCEPTION("The band height and maximum displacement per step must be positive.");
+    }
+}
+
+template<unsigned DIM>
+double HeightBucketedSloughingCellKiller<DIM>::GetSloughHeight() const
+{
+    return mSloughHeight;
+}
+
+template<unsigned DIM>
+double HeightBucketedSloughingCellKiller<DIM>::GetBandHeight() const
+{
+    return mBandHeight;
+}
+
+template<unsigned DIM>
+double HeightBucketedSloughingCellKiller<DIM>::GetMaxDisplacementPerStep() const
+{
+    return mMaxDisplacementPerStep;
+}
+
+template<unsigned DIM>
+unsigned HeightBucketedSloughingCellKiller<DIM>::GetNumCellsInspected() const
+{
+    return mNumCellsInspected;
+}
+
+template<unsigned DIM>
+void HeightBucketedSloughingCellKiller<DIM>::AddCell(CellPtr pCell)
+{
+    // Before the first timestep the whole population will be bucketed anyway
+    if (mStep >= 0)
+    {
+        PlaceCell(pCell);
+    }
+}
+
+template<unsigned DIM>
+void HeightBucketedSloughingCellKiller<DIM>::CheckAndLabelCellsForApoptosisOrDeath()
+{
+    if (mStep < 0)
+    {
+        // Cells are bucketed down to the base of the crypt; any further below share the lowest bucket
+        unsigned num_buckets = (unsigned)std::max(1.0, ceil(mSloughHeight/mBandHeight)) + 1u;
+        mBuckets.assign(num_buckets, std::vector<CellPtr>());
+        mBucketDeadlines.assign(num_buckets, INT_MAX);
+        mStep = 0;
+        for (typename AbstractCellPopulation<DIM>::Iterator cell_iter = this->mpCellPopulation->Begin();
+             cell_iter != this->mpCellPopulation->End();
+             ++cell_iter)
+        {
+            PlaceCell(*cell_iter);
+        }
+        return;
+    }
+
+    mStep++;
+    std::vector<CellPtr> cells;
+    for (unsigned bucket=0; bucket<mBuckets.size(); bucket++)
+    {
+        if (mBucketDeadlines[bucket] <= mStep)
+        {
+            // Cells may go back into this bucket, so take them all out first
+            cells.swap(mBuckets[bucket]);
+            mBucketDeadlines[bucket] = INT_MAX;
+            for (unsigned i=0; i<cells.size(); i++)
+            {
+                PlaceCell(cells[i]);
+            }
+            cells.clear();
+        }
+    }
+}
+
+template<unsigned DIM>
+void HeightBucketedSloughingCellKiller<DIM>::PlaceCell(CellPtr pCell)
+{
+    // Cells that have died some other way will have been removed from the population
+    if (pCell->IsDead())
+    {
+        return;
+    }
+    mNumCellsInspected++;
+    double distance_below = mSloughHeight - this->mpCellPopulation->GetLocationOfCellCentre(pCell)[DIM-1];
+    if (distance_below < 0.0)
+    {
+        pCell->Kill();
+        return;
+    }
+    unsigned bucket = std::min((unsigned)(distance_below/mBandHeight), (unsigned)mBuckets.size() - 1u);
+    mBuckets[bucket].push_back(pCell);
+    mBucketDeadlines[bucket] = std::min(mBucketDeadlines[bucket], mStep + GetBucketInterval(bucket));
+}
+
+template<unsigned DIM>
+int HeightBucketedSloughingCellKiller<DIM>::GetBucketInterval(unsigned bucket) const
+{
+    // A cell in this bucket is at least bucket*mBandHeight below the slough height, so can't be above it
+    // until it has moved that far, which takes more than bucket*mBandHeight/mMaxDisplacementPerStep timesteps
+    return (int)floor(bucket*mBandHeight/mMaxDisplacementPerStep) + 1;
+}
+
+template<unsigned DIM>
+void HeightBucketedSloughingCellKiller<DIM>::OutputCellKillerParameters(out_stream& rParamsFile)
+{
+    *rParamsFile << "\t\t\t<SloughHeight>" << mSloughHeight << "</SloughHeight>\n";
+    *rParamsFile << "\t\t\t<BandHeight>" << mBandHeight << "</BandHeight>\n";
+    *rParamsFile << "\t\t\t<MaxDisplacementPerStep>" << mMaxDisplacementPerStep << "</MaxDisplacementPerStep>\n";
+
+    // Call method on direct parent class
+    AbstractCellKiller<DIM>::OutputCellKillerParameters(rParamsFile);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class HeightBucketedSloughingCellKiller<1>;
+template class HeightBucketedSloughingCellKiller<2>;
+template class HeightBucketedSloughingCellKiller<3>;
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(HeightBucketedSloughingCellKiller)
@@ -0,0 +1,210 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef HEIGHTBUCKETEDSLOUGHINGCELLKILLER_HPP_
+#define HEIGHTBUCKETEDSLOUGHINGCELLKILLER_HPP_
+
+#include <vector>
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+
+#include "AbstractCellKiller.hpp"
+
+/**
+ * A cell killer which kills cells above a given height, as SloughingCellKiller does (without sloughing at the
+ * sides), but without looking at every cell on every timestep.
+ *
+ * Cells are kept in buckets according to how far below the slough height they were when last looked at, in
+ * bands of a fixed height.  Since no node can move further than a known distance in a timestep, a cell k bands
+ * below the slough height can't reach it for several timesteps, and so its bucket only needs looking at that
+ * often.  When a bucket is looked at, its cells above the slough height are killed, and the rest are moved to
+ * the buckets for their new heights.  Only the top bucket, of cells within a band of the slough height, is
+ * looked at on every timestep, so in a tall crypt only a small fraction of cells are looked at per step.
+ *
+ * Killed cells are only marked as dead; the population removes them all together afterwards, as usual.
+ *
+ * Cells born after the first timestep must be given to AddCell; CryptProliferationSimulation does this.
+ */
+template<unsigned DIM>
+class HeightBucketedSloughingCellKiller : public AbstractCellKiller<DIM>
+{
+private:
+    /** Cells above this height are killed. */
+    double mSloughHeight;
+
+    /** The height of each band of cells. */
+    double mBandHeight;
+
+    /** The furthest any node can move in one timestep. */
+    double mMaxDisplacementPerStep;
+
+    /** The number of timesteps taken since the buckets were filled, or -1 if they haven't been. */
+    int mStep;
+
+    /** The cells in each bucket, nearest the slough height first. */
+    std::vector<std::vector<CellPtr> > mBuckets;
+
+    /** The timestep by which each bucket must next be looked at. */
+    std::vector<int> mBucketDeadlines;
+
+    /** The number of times a cell has been looked at, for testing. */
+    unsigned mNumCellsInspected;
+
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.  The buckets are refilled after loading.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<AbstractCellKiller<DIM> >(*this);
+    }
+
+    /**
+     * Put a cell in the bucket for its current height, or kill it if it is above the slough height.
+     *
+     * @param pCell  the cell
+     */
+    void PlaceCell(CellPtr pCell);
+
+    /**
+     * @param bucket  a bucket
+     * @return  the number of timesteps after which the cells placed in the bucket must be looked at again
+     */
+    int GetBucketInterval(unsigned bucket) const;
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param pCellPopulation  the cell population
+     * @param sloughHeight  cells above this height are killed
+     * @param bandHeight  the height of each band of cells; the top band is looked at every timestep
+     * @param maxDisplacementPerStep  the furthest any node can move in one timestep.  The default is the
+     *     default movement threshold beyond which Chaste's off-lattice populations throw an exception; callers
+     *     should pass their population's threshold, plus the division separation since dividing moves the
+     *     parent cell's node too.
+     */
+    HeightBucketedSloughingCellKiller(AbstractCellPopulation<DIM>* pCellPopulation, double sloughHeight,
+                                      double bandHeight=1.0, double maxDisplacementPerStep=1.5);
+
+    /** @return  the slough height. */
+    double GetSloughHeight() const;
+
+    /** @return  the height of each band of cells. */
+    double GetBandHeight() const;
+
+    /** @return  the furthest any node can move in one timestep. */
+    double GetMaxDisplacementPerStep() const;
+
+    /** @return  the total number of times cells have been looked at. */
+    unsigned GetNumCellsInspected() const;
+
+    /**
+     * Tell the killer about a cell added to the population after the first timestep, e.g. by division.
+     *
+     * @param pCell  the new cell, which must already be in the population
+     */
+    void AddCell(CellPtr pCell);
+
+    /**
+     * Kill the cells in the buckets due to be looked at which are above the slough height.  On the first
+     * call, every cell in the population is looked at and bucketed.
+     */
+    virtual void CheckAndLabelCellsForApoptosisOrDeath();
+
+    /**
+     * Overridden OutputCellKillerParameters() method.
+     *
+     * @param rParamsFile the file stream to which the parameters are output
+     */
+    void OutputCellKillerParameters(out_stream& rParamsFile);
+};
+
+#include "SerializationExportWrapper.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(HeightBucketedSloughingCellKiller)
+
+namespace boost
+{
+namespace serialization
+{
+/**
+ * Serialize information required to construct a HeightBucketedSloughingCellKiller.
+ */
+template<class Archive, unsigned DIM>
+inline void save_construct_data(
+    Archive & ar, const HeightBucketedSloughingCellKiller<DIM> * t, const BOOST_PFTO unsigned int file_version)
+{
+    // Save data required to construct instance
+    const AbstractCellPopulation<DIM>* const p_cell_population = t->GetCellPopulation();
+    ar << p_cell_population;
+    double slough_height = t->GetSloughHeight();
+    ar << slough_height;
+    double band_height = t->GetBandHeight();
+    ar << band_height;
+    double max_displacement = t->GetMaxDisplacementPerStep();
+    ar << max_displacement;
+}
+
+/**
+ * De-serialize constructor parameters and initialise a HeightBucketedSloughingCellKiller.
+ */
+template<class Archive, unsigned DIM>
+inline void load_construct_data(
+    Archive & ar, HeightBucketedSloughingCellKiller<DIM> * t, const unsigned int file_version)
+{
+    // Retrieve data from archive required to construct new instance
+    AbstractCellPopulation<DIM>* p_cell_population;
+    ar >> p_cell_population;
+    double slough_height;
+    ar >> slough_height;
+    double band_height;
+    ar >> band_height;
+    double max_displacement;
+    ar >> max_displacement;
+
+    // Invoke inplace constructor to initialise instance
+    ::new(t)HeightBucketedSloughingCellKiller<DIM>(p_cell_population, slough_height, band_height, max_displacement);
+}
+}
+} // namespace ...
+
+#endif /*HEIGHTBUCKETEDSLOUGHINGCELLKILLER_HPP_*/
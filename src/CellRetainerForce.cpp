@@ -106,6 +106,38 @@ void CellRetainerForce<DIM>::AddForceContribution(AbstractCellPopulation<DIM>& r
     }
 }
 
+template<unsigned DIM>
+double CellRetainerForce<DIM>::GetForceMagnitude(CellPtr pCell) const
+{
+    boost::shared_ptr<AbstractCellProliferativeType> p_cell_type = pCell->GetCellProliferativeType();
+    if (p_cell_type->IsType<StemCellProliferativeType>())
+    {
+        return mStemCellForceMagnitudeParameter;
+    }
+    else if (p_cell_type->IsType<PanethCellProliferativeType>())
+    {
+        return mPanethCellForceMagnitudeParameter;
+    }
+    return 0.0;
+}
+
+template<unsigned DIM>
+void CellRetainerForce<DIM>::AddForceContribution(NodeStateArrays<DIM>& rNodeState,
+                                                  AbstractCellPopulation<DIM>& rCellPopulation)
+{
+    NodeStateValue* p_vertical_forces = rNodeState.GetForces(DIM-1);
+    for (typename AbstractCellPopulation<DIM>::Iterator cell_iter = rCellPopulation.Begin();
+         cell_iter != rCellPopulation.End();
+         ++cell_iter)
+    {
+        double magnitude = GetForceMagnitude(*cell_iter);
+        if (magnitude != 0.0)
+        {
+            p_vertical_forces[rCellPopulation.GetLocationIndexUsingCell(*cell_iter)] -= magnitude;
+        }
+    }
+}
+
 template<unsigned DIM>
 void CellRetainerForce<DIM>::OutputForceParameters(out_stream& rParamsFile)
 {
@@ -41,6 +41,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "AbstractForce.hpp"
 #include "AbstractCentreBasedCellPopulation.hpp"
+#include "NodeStateArrays.hpp"
 
 /**
  * A force class to retain stem and paneth cells in the base of the crypt.
@@ -112,6 +113,14 @@ public :
      */
     double GetPanethCellForceMagnitudeParameter();
 
+    /**
+     * @return  the magnitude of the downward force on the given cell: the stem or paneth cell force magnitude
+     *     parameter, or zero for other cells
+     *
+     * @param pCell  the cell
+     */
+    double GetForceMagnitude(CellPtr pCell) const;
+
      /**
      * Overridden AddForceContribution() method.
      *
@@ -120,6 +129,14 @@ public :
      */
     void AddForceContribution(AbstractCellPopulation<DIM>& rCellPopulation);
 
+    /**
+     * Add the force contribution straight into the force arrays of the population's nodes.
+     *
+     * @param rNodeState  the node state, reset for the population
+     * @param rCellPopulation  the population
+     */
+    void AddForceContribution(NodeStateArrays<DIM>& rNodeState, AbstractCellPopulation<DIM>& rCellPopulation);
+
     /**
      * Overridden OutputForceParameters() method.
      *
@@ -0,0 +1,87 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CRYPTMODELPARAMETERS_HPP_
+#define CRYPTMODELPARAMETERS_HPP_
+
+/**
+ * The parameters of CryptProliferationModel that may be set from a protocol, with their default values.
+ *
+ * This list is the single place parameters are declared: it is expanded both to create the model's
+ * RestrictedEnvironment of defaults, and to generate the CryptModelParameters struct whose members are
+ * kept up to date with that environment.  To add a parameter, add a line here.
+ *
+ * Each entry is PARAMETER(name, default_value).
+ */
+#define CRYPT_MODEL_PARAMETERS(PARAMETER) \
+    PARAMETER(cells_across, 14) \
+    PARAMETER(crypt_width, 10) \
+    PARAMETER(crypt_length, 20) \
+    PARAMETER(cells_up, 24) \
+    PARAMETER(thickness_of_ghost_layer, 2) \
+    PARAMETER(end_time, 50) \
+    PARAMETER(dt_divisor, 360) \
+    PARAMETER(random_seed, 0) \
+    PARAMETER(progress_interval, 30)   /* Wall-clock seconds between status file updates; 0 to disable */ \
+    PARAMETER(count_allocations, 0)    /* Set non-zero to count heap allocations in the timestep loop */ \
+    PARAMETER(enable_perf_counters, 0) /* Set non-zero to record hardware counters per phase */ \
+    PARAMETER(async_output, 0)         /* Set non-zero to write divisions from a background thread */ \
+    PARAMETER(snapshot_interval, 0)    /* Hours between compressed population snapshots; 0 to disable */ \
+    PARAMETER(bucketed_sloughing, 0)   /* Set non-zero to only check cells near the top of the crypt for sloughing */ \
+    PARAMETER(batch_births, 0)         /* Set non-zero to add all of a timestep's daughter cells together */ \
+    PARAMETER(reorder_interval, 0)     /* Hours between renumbering nodes along a Morton curve; 0 to disable */ \
+    PARAMETER(node_state_arrays, 0)    /* Set non-zero to compute forces and move nodes using contiguous arrays */ \
+    PARAMETER(fused_update, 0)         /* Set non-zero to add the retainer force, move nodes and apply the boundary condition in one pass */ \
+    PARAMETER(implicit_springs, 0)     /* Set non-zero to treat spring forces implicitly, allowing a smaller dt_divisor */ \
+    PARAMETER(distributed, 0)          /* Set non-zero to share spring forces between all processes, by slabs of the crypt */ \
+    PARAMETER(checkpoint_interval, 0)  /* Hours between checkpoints, from which a later run may resume; 0 to disable */
+
+/** Helper for CRYPT_MODEL_PARAMETERS, declaring a struct member for a parameter. */
+#define CRYPT_MODEL_PARAMETER_MEMBER(name, default_value) double name;
+
+/**
+ * Typed storage for the values of CryptProliferationModel's parameters, with one member per entry in
+ * CRYPT_MODEL_PARAMETERS.  The model binds each member to its parameters environment, so protocol
+ * modifiers write directly into the struct, and the simulation set-up reads members rather than looking
+ * up each parameter by name.
+ */
+struct CryptModelParameters
+{
+    CRYPT_MODEL_PARAMETERS(CRYPT_MODEL_PARAMETER_MEMBER)
+};
+
+#undef CRYPT_MODEL_PARAMETER_MEMBER
+
+#endif // CRYPTMODELPARAMETERS_HPP_
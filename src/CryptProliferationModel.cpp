@@ -35,9 +35,15 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "CryptProliferationModel.hpp"
 
+#include <algorithm>
 #include <cassert>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <set>
 #include <sstream>
 #include <boost/foreach.hpp>
+#include <boost/scoped_ptr.hpp>
 
 // Functional curation includes
 #include "RestrictedEnvironment.hpp"
@@ -46,9 +52,15 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "NdArray.hpp"
 #include "ProtoHelperMacros.hpp"
 
+// Core Chaste includes
+#include "OutputFileHandler.hpp"
+#include "ChasteBuildInfo.hpp"
+#include "Exception.hpp"
+
 // Cell-based Chaste includes
 #include "CylindricalHoneycombMeshGenerator.hpp"
 #include "Cylindrical2dMesh.hpp"
+#include "MortonOrderedCylindrical2dMesh.hpp"
 #include "Cell.hpp"
 #include "CryptCellsGenerator.hpp"
 #include "SimpleWntUniformDistCellCycleModel.hpp"
@@ -56,13 +68,27 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include "ContactInhibitionGenerationBasedCellCycleModel.hpp"
 #include "VariableWntCellCycleModel.hpp"
 #include "MeshBasedCellPopulationWithGhostNodes.hpp"
-#include "OffLatticeSimulation.hpp"
+#include "CryptProliferationSimulation.hpp"
+#include "CellBasedSimulationArchiver.hpp"
 #include "VolumeTrackingModifier.hpp"
+#include "NodeStateVolumeTrackingModifier.hpp"
 #include "GeneralisedLinearSpringForce.hpp"
+#include "NodeStateSpringForce.hpp"
+#include "CryptSlabDecomposition.hpp"
 #include "CellRetainerForce.hpp"
 #include "SloughingCellKiller.hpp"
+#include "HeightBucketedSloughingCellKiller.hpp"
 #include "WntConcentration.hpp"
 #include "CryptSimulationBoundaryCondition.hpp"
+#include "PopulationSizeTrackingModifier.hpp"
+#include "CryptPhaseTimer.hpp"
+#include "PerfCounterGroup.hpp"
+#include "PhaseTimingModifier.hpp"
+#include "TimedSimulationModifier.hpp"
+#include "ProgressReportingModifier.hpp"
+#include "TraceRecorder.hpp"
+#include "AsyncRecordWriter.hpp"
+#include "SnapshotWritingModifier.hpp"
 
 
 std::string CryptProliferationModel::GetModelName(ModelType modelType)
@@ -90,27 +116,54 @@ std::string CryptProliferationModel::GetModelName(ModelType modelType)
 
 
 CryptProliferationModel::CryptProliferationModel(ModelType modelType)
-    : mModelType(modelType)
+    : mModelType(modelType),
+      mResultCacheMode(ResultCache::BYPASS),
+      mCheckpointFolder("CryptProliferationCheckpoints", RelativeTo::ChasteTestOutput)
 {
-    // Set up our parameters environment with default values.
+    // Set up our parameters environment with default values, as listed in CryptModelParameters.hpp.
     // CV is a helper macro that converts a double into the wrapped Functional Curation equivalent.
     std::map<std::string, AbstractValuePtr> default_model_params;
-    default_model_params["cells_across"] = CV(14);
-    default_model_params["crypt_width"] = CV(10);
-    default_model_params["crypt_length"] = CV(20);
-    default_model_params["cells_up"] = CV(24);
-    default_model_params["thickness_of_ghost_layer"] = CV(2);
-    default_model_params["end_time"] = CV(50);
-    default_model_params["dt_divisor"] = CV(360);
+#define CRYPT_MODEL_PARAMETER_DEFAULT(name, default_value) default_model_params[#name] = CV(default_value);
+    CRYPT_MODEL_PARAMETERS(CRYPT_MODEL_PARAMETER_DEFAULT)
+#undef CRYPT_MODEL_PARAMETER_DEFAULT
     mpModelParameters.reset(new RestrictedEnvironment(default_model_params));
+    // Bind each parameter to its member of mParameters, so that protocol modifiers setting a parameter
+    // update the member directly, and SolveModel doesn't need to look parameters up by name
+#define CRYPT_MODEL_PARAMETER_BIND(name, default_value) mpModelParameters->BindValue(#name, &mParameters.name);
+    CRYPT_MODEL_PARAMETERS(CRYPT_MODEL_PARAMETER_BIND)
+#undef CRYPT_MODEL_PARAMETER_BIND
     // Set up what outputs are available
     mOutputNames.push_back("divisions");
     mOutputUnits.push_back("mixed");
+    mOutputNames.push_back("peak_num_cells");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("peak_num_nodes");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("peak_num_ghost_nodes");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("timings");
+    mOutputUnits.push_back("mixed");
+    mOutputNames.push_back("peak_bytes");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("allocations");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("perf_counters");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("output_writer");
+    mOutputUnits.push_back("mixed");
     // No state is kept between calls to SolveModel
     mHasImplicitReset = true;
 }
 
 
+CryptProliferationModel::~CryptProliferationModel()
+{
+#define CRYPT_MODEL_PARAMETER_UNBIND(name, default_value) mpModelParameters->BindValue(#name, NULL);
+    CRYPT_MODEL_PARAMETERS(CRYPT_MODEL_PARAMETER_UNBIND)
+#undef CRYPT_MODEL_PARAMETER_UNBIND
+}
+
+
 void CryptProliferationModel::SetNamespaceBindings(const std::map<std::string, std::string>& rNamespaceBindings)
 {
     // Associate whatever prefix is bound to the cell-based namespace with our parameters environment
@@ -128,25 +181,206 @@ void CryptProliferationModel::SetNamespaceBindings(const std::map<std::string, s
 
 EnvironmentCPtr CryptProliferationModel::GetOutputs()
 {
+    TraceSpan span("get_outputs", "model");
     EnvironmentPtr p_outputs(new Environment);
-    assert(mOutputFolder.IsPathSet());
-    FileFinder raw_results("results_from_time_0/divisions.dat", mOutputFolder);
+    assert(mDivisionsFile.IsPathSet());
     // The raw results have four whitespace-separated columns: time, x co-ord, y co-ord, parent age
     // We convert this into a 2d array, with the last dimension having extent 4
     ArrayFileReader reader;
-    NdArray<double> raw_result_data = reader.ReadFile(raw_results);
+    NdArray<double> raw_result_data = reader.ReadFile(mDivisionsFile);
     AbstractValuePtr p_results(new ArrayValue(raw_result_data));
-    p_results->SetUnits(mOutputUnits.front());
-    p_outputs->DefineName(mOutputNames.front(), p_results, "CryptProliferationModel::GetOutputs");
+    p_results->SetUnits(mOutputUnits[0]);
+    p_outputs->DefineName(mOutputNames[0], p_results, "CryptProliferationModel::GetOutputs");
+    // Statistics on the simulation run, computed by SolveModel
+    for (unsigned i=1; i<mOutputNames.size(); i++)
+    {
+        std::map<std::string, StatisticsOutput>::const_iterator it = mStatisticsOutputs.find(mOutputNames[i]);
+        assert(it != mStatisticsOutputs.end());
+        const StatisticsOutput& r_output = it->second;
+        AbstractValuePtr p_value;
+        if (r_output.mShape.empty())
+        {
+            p_value = CV(r_output.mValues[0]);
+        }
+        else
+        {
+            NdArray<double>::Extents shape(r_output.mShape.begin(), r_output.mShape.end());
+            NdArray<double> array(shape);
+            assert(r_output.mValues.size() == array.GetNumElements());
+            std::copy(r_output.mValues.begin(), r_output.mValues.end(), array.Begin());
+            p_value.reset(new ArrayValue(array));
+        }
+        p_value->SetUnits(mOutputUnits[i]);
+        p_outputs->DefineName(mOutputNames[i], p_value, "CryptProliferationModel::GetOutputs");
+    }
     return p_outputs;
 }
 
 
+void CryptProliferationModel::SetStatisticsOutput(const std::string& rName, double value)
+{
+    StatisticsOutput& r_output = mStatisticsOutputs[rName];
+    r_output.mShape.clear();
+    r_output.mValues.assign(1u, value);
+}
+
+
+void CryptProliferationModel::SetStatisticsOutput(const std::string& rName, const std::vector<double>& rValues,
+                                                  const std::vector<unsigned>& rShape)
+{
+    StatisticsOutput& r_output = mStatisticsOutputs[rName];
+    r_output.mShape = rShape;
+    r_output.mValues = rValues;
+}
+
+
+FileFinder CryptProliferationModel::WriteStatisticsOutputs() const
+{
+    // One line per output: name, number of dimensions, extents, values
+    OutputFileHandler handler(mOutputFolder, false);
+    out_stream p_file = handler.OpenOutputFile("statistics.txt");
+    *p_file << std::setprecision(17);
+    typedef std::pair<std::string, StatisticsOutput> StringOutputPair;
+    BOOST_FOREACH(const StringOutputPair& r_output, mStatisticsOutputs)
+    {
+        *p_file << r_output.first << " " << r_output.second.mShape.size();
+        BOOST_FOREACH(unsigned extent, r_output.second.mShape)
+        {
+            *p_file << " " << extent;
+        }
+        BOOST_FOREACH(double value, r_output.second.mValues)
+        {
+            *p_file << " " << value;
+        }
+        *p_file << std::endl;
+    }
+    p_file->close();
+    return handler.FindFile("statistics.txt");
+}
+
+
+void CryptProliferationModel::ReadStatisticsOutputs(const FileFinder& rFile)
+{
+    mStatisticsOutputs.clear();
+    std::ifstream file(rFile.GetAbsolutePath().c_str());
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::stringstream line_stream(line);
+        std::string name;
+        unsigned num_dims;
+        line_stream >> name >> num_dims;
+        StatisticsOutput& r_output = mStatisticsOutputs[name];
+        unsigned num_values = 1u;
+        r_output.mShape.resize(num_dims);
+        for (unsigned i=0; i<num_dims; i++)
+        {
+            line_stream >> r_output.mShape[i];
+            num_values *= r_output.mShape[i];
+        }
+        r_output.mValues.resize(num_values);
+        for (unsigned i=0; i<num_values; i++)
+        {
+            line_stream >> r_output.mValues[i];
+        }
+        if (!line_stream)
+        {
+            EXCEPTION("Unable to read cached statistics output '" << name << "' from " << rFile.GetAbsolutePath());
+        }
+    }
+}
+
+
 /**
- * A handy macro to save typing when reading a typical parameter value
- * @param name  the parameter name (no quotes needed)
+ * Remove the definitions of some parameters from a cache or checkpoint key.
+ *
+ * @param rKey  the key, with a 'name = value' line for each parameter
+ * @param rNames  the parameters to remove
+ * @return  the key without their lines
  */
-#define PARAM(name) GET_SIMPLE_VALUE(mpModelParameters->Lookup(#name, "CryptProliferationModel::SolveModel"))
+static std::string RemoveKeyLines(const std::string& rKey, const std::set<std::string>& rNames)
+{
+    std::istringstream key_stream(rKey);
+    std::stringstream key;
+    std::string line;
+    while (std::getline(key_stream, line))
+    {
+        if (rNames.find(line.substr(0, line.find(" ="))) == rNames.end())
+        {
+            key << line << std::endl;
+        }
+    }
+    return key.str();
+}
+
+
+std::string CryptProliferationModel::GetParameterKey() const
+{
+    std::stringstream key;
+    key << "model = " << GetModelName(mModelType) << std::endl
+        << "simulation_code_version = " << SIMULATION_CODE_VERSION << std::endl
+        << "chaste_version = " << ChasteBuildInfo::GetVersionString() << std::endl
+        << mpModelParameters->GetDefinitionsAsText();
+    if (sizeof(NodeStateValue) != sizeof(double))
+    {
+        // Results from single precision builds differ, but existing double precision entries stay valid.  Entries
+        // from builds that only stored forces in single precision are not reused.
+        key << "node_state_precision = single locations, radii and forces" << std::endl;
+    }
+    if (mParameters.distributed != 0.0)
+    {
+        // Forces are summed in a different order for each number of processes
+        key << "num_slabs = " << CryptSlabDecomposition::GetNumProcesses() << std::endl;
+    }
+    return key.str();
+}
+
+
+std::string CryptProliferationModel::GetResultCacheKey() const
+{
+    // Parameters which only control monitoring, extra outputs and checkpointing don't change the results
+    std::set<std::string> monitoring_parameters;
+    monitoring_parameters.insert("checkpoint_interval");
+    monitoring_parameters.insert("progress_interval");
+    monitoring_parameters.insert("count_allocations");
+    monitoring_parameters.insert("enable_perf_counters");
+    monitoring_parameters.insert("async_output");
+    monitoring_parameters.insert("snapshot_interval");
+    return RemoveKeyLines(GetParameterKey(), monitoring_parameters);
+}
+
+
+std::string CryptProliferationModel::GetCheckpointKey() const
+{
+    // Runs which differ only in how long they go on for can carry on from each other's checkpoints.  Monitoring
+    // parameters stay in the key, since the modifiers they add are archived with the simulation.
+    std::set<std::string> duration_parameters;
+    duration_parameters.insert("end_time");
+    duration_parameters.insert("checkpoint_interval");
+    std::string key = RemoveKeyLines(GetParameterKey(), duration_parameters);
+    if (mParameters.distributed != 0.0)
+    {
+        // Every process runs the same simulation, and keeps its own checkpoints
+        std::stringstream process;
+        process << "process = " << PetscTools::GetMyRank() << std::endl;
+        key += process.str();
+    }
+    return key;
+}
+
+
+void CryptProliferationModel::SetCheckpointFolder(const FileFinder& rCheckpointFolder)
+{
+    mCheckpointFolder = rCheckpointFolder;
+}
+
+
+void CryptProliferationModel::SetResultCache(ResultCache::Mode mode, const FileFinder& rCacheFolder)
+{
+    mResultCacheMode = mode;
+    mResultCacheFolder = rCacheFolder;
+}
+
 
 /**
  * Another short-hand, for getting the cell-cycle model from a cell as the appropriate concrete type.
@@ -155,37 +389,24 @@ EnvironmentCPtr CryptProliferationModel::GetOutputs()
  */
 #define CCM(type, pCell) dynamic_cast<type*>(pCell->GetCellCycleModel())
 
-void CryptProliferationModel::SolveModel(double endPoint)
+/**
+ * Create the cells for a crypt, with cell-cycle models for the given type of model.
+ *
+ * @param modelType  the type of model
+ * @param rCells  filled in with the cells
+ * @param pMesh  the mesh the cells are to go on
+ * @param rLocationIndices  the indices of the mesh's real (non-ghost) nodes
+ */
+static void CreateCells(CryptProliferationModel::ModelType modelType, std::vector<CellPtr>& rCells,
+                        Cylindrical2dMesh* pMesh, const std::vector<unsigned>& rLocationIndices)
 {
-    assert(mpOutputHandler);
-    std::stringstream raw_results_path;
-    raw_results_path << "raw_results" << PetscTools::GetMyRank();
-    mOutputFolder.SetPath(raw_results_path.str(), GetOutputFolder());
-    //
-    // Set up the simulation object
-    //
-
-    // Set up singletons
-    SimulationTime::Instance()->SetStartTime(0.0);
-    RandomNumberGenerator::Instance()->Reseed(0);
-    CellPropertyRegistry::Instance()->Clear();
-
-    // Create the mesh
-    CylindricalHoneycombMeshGenerator generator((unsigned)PARAM(cells_across), (unsigned)PARAM(cells_up),
-                                                (unsigned)PARAM(thickness_of_ghost_layer),
-                                                PARAM(crypt_width)/PARAM(cells_across));
-    Cylindrical2dMesh* p_mesh = generator.GetCylindricalMesh();
-    std::vector<unsigned> location_indices = generator.GetCellLocationIndices();
-
-    // Create the cells
-    std::vector<CellPtr> cells;
-    switch (mModelType)
+    switch (modelType)
     {
         case CryptProliferationModel::UNIFORM_WNT:
         {
             CryptCellsGenerator<SimpleWntUniformDistCellCycleModel> cells_generator;
-            cells_generator.Generate(cells, p_mesh, location_indices, true);
-            BOOST_FOREACH(CellPtr p_cell, cells)
+            cells_generator.Generate(rCells, pMesh, rLocationIndices, true);
+            BOOST_FOREACH(CellPtr p_cell, rCells)
             {
                   CCM(SimpleWntUniformDistCellCycleModel, p_cell)->SetWntTransitThreshold(0.5);   // So only proliferate in bottom half of the crypt
 
@@ -200,8 +421,8 @@ void CryptProliferationModel::SolveModel(double endPoint)
         case CryptProliferationModel::VARIABLE_WNT:
         {
             CryptCellsGenerator<VariableWntCellCycleModel> cells_generator;
-            cells_generator.Generate(cells, p_mesh, location_indices, true);
-            BOOST_FOREACH(CellPtr p_cell, cells)
+            cells_generator.Generate(rCells, pMesh, rLocationIndices, true);
+            BOOST_FOREACH(CellPtr p_cell, rCells)
             {
                 CCM(VariableWntCellCycleModel, p_cell)->SetWntTransitThreshold(0.5);   // So only proliferate in bottom half of the crypt
 
@@ -216,8 +437,8 @@ void CryptProliferationModel::SolveModel(double endPoint)
         case CryptProliferationModel::STOCHASTIC_GEN_BASED:
         {
             CryptCellsGenerator<StochasticDurationGenerationBasedCellCycleModel> cells_generator;
-            cells_generator.Generate(cells, p_mesh, location_indices, true, 0.0, 3.0, 6.5, 8.0);
-            BOOST_FOREACH(CellPtr p_cell, cells)
+            cells_generator.Generate(rCells, pMesh, rLocationIndices, true, 0.0, 3.0, 6.5, 8.0);
+            BOOST_FOREACH(CellPtr p_cell, rCells)
             {
                 CCM(StochasticDurationGenerationBasedCellCycleModel, p_cell)->SetMaxTransitGenerations(4u); // So only proliferate roughly in bottom half of the crypt
 
@@ -234,8 +455,8 @@ void CryptProliferationModel::SolveModel(double endPoint)
         case CryptProliferationModel::CONTACT_INHIBITION:
         {
             CryptCellsGenerator<ContactInhibitionGenerationBasedCellCycleModel> cells_generator;
-            cells_generator.Generate(cells, p_mesh, location_indices, true, 0.0, 3.0, 6.5, 8.);
-            BOOST_FOREACH(CellPtr p_cell, cells)
+            cells_generator.Generate(rCells, pMesh, rLocationIndices, true, 0.0, 3.0, 6.5, 8.);
+            BOOST_FOREACH(CellPtr p_cell, rCells)
             {
                 CCM(ContactInhibitionGenerationBasedCellCycleModel, p_cell)->SetMaxTransitGenerations(4u); // So only proliferate roughly in bottom half of the crypt
                 CCM(ContactInhibitionGenerationBasedCellCycleModel, p_cell)->SetEquilibriumVolume(0.866); //sqrt(3)/2
@@ -253,54 +474,377 @@ void CryptProliferationModel::SolveModel(double endPoint)
             NEVER_REACHED;
             break;
     }
+}
+
+/**
+ * Tears down the simulation singletons when it goes out of scope, so that a simulation which throws leaves the
+ * process ready for the next one, as when a server runs many jobs in turn.
+ */
+class SingletonCleaner
+{
+public:
+    /** Destroy the singletons the simulation set up. */
+    ~SingletonCleaner()
+    {
+        WntConcentration<2>::Destroy();
+        RandomNumberGenerator::Destroy();
+        SimulationTime::Destroy();
+        CellPropertyRegistry::Instance()->Clear();
+    }
+};
 
-    // Wrap cells & mesh into a population, and set what outputs to record
-    MeshBasedCellPopulationWithGhostNodes<2> crypt(*p_mesh, cells, location_indices);
 
-    // Create the simulator, and set some extra parameters
-    OffLatticeSimulation<2> simulator(crypt);
+void CryptProliferationModel::SolveModel(double endPoint)
+{
+    TraceSpan span("simulate", "model");
+    span.AddArgument("model", GetModelName(mModelType));
+    // Take a snapshot of the parameter values for this run; protocol modifiers keep mParameters up to date
+    const CryptModelParameters params = mParameters;
+    assert(mpOutputHandler);
+    std::stringstream raw_results_path;
+    raw_results_path << "raw_results" << PetscTools::GetMyRank();
+    mOutputFolder.SetPath(raw_results_path.str(), GetOutputFolder());
+
+    // Reuse cached results for these parameters if we can
+    boost::shared_ptr<ResultCache> p_cache;
+    if (mResultCacheMode != ResultCache::BYPASS)
+    {
+        p_cache.reset(new ResultCache(mResultCacheFolder, GetResultCacheKey()));
+        if (mResultCacheMode == ResultCache::USE && p_cache->Contains())
+        {
+            OutputFileHandler results_handler(FileFinder("results_from_time_0", mOutputFolder), false);
+            mDivisionsFile = results_handler.FindFile("divisions.dat");
+            p_cache->GetEntryFile("divisions.dat").CopyTo(mDivisionsFile);
+            ReadStatisticsOutputs(p_cache->GetEntryFile("statistics.txt"));
+            return;
+        }
+    }
+
+    //
+    // Set up the simulation object
+    //
+
+    // Set up singletons, to be cleaned up however we leave this method
+    SingletonCleaner singleton_cleaner;
+    SimulationTime::Instance()->SetStartTime(0.0);
+    RandomNumberGenerator::Instance()->Reseed((unsigned)params.random_seed);
+    CellPropertyRegistry::Instance()->Clear();
+
+    // Carry on from the latest checkpoint of a run with the same parameters, if it stopped before our end time
+    boost::shared_ptr<CheckpointStore> p_checkpoints;
+    bool resume_from_checkpoint = false;
+    const double dt = 1.0/params.dt_divisor;
+    if (params.checkpoint_interval > 0.0)
+    {
+        p_checkpoints.reset(new CheckpointStore(mCheckpointFolder, GetCheckpointKey()));
+        if (p_checkpoints->HasCheckpoint())
+        {
+            // A checkpoint at our end time is from before the population was last updated, so we start again
+            double checkpoint_time = p_checkpoints->GetCheckpointTime();
+            resume_from_checkpoint = (checkpoint_time < params.end_time - 0.5*dt);
+            if (checkpoint_time > params.end_time + 0.5*dt)
+            {
+                // Don't replace it with checkpoints from a shorter run
+                p_checkpoints.reset();
+            }
+        }
+    }
+
+    // The division logs making up the complete log for this run, in time order
+    std::vector<FileFinder> division_logs;
+
+    // These are declared in this order so that the simulation (which owns the population) is destroyed first,
+    // and all of them before the singletons are cleaned up
+    boost::scoped_ptr<CylindricalHoneycombMeshGenerator> p_generator;
+    boost::scoped_ptr<MortonOrderedCylindrical2dMesh> p_ordered_mesh;
+    boost::scoped_ptr<CryptProliferationSimulation> p_simulator;
     FileFinder test_output_root("", RelativeTo::ChasteTestOutput);
-    simulator.SetOutputDirectory(mOutputFolder.GetRelativePath(test_output_root));
-    simulator.SetOutputDivisionLocations(true); // The output we're really interested in
-    simulator.SetDt(1.0/PARAM(dt_divisor));
-    simulator.SetSamplingTimestepMultiple(PARAM(dt_divisor));
-    simulator.SetEndTime(PARAM(end_time));
+
+    // Time each phase of the timestep loop
+    boost::shared_ptr<CryptPhaseTimer> p_timer(new CryptPhaseTimer);
+    if (params.enable_perf_counters != 0.0)
+    {
+        // If hardware counters can't be opened the timer just ignores them
+        p_timer->SetPerfCounters(boost::shared_ptr<PerfCounterGroup>(new PerfCounterGroup));
+    }
+
+    // Forces and node movement may go through contiguous arrays, for which the spring force must know about them
+    bool use_node_state_spring_force = (params.node_state_arrays != 0.0 || params.fused_update != 0.0
+                                        || params.implicit_springs != 0.0 || params.distributed != 0.0);
+
+    if (resume_from_checkpoint)
+    {
+        // Keep the division log so far, since the checkpoint will be replaced as we go
+        FileFinder checkpoint = p_checkpoints->GetCheckpointFolder();
+        double checkpoint_time = p_checkpoints->GetCheckpointTime();
+        OutputFileHandler raw_results_handler(mOutputFolder, false);
+        FileFinder resumed_divisions = raw_results_handler.FindFile("checkpoint_divisions.dat");
+        FileFinder("divisions.dat", checkpoint).CopyTo(resumed_divisions);
+        division_logs.push_back(resumed_divisions);
+
+        // The archive holds the population, forces, killers, boundary conditions and modifiers
+        p_simulator.reset(CellBasedSimulationArchiver<2, CryptProliferationSimulation>::Load(
+                checkpoint.GetRelativePath(test_output_root), checkpoint_time));
+
+        // Timers and the status file aren't archived
+        boost::shared_ptr<TimedSimulationModifier<2> > p_timed_vol_tracker
+                = p_simulator->GetSimulationModifier<TimedSimulationModifier<2> >();
+        if (p_timed_vol_tracker)
+        {
+            p_timed_vol_tracker->SetTimer(p_timer);
+        }
+        boost::shared_ptr<ProgressReportingModifier<2> > p_progress
+                = p_simulator->GetSimulationModifier<ProgressReportingModifier<2> >();
+        if (p_progress)
+        {
+            p_progress->SetStatusFile(FileFinder("status.txt", mOutputFolder));
+        }
+        boost::shared_ptr<PhaseTimingModifier<2> > p_timing_modifier
+                = p_simulator->GetSimulationModifier<PhaseTimingModifier<2> >();
+        if (p_timing_modifier)
+        {
+            p_timing_modifier->SetTimer(p_timer);
+        }
+    }
+    else
+    {
+        // Create the mesh
+        p_generator.reset(new CylindricalHoneycombMeshGenerator((unsigned)params.cells_across, (unsigned)params.cells_up,
+                                                                (unsigned)params.thickness_of_ghost_layer,
+                                                                params.crypt_width/params.cells_across));
+        Cylindrical2dMesh* p_mesh = p_generator->GetCylindricalMesh();
+        std::vector<unsigned> location_indices = p_generator->GetCellLocationIndices();
+        // Optionally use a copy of the mesh which keeps nodes that are close in space close in memory
+        if (params.reorder_interval > 0.0)
+        {
+            unsigned steps_between_reorderings = std::max(1u, (unsigned)(params.reorder_interval*params.dt_divisor + 0.5));
+            p_ordered_mesh.reset(new MortonOrderedCylindrical2dMesh(*p_mesh, steps_between_reorderings));
+            p_mesh = p_ordered_mesh.get();
+        }
+
+        // Create the cells
+        std::vector<CellPtr> cells;
+        CreateCells(mModelType, cells, p_mesh, location_indices);
+
+        // Wrap cells & mesh into a population, which the simulator takes ownership of
+        MeshBasedCellPopulationWithGhostNodes<2>* p_crypt
+                = new MeshBasedCellPopulationWithGhostNodes<2>(*p_mesh, cells, location_indices);
+        p_simulator.reset(new CryptProliferationSimulation(*p_crypt, true));
+
+        // Set forces acting on cells
+        boost::shared_ptr<GeneralisedLinearSpringForce<2> > p_force;
+        if (use_node_state_spring_force)
+        {
+            // The same force, but able to add to the simulation's node state arrays directly
+            p_force.reset(new NodeStateSpringForce<2>);
+        }
+        else
+        {
+            p_force.reset(new GeneralisedLinearSpringForce<2>);
+        }
+        p_force->SetMeinekeSpringStiffness(100.0); //normally 15.0 but 30 in all CellBased Papers; modified to stop crowding at base of crypt
+        p_force->SetCutOffLength(1.5);
+        p_simulator->AddForce(p_force);
+        // As there is a WntConcentration the stem cells aren't fixed so we use a CellRetainerForce
+        MAKE_PTR(CellRetainerForce<2>, p_retainer_force);
+        p_retainer_force->SetStemCellForceMagnitudeParameter(50.0);
+        p_simulator->AddForce(p_retainer_force);
+
+        // Set how cells get killed
+        if (params.bucketed_sloughing != 0.0)
+        {
+            // Only inspects cells that may have reached the top of the crypt; kills exactly the same cells.  A node
+            // moves at most the population's movement threshold in a timestep, plus the division separation if its
+            // cell divides.
+            double max_displacement_per_step = p_crypt->GetAbsoluteMovementThreshold()
+                                               + p_crypt->GetMeinekeDivisionSeparation();
+            MAKE_PTR_ARGS(HeightBucketedSloughingCellKiller<2>, p_cell_killer,
+                          (p_crypt, params.crypt_length, 1.0, max_displacement_per_step));
+            p_simulator->AddCellKiller(p_cell_killer);
+        }
+        else
+        {
+            MAKE_PTR_ARGS(SloughingCellKiller<2>, p_cell_killer,(p_crypt, params.crypt_length));
+            p_simulator->AddCellKiller(p_cell_killer);
+        }
+
+        // Set boundary conditions
+        MAKE_PTR_ARGS(CryptSimulationBoundaryCondition<2>, p_bc, (p_crypt));
+        p_bc->SetUseJiggledBottomCells(true);
+        p_simulator->AddCellPopulationBoundaryCondition(p_bc);
+
+        // Track cell volumes
+        boost::shared_ptr<VolumeTrackingModifier<2> > p_vol_tracker;
+        if (use_node_state_spring_force)
+        {
+            // The same volumes, but computed from the simulation's node state arrays
+            p_vol_tracker.reset(new NodeStateVolumeTrackingModifier);
+        }
+        else
+        {
+            p_vol_tracker.reset(new VolumeTrackingModifier<2>);
+        }
+        MAKE_PTR_ARGS(TimedSimulationModifier<2>, p_timed_vol_tracker, (p_vol_tracker, p_timer, CryptPhaseTimer::VOLUME_TRACKING));
+        p_simulator->AddSimulationModifier(p_timed_vol_tracker);
+
+        // Track how large the population gets
+        MAKE_PTR(PopulationSizeTrackingModifier<2>, p_size_tracker);
+        p_simulator->AddSimulationModifier(p_size_tracker);
+
+        // Periodically report progress to a status file in our output folder, for monitoring long runs
+        if (params.progress_interval > 0.0)
+        {
+            MAKE_PTR_ARGS(ProgressReportingModifier<2>, p_progress, (params.progress_interval, params.end_time));
+            p_progress->SetStatusFile(FileFinder("status.txt", mOutputFolder));
+            p_simulator->AddSimulationModifier(p_progress);
+        }
+
+        // Record the population compactly, for visualising long runs (see SnapshotReader)
+        if (params.snapshot_interval > 0.0)
+        {
+            unsigned steps_between_snapshots = std::max(1u, (unsigned)(params.snapshot_interval*params.dt_divisor + 0.5));
+            MAKE_PTR_ARGS(SnapshotWritingModifier<2>, p_snapshots, (steps_between_snapshots));
+            p_simulator->AddSimulationModifier(p_snapshots);
+        }
+
+        // This must be the last modifier added, so that it can time output
+        MAKE_PTR(PhaseTimingModifier<2>, p_timing_modifier);
+        p_timing_modifier->SetTimer(p_timer);
+        p_simulator->AddSimulationModifier(p_timing_modifier);
+    }
+    boost::shared_ptr<PopulationSizeTrackingModifier<2> > p_size_tracker
+            = p_simulator->GetSimulationModifier<PopulationSizeTrackingModifier<2> >();
+    assert(p_size_tracker);
+
+    // Set some extra parameters, which aren't archived
+    p_simulator->SetOutputDirectory(mOutputFolder.GetRelativePath(test_output_root));
+    // The output we're really interested in; optionally written from a background thread (see below)
+    if (params.async_output == 0.0)
+    {
+        p_simulator->SetOutputDivisionLocations(true);
+    }
+    p_simulator->SetBatchBirths(params.batch_births != 0.0);
+    p_simulator->SetDt(1.0/params.dt_divisor);
+    if (params.snapshot_interval > 0.0)
+    {
+        // Snapshots replace the text visualiser output, which is then only written at the start and end
+        p_simulator->SetSamplingTimestepMultiple((unsigned)(params.end_time*params.dt_divisor + 0.5));
+    }
+    else
+    {
+        p_simulator->SetSamplingTimestepMultiple(params.dt_divisor);
+    }
+    if (use_node_state_spring_force)
+    {
+        p_simulator->SetUseNodeStateArrays(true);
+        p_simulator->SetFusedPositionUpdate(params.fused_update != 0.0);
+        p_simulator->SetSemiImplicitPositionUpdate(params.implicit_springs != 0.0);
+    }
 
     // The simulation depends on the Wnt concentration
     WntConcentration<2>::Instance()->SetType(LINEAR);
-    WntConcentration<2>::Instance()->SetCellPopulation(crypt);
-    WntConcentration<2>::Instance()->SetCryptLength(PARAM(crypt_length));
-
-    // Set forces acting on cells
-    MAKE_PTR(GeneralisedLinearSpringForce<2>, p_force);
-    p_force->SetMeinekeSpringStiffness(100.0); //normally 15.0 but 30 in all CellBased Papers; modified to stop crowding at base of crypt
-    p_force->SetCutOffLength(1.5);
-    simulator.AddForce(p_force);
-    // As there is a WntConcentration the stem cells aren't fixed so we use a CellRetainerForce
-    MAKE_PTR(CellRetainerForce<2>, p_retainer_force);
-    p_retainer_force->SetStemCellForceMagnitudeParameter(50.0);
-    simulator.AddForce(p_retainer_force);
-
-    // Set how cells get killed
-    MAKE_PTR_ARGS(SloughingCellKiller<2>, p_cell_killer,(&crypt, PARAM(crypt_length)));
-    simulator.AddCellKiller(p_cell_killer);
-
-    // Set boundary conditions
-    MAKE_PTR_ARGS(CryptSimulationBoundaryCondition<2>, p_bc, (&crypt));
-    p_bc->SetUseJiggledBottomCells(true);
-    simulator.AddCellPopulationBoundaryCondition(p_bc);
-
-    // Track cell volumes
-    MAKE_PTR(VolumeTrackingModifier<2>, p_vol_tracker);
-    simulator.AddSimulationModifier(p_vol_tracker);
+    WntConcentration<2>::Instance()->SetCellPopulation(p_simulator->rGetCellPopulation());
+    WntConcentration<2>::Instance()->SetCryptLength(params.crypt_length);
+
+    // Optionally share the spring forces between processes; every process runs this same simulation
+    boost::shared_ptr<CryptSlabDecomposition> p_decomposition;
+    if (params.distributed != 0.0)
+    {
+        p_decomposition.reset(new CryptSlabDecomposition(params.crypt_length));
+        if (p_decomposition->GetNumSlabs() > 1u && !PetscTools::IsIsolated())
+        {
+            EXCEPTION("A distributed simulation must be run with processes isolated, so each writes its own output.");
+        }
+        p_simulator->SetSlabDecomposition(p_decomposition);
+    }
+
+    p_simulator->SetPhaseTimer(p_timer);
 
     //
-    // Run the simulation
+    // Run the simulation, taking a checkpoint every checkpoint_interval hours if required
     //
-    simulator.Solve();
+    if (p_checkpoints)
+    {
+        p_simulator->SetCheckpointing(p_checkpoints, params.checkpoint_interval, division_logs);
+    }
+    p_simulator->SetCountAllocations(params.count_allocations != 0.0);
+    std::vector<double> writer_stats(AsyncRecordWriter::NUM_STATISTICS, 0.0);
+    // Solve writes its results to a folder named after the time it starts at
+    std::stringstream results_folder;
+    results_folder << "results_from_time_" << SimulationTime::Instance()->GetTime();
+    division_logs.push_back(FileFinder(results_folder.str() + "/divisions.dat", mOutputFolder));
+    boost::shared_ptr<AsyncRecordWriter> p_writer;
+    if (params.async_output != 0.0)
+    {
+        p_writer.reset(new AsyncRecordWriter);
+        p_simulator->SetAsyncDivisionOutput(p_writer);
+    }
+
+    p_simulator->SetEndTime(params.end_time);
+    p_simulator->Solve();
+    p_simulator->FinishAllocationCounting();
+    if (p_writer)
+    {
+        // Wait for the division locations to reach the filesystem
+        p_writer->Close();
+        writer_stats = p_writer->GetStatistics();
+    }
+
+    // Combine the log from Solve with that of any resumed checkpoint
+    if (division_logs.size() == 1u)
+    {
+        mDivisionsFile = division_logs[0];
+    }
+    else
+    {
+        mDivisionsFile = FileFinder("divisions.dat", mOutputFolder);
+        CryptProliferationSimulation::ConcatenateDivisionLogs(division_logs, mDivisionsFile);
+    }
+
+    // Record statistics on how the simulation ran
+    SetStatisticsOutput("peak_num_cells", p_size_tracker->GetPeakNumCells());
+    SetStatisticsOutput("peak_num_nodes", p_size_tracker->GetPeakNumNodes());
+    SetStatisticsOutput("peak_num_ghost_nodes", p_size_tracker->GetPeakNumGhostNodes());
+    // Phase timings have two columns: wall-clock seconds, number of calls; one row per CryptPhaseTimer::Phase
+    std::vector<unsigned> timings_shape(2);
+    timings_shape[0] = CryptPhaseTimer::NUM_PHASES;
+    timings_shape[1] = 2u;
+    SetStatisticsOutput("timings", p_timer->GetTimings(), timings_shape);
+    // Estimated peak bytes held by cells, cell-cycle models, cell properties, and nodes
+    SetStatisticsOutput("peak_bytes", p_size_tracker->rGetPeakBytes(),
+                        std::vector<unsigned>(1, PopulationSizeTrackingModifier<2>::NUM_MEMORY_CATEGORIES));
+    // Timesteps counted, total allocations, total bytes allocated, maximum allocations in one timestep;
+    // all zero unless count_allocations is set and the project was built with CRYPT_COUNT_ALLOCATIONS
+    std::vector<double> allocation_stats = p_simulator->GetAllocationStatistics();
+    SetStatisticsOutput("allocations", allocation_stats, std::vector<unsigned>(1, allocation_stats.size()));
+    OutputFileHandler raw_results_handler(mOutputFolder, false);
+    out_stream p_timings_file = raw_results_handler.OpenOutputFile("phase_timings.txt");
+    p_timer->WriteSummary(p_timings_file);
+    p_timings_file->close();
+    // Hardware counter totals, all zero unless enable_perf_counters is set and counters are available;
+    // one row per CryptPhaseTimer::Phase, one column per PerfCounterGroup::Counter
+    std::vector<unsigned> counters_shape(2);
+    counters_shape[0] = CryptPhaseTimer::NUM_PHASES;
+    counters_shape[1] = PerfCounterGroup::NUM_COUNTERS;
+    SetStatisticsOutput("perf_counters", p_timer->GetCounterTotals(), counters_shape);
+    // Records written, bytes, writes blocked on a full queue, seconds blocked, peak queue length, flushes
+    // (see AsyncRecordWriter::Statistic); all zero unless async_output is set
+    SetStatisticsOutput("output_writer", writer_stats, std::vector<unsigned>(1, writer_stats.size()));
+    if (params.enable_perf_counters != 0.0)
+    {
+        // The summary table goes alongside the divisions output
+        OutputFileHandler divisions_handler(mDivisionsFile.GetParent(), false);
+        out_stream p_counters_file = divisions_handler.OpenOutputFile("perf_counters.txt");
+        p_timer->WriteCounterSummary(p_counters_file);
+        p_counters_file->close();
+    }
 
-    // Clean up singletons
-    WntConcentration<2>::Destroy();
-    RandomNumberGenerator::Destroy();
-    SimulationTime::Destroy();
+    // Distributed runs give the same results on every process, so only the first stores them
+    if (p_cache && (!p_decomposition || p_decomposition->GetLocalSlab() == 0u))
+    {
+        std::vector<FileFinder> cache_files;
+        cache_files.push_back(mDivisionsFile);
+        cache_files.push_back(WriteStatisticsOutputs());
+        p_cache->Store(cache_files);
+    }
 }
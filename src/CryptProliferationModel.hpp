@@ -36,11 +36,19 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef CRYPTPROLIFERATIONMODEL_HPP_
 #define CRYPTPROLIFERATIONMODEL_HPP_
 
+#include <map>
+
 #include "AbstractSystemWithOutputs.hpp"
 
 #include "FileFinder.hpp"
 
 #include "Environment.hpp"
+#include "AbstractValue.hpp"
+
+#include "ResultCache.hpp"
+#include "CheckpointStore.hpp"
+#include "RestrictedEnvironment.hpp"
+#include "CryptModelParameters.hpp"
 
 /**
  * This class wraps a particular kind of crypt simulation as a functional curation model.
@@ -76,6 +84,12 @@ public:
      */
     CryptProliferationModel(ModelType modelType);
 
+    /**
+     * Destructor.  Unbinds our parameter values from the parameters environment, which a protocol may
+     * still hold.
+     */
+    ~CryptProliferationModel();
+
     /**
      * Get the simulation outputs of interest in the Functional Curation data structures.
      * SolveModel must have been called prior to using this method.
@@ -85,10 +99,45 @@ public:
     /**
      * Solve the model - initialises (if not already done) and runs a cell-based simulation.
      *
+     * If a result cache is in use (see SetResultCache) and holds results for the current parameter values,
+     * these are returned instead of running a simulation.
+     *
+     * If the checkpoint_interval parameter is positive, the simulation is archived every checkpoint_interval
+     * hours of simulated time, and at the end, replacing the previous checkpoint (see SetCheckpointFolder).  A
+     * later run with the same parameters, other than perhaps a later end_time, then carries on from the latest
+     * checkpoint rather than starting again, giving exactly the same results as a run that was never stopped.
+     *
      * @param endPoint  ignored
      */
     void SolveModel(double endPoint);
 
+    /**
+     * Set whether to cache simulation results on disk, keyed by the full set of model parameters together
+     * with the model type and code version, so that repeated runs with the same parameters (e.g. when only
+     * changing protocol post-processing) reuse earlier results.  By default the cache is bypassed.
+     *
+     * @param mode  how to use the cache
+     * @param rCacheFolder  where to store cached results; must be within CHASTE_TEST_OUTPUT
+     */
+    void SetResultCache(ResultCache::Mode mode,
+                        const FileFinder& rCacheFolder=FileFinder("CryptProliferationResultCache",
+                                                                  RelativeTo::ChasteTestOutput));
+
+    /**
+     * Set where checkpoints are stored, if the checkpoint_interval parameter is positive.  Each set of
+     * parameters (ignoring end_time) has its own checkpoint; see CheckpointStore.
+     *
+     * @param rCheckpointFolder  where to store checkpoints; must be within CHASTE_TEST_OUTPUT
+     */
+    void SetCheckpointFolder(const FileFinder& rCheckpointFolder);
+
+    /**
+     * Version number for the simulation code, included in result cache and checkpoint keys.  This must be
+     * incremented whenever a code change could alter simulation results or what a checkpoint holds, so that
+     * stale cached results and checkpoints aren't used.
+     */
+    static const unsigned SIMULATION_CODE_VERSION = 3u;
+
 
     /**
      * Set the bindings from prefix to namespace URI used by the protocol for accessing model
@@ -102,14 +151,98 @@ public:
     void SetNamespaceBindings(const std::map<std::string, std::string>& rNamespaceBindings);
 
 private:
-    /** Input parameters for the model. */
-    EnvironmentPtr mpModelParameters;
+    /** Input parameters for the model, as seen by protocols. */
+    boost::shared_ptr<RestrictedEnvironment> mpModelParameters;
+
+    /** The current parameter values, kept up to date with mpModelParameters. */
+    CryptModelParameters mParameters;
 
     /** Which specific kind of model this is. */
     ModelType mModelType;
 
     /** Where to place temporary model outputs. */
     FileFinder mOutputFolder;
+
+    /** How to use the result cache. */
+    ResultCache::Mode mResultCacheMode;
+
+    /** Where cached results are stored. */
+    FileFinder mResultCacheFolder;
+
+    /** Where checkpoints are stored. */
+    FileFinder mCheckpointFolder;
+
+    /**
+     * The complete division log from the last call to SolveModel.  If the simulation carried on from a
+     * checkpoint, this joins the checkpoint's log to that of the rest of the run.
+     */
+    FileFinder mDivisionsFile;
+
+    /** An output other than the division log, describing how a simulation ran. */
+    struct StatisticsOutput
+    {
+        /** The array shape, or empty for a scalar output. */
+        std::vector<unsigned> mShape;
+
+        /** The values, in row-major order. */
+        std::vector<double> mValues;
+    };
+
+    /**
+     * Outputs other than the division log, describing how the last simulation ran (e.g. population size,
+     * timings, memory use).  These are computed by SolveModel and returned by GetOutputs.
+     */
+    std::map<std::string, StatisticsOutput> mStatisticsOutputs;
+
+    /**
+     * Record a scalar statistics output.
+     *
+     * @param rName  the output name, which must be listed in mOutputNames
+     * @param value  its value
+     */
+    void SetStatisticsOutput(const std::string& rName, double value);
+
+    /**
+     * Record an array statistics output.
+     *
+     * @param rName  the output name, which must be listed in mOutputNames
+     * @param rValues  the array entries, in row-major order
+     * @param rShape  the array shape; its extents must multiply to rValues.size()
+     */
+    void SetStatisticsOutput(const std::string& rName, const std::vector<double>& rValues,
+                             const std::vector<unsigned>& rShape);
+
+    /**
+     * Write the statistics outputs to a file in our output folder, so they can be cached.
+     *
+     * @return  the file written
+     */
+    FileFinder WriteStatisticsOutputs() const;
+
+    /**
+     * Read the statistics outputs from a file written by WriteStatisticsOutputs.
+     *
+     * @param rFile  the file to read
+     */
+    void ReadStatisticsOutputs(const FileFinder& rFile);
+
+    /**
+     * @return  text identifying the model, code version and every parameter value
+     */
+    std::string GetParameterKey() const;
+
+    /**
+     * @return  text identifying everything that can affect the simulation results, for use as a cache key;
+     *     parameters which only control monitoring, extra outputs and checkpoints are left out, so cached statistics
+     *     outputs are those of whichever run stored the entry
+     */
+    std::string GetResultCacheKey() const;
+
+    /**
+     * @return  text identifying everything that can affect the simulation results other than the end time,
+     *     for use as a checkpoint key
+     */
+    std::string GetCheckpointKey() const;
 };
 
 #endif // CRYPTPROLIFERATIONMODEL_HPP_
@@ -0,0 +1,835 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "CryptProliferationSimulation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <boost/foreach.hpp>
+
+#include "AbstractCentreBasedCellPopulation.hpp"
+#include "MeshBasedCellPopulationWithGhostNodes.hpp"
+#include "StemCellProliferativeType.hpp"
+#include "WntConcentration.hpp"
+#include "RandomNumberGenerator.hpp"
+#include "AllocationCounter.hpp"
+#include "OutputFileHandler.hpp"
+#include "CellBasedSimulationArchiver.hpp"
+#include "NodeStateVolumeTrackingModifier.hpp"
+#include "TimedSimulationModifier.hpp"
+
+/**
+ * The longest step over which ghost nodes are moved at once.  The population moves them explicitly, by springs
+ * of stiffness 15 and unit damping, which is unstable for steps much over 1/70 hour.
+ */
+static const double MAX_GHOST_NODE_TIMESTEP = 1.0/120.0;
+
+CryptProliferationSimulation::CryptProliferationSimulation(AbstractCellPopulation<2>& rCellPopulation,
+                                                           bool deleteCellPopulationInDestructor,
+                                                           bool initialiseCells)
+    : OffLatticeSimulation<2>(rCellPopulation, deleteCellPopulationInDestructor, initialiseCells),
+      mCountAllocations(false),
+      mAllocationsAtStepStart(0ul),
+      mNumStepsCounted(0u),
+      mMaxAllocationsPerStep(0ul),
+      mDivisionsFile(0u),
+      mUseNodeStateArrays(false),
+      mpNodeState(new NodeStateArrays<2>),
+      mSemiImplicitPositionUpdate(false),
+      mTotalSolverIterations(0ul),
+      mFusedPositionUpdate(false),
+      mBatchBirths(false),
+      mCheckpointInterval(DOUBLE_UNSET)
+{
+}
+
+void CryptProliferationSimulation::SetAsyncDivisionOutput(boost::shared_ptr<AsyncRecordWriter> pWriter)
+{
+    mpOutputWriter = pWriter;
+}
+
+void CryptProliferationSimulation::SetBatchBirths(bool batchBirths)
+{
+    mBatchBirths = batchBirths;
+}
+
+void CryptProliferationSimulation::SetUseNodeStateArrays(bool useNodeStateArrays)
+{
+    mUseNodeStateArrays = useNodeStateArrays;
+}
+
+void CryptProliferationSimulation::SetSemiImplicitPositionUpdate(bool semiImplicitPositionUpdate)
+{
+    mSemiImplicitPositionUpdate = semiImplicitPositionUpdate;
+    if (semiImplicitPositionUpdate)
+    {
+        mUseNodeStateArrays = true;
+    }
+}
+
+unsigned long CryptProliferationSimulation::GetTotalSolverIterations() const
+{
+    return mTotalSolverIterations;
+}
+
+void CryptProliferationSimulation::SetFusedPositionUpdate(bool fusedPositionUpdate)
+{
+    mFusedPositionUpdate = fusedPositionUpdate;
+    if (fusedPositionUpdate)
+    {
+        mUseNodeStateArrays = true;
+    }
+}
+
+void CryptProliferationSimulation::SetSlabDecomposition(boost::shared_ptr<CryptSlabDecomposition> pDecomposition)
+{
+    mpSlabDecomposition = pDecomposition;
+    if (pDecomposition)
+    {
+        mUseNodeStateArrays = true;
+    }
+}
+
+const NodeStateArrays<2>& CryptProliferationSimulation::rGetNodeState() const
+{
+    return *mpNodeState;
+}
+
+void CryptProliferationSimulation::SetupSolve()
+{
+    OffLatticeSimulation<2>::SetupSolve();
+    mBucketedKillers.clear();
+    for (std::vector<boost::shared_ptr<AbstractCellKiller<2> > >::iterator iter = this->mCellKillers.begin();
+         iter != this->mCellKillers.end();
+         ++iter)
+    {
+        boost::shared_ptr<HeightBucketedSloughingCellKiller<2> > p_killer
+                = boost::dynamic_pointer_cast<HeightBucketedSloughingCellKiller<2> >(*iter);
+        if (p_killer)
+        {
+            mBucketedKillers.push_back(p_killer);
+        }
+    }
+    if (mFusedPositionUpdate && mSemiImplicitPositionUpdate)
+    {
+        EXCEPTION("The fused position update can't treat spring forces implicitly.");
+    }
+    if (mFusedPositionUpdate)
+    {
+        SetupFusedPositionUpdate();
+    }
+    if (mpSlabDecomposition)
+    {
+        SetupSlabDecomposition();
+    }
+    if (mUseNodeStateArrays)
+    {
+        SetupNodeStateVolumeTracking();
+    }
+    if (mpOutputWriter)
+    {
+        OutputFileHandler handler(this->mSimulationOutputDirectory + "/", false);
+        mDivisionsFile = mpOutputWriter->OpenFile(handler.GetOutputDirectoryFullPath() + "divisions.dat");
+    }
+}
+
+void CryptProliferationSimulation::SetupNodeStateVolumeTracking()
+{
+    // The volume tracker may be timed, in which case it is wrapped
+    for (unsigned i=0; i<this->mSimulationModifiers.size(); i++)
+    {
+        boost::shared_ptr<AbstractCellBasedSimulationModifier<2,2> > p_modifier = this->mSimulationModifiers[i];
+        boost::shared_ptr<TimedSimulationModifier<2> > p_timed_modifier = boost::dynamic_pointer_cast<TimedSimulationModifier<2> >(p_modifier);
+        if (p_timed_modifier)
+        {
+            p_modifier = p_timed_modifier->GetModifier();
+        }
+        boost::shared_ptr<NodeStateVolumeTrackingModifier> p_volume_tracker = boost::dynamic_pointer_cast<NodeStateVolumeTrackingModifier>(p_modifier);
+        if (p_volume_tracker)
+        {
+            p_volume_tracker->SetNodeState(mpNodeState);
+        }
+    }
+}
+
+void CryptProliferationSimulation::SetupFusedPositionUpdate()
+{
+    // Forces are summed in the order they were added, so the spring force must come first
+    mpFusedSpringForce.reset();
+    mpFusedRetainerForce.reset();
+    if (!mForceCollection.empty())
+    {
+        mpFusedSpringForce = boost::dynamic_pointer_cast<NodeStateSpringForce<2> >(mForceCollection[0]);
+    }
+    if (mForceCollection.size() > 1u)
+    {
+        mpFusedRetainerForce = boost::dynamic_pointer_cast<CellRetainerForce<2> >(mForceCollection[1]);
+    }
+    if (!mpFusedSpringForce || mForceCollection.size() > 2u || (mForceCollection.size() == 2u && !mpFusedRetainerForce))
+    {
+        EXCEPTION("The fused position update needs a NodeStateSpringForce followed by at most a CellRetainerForce.");
+    }
+
+    mpFusedBoundaryCondition.reset();
+    if (!this->mBoundaryConditions.empty())
+    {
+        mpFusedBoundaryCondition = boost::dynamic_pointer_cast<CryptSimulationBoundaryCondition<2> >(this->mBoundaryConditions[0]);
+    }
+    if (this->mBoundaryConditions.size() > 1u || (this->mBoundaryConditions.size() == 1u && !mpFusedBoundaryCondition))
+    {
+        EXCEPTION("The fused position update can only impose a CryptSimulationBoundaryCondition.");
+    }
+}
+
+void CryptProliferationSimulation::SetupSlabDecomposition()
+{
+    if (mSemiImplicitPositionUpdate)
+    {
+        EXCEPTION("The semi-implicit position update can't share spring forces between processes.");
+    }
+    // Forces are summed straight after the springs, so nothing else may have been added to the arrays yet
+    unsigned num_spring_forces = 0u;
+    for (unsigned i=0; i<mForceCollection.size(); i++)
+    {
+        boost::shared_ptr<NodeStateSpringForce<2> > p_spring_force = boost::dynamic_pointer_cast<NodeStateSpringForce<2> >(mForceCollection[i]);
+        if (p_spring_force)
+        {
+            p_spring_force->SetSlabDecomposition(mpSlabDecomposition);
+            num_spring_forces++;
+        }
+    }
+    if (num_spring_forces != 1u || !boost::dynamic_pointer_cast<NodeStateSpringForce<2> >(mForceCollection[0]))
+    {
+        EXCEPTION("Sharing spring forces between processes needs the first force to be the only NodeStateSpringForce.");
+    }
+}
+
+void CryptProliferationSimulation::SumSlabForces()
+{
+    if (mpSlabDecomposition)
+    {
+        for (unsigned dim=0; dim<2; dim++)
+        {
+            mpSlabDecomposition->SumForces(mpNodeState->GetForces(dim), mpNodeState->GetNumNodes());
+        }
+    }
+}
+
+unsigned CryptProliferationSimulation::DoCellBirth()
+{
+    if (!mpOutputWriter && mBucketedKillers.empty() && !mBatchBirths)
+    {
+        return OffLatticeSimulation<2>::DoCellBirth();
+    }
+
+    // This follows AbstractCellBasedSimulation::DoCellBirth, with division locations queued for the writer,
+    // new cells passed to the killers that need them, and optionally daughters added after all cells have divided
+    if (this->mNoBirth)
+    {
+        return 0;
+    }
+    unsigned num_births_this_step = 0;
+    for (AbstractCellPopulation<2>::Iterator cell_iter = this->mrCellPopulation.Begin();
+         cell_iter != this->mrCellPopulation.End();
+         ++cell_iter)
+    {
+        double cell_age = cell_iter->GetAge();
+        if (cell_age > 0.0 && cell_iter->ReadyToDivide() && this->mrCellPopulation.IsRoomToDivide(*cell_iter))
+        {
+            // Dividing and choosing the daughter's location use random numbers, so are done in the usual order
+            CellPtr p_new_cell = cell_iter->Divide();
+            c_vector<double, 2> new_location = this->CalculateCellDivisionVector(*cell_iter);
+            if (mBatchBirths)
+            {
+                PendingDivision division;
+                division.mpParent = *cell_iter;
+                division.mpDaughter = p_new_cell;
+                division.mLocation = new_location;
+                division.mParentAge = cell_age;
+                mPendingDivisions.push_back(division);
+            }
+            else
+            {
+                RecordDivision(*cell_iter, cell_age);
+                AddDaughterCell(*cell_iter, p_new_cell, new_location);
+            }
+            num_births_this_step++;
+        }
+    }
+
+    // Parents don't move once they have divided, so are recorded where they were when they did
+    for (std::vector<PendingDivision>::iterator it = mPendingDivisions.begin(); it != mPendingDivisions.end(); ++it)
+    {
+        RecordDivision(it->mpParent, it->mParentAge);
+        AddDaughterCell(it->mpParent, it->mpDaughter, it->mLocation);
+    }
+    mPendingDivisions.clear();
+
+    return num_births_this_step;
+}
+
+void CryptProliferationSimulation::RecordDivision(CellPtr pParent, double parentAge)
+{
+    if (mpOutputWriter)
+    {
+        // Columns are time, x co-ord, y co-ord, parent age
+        c_vector<double, 2> cell_location = this->mrCellPopulation.GetLocationOfCellCentre(pParent);
+        std::vector<double> division_record(4u);
+        division_record[0] = SimulationTime::Instance()->GetTime();
+        division_record[1] = cell_location[0];
+        division_record[2] = cell_location[1];
+        division_record[3] = parentAge;
+        mpOutputWriter->WriteRow(mDivisionsFile, division_record);
+    }
+    else if (this->mOutputDivisionLocations)
+    {
+        c_vector<double, 2> cell_location = this->mrCellPopulation.GetLocationOfCellCentre(pParent);
+        *this->mpDivisionLocationFile << SimulationTime::Instance()->GetTime() << "\t";
+        for (unsigned i=0; i<2u; i++)
+        {
+            *this->mpDivisionLocationFile << cell_location[i] << "\t";
+        }
+        *this->mpDivisionLocationFile << "\t" << parentAge << "\n";
+    }
+}
+
+void CryptProliferationSimulation::AddDaughterCell(CellPtr pParent, CellPtr pDaughter, const c_vector<double, 2>& rLocation)
+{
+    this->mrCellPopulation.AddCell(pDaughter, rLocation, pParent);
+    for (unsigned i=0; i<mBucketedKillers.size(); i++)
+    {
+        mBucketedKillers[i]->AddCell(pDaughter);
+    }
+}
+
+void CryptProliferationSimulation::SetCountAllocations(bool countAllocations)
+{
+    mCountAllocations = countAllocations && AllocationCounter::IsAvailable();
+}
+
+void CryptProliferationSimulation::RecordStepAllocations()
+{
+    unsigned long num_allocations = AllocationCounter::GetNumAllocations();
+    if (AllocationCounter::IsCounting())
+    {
+        unsigned long allocations_this_step = num_allocations - mAllocationsAtStepStart;
+        if (allocations_this_step > mMaxAllocationsPerStep)
+        {
+            mMaxAllocationsPerStep = allocations_this_step;
+        }
+        mNumStepsCounted++;
+    }
+    else
+    {
+        // First timestep: start counting from here, carrying on from any earlier call to Solve
+        if (mNumStepsCounted == 0u)
+        {
+            AllocationCounter::Reset();
+            num_allocations = 0ul;
+        }
+        AllocationCounter::StartCounting();
+    }
+    mAllocationsAtStepStart = num_allocations;
+}
+
+void CryptProliferationSimulation::FinishAllocationCounting()
+{
+    if (mCountAllocations && AllocationCounter::IsCounting())
+    {
+        RecordStepAllocations();
+        AllocationCounter::StopCounting();
+    }
+}
+
+std::vector<double> CryptProliferationSimulation::GetAllocationStatistics() const
+{
+    std::vector<double> stats(4u, 0.0);
+    if (mCountAllocations)
+    {
+        stats[0] = mNumStepsCounted;
+        stats[1] = AllocationCounter::GetNumAllocations();
+        stats[2] = AllocationCounter::GetNumBytesAllocated();
+        stats[3] = mMaxAllocationsPerStep;
+    }
+    return stats;
+}
+
+void CryptProliferationSimulation::SetPhaseTimer(boost::shared_ptr<CryptPhaseTimer> pTimer)
+{
+    mpPhaseTimer = pTimer;
+}
+
+CryptPhaseTimer::Phase CryptProliferationSimulation::GetForcePhase(boost::shared_ptr<AbstractForce<2> > pForce) const
+{
+    if (boost::dynamic_pointer_cast<CellRetainerForce<2> >(pForce))
+    {
+        return CryptPhaseTimer::RETAINER_FORCE;
+    }
+    return CryptPhaseTimer::SPRING_FORCE;
+}
+
+void CryptProliferationSimulation::SetCheckpointing(boost::shared_ptr<CheckpointStore> pCheckpoints, double interval,
+                                                    const std::vector<FileFinder>& rEarlierDivisionLogs)
+{
+    if (interval <= 0.0)
+    {
+        EXCEPTION("The interval between checkpoints must be positive.");
+    }
+    mpCheckpoints = pCheckpoints;
+    mCheckpointInterval = interval;
+    mEarlierDivisionLogs = rEarlierDivisionLogs;
+}
+
+bool CryptProliferationSimulation::IsCheckpointTime() const
+{
+    SimulationTime* p_time = SimulationTime::Instance();
+    if (!mpCheckpoints || p_time->GetTimeStepsElapsed() == 0u)
+    {
+        // Solve has only just started, perhaps from this very checkpoint
+        return false;
+    }
+    if (p_time->IsFinished())
+    {
+        // So that the run can be extended to a later end time
+        return true;
+    }
+    double time = p_time->GetTime();
+    double nearest_checkpoint_time = floor(time/mCheckpointInterval + 0.5)*mCheckpointInterval;
+    return fabs(time - nearest_checkpoint_time) < 0.5*this->mDt;
+}
+
+void CryptProliferationSimulation::SaveCheckpoint()
+{
+    // The division log so far must all be on disk to be copied
+    std::vector<FileFinder> division_logs(mEarlierDivisionLogs);
+    if (mpOutputWriter || this->mOutputDivisionLocations)
+    {
+        if (mpOutputWriter)
+        {
+            mpOutputWriter->Sync();
+        }
+        else
+        {
+            this->mpDivisionLocationFile->flush();
+        }
+        division_logs.push_back(FileFinder(this->mSimulationOutputDirectory + "/divisions.dat",
+                                           RelativeTo::ChasteTestOutput));
+    }
+
+    // Chaste archives a simulation into its output directory, so point that at the new checkpoint.  This is set
+    // directly, since SetOutputDirectory would also move where the rest of this Solve writes its results.
+    FileFinder checkpoint = mpCheckpoints->BeginCheckpoint();
+    std::string output_directory = this->mOutputDirectory;
+    this->mOutputDirectory = checkpoint.GetRelativePath(FileFinder("", RelativeTo::ChasteTestOutput));
+    CellBasedSimulationArchiver<2, CryptProliferationSimulation>::Save(this);
+    this->mOutputDirectory = output_directory;
+
+    ConcatenateDivisionLogs(division_logs, FileFinder("divisions.dat", checkpoint));
+    mpCheckpoints->CommitCheckpoint(SimulationTime::Instance()->GetTime());
+}
+
+void CryptProliferationSimulation::ConcatenateDivisionLogs(const std::vector<FileFinder>& rLogs,
+                                                           const FileFinder& rDestination)
+{
+    std::ofstream destination(rDestination.GetAbsolutePath().c_str());
+    BOOST_FOREACH(const FileFinder& r_log, rLogs)
+    {
+        std::ifstream log(r_log.GetAbsolutePath().c_str());
+        // Copying an empty stream would mark the destination as failed
+        if (log.peek() != std::ifstream::traits_type::eof())
+        {
+            destination << log.rdbuf();
+        }
+    }
+    destination.close();
+    if (!destination)
+    {
+        EXCEPTION("Unable to write the division log " << rDestination.GetAbsolutePath());
+    }
+}
+
+void CryptProliferationSimulation::UpdateCellPopulation()
+{
+    if (IsCheckpointTime())
+    {
+        // Nothing has happened yet this timestep, so this is exactly the state a resumed Solve starts from
+        SaveCheckpoint();
+    }
+    if (mCountAllocations)
+    {
+        RecordStepAllocations();
+    }
+    if (mpOutputWriter && SimulationTime::Instance()->GetTimeStepsElapsed() % this->mSamplingTimestepMultiple == 0)
+    {
+        // Results were sampled at the end of the last timestep, so make division locations up to here visible too
+        mpOutputWriter->Flush();
+    }
+
+    if (!mpPhaseTimer)
+    {
+        OffLatticeSimulation<2>::UpdateCellPopulation();
+        return;
+    }
+
+    // A new timestep is starting, so any output from the last one has finished
+    mpPhaseTimer->EndPhase(CryptPhaseTimer::OUTPUT);
+    mpPhaseTimer->EndPhase(CryptPhaseTimer::TIMESTEP);
+    mpPhaseTimer->BeginPhase(CryptPhaseTimer::TIMESTEP);
+
+    // This follows AbstractCellBasedSimulation::UpdateCellPopulation, with timing added
+    mpPhaseTimer->BeginPhase(CryptPhaseTimer::SLOUGHING);
+    unsigned deaths_this_step = this->DoCellRemoval();
+    this->mNumDeaths += deaths_this_step;
+    mpPhaseTimer->EndPhase(CryptPhaseTimer::SLOUGHING);
+
+    mpPhaseTimer->BeginPhase(CryptPhaseTimer::CELL_CYCLE);
+    unsigned births_this_step = this->DoCellBirth();
+    this->mNumBirths += births_this_step;
+    mpPhaseTimer->EndPhase(CryptPhaseTimer::CELL_CYCLE);
+
+    bool births_or_death_occurred = ((births_this_step>0) || (deaths_this_step>0));
+
+    mpPhaseTimer->BeginPhase(CryptPhaseTimer::REMESH);
+    if (this->mUpdateCellPopulation)
+    {
+        this->mrCellPopulation.Update(births_or_death_occurred);
+    }
+    else if (births_or_death_occurred)
+    {
+        EXCEPTION("CellPopulation has had births or deaths but mUpdateCellPopulation is set to false, please set it to true.");
+    }
+    mpPhaseTimer->EndPhase(CryptPhaseTimer::REMESH);
+}
+
+void CryptProliferationSimulation::UpdateCellLocationsAndTopology()
+{
+    if (!mpPhaseTimer && !mUseNodeStateArrays)
+    {
+        OffLatticeSimulation<2>::UpdateCellLocationsAndTopology();
+        return;
+    }
+
+    if (!mUseNodeStateArrays)
+    {
+        // This follows OffLatticeSimulation::UpdateCellLocationsAndTopology, with timing added
+        for (AbstractMesh<2,2>::NodeIterator node_iter = this->mrCellPopulation.rGetMesh().GetNodeIteratorBegin();
+             node_iter != this->mrCellPopulation.rGetMesh().GetNodeIteratorEnd();
+             ++node_iter)
+        {
+            node_iter->ClearAppliedForce();
+        }
+
+        for (std::vector<boost::shared_ptr<AbstractForce<2> > >::iterator iter = mForceCollection.begin();
+             iter != mForceCollection.end();
+             ++iter)
+        {
+            CryptPhaseTimer::Phase phase = GetForcePhase(*iter);
+            mpPhaseTimer->BeginPhase(phase);
+            (*iter)->AddForceContribution(this->mrCellPopulation);
+            mpPhaseTimer->EndPhase(phase);
+        }
+
+        mpPhaseTimer->BeginPhase(CryptPhaseTimer::POSITION_UPDATE);
+        UpdateNodePositions();
+        mpPhaseTimer->EndPhase(CryptPhaseTimer::POSITION_UPDATE);
+        return;
+    }
+
+    // Node indices are fixed from here until the next remesh
+    mpNodeState->Gather(this->mrCellPopulation);
+    if (mFusedPositionUpdate)
+    {
+        // Springs span two nodes, so need a pass of their own; everything else is done node by node
+        if (mpPhaseTimer)
+        {
+            mpPhaseTimer->BeginPhase(CryptPhaseTimer::SPRING_FORCE);
+        }
+        mpFusedSpringForce->AddForceContribution(*mpNodeState, this->mrCellPopulation);
+        SumSlabForces();
+        if (mpPhaseTimer)
+        {
+            mpPhaseTimer->EndPhase(CryptPhaseTimer::SPRING_FORCE);
+            mpPhaseTimer->BeginPhase(CryptPhaseTimer::POSITION_UPDATE);
+        }
+        FusedUpdateNodePositions();
+        if (mpPhaseTimer)
+        {
+            mpPhaseTimer->EndPhase(CryptPhaseTimer::POSITION_UPDATE);
+        }
+        return;
+    }
+
+    bool node_forces_used = false;
+    bool springs_added_to_solver = false;
+    if (mSemiImplicitPositionUpdate)
+    {
+        mSpringSolver.Reset(mpNodeState->GetNumNodes());
+    }
+    for (std::vector<boost::shared_ptr<AbstractForce<2> > >::iterator iter = mForceCollection.begin();
+         iter != mForceCollection.end();
+         ++iter)
+    {
+        CryptPhaseTimer::Phase phase = GetForcePhase(*iter);
+        if (mpPhaseTimer)
+        {
+            mpPhaseTimer->BeginPhase(phase);
+        }
+        boost::shared_ptr<NodeStateSpringForce<2> > p_spring_force = boost::dynamic_pointer_cast<NodeStateSpringForce<2> >(*iter);
+        boost::shared_ptr<CellRetainerForce<2> > p_retainer_force = boost::dynamic_pointer_cast<CellRetainerForce<2> >(*iter);
+        if (p_spring_force)
+        {
+            if (mSemiImplicitPositionUpdate)
+            {
+                p_spring_force->AddForceContribution(*mpNodeState, this->mrCellPopulation, &mSpringSolver);
+                springs_added_to_solver = true;
+            }
+            else
+            {
+                p_spring_force->AddForceContribution(*mpNodeState, this->mrCellPopulation);
+                SumSlabForces();
+            }
+        }
+        else if (p_retainer_force)
+        {
+            p_retainer_force->AddForceContribution(*mpNodeState, this->mrCellPopulation);
+        }
+        else
+        {
+            if (!node_forces_used)
+            {
+                for (AbstractMesh<2,2>::NodeIterator node_iter = this->mrCellPopulation.rGetMesh().GetNodeIteratorBegin();
+                     node_iter != this->mrCellPopulation.rGetMesh().GetNodeIteratorEnd();
+                     ++node_iter)
+                {
+                    node_iter->ClearAppliedForce();
+                }
+                node_forces_used = true;
+            }
+            (*iter)->AddForceContribution(this->mrCellPopulation);
+        }
+        if (mpPhaseTimer)
+        {
+            mpPhaseTimer->EndPhase(phase);
+        }
+    }
+
+    if (mpPhaseTimer)
+    {
+        mpPhaseTimer->BeginPhase(CryptPhaseTimer::POSITION_UPDATE);
+    }
+    if (node_forces_used)
+    {
+        mpNodeState->AddNodeForces(this->mrCellPopulation);
+    }
+    if (mSemiImplicitPositionUpdate && !springs_added_to_solver)
+    {
+        EXCEPTION("The semi-implicit position update needs a NodeStateSpringForce.");
+    }
+    UpdateNodePositionsFromNodeState();
+    if (mpPhaseTimer)
+    {
+        mpPhaseTimer->EndPhase(CryptPhaseTimer::POSITION_UPDATE);
+    }
+}
+
+void CryptProliferationSimulation::MoveGhostNodes()
+{
+    MeshBasedCellPopulationWithGhostNodes<2>* p_ghost_population
+            = dynamic_cast<MeshBasedCellPopulationWithGhostNodes<2>*>(&(this->mrCellPopulation));
+    if (p_ghost_population)
+    {
+        // Substeps are only needed for timesteps much larger than the usual explicit ones
+        unsigned num_substeps = std::max(1u, (unsigned)ceil(this->mDt/MAX_GHOST_NODE_TIMESTEP - 1e-6));
+        for (unsigned substep=0; substep<num_substeps; substep++)
+        {
+            p_ghost_population->UpdateGhostPositions(this->mDt/num_substeps);
+        }
+        for (AbstractMesh<2,2>::NodeIterator node_iter = p_ghost_population->rGetMesh().GetNodeIteratorBegin();
+             node_iter != p_ghost_population->rGetMesh().GetNodeIteratorEnd();
+             ++node_iter)
+        {
+            if (p_ghost_population->IsGhostNode(node_iter->GetIndex()))
+            {
+                mpNodeState->CopyLocation(&(*node_iter));
+            }
+        }
+    }
+}
+
+void CryptProliferationSimulation::UpdateNodePositionsFromNodeState()
+{
+    AbstractCentreBasedCellPopulation<2>* p_population
+            = static_cast<AbstractCentreBasedCellPopulation<2>*>(&(this->mrCellPopulation));
+
+    // Ghost nodes are moved by the population, by their own springs, before any real nodes move
+    MoveGhostNodes();
+
+    if (mSemiImplicitPositionUpdate)
+    {
+        for (AbstractCellPopulation<2>::Iterator cell_iter = this->mrCellPopulation.Begin();
+             cell_iter != this->mrCellPopulation.End();
+             ++cell_iter)
+        {
+            unsigned node_index = p_population->GetLocationIndexUsingCell(*cell_iter);
+            mSpringSolver.SetDampingTerm(node_index, p_population->GetDampingConstant(node_index)/this->mDt);
+        }
+        mSpringSolver.Solve(*mpNodeState);
+        mTotalSolverIterations += mSpringSolver.GetNumIterations();
+    }
+
+    // Boundary conditions need the locations from before the move
+    std::map<Node<2>*, c_vector<double, 2> > old_node_locations;
+    for (AbstractCellPopulation<2>::Iterator cell_iter = this->mrCellPopulation.Begin();
+         cell_iter != this->mrCellPopulation.End();
+         ++cell_iter)
+    {
+        unsigned node_index = p_population->GetLocationIndexUsingCell(*cell_iter);
+        c_vector<double, 2> old_location = mpNodeState->GetLocation(node_index);
+        c_vector<double, 2> displacement;
+        if (mSemiImplicitPositionUpdate)
+        {
+            displacement = mSpringSolver.GetDisplacement(node_index);
+        }
+        else
+        {
+            double damping_const = p_population->GetDampingConstant(node_index);
+            displacement = this->mDt*mpNodeState->GetForce(node_index)/damping_const;
+        }
+        if (norm_2(displacement) > p_population->GetAbsoluteMovementThreshold())
+        {
+            EXCEPTION("Cells are moving by: " << norm_2(displacement) << ", which is more than the AbsoluteMovementThreshold: use a smaller timestep to avoid this exception.");
+        }
+        mpNodeState->SetLocation(*p_population, node_index, old_location + displacement);
+        old_node_locations[p_population->GetNode(node_index)] = old_location;
+    }
+
+    for (std::vector<boost::shared_ptr<AbstractCellPopulationBoundaryCondition<2> > >::iterator bcs_iter = this->mBoundaryConditions.begin();
+         bcs_iter != this->mBoundaryConditions.end();
+         ++bcs_iter)
+    {
+        (*bcs_iter)->ImposeBoundaryCondition(old_node_locations);
+    }
+    for (std::vector<boost::shared_ptr<AbstractCellPopulationBoundaryCondition<2> > >::iterator bcs_iter = this->mBoundaryConditions.begin();
+         bcs_iter != this->mBoundaryConditions.end();
+         ++bcs_iter)
+    {
+        if (!((*bcs_iter)->VerifyBoundaryCondition()))
+        {
+            EXCEPTION("The cell population boundary conditions are incompatible.");
+        }
+    }
+
+    // Boundary conditions only know about Node objects
+    if (!this->mBoundaryConditions.empty())
+    {
+        for (std::map<Node<2>*, c_vector<double, 2> >::iterator iter = old_node_locations.begin();
+             iter != old_node_locations.end();
+             ++iter)
+        {
+            mpNodeState->CopyLocation(iter->first);
+        }
+    }
+}
+
+void CryptProliferationSimulation::FusedUpdateNodePositions()
+{
+    AbstractCentreBasedCellPopulation<2>* p_population
+            = static_cast<AbstractCentreBasedCellPopulation<2>*>(&(this->mrCellPopulation));
+    MoveGhostNodes();
+
+    // As in CryptSimulationBoundaryCondition::ImposeBoundaryCondition, stem cells are pinned if there's no Wnt
+    bool pin_stem_cells = false;
+    bool jiggle_bottom_cells = false;
+    if (mpFusedBoundaryCondition)
+    {
+        pin_stem_cells = !WntConcentration<2>::Instance()->IsWntSetUp();
+        if (pin_stem_cells)
+        {
+            WntConcentration<2>::Destroy();
+        }
+        jiggle_bottom_cells = mpFusedBoundaryCondition->GetUseJiggledBottomCells();
+    }
+
+    // Cells are visited in the same order as by the boundary condition, so random numbers are used in the same order
+    NodeStateValue* p_vertical_forces = mpNodeState->GetForces(1);
+    double threshold = p_population->GetAbsoluteMovementThreshold();
+    for (AbstractCellPopulation<2>::Iterator cell_iter = this->mrCellPopulation.Begin();
+         cell_iter != this->mrCellPopulation.End();
+         ++cell_iter)
+    {
+        unsigned node_index = p_population->GetLocationIndexUsingCell(*cell_iter);
+        if (mpFusedRetainerForce)
+        {
+            double magnitude = mpFusedRetainerForce->GetForceMagnitude(*cell_iter);
+            if (magnitude != 0.0)
+            {
+                p_vertical_forces[node_index] -= magnitude;
+            }
+        }
+
+        double damping_const = p_population->GetDampingConstant(node_index);
+        c_vector<double, 2> old_location = mpNodeState->GetLocation(node_index);
+        c_vector<double, 2> displacement = this->mDt*mpNodeState->GetForce(node_index)/damping_const;
+        if (norm_2(displacement) > threshold)
+        {
+            EXCEPTION("Cells are moving by: " << norm_2(displacement) << ", which is more than the AbsoluteMovementThreshold: use a smaller timestep to avoid this exception.");
+        }
+
+        mpNodeState->SetLocation(*p_population, node_index, old_location + displacement);
+        if (mpFusedBoundaryCondition)
+        {
+            Node<2>* p_node = p_population->GetNode(node_index);
+            if (pin_stem_cells && cell_iter->GetCellProliferativeType()->IsType<StemCellProliferativeType>())
+            {
+                p_node->rGetModifiableLocation() = old_location;
+            }
+            if (p_node->rGetLocation()[1] < 0.0)
+            {
+                p_node->rGetModifiableLocation()[1] = 0.0;
+                if (jiggle_bottom_cells)
+                {
+                    p_node->rGetModifiableLocation()[1] = 0.05*RandomNumberGenerator::Instance()->ranf();
+                }
+            }
+            mpNodeState->CopyLocation(p_node);
+        }
+    }
+}
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+CHASTE_CLASS_EXPORT(CryptProliferationSimulation)
@@ -0,0 +1,483 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CRYPTPROLIFERATIONSIMULATION_HPP_
+#define CRYPTPROLIFERATIONSIMULATION_HPP_
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+
+#include "OffLatticeSimulation.hpp"
+#include "CryptPhaseTimer.hpp"
+#include "AsyncRecordWriter.hpp"
+#include "HeightBucketedSloughingCellKiller.hpp"
+#include "NodeStateArrays.hpp"
+#include "NodeStateSpringForce.hpp"
+#include "SemiImplicitSpringSolver.hpp"
+#include "CellRetainerForce.hpp"
+#include "CryptSimulationBoundaryCondition.hpp"
+#include "CryptSlabDecomposition.hpp"
+#include "CheckpointStore.hpp"
+#include "FileFinder.hpp"
+
+/**
+ * The off-lattice simulation used by CryptProliferationModel.
+ *
+ * This behaves exactly as its parent class, but provides hooks for instrumenting the phases of each
+ * timestep: if a CryptPhaseTimer is supplied, time spent removing cells, dividing cells, remeshing,
+ * computing each force and moving nodes is recorded.  The division locations may also be written from a
+ * background thread (see SetAsyncDivisionOutput).  Cells born are passed to any HeightBucketedSloughingCellKiller
+ * added to the simulation, and may be added to the population in one batch (see SetBatchBirths).  Node state
+ * may be held in contiguous arrays while forces are computed and nodes moved (see SetUseNodeStateArrays), and
+ * for the crypt setup the retainer force, node movement and boundary condition may be done in a single pass
+ * (see SetFusedPositionUpdate), or spring forces may be treated implicitly to allow larger timesteps
+ * (see SetSemiImplicitPositionUpdate).  Spring forces may be shared out between processes by slabs of the crypt
+ * (see SetSlabDecomposition).  Checkpoints may be saved from within the timestep loop (see SetCheckpointing).
+ *
+ * Only the state of the parent class is archived.  The options set by the methods of this class must be set again
+ * after loading a simulation from an archive.
+ */
+class CryptProliferationSimulation : public OffLatticeSimulation<2>
+{
+private:
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<OffLatticeSimulation<2> >(*this);
+    }
+
+    /** Optional timer for the phases of each timestep. */
+    boost::shared_ptr<CryptPhaseTimer> mpPhaseTimer;
+
+    /** Whether to count heap allocations made during each timestep. */
+    bool mCountAllocations;
+
+    /** The AllocationCounter total at the start of the current timestep. */
+    unsigned long mAllocationsAtStepStart;
+
+    /** Number of complete timesteps for which allocations have been counted. */
+    unsigned mNumStepsCounted;
+
+    /** The most allocations made in any one timestep. */
+    unsigned long mMaxAllocationsPerStep;
+
+    /** Optional writer through which division locations are written. */
+    boost::shared_ptr<AsyncRecordWriter> mpOutputWriter;
+
+    /** The division locations file, if mpOutputWriter is set. */
+    unsigned mDivisionsFile;
+
+    /** The cell killers which need to be told about new cells; found by SetupSolve. */
+    std::vector<boost::shared_ptr<HeightBucketedSloughingCellKiller<2> > > mBucketedKillers;
+
+    /** A cell division decided on during DoCellBirth, but not yet applied to the population. */
+    struct PendingDivision
+    {
+        /** The parent cell. */
+        CellPtr mpParent;
+        /** The daughter cell. */
+        CellPtr mpDaughter;
+        /** Where the daughter cell is to go. */
+        c_vector<double, 2> mLocation;
+        /** The age of the parent cell when it divided. */
+        double mParentAge;
+    };
+
+    /** Whether forces and node movement go through mpNodeState. */
+    bool mUseNodeStateArrays;
+
+    /**
+     * The locations and radii of and forces on the population's nodes, if mUseNodeStateArrays is set.  These are
+     * shared with any NodeStateVolumeTrackingModifier.
+     */
+    boost::shared_ptr<NodeStateArrays<2> > mpNodeState;
+
+    /**
+     * Move nodes according to the forces in mpNodeState, and apply boundary conditions.  This follows
+     * OffLatticeSimulation::UpdateNodePositions and the population's UpdateNodeLocations, except that if
+     * spring forces are treated implicitly nodes are moved by the displacements from mSpringSolver.
+     */
+    void UpdateNodePositionsFromNodeState();
+
+    /**
+     * Move any ghost nodes by their own springs, as the population does before moving real nodes, but in
+     * substeps if the timestep is too large for these springs to be stable, and copy their new locations into
+     * mpNodeState.
+     */
+    void MoveGhostNodes();
+
+    /** Whether spring forces are treated implicitly when moving nodes. */
+    bool mSemiImplicitPositionUpdate;
+
+    /** Solves for node displacements, if mSemiImplicitPositionUpdate is set. */
+    SemiImplicitSpringSolver<2> mSpringSolver;
+
+    /** The total number of solver iterations over all timesteps, if mSemiImplicitPositionUpdate is set. */
+    unsigned long mTotalSolverIterations;
+
+    /** Whether the retainer force, node movement and boundary condition are done in one pass over the cells. */
+    bool mFusedPositionUpdate;
+
+    /** The spring force, if mFusedPositionUpdate is set; found by SetupSolve. */
+    boost::shared_ptr<NodeStateSpringForce<2> > mpFusedSpringForce;
+
+    /** The retainer force (if any), if mFusedPositionUpdate is set; found by SetupSolve. */
+    boost::shared_ptr<CellRetainerForce<2> > mpFusedRetainerForce;
+
+    /** The boundary condition (if any), if mFusedPositionUpdate is set; found by SetupSolve. */
+    boost::shared_ptr<CryptSimulationBoundaryCondition<2> > mpFusedBoundaryCondition;
+
+    /**
+     * Pass mpNodeState to any NodeStateVolumeTrackingModifier, timed or not, so that cell volumes are computed
+     * from the arrays.
+     */
+    void SetupNodeStateVolumeTracking();
+
+    /**
+     * Find the forces and boundary condition used by the fused position update, checking there are no others.
+     */
+    void SetupFusedPositionUpdate();
+
+    /**
+     * Add the retainer force to the spring forces in mpNodeState, move each node and apply the crypt boundary
+     * condition to it, in one pass over the cells.  This gives exactly the same results as adding the retainer
+     * force, calling UpdateNodePositionsFromNodeState and imposing CryptSimulationBoundaryCondition in turn.
+     */
+    void FusedUpdateNodePositions();
+
+    /** If set, the decomposition by which spring forces are shared out between processes. */
+    boost::shared_ptr<CryptSlabDecomposition> mpSlabDecomposition;
+
+    /**
+     * Check the forces can be shared out by mpSlabDecomposition, and pass it to the spring force.
+     */
+    void SetupSlabDecomposition();
+
+    /**
+     * Sum the forces in mpNodeState over all processes, if spring forces are shared out between them.
+     */
+    void SumSlabForces();
+
+    /** Whether DoCellBirth divides every cell that is ready before adding any daughters to the population. */
+    bool mBatchBirths;
+
+    /** The divisions decided on this timestep, if births are batched; kept to reuse its storage. */
+    std::vector<PendingDivision> mPendingDivisions;
+
+    /** If set, the store to which checkpoints are saved. */
+    boost::shared_ptr<CheckpointStore> mpCheckpoints;
+
+    /** Hours between checkpoints, if mpCheckpoints is set. */
+    double mCheckpointInterval;
+
+    /** The division logs from before this simulation was loaded, which each checkpoint's log starts with. */
+    std::vector<FileFinder> mEarlierDivisionLogs;
+
+    /**
+     * @return  whether a checkpoint should be saved before the timestep now starting (or, at the end of Solve,
+     *     before the final update of the population)
+     */
+    bool IsCheckpointTime() const;
+
+    /**
+     * Save the simulation to a new checkpoint in mpCheckpoints, along with the division log so far.
+     */
+    void SaveCheckpoint();
+
+    /**
+     * Write the location of a division, if division locations are being output.
+     *
+     * @param pParent  the parent cell, which has just divided
+     * @param parentAge  the age of the parent cell when it divided
+     */
+    void RecordDivision(CellPtr pParent, double parentAge);
+
+    /**
+     * Add a daughter cell to the population, and pass it to any HeightBucketedSloughingCellKiller.
+     *
+     * @param pParent  the parent cell
+     * @param pDaughter  the daughter cell
+     * @param rLocation  where the daughter cell is to go
+     */
+    void AddDaughterCell(CellPtr pParent, CellPtr pDaughter, const c_vector<double, 2>& rLocation);
+
+    /**
+     * Record allocations made during the timestep that has just finished (if any), and start counting
+     * for the next one.
+     */
+    void RecordStepAllocations();
+
+    /**
+     * Determine which timer phase a force's contribution should be recorded under.
+     *
+     * @param pForce  the force
+     * @return  the phase
+     */
+    CryptPhaseTimer::Phase GetForcePhase(boost::shared_ptr<AbstractForce<2> > pForce) const;
+
+protected:
+    /**
+     * Overridden UpdateCellPopulation() method, which removes dead cells, divides cells and updates the
+     * population topology, timing each of these if required.  At output sampling boundaries, this also
+     * asks any output writer to flush, and at checkpoint times it first saves a checkpoint.
+     */
+    virtual void UpdateCellPopulation();
+
+    /**
+     * Overridden DoCellBirth() method, which queues division locations on the output writer if one has
+     * been set, and passes new cells to any HeightBucketedSloughingCellKiller.  If births are batched, all
+     * the daughter cells are added to the population together, after every cell has been looked at.
+     *
+     * @return  the number of births that occurred
+     */
+    virtual unsigned DoCellBirth();
+
+    /**
+     * Overridden SetupSolve() method, which opens the division locations file on the output writer if
+     * one has been set, finds any HeightBucketedSloughingCellKiller, and checks the forces and boundary
+     * conditions if the fused position update is used.
+     */
+    virtual void SetupSolve();
+
+    /**
+     * Overridden UpdateCellLocationsAndTopology() method, which computes forces and moves nodes,
+     * timing each force and the position update if required, and using node state arrays or the fused
+     * position update if set.
+     */
+    virtual void UpdateCellLocationsAndTopology();
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param rCellPopulation  the cell population
+     * @param deleteCellPopulationInDestructor  whether to delete the cell population on destruction
+     * @param initialiseCells  whether to initialise cells (set to false when loading from an archive)
+     */
+    CryptProliferationSimulation(AbstractCellPopulation<2>& rCellPopulation,
+                                 bool deleteCellPopulationInDestructor=false,
+                                 bool initialiseCells=true);
+
+    /**
+     * Set a timer with which to record the time spent in each phase of the timestep.
+     * A PhaseTimingModifier using the same timer should also be added as the last simulation modifier.
+     *
+     * @param pTimer  the timer
+     */
+    void SetPhaseTimer(boost::shared_ptr<CryptPhaseTimer> pTimer);
+
+    /**
+     * Write division locations to divisions.dat through the given writer, so the timestep loop doesn't wait
+     * for the filesystem.  The file has the same columns as that written by SetOutputDivisionLocations,
+     * which should not also be enabled.  The writer must be closed after Solve before reading the file.
+     *
+     * @param pWriter  the writer
+     */
+    void SetAsyncDivisionOutput(boost::shared_ptr<AsyncRecordWriter> pWriter);
+
+    /**
+     * Set whether to divide every cell that is ready to divide before adding any of the daughter cells to the
+     * population.  Cells that have died are already removed all together, and the nodes of dead cells are only
+     * renumbered in the one remesh at the end of the timestep, so this makes all the changes to the population
+     * in a timestep happen in three batches: deaths, then births (reusing the nodes freed by deaths), then
+     * remeshing.  The results are unchanged.
+     *
+     * @param batchBirths  whether to batch births
+     */
+    void SetBatchBirths(bool batchBirths);
+
+    /**
+     * Set whether to hold node locations, radii and forces in contiguous arrays while computing forces, moving
+     * nodes and tracking cell volumes, rather than going through the population's Node objects.
+     * NodeStateSpringForce reads locations and radii from the arrays, and it and CellRetainerForce add to the
+     * force arrays directly; other forces are added to the Node objects, and then copied into the arrays.  Nodes
+     * are then moved from the arrays, and a NodeStateVolumeTrackingModifier, if added, computes cell volumes from
+     * them.  The Node objects' locations are kept up to date, but their applied forces are not.
+     *
+     * @param useNodeStateArrays  whether to use node state arrays
+     */
+    void SetUseNodeStateArrays(bool useNodeStateArrays);
+
+    /**
+     * Set whether to add the retainer force, move nodes and impose the boundary condition in a single pass over
+     * the cells, rather than one pass each, once the spring forces have been computed.  This implies
+     * SetUseNodeStateArrays(true).  The only forces may be a NodeStateSpringForce followed by an optional
+     * CellRetainerForce, and the only boundary condition an optional CryptSimulationBoundaryCondition; Solve
+     * throws if there are others.  The results are unchanged.  If a phase timer is set, the retainer force
+     * is timed as part of the position update.
+     *
+     * @param fusedPositionUpdate  whether to use the fused position update
+     */
+    void SetFusedPositionUpdate(bool fusedPositionUpdate);
+
+    /**
+     * Set whether to treat spring forces implicitly when moving nodes, which allows much larger timesteps than
+     * the explicit forward Euler update: each timestep, the spring forces are linearised about the current node
+     * locations, and a SemiImplicitSpringSolver finds displacements that are stable whatever the timestep.
+     * This implies SetUseNodeStateArrays(true), and needs a NodeStateSpringForce.  It can't be used with the
+     * fused position update.  Ghost nodes are still moved explicitly by the population, in substeps if the
+     * timestep is too large for their springs.  Results agree with the explicit update only statistically.
+     *
+     * @param semiImplicitPositionUpdate  whether to use the semi-implicit position update
+     */
+    void SetSemiImplicitPositionUpdate(bool semiImplicitPositionUpdate);
+
+    /**
+     * Share out the computation of spring forces between processes, each computing the springs in one slab
+     * of the crypt, and then summing the forces.  Every process must run the same simulation, with the same
+     * random number seed, and with processes isolated so that each writes its own output; see
+     * CryptSlabDecomposition.  This implies SetUseNodeStateArrays(true), and the first force must be the only
+     * NodeStateSpringForce.  It can't be used with the semi-implicit position update.
+     *
+     * @param pDecomposition  the decomposition
+     */
+    void SetSlabDecomposition(boost::shared_ptr<CryptSlabDecomposition> pDecomposition);
+
+    /**
+     * Save a checkpoint at the start of each timestep at which the simulated time is a multiple of the given
+     * interval, and at the end of Solve, before the population is last updated.  A simulation loaded from one of
+     * these checkpoints and solved to a later time therefore carries on exactly as if it had never stopped.  No
+     * checkpoint is saved at the time Solve starts from.
+     *
+     * Each checkpoint holds the archived simulation, and a divisions.dat file holding the given earlier division
+     * logs followed by the divisions recorded by this simulation so far.  Division locations must be output
+     * (directly or through an AsyncRecordWriter) for the latter to be included.
+     *
+     * @param pCheckpoints  the store to save checkpoints to
+     * @param interval  hours between checkpoints
+     * @param rEarlierDivisionLogs  division logs from before this simulation was loaded, in time order
+     */
+    void SetCheckpointing(boost::shared_ptr<CheckpointStore> pCheckpoints, double interval,
+                          const std::vector<FileFinder>& rEarlierDivisionLogs);
+
+    /**
+     * Concatenate division logs into one file.
+     *
+     * @param rLogs  the logs, in time order
+     * @param rDestination  the file to write
+     */
+    static void ConcatenateDivisionLogs(const std::vector<FileFinder>& rLogs, const FileFinder& rDestination);
+
+    /**
+     * Find a simulation modifier of a given type, e.g. after loading from an archive.
+     *
+     * @return  the first modifier added of type MODIFIER, or an empty pointer if there is none
+     */
+    template<class MODIFIER>
+    boost::shared_ptr<MODIFIER> GetSimulationModifier() const
+    {
+        boost::shared_ptr<MODIFIER> p_modifier;
+        for (unsigned i=0; i<this->mSimulationModifiers.size() && !p_modifier; i++)
+        {
+            p_modifier = boost::dynamic_pointer_cast<MODIFIER>(this->mSimulationModifiers[i]);
+        }
+        return p_modifier;
+    }
+
+    /** @return  the total number of spring solver iterations, over all timesteps so far. */
+    unsigned long GetTotalSolverIterations() const;
+
+    /** @return  the node state arrays, which are only kept up to date if they are being used. */
+    const NodeStateArrays<2>& rGetNodeState() const;
+
+    /**
+     * Set whether to count heap allocations made during each timestep.  This only has an effect if
+     * AllocationCounter::IsAvailable().  FinishAllocationCounting must be called after each call to Solve.
+     *
+     * @param countAllocations  whether to count allocations
+     */
+    void SetCountAllocations(bool countAllocations);
+
+    /**
+     * Stop counting allocations, recording those made during the final timestep.  If Solve is called again,
+     * counting carries on from the totals so far.
+     */
+    void FinishAllocationCounting();
+
+    /**
+     * @return  allocation statistics for the timestep loop: the number of timesteps counted, the total
+     *     number of allocations and bytes allocated, and the most allocations made in one timestep
+     */
+    std::vector<double> GetAllocationStatistics() const;
+};
+
+#include "SerializationExportWrapper.hpp"
+CHASTE_CLASS_EXPORT(CryptProliferationSimulation)
+
+namespace boost
+{
+namespace serialization
+{
+/**
+ * Serialize information required to construct a CryptProliferationSimulation.
+ */
+template<class Archive>
+inline void save_construct_data(
+    Archive & ar, const CryptProliferationSimulation * t, const BOOST_PFTO unsigned int file_version)
+{
+    // Save data required to construct instance
+    const AbstractCellPopulation<2>* p_cell_population = &(t->rGetCellPopulation());
+    ar & p_cell_population;
+}
+
+/**
+ * De-serialize constructor parameters and initialise a CryptProliferationSimulation.
+ */
+template<class Archive>
+inline void load_construct_data(
+    Archive & ar, CryptProliferationSimulation * t, const unsigned int file_version)
+{
+    // Retrieve data from archive required to construct new instance
+    AbstractCellPopulation<2>* p_cell_population;
+    ar >> p_cell_population;
+
+    // Invoke inplace constructor to initialise instance; the simulation now owns the population
+    ::new(t)CryptProliferationSimulation(*p_cell_population, true, false);
+}
+}
+} // namespace ...
+
+#endif // CRYPTPROLIFERATIONSIMULATION_HPP_
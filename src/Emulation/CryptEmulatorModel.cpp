@@ -0,0 +1,291 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "CryptEmulatorModel.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <boost/foreach.hpp>
+
+// Functional curation includes
+#include "ValueTypes.hpp"
+#include "NdArray.hpp"
+#include "ProtoHelperMacros.hpp"
+
+// Core Chaste includes
+#include "Exception.hpp"
+
+#include "CryptPhaseTimer.hpp"
+
+
+CryptEmulatorModel::CryptEmulatorModel(const FileFinder& rSweepFolder, const std::string& rFilePrefix)
+    : mCryptLength(0.0),
+      mEndTime(0.0)
+{
+    // The same parameters as CryptProliferationModel, so protocols written for that model can set them
+    std::map<std::string, AbstractValuePtr> default_model_params;
+#define CRYPT_MODEL_PARAMETER_DEFAULT(name, default_value) default_model_params[#name] = CV(default_value);
+    CRYPT_MODEL_PARAMETERS(CRYPT_MODEL_PARAMETER_DEFAULT)
+#undef CRYPT_MODEL_PARAMETER_DEFAULT
+    mpModelParameters.reset(new RestrictedEnvironment(default_model_params));
+#define CRYPT_MODEL_PARAMETER_BIND(name, default_value) mpModelParameters->BindValue(#name, &mParameters.name);
+    CRYPT_MODEL_PARAMETERS(CRYPT_MODEL_PARAMETER_BIND)
+#undef CRYPT_MODEL_PARAMETER_BIND
+
+    // Train on the sweep outputs
+    std::vector<unsigned> shape;
+    std::vector<double> heights = ReadSweepOutput(FileFinder(rFilePrefix + "outputs_heights.csv", rSweepFolder), shape);
+    if (shape.size() != 1u)
+    {
+        EXCEPTION("The crypt heights from a sweep must be a 1d array.");
+    }
+    TrainOnSweepOutput(mFreqsEmulator, heights, FileFinder(rFilePrefix + "outputs_freqs.csv", rSweepFolder));
+    TrainOnSweepOutput(mNormFreqsEmulator, heights, FileFinder(rFilePrefix + "outputs_norm_freqs.csv", rSweepFolder));
+    if (mFreqsEmulator.GetNumOutputs() != mNormFreqsEmulator.GetNumOutputs())
+    {
+        EXCEPTION("The sweep histograms have inconsistent numbers of boxes.");
+    }
+
+    // Set up what outputs are available; the first two match CryptProliferationModel
+    mOutputNames.push_back("divisions");
+    mOutputUnits.push_back("mixed");
+    mOutputNames.push_back("timings");
+    mOutputUnits.push_back("mixed");
+    mOutputNames.push_back("freqs_mean");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("freqs_sd");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("norm_freqs_mean");
+    mOutputUnits.push_back("dimensionless");
+    mOutputNames.push_back("norm_freqs_sd");
+    mOutputUnits.push_back("dimensionless");
+    // No state is kept between calls to SolveModel
+    mHasImplicitReset = true;
+}
+
+
+CryptEmulatorModel::~CryptEmulatorModel()
+{
+#define CRYPT_MODEL_PARAMETER_UNBIND(name, default_value) mpModelParameters->BindValue(#name, NULL);
+    CRYPT_MODEL_PARAMETERS(CRYPT_MODEL_PARAMETER_UNBIND)
+#undef CRYPT_MODEL_PARAMETER_UNBIND
+}
+
+
+void CryptEmulatorModel::SetNamespaceBindings(const std::map<std::string, std::string>& rNamespaceBindings)
+{
+    mEnvironmentMap.clear();
+    typedef std::pair<std::string, std::string> StringPair;
+    BOOST_FOREACH(StringPair binding, rNamespaceBindings)
+    {
+        if (binding.second == "https://chaste.cs.ox.ac.uk/nss/cellbased/0.1#")
+        {
+            mEnvironmentMap[binding.first] = mpModelParameters;
+        }
+    }
+}
+
+
+void CryptEmulatorModel::SolveModel(double endPoint)
+{
+    mCryptLength = mParameters.crypt_length;
+    mEndTime = mParameters.end_time;
+    std::vector<double> input(1, mCryptLength);
+    mFreqsEmulator.Predict(input, mFreqsMean, mFreqsStdDev);
+    mNormFreqsEmulator.Predict(input, mNormFreqsMean, mNormFreqsStdDev);
+}
+
+
+/**
+ * Short-hand for wrapping a vector as a 1d Functional Curation array.
+ * @param rValues  the array entries
+ * @return  the wrapped array
+ */
+static AbstractValuePtr MakeArrayValue(const std::vector<double>& rValues)
+{
+    NdArray<double>::Extents shape(1, rValues.size());
+    NdArray<double> array(shape);
+    std::copy(rValues.begin(), rValues.end(), array.Begin());
+    return AbstractValuePtr(new ArrayValue(array));
+}
+
+
+EnvironmentCPtr CryptEmulatorModel::GetOutputs()
+{
+    assert(!mFreqsMean.empty());
+    EnvironmentPtr p_outputs(new Environment);
+
+    // A synthetic division log, with columns time, x co-ord, y co-ord, parent age as for the simulation
+    const unsigned num_boxes = mFreqsMean.size();
+    const double box_size = mCryptLength / num_boxes;
+    std::vector<unsigned> box_counts(num_boxes);
+    unsigned num_divisions = 0u;
+    for (unsigned box=0; box<num_boxes; box++)
+    {
+        box_counts[box] = (unsigned)floor(std::max(0.0, mFreqsMean[box]) + 0.5);
+        num_divisions += box_counts[box];
+    }
+    NdArray<double>::Extents shape(2);
+    shape[0] = num_divisions;
+    shape[1] = 4u;
+    NdArray<double> divisions(shape);
+    NdArray<double>::Iterator it = divisions.Begin();
+    for (unsigned box=0; box<num_boxes; box++)
+    {
+        for (unsigned i=0; i<box_counts[box]; i++)
+        {
+            *it++ = mEndTime;
+            *it++ = 0.0;
+            *it++ = (box + 0.5) * box_size;
+            *it++ = 0.0;
+        }
+    }
+    std::vector<AbstractValuePtr> values;
+    values.push_back(AbstractValuePtr(new ArrayValue(divisions)));
+
+    // No simulation was run, so there are no phase timings
+    NdArray<double>::Extents timings_shape(2);
+    timings_shape[0] = CryptPhaseTimer::NUM_PHASES;
+    timings_shape[1] = 2u;
+    NdArray<double> timings(timings_shape);
+    std::fill(timings.Begin(), timings.End(), 0.0);
+    values.push_back(AbstractValuePtr(new ArrayValue(timings)));
+
+    values.push_back(MakeArrayValue(mFreqsMean));
+    values.push_back(MakeArrayValue(mFreqsStdDev));
+    values.push_back(MakeArrayValue(mNormFreqsMean));
+    values.push_back(MakeArrayValue(mNormFreqsStdDev));
+
+    assert(values.size() == mOutputNames.size());
+    for (unsigned i=0; i<mOutputNames.size(); i++)
+    {
+        values[i]->SetUnits(mOutputUnits[i]);
+        p_outputs->DefineName(mOutputNames[i], values[i], "CryptEmulatorModel::GetOutputs");
+    }
+    return p_outputs;
+}
+
+
+const GaussianProcessEmulator& CryptEmulatorModel::rGetFreqsEmulator() const
+{
+    return mFreqsEmulator;
+}
+
+
+std::vector<double> CryptEmulatorModel::ReadSweepOutput(const FileFinder& rFile, std::vector<unsigned>& rShape)
+{
+    if (!rFile.IsFile())
+    {
+        EXCEPTION("Sweep output file " << rFile.GetAbsolutePath() << " does not exist.");
+    }
+    std::ifstream file(rFile.GetAbsolutePath().c_str());
+    std::vector<std::vector<double> > rows;
+    std::string line;
+    while (std::getline(file, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        std::replace(line.begin(), line.end(), ',', ' ');
+        std::stringstream line_stream(line);
+        std::vector<double> row;
+        double value;
+        while (line_stream >> value)
+        {
+            row.push_back(value);
+        }
+        rows.push_back(row);
+    }
+    if (rows.empty())
+    {
+        EXCEPTION("Sweep output file " << rFile.GetAbsolutePath() << " contains no data.");
+    }
+
+    std::vector<double> values;
+    if (rows[0].size() == 2u && rows[0][0] == 1.0 && rows.size() == 1u + rows[0][1]
+        && (rows.size() == 1u || rows[1].size() == 1u))
+    {
+        // A 1d array, after its shape line
+        rShape.assign(1u, rows.size() - 1u);
+        for (unsigned i=1; i<rows.size(); i++)
+        {
+            values.push_back(rows[i][0]);
+        }
+    }
+    else
+    {
+        // A 2d array, stored with the last dimension running down the file
+        rShape.resize(2u);
+        rShape[0] = rows[0].size();
+        rShape[1] = rows.size();
+        for (unsigned i=0; i<rShape[0]; i++)
+        {
+            for (unsigned j=0; j<rShape[1]; j++)
+            {
+                if (rows[j].size() != rShape[0])
+                {
+                    EXCEPTION("Sweep output file " << rFile.GetAbsolutePath() << " has rows of different lengths.");
+                }
+                values.push_back(rows[j][i]);
+            }
+        }
+    }
+    return values;
+}
+
+
+void CryptEmulatorModel::TrainOnSweepOutput(GaussianProcessEmulator& rEmulator, const std::vector<double>& rHeights,
+                                            const FileFinder& rFile)
+{
+    std::vector<unsigned> shape;
+    std::vector<double> values = ReadSweepOutput(rFile, shape);
+    if (shape.size() != 2u || shape[0] != rHeights.size())
+    {
+        EXCEPTION("Sweep output file " << rFile.GetAbsolutePath() << " should have one histogram per crypt height.");
+    }
+    std::vector<std::vector<double> > inputs;
+    std::vector<std::vector<double> > outputs;
+    for (unsigned i=0; i<shape[0]; i++)
+    {
+        inputs.push_back(std::vector<double>(1, rHeights[i]));
+        outputs.push_back(std::vector<double>(values.begin() + i*shape[1], values.begin() + (i+1)*shape[1]));
+    }
+    rEmulator.Train(inputs, outputs);
+}
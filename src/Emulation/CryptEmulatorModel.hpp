@@ -0,0 +1,168 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef CRYPTEMULATORMODEL_HPP_
+#define CRYPTEMULATORMODEL_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "AbstractSystemWithOutputs.hpp"
+
+#include "FileFinder.hpp"
+
+#include "Environment.hpp"
+#include "AbstractValue.hpp"
+
+#include "RestrictedEnvironment.hpp"
+#include "CryptModelParameters.hpp"
+#include "GaussianProcessEmulator.hpp"
+
+/**
+ * A stand-in for CryptProliferationModel which, rather than running a cell-based simulation, predicts the
+ * division location histogram from a Gaussian process emulator trained on the outputs of a crypt height
+ * sweep (as written by CryptSweepRunner or the CryptProliferationSweep protocol).  Predictions take well
+ * under a millisecond, so this is useful for interactive exploration, and the predicted uncertainty shows
+ * where further simulations would be most informative.
+ *
+ * The model accepts the same parameters as CryptProliferationModel, but only crypt_length (as the emulator
+ * input) and end_time (see below) affect the results.  The predictions are only meaningful for the other
+ * parameter values and protocol inputs used in the training sweep.
+ *
+ * So that existing protocols run unchanged, the 'divisions' output is a synthetic division log giving the
+ * predicted number of divisions (rounded to the nearest whole number) at the centre of each histogram box,
+ * all at end_time; binning these with the same number of boxes as the training sweep reproduces the
+ * predicted histogram.  The 'timings' output is all zeros.  The predictions themselves, with their standard
+ * deviations, are available as 'freqs_mean', 'freqs_sd', 'norm_freqs_mean' and 'norm_freqs_sd', each of
+ * shape [num_boxes].
+ */
+class CryptEmulatorModel : public AbstractSystemWithOutputs
+{
+public:
+    /**
+     * Create a model, training it on the outputs of a crypt height sweep.
+     *
+     * @param rSweepFolder  the folder containing the sweep outputs for a single cell-based model
+     * @param rFilePrefix  prefix to the names of the output files, which are otherwise
+     *     outputs_heights.csv, outputs_freqs.csv and outputs_norm_freqs.csv
+     */
+    CryptEmulatorModel(const FileFinder& rSweepFolder, const std::string& rFilePrefix="");
+
+    /**
+     * Destructor.  Unbinds our parameter values from the parameters environment, which a protocol may
+     * still hold.
+     */
+    ~CryptEmulatorModel();
+
+    /**
+     * Get the predicted outputs in the Functional Curation data structures.
+     * SolveModel must have been called prior to using this method.
+     */
+    EnvironmentCPtr GetOutputs();
+
+    /**
+     * Predict the histogram for the current crypt length.
+     *
+     * @param endPoint  ignored
+     */
+    void SolveModel(double endPoint);
+
+    /**
+     * Set the bindings from prefix to namespace URI used by the protocol for accessing model
+     * variables.  As for CryptProliferationModel, only the https://chaste.cs.ox.ac.uk/nss/cellbased/0.1#
+     * namespace URI is recognised.
+     *
+     * @param rNamespaceBindings  the prefix->URI map
+     */
+    void SetNamespaceBindings(const std::map<std::string, std::string>& rNamespaceBindings);
+
+    /** @return  the emulator of division counts per box, e.g. for checking its fitted hyperparameters. */
+    const GaussianProcessEmulator& rGetFreqsEmulator() const;
+
+    /**
+     * Read a 1d or 2d array written by CryptSweepRunner.  A 1d array has a line giving its shape as 1,N then
+     * one value per line, and a 2d array of shape [A, B] has B lines of A comma-separated values.
+     *
+     * @param rFile  the file to read
+     * @param rShape  filled in with the array shape
+     * @return  the array entries, in row-major order
+     */
+    static std::vector<double> ReadSweepOutput(const FileFinder& rFile, std::vector<unsigned>& rShape);
+
+private:
+    /** Input parameters for the model, as seen by protocols. */
+    boost::shared_ptr<RestrictedEnvironment> mpModelParameters;
+
+    /** The current parameter values, kept up to date with mpModelParameters. */
+    CryptModelParameters mParameters;
+
+    /** Emulator for the number of divisions in each box. */
+    GaussianProcessEmulator mFreqsEmulator;
+
+    /** Emulator for the percentage of divisions in each box. */
+    GaussianProcessEmulator mNormFreqsEmulator;
+
+    /** The crypt length used for the last prediction. */
+    double mCryptLength;
+
+    /** The end time at the last prediction. */
+    double mEndTime;
+
+    /** Predicted number of divisions per box. */
+    std::vector<double> mFreqsMean;
+
+    /** Standard deviation of the predicted number of divisions per box. */
+    std::vector<double> mFreqsStdDev;
+
+    /** Predicted percentage of divisions per box. */
+    std::vector<double> mNormFreqsMean;
+
+    /** Standard deviation of the predicted percentage of divisions per box. */
+    std::vector<double> mNormFreqsStdDev;
+
+    /**
+     * Train an emulator on a histogram output from the sweep.
+     *
+     * @param rEmulator  the emulator to train
+     * @param rHeights  the crypt height at each sweep point
+     * @param rFile  the histogram file, of shape [num_points, num_boxes]
+     */
+    static void TrainOnSweepOutput(GaussianProcessEmulator& rEmulator, const std::vector<double>& rHeights,
+                                   const FileFinder& rFile);
+};
+
+#endif // CRYPTEMULATORMODEL_HPP_
@@ -0,0 +1,349 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "GaussianProcessEmulator.hpp"
+
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+#include "Exception.hpp"
+
+/** Number of candidate length scales tried when training. */
+const unsigned NUM_LENGTH_SCALES = 41u;
+/** Smallest candidate length scale, relative to the input range. */
+const double MIN_LENGTH_SCALE = 0.1;
+/** Largest candidate length scale, relative to the input range. */
+const double MAX_LENGTH_SCALE = 10.0;
+/** Candidate noise ratios tried when training. */
+const double NOISE_RATIOS[] = {1e-6, 1e-4, 1e-3, 1e-2, 1e-1};
+
+GaussianProcessEmulator::GaussianProcessEmulator()
+    : mLengthScale(0.0)
+{
+}
+
+void GaussianProcessEmulator::Train(const std::vector<std::vector<double> >& rInputs,
+                                    const std::vector<std::vector<double> >& rOutputs)
+{
+    if (rInputs.empty() || rInputs.size() != rOutputs.size())
+    {
+        EXCEPTION("Emulator training needs the same, non-zero, number of inputs and outputs.");
+    }
+    const unsigned num_points = rInputs.size();
+    const unsigned num_inputs = rInputs[0].size();
+    const unsigned num_outputs = rOutputs[0].size();
+    for (unsigned i=0; i<num_points; i++)
+    {
+        if (rInputs[i].size() != num_inputs || rOutputs[i].size() != num_outputs)
+        {
+            EXCEPTION("Emulator training point " << i << " has the wrong number of inputs or outputs.");
+        }
+    }
+
+    // Scale inputs to the unit range, so length scales are relative
+    mInputMins.assign(num_inputs, std::numeric_limits<double>::max());
+    mInputRanges.assign(num_inputs, 0.0);
+    std::vector<double> input_maxs(num_inputs, -std::numeric_limits<double>::max());
+    for (unsigned i=0; i<num_points; i++)
+    {
+        for (unsigned d=0; d<num_inputs; d++)
+        {
+            mInputMins[d] = std::min(mInputMins[d], rInputs[i][d]);
+            input_maxs[d] = std::max(input_maxs[d], rInputs[i][d]);
+        }
+    }
+    for (unsigned d=0; d<num_inputs; d++)
+    {
+        mInputRanges[d] = (input_maxs[d] > mInputMins[d] ? input_maxs[d] - mInputMins[d] : 1.0);
+    }
+    mScaledInputs.clear();
+    for (unsigned i=0; i<num_points; i++)
+    {
+        mScaledInputs.push_back(ScaleInput(rInputs[i]));
+    }
+
+    // Search for the length scale maximising the total likelihood, with each output's noise ratio chosen
+    // to maximise its own likelihood
+    const unsigned num_noise_ratios = sizeof(NOISE_RATIOS)/sizeof(NOISE_RATIOS[0]);
+    double best_likelihood = -std::numeric_limits<double>::infinity();
+    std::vector<double> factor;
+    std::vector<double> weights;
+    double log_determinant, mean, variance;
+    for (unsigned i=0; i<NUM_LENGTH_SCALES; i++)
+    {
+        double length_scale = MIN_LENGTH_SCALE * pow(MAX_LENGTH_SCALE/MIN_LENGTH_SCALE, i/(NUM_LENGTH_SCALES-1.0));
+        std::vector<double> output_likelihoods(num_outputs, -std::numeric_limits<double>::infinity());
+        std::vector<double> output_noise_ratios(num_outputs, 0.0);
+        for (unsigned j=0; j<num_noise_ratios; j++)
+        {
+            if (!Factorise(length_scale, NOISE_RATIOS[j], factor, log_determinant))
+            {
+                continue;
+            }
+            for (unsigned output=0; output<num_outputs; output++)
+            {
+                double likelihood = FitOutput(factor, log_determinant, rOutputs, output, mean, variance, weights);
+                if (likelihood > output_likelihoods[output])
+                {
+                    output_likelihoods[output] = likelihood;
+                    output_noise_ratios[output] = NOISE_RATIOS[j];
+                }
+            }
+        }
+        double total_likelihood = 0.0;
+        for (unsigned output=0; output<num_outputs; output++)
+        {
+            total_likelihood += output_likelihoods[output];
+        }
+        if (total_likelihood > best_likelihood)
+        {
+            best_likelihood = total_likelihood;
+            mLengthScale = length_scale;
+            mNoiseRatios = output_noise_ratios;
+        }
+    }
+    if (best_likelihood == -std::numeric_limits<double>::infinity())
+    {
+        EXCEPTION("Unable to fit an emulator to the training data; are there duplicate training inputs?");
+    }
+
+    // Store the fit for each output
+    mCholeskyFactors.resize(num_outputs);
+    mOutputMeans.resize(num_outputs);
+    mSignalVariances.resize(num_outputs);
+    mWeights.resize(num_outputs);
+    for (unsigned output=0; output<num_outputs; output++)
+    {
+        bool ok = Factorise(mLengthScale, mNoiseRatios[output], mCholeskyFactors[output], log_determinant);
+        assert(ok);
+        FitOutput(mCholeskyFactors[output], log_determinant, rOutputs, output,
+                  mOutputMeans[output], mSignalVariances[output], mWeights[output]);
+    }
+}
+
+bool GaussianProcessEmulator::Factorise(double lengthScale, double noiseRatio,
+                                        std::vector<double>& rFactor, double& rLogDeterminant) const
+{
+    const unsigned n = mScaledInputs.size();
+    rFactor.assign(n*n, 0.0);
+    rLogDeterminant = 0.0;
+    for (unsigned i=0; i<n; i++)
+    {
+        for (unsigned j=0; j<=i; j++)
+        {
+            double sum = Correlation(mScaledInputs[i], mScaledInputs[j], lengthScale) + (i == j ? noiseRatio : 0.0);
+            for (unsigned k=0; k<j; k++)
+            {
+                sum -= rFactor[i*n+k] * rFactor[j*n+k];
+            }
+            if (i == j)
+            {
+                if (sum <= 0.0)
+                {
+                    return false;
+                }
+                rFactor[i*n+i] = sqrt(sum);
+                rLogDeterminant += 2.0*log(rFactor[i*n+i]);
+            }
+            else
+            {
+                rFactor[i*n+j] = sum / rFactor[j*n+j];
+            }
+        }
+    }
+    return true;
+}
+
+double GaussianProcessEmulator::FitOutput(const std::vector<double>& rFactor, double logDeterminant,
+                                          const std::vector<std::vector<double> >& rOutputs, unsigned output,
+                                          double& rMean, double& rVariance, std::vector<double>& rWeights)
+{
+    const unsigned n = rOutputs.size();
+
+    // Generalised least squares estimate of the mean
+    std::vector<double> ones(n, 1.0);
+    CholeskySolve(rFactor, ones);
+    double sum_weights = 0.0;
+    rMean = 0.0;
+    for (unsigned i=0; i<n; i++)
+    {
+        sum_weights += ones[i];
+        rMean += ones[i] * rOutputs[i][output];
+    }
+    rMean /= sum_weights;
+
+    // Weights for prediction, and the maximum likelihood signal variance
+    rWeights.resize(n);
+    for (unsigned i=0; i<n; i++)
+    {
+        rWeights[i] = rOutputs[i][output] - rMean;
+    }
+    std::vector<double> centred(rWeights);
+    CholeskySolve(rFactor, rWeights);
+    rVariance = 0.0;
+    for (unsigned i=0; i<n; i++)
+    {
+        rVariance += centred[i] * rWeights[i];
+    }
+    rVariance /= n;
+
+    double log_likelihood = 0.0;
+    if (rVariance > 0.0)
+    {
+        log_likelihood = -0.5*n*log(rVariance) - 0.5*logDeterminant;
+    }
+    return log_likelihood;
+}
+
+void GaussianProcessEmulator::Predict(const std::vector<double>& rInput,
+                                      std::vector<double>& rMean, std::vector<double>& rStdDev) const
+{
+    if (!IsTrained())
+    {
+        EXCEPTION("The emulator must be trained before making predictions.");
+    }
+    if (rInput.size() != GetNumInputs())
+    {
+        EXCEPTION("The emulator expects " << GetNumInputs() << " inputs, not " << rInput.size() << ".");
+    }
+    const unsigned n = mScaledInputs.size();
+    std::vector<double> scaled_input = ScaleInput(rInput);
+    std::vector<double> correlations(n);
+    for (unsigned i=0; i<n; i++)
+    {
+        correlations[i] = Correlation(scaled_input, mScaledInputs[i], mLengthScale);
+    }
+    const unsigned num_outputs = GetNumOutputs();
+    rMean.resize(num_outputs);
+    rStdDev.resize(num_outputs);
+    std::vector<double> reduction;
+    for (unsigned output=0; output<num_outputs; output++)
+    {
+        double mean = mOutputMeans[output];
+        for (unsigned i=0; i<n; i++)
+        {
+            mean += correlations[i] * mWeights[output][i];
+        }
+        rMean[output] = mean;
+
+        // The variance reduction from conditioning on the training data is |L^{-1} k|^2; outputs sharing a
+        // noise ratio share a factor, so only recompute this when the ratio changes
+        if (output == 0 || mNoiseRatios[output] != mNoiseRatios[output-1])
+        {
+            reduction = correlations;
+            ForwardSubstitute(mCholeskyFactors[output], reduction);
+        }
+        double explained = 0.0;
+        for (unsigned i=0; i<n; i++)
+        {
+            explained += reduction[i]*reduction[i];
+        }
+        rStdDev[output] = sqrt(mSignalVariances[output] * std::max(0.0, 1.0 - explained));
+    }
+}
+
+bool GaussianProcessEmulator::IsTrained() const
+{
+    return !mScaledInputs.empty();
+}
+
+unsigned GaussianProcessEmulator::GetNumInputs() const
+{
+    return mInputMins.size();
+}
+
+unsigned GaussianProcessEmulator::GetNumOutputs() const
+{
+    return mOutputMeans.size();
+}
+
+double GaussianProcessEmulator::GetLengthScale() const
+{
+    return mLengthScale;
+}
+
+double GaussianProcessEmulator::GetNoiseRatio(unsigned output) const
+{
+    return mNoiseRatios[output];
+}
+
+double GaussianProcessEmulator::Correlation(const std::vector<double>& rX, const std::vector<double>& rY,
+                                            double lengthScale)
+{
+    double distance_squared = 0.0;
+    for (unsigned d=0; d<rX.size(); d++)
+    {
+        distance_squared += (rX[d]-rY[d])*(rX[d]-rY[d]);
+    }
+    return exp(-0.5*distance_squared/(lengthScale*lengthScale));
+}
+
+std::vector<double> GaussianProcessEmulator::ScaleInput(const std::vector<double>& rInput) const
+{
+    std::vector<double> scaled(rInput.size());
+    for (unsigned d=0; d<rInput.size(); d++)
+    {
+        scaled[d] = (rInput[d] - mInputMins[d]) / mInputRanges[d];
+    }
+    return scaled;
+}
+
+void GaussianProcessEmulator::ForwardSubstitute(const std::vector<double>& rFactor, std::vector<double>& rB)
+{
+    const unsigned n = rB.size();
+    for (unsigned i=0; i<n; i++)
+    {
+        for (unsigned k=0; k<i; k++)
+        {
+            rB[i] -= rFactor[i*n+k] * rB[k];
+        }
+        rB[i] /= rFactor[i*n+i];
+    }
+}
+
+void GaussianProcessEmulator::CholeskySolve(const std::vector<double>& rFactor, std::vector<double>& rB)
+{
+    ForwardSubstitute(rFactor, rB);
+    const unsigned n = rB.size();
+    for (unsigned i=n; i-- > 0; )
+    {
+        for (unsigned k=i+1; k<n; k++)
+        {
+            rB[i] -= rFactor[k*n+i] * rB[k];
+        }
+        rB[i] /= rFactor[i*n+i];
+    }
+}
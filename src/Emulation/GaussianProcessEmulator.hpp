@@ -0,0 +1,191 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef GAUSSIANPROCESSEMULATOR_HPP_
+#define GAUSSIANPROCESSEMULATOR_HPP_
+
+#include <vector>
+
+/**
+ * A Gaussian process emulator, trained on the outputs of a small number of expensive simulations, which
+ * predicts the outputs (with uncertainty) at other parameter values in a fraction of a millisecond.
+ *
+ * Each output is modelled as an independent Gaussian process with a constant mean and a squared exponential
+ * covariance function.  Inputs are scaled to [0, 1] by their training range, and all outputs share the same
+ * length scale, which is chosen to maximise the total log marginal likelihood over a grid of candidate values.
+ * This is appropriate when outputs are different entries of one result (e.g. boxes of a histogram) which vary
+ * similarly with the inputs.  Each output has its own noise level (chosen from a grid of candidate ratios to
+ * the signal variance) since, for instance, histogram boxes with few events are relatively noisier; its mean
+ * and signal variance take their maximum likelihood values.
+ *
+ * Training uses dense Cholesky factorisation, so costs O(n^3) in the number of training points; it is
+ * intended for tens or hundreds of points, as produced by parameter sweeps.
+ */
+class GaussianProcessEmulator
+{
+public:
+    /**
+     * Create an untrained emulator.
+     */
+    GaussianProcessEmulator();
+
+    /**
+     * Train the emulator.
+     *
+     * @param rInputs  the parameter values for each training point, all of the same length
+     * @param rOutputs  the simulation outputs at each training point, all of the same length
+     */
+    void Train(const std::vector<std::vector<double> >& rInputs,
+               const std::vector<std::vector<double> >& rOutputs);
+
+    /**
+     * Predict outputs at new parameter values.
+     *
+     * @param rInput  the parameter values
+     * @param rMean  filled in with the predicted mean of each output
+     * @param rStdDev  filled in with the standard deviation of each prediction
+     */
+    void Predict(const std::vector<double>& rInput, std::vector<double>& rMean, std::vector<double>& rStdDev) const;
+
+    /** @return  whether Train has been called. */
+    bool IsTrained() const;
+
+    /** @return  the number of inputs. */
+    unsigned GetNumInputs() const;
+
+    /** @return  the number of outputs. */
+    unsigned GetNumOutputs() const;
+
+    /** @return  the fitted length scale, relative to the training range of each input. */
+    double GetLengthScale() const;
+
+    /**
+     * @param output  the output
+     * @return  the fitted noise variance for this output, relative to its signal variance
+     */
+    double GetNoiseRatio(unsigned output) const;
+
+private:
+    /** The training inputs, scaled to [0, 1]. */
+    std::vector<std::vector<double> > mScaledInputs;
+
+    /** Minimum of each input over the training points. */
+    std::vector<double> mInputMins;
+
+    /** Range of each input over the training points (1 if it doesn't vary). */
+    std::vector<double> mInputRanges;
+
+    /** The fitted length scale. */
+    double mLengthScale;
+
+    /** The fitted noise ratio for each output. */
+    std::vector<double> mNoiseRatios;
+
+    /** Cholesky factor of the training correlation matrix for each output, lower triangular, row-major. */
+    std::vector<std::vector<double> > mCholeskyFactors;
+
+    /** Maximum likelihood mean of each output. */
+    std::vector<double> mOutputMeans;
+
+    /** Maximum likelihood signal variance of each output. */
+    std::vector<double> mSignalVariances;
+
+    /** For each output, the inverse training correlation matrix applied to the centred training outputs. */
+    std::vector<std::vector<double> > mWeights;
+
+    /**
+     * Compute the correlation between two scaled inputs.
+     *
+     * @param rX  the first input
+     * @param rY  the second input
+     * @param lengthScale  the length scale
+     * @return  the squared exponential correlation
+     */
+    static double Correlation(const std::vector<double>& rX, const std::vector<double>& rY, double lengthScale);
+
+    /**
+     * Scale parameter values to the unit training range.
+     *
+     * @param rInput  the parameter values
+     * @return  the scaled values
+     */
+    std::vector<double> ScaleInput(const std::vector<double>& rInput) const;
+
+    /**
+     * Compute the Cholesky factor of the training correlation matrix plus noise.
+     *
+     * @param lengthScale  the length scale
+     * @param noiseRatio  the noise ratio
+     * @param rFactor  filled in with the lower triangular factor, row-major
+     * @param rLogDeterminant  filled in with the log determinant of the matrix
+     * @return  false if the matrix is not numerically positive definite
+     */
+    bool Factorise(double lengthScale, double noiseRatio, std::vector<double>& rFactor, double& rLogDeterminant) const;
+
+    /**
+     * Fit a single output given a factorised correlation matrix, returning its log marginal likelihood
+     * (up to a constant) with the maximum likelihood mean and signal variance.
+     *
+     * @param rFactor  the Cholesky factor of the correlation matrix
+     * @param logDeterminant  its log determinant
+     * @param rOutputs  the training outputs
+     * @param output  which output to fit
+     * @param rMean  filled in with the output mean
+     * @param rVariance  filled in with the signal variance
+     * @param rWeights  filled in with the weights for prediction
+     * @return  the log likelihood; zero for a constant output, which carries no information
+     */
+    static double FitOutput(const std::vector<double>& rFactor, double logDeterminant,
+                            const std::vector<std::vector<double> >& rOutputs, unsigned output,
+                            double& rMean, double& rVariance, std::vector<double>& rWeights);
+
+    /**
+     * Solve L L^T x = b.
+     *
+     * @param rFactor  the Cholesky factor L
+     * @param rB  the right-hand side; overwritten with the solution
+     */
+    static void CholeskySolve(const std::vector<double>& rFactor, std::vector<double>& rB);
+
+    /**
+     * Solve L x = b.
+     *
+     * @param rFactor  the Cholesky factor L
+     * @param rB  the right-hand side; overwritten with the solution
+     */
+    static void ForwardSubstitute(const std::vector<double>& rFactor, std::vector<double>& rB);
+};
+
+#endif // GAUSSIANPROCESSEMULATOR_HPP_
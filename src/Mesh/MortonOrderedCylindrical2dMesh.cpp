@@ -0,0 +1,189 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "MortonOrderedCylindrical2dMesh.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace
+{
+/**
+ * Spread the bits of a 16-bit value out to the even bits of a 32-bit value.
+ *
+ * @param value  the value, less than 2^16
+ * @return  the value with a zero bit inserted above each of its bits
+ */
+unsigned SpreadBits(unsigned value)
+{
+    value = (value | (value << 8)) & 0x00FF00FFu;
+    value = (value | (value << 4)) & 0x0F0F0F0Fu;
+    value = (value | (value << 2)) & 0x33333333u;
+    value = (value | (value << 1)) & 0x55555555u;
+    return value;
+}
+}
+
+MortonOrderedCylindrical2dMesh::MortonOrderedCylindrical2dMesh(double width, unsigned reorderingInterval)
+    : Cylindrical2dMesh(width),
+      mReorderingInterval(reorderingInterval),
+      mNumReMeshesSinceReordering(0u),
+      mNumReorderings(0u)
+{
+}
+
+MortonOrderedCylindrical2dMesh::MortonOrderedCylindrical2dMesh(const Cylindrical2dMesh& rMesh, unsigned reorderingInterval)
+    : Cylindrical2dMesh(rMesh.GetWidth(0), CopyNodes(rMesh)),
+      mReorderingInterval(reorderingInterval),
+      mNumReMeshesSinceReordering(0u),
+      mNumReorderings(0u)
+{
+}
+
+std::vector<Node<2>*> MortonOrderedCylindrical2dMesh::CopyNodes(const Cylindrical2dMesh& rMesh)
+{
+    std::vector<Node<2>*> nodes;
+    nodes.reserve(rMesh.GetNumNodes());
+    for (unsigned i=0; i<rMesh.GetNumAllNodes(); i++)
+    {
+        Node<2>* p_node = rMesh.GetNode(i);
+        if (!p_node->IsDeleted())
+        {
+            nodes.push_back(new Node<2>(nodes.size(), p_node->rGetLocation(), p_node->IsBoundaryNode()));
+        }
+    }
+    return nodes;
+}
+
+unsigned MortonOrderedCylindrical2dMesh::GetReorderingInterval() const
+{
+    return mReorderingInterval;
+}
+
+unsigned MortonOrderedCylindrical2dMesh::GetNumReorderings() const
+{
+    return mNumReorderings;
+}
+
+std::vector<unsigned> MortonOrderedCylindrical2dMesh::CalculateMortonOrder() const
+{
+    // Find the bounding box of the nodes
+    c_vector<double, 2> min_corner = zero_vector<double>(2);
+    c_vector<double, 2> max_corner = zero_vector<double>(2);
+    bool first = true;
+    for (unsigned i=0; i<mNodes.size(); i++)
+    {
+        if (mNodes[i]->IsDeleted())
+        {
+            continue;
+        }
+        const c_vector<double, 2>& r_location = mNodes[i]->rGetLocation();
+        for (unsigned dim=0; dim<2u; dim++)
+        {
+            if (first || r_location[dim] < min_corner[dim])
+            {
+                min_corner[dim] = r_location[dim];
+            }
+            if (first || r_location[dim] > max_corner[dim])
+            {
+                max_corner[dim] = r_location[dim];
+            }
+        }
+        first = false;
+    }
+
+    // Divide the longer side into 2^16 grid cells, and sort nodes by the Morton code of their grid cell
+    double extent = std::max(max_corner[0] - min_corner[0], max_corner[1] - min_corner[1]);
+    double scale = (extent > 0.0) ? 65535.0/extent : 0.0;
+    std::vector<std::pair<unsigned, unsigned> > codes;
+    codes.reserve(mNodes.size());
+    for (unsigned i=0; i<mNodes.size(); i++)
+    {
+        if (mNodes[i]->IsDeleted())
+        {
+            continue;
+        }
+        const c_vector<double, 2>& r_location = mNodes[i]->rGetLocation();
+        unsigned x = std::min(65535u, (unsigned)((r_location[0] - min_corner[0])*scale));
+        unsigned y = std::min(65535u, (unsigned)((r_location[1] - min_corner[1])*scale));
+        codes.push_back(std::make_pair(SpreadBits(x) | (SpreadBits(y) << 1), i));
+    }
+    std::sort(codes.begin(), codes.end());
+
+    std::vector<unsigned> order(codes.size());
+    for (unsigned i=0; i<codes.size(); i++)
+    {
+        order[i] = codes[i].second;
+    }
+    return order;
+}
+
+void MortonOrderedCylindrical2dMesh::ReMesh(NodeMap& rMap)
+{
+    Cylindrical2dMesh::ReMesh(rMap);
+
+    // Remeshing removes deleted nodes, so indices are contiguous here
+    if (mReorderingInterval == 0u || ++mNumReMeshesSinceReordering < mReorderingInterval
+        || GetNumAllNodes() != GetNumNodes())
+    {
+        return;
+    }
+    mNumReMeshesSinceReordering = 0u;
+
+    std::vector<unsigned> order = CalculateMortonOrder();
+    std::vector<unsigned> new_indices(order.size());
+    std::vector<Node<2>*> old_nodes(mNodes);
+    for (unsigned new_index=0; new_index<order.size(); new_index++)
+    {
+        new_indices[order[new_index]] = new_index;
+        mNodes[new_index] = old_nodes[order[new_index]];
+        mNodes[new_index]->SetIndex(new_index);
+    }
+
+    // The map from before remeshing now needs to give the new index of each node after reordering
+    for (unsigned old_index=0; old_index<rMap.Size(); old_index++)
+    {
+        if (!rMap.IsDeleted(old_index))
+        {
+            rMap.SetNewIndex(old_index, new_indices[rMap.GetNewIndex(old_index)]);
+        }
+    }
+    mNumReorderings++;
+}
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+CHASTE_CLASS_EXPORT(MortonOrderedCylindrical2dMesh)
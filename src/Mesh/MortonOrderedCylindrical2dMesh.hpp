@@ -0,0 +1,173 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef MORTONORDEREDCYLINDRICAL2DMESH_HPP_
+#define MORTONORDEREDCYLINDRICAL2DMESH_HPP_
+
+#include <vector>
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+
+#include "Cylindrical2dMesh.hpp"
+
+/**
+ * A Cylindrical2dMesh which periodically renumbers its nodes in the order they lie along a Morton
+ * (Z-order) curve through the unwrapped cylinder, so that nodes close together in space are usually close
+ * together in memory.  As a crypt evolves, daughter cells' nodes are added at the end of the node list and
+ * sloughed cells leave gaps that remeshing closes up, so without this the loops over springs and neighbours
+ * jump about memory more and more.
+ *
+ * Renumbering is done at the end of ReMesh, and is included in the NodeMap it fills in, so a cell population
+ * using the mesh updates its cells' location indices and ghost node flags just as it does for the renumbering
+ * remeshing does anyway.  The Node objects themselves are only reordered, so anything holding pointers to
+ * them, including the mesh elements, is unaffected.
+ */
+class MortonOrderedCylindrical2dMesh : public Cylindrical2dMesh
+{
+private:
+    /** The number of calls to ReMesh between reorderings; 0 to never reorder. */
+    unsigned mReorderingInterval;
+
+    /** The number of calls to ReMesh since nodes were last reordered. */
+    unsigned mNumReMeshesSinceReordering;
+
+    /** The number of times nodes have been reordered. */
+    unsigned mNumReorderings;
+
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<Cylindrical2dMesh>(*this);
+        archive & mNumReMeshesSinceReordering;
+        archive & mNumReorderings;
+    }
+
+    /**
+     * @param rMesh  a mesh
+     * @return  new copies of the mesh's nodes, for the constructor to take ownership of
+     */
+    static std::vector<Node<2>*> CopyNodes(const Cylindrical2dMesh& rMesh);
+
+public:
+    /**
+     * Constructor for an empty mesh.
+     *
+     * @param width  the width of the crypt (circumference)
+     * @param reorderingInterval  the number of calls to ReMesh between reorderings; 0 to never reorder
+     */
+    MortonOrderedCylindrical2dMesh(double width, unsigned reorderingInterval=1u);
+
+    /**
+     * Constructor which copies the nodes of another mesh, keeping their indices, and triangulates them.
+     *
+     * @param rMesh  the mesh to copy, e.g. from a CylindricalHoneycombMeshGenerator
+     * @param reorderingInterval  the number of calls to ReMesh between reorderings; 0 to never reorder
+     */
+    MortonOrderedCylindrical2dMesh(const Cylindrical2dMesh& rMesh, unsigned reorderingInterval);
+
+    /** @return  the number of calls to ReMesh between reorderings. */
+    unsigned GetReorderingInterval() const;
+
+    /** @return  the number of times nodes have been reordered. */
+    unsigned GetNumReorderings() const;
+
+    /**
+     * @return  the indices of the nodes in the order they lie along a Morton curve through the mesh's bounding
+     *     box, with the same grid spacing in each direction.  Deleted nodes are left out.
+     */
+    std::vector<unsigned> CalculateMortonOrder() const;
+
+    using MutableMesh<2,2>::ReMesh;
+
+    /**
+     * Overridden ReMesh() method.  Remeshes as Cylindrical2dMesh does, then renumbers nodes along a Morton
+     * curve if it's time to.
+     *
+     * @param rMap  filled in with the new index of each node, including any reordering
+     */
+    virtual void ReMesh(NodeMap& rMap);
+};
+
+#include "SerializationExportWrapper.hpp"
+CHASTE_CLASS_EXPORT(MortonOrderedCylindrical2dMesh)
+
+namespace boost
+{
+namespace serialization
+{
+/**
+ * Serialize information required to construct a MortonOrderedCylindrical2dMesh.
+ */
+template<class Archive>
+inline void save_construct_data(
+    Archive & ar, const MortonOrderedCylindrical2dMesh * t, const BOOST_PFTO unsigned int file_version)
+{
+    // Save data required to construct instance
+    const double width = t->GetWidth(0);
+    ar << width;
+    const unsigned reordering_interval = t->GetReorderingInterval();
+    ar << reordering_interval;
+}
+
+/**
+ * De-serialize constructor parameters and initialise a MortonOrderedCylindrical2dMesh.
+ */
+template<class Archive>
+inline void load_construct_data(
+    Archive & ar, MortonOrderedCylindrical2dMesh * t, const unsigned int file_version)
+{
+    // Retrieve data from archive required to construct new instance
+    double width;
+    ar >> width;
+    unsigned reordering_interval;
+    ar >> reordering_interval;
+
+    // Invoke inplace constructor to initialise instance
+    ::new(t)MortonOrderedCylindrical2dMesh(width, reordering_interval);
+}
+}
+} // namespace ...
+
+#endif /*MORTONORDEREDCYLINDRICAL2DMESH_HPP_*/
@@ -0,0 +1,154 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "NodeStateArrays.hpp"
+
+#include <cassert>
+
+template<unsigned DIM>
+void NodeStateArrays<DIM>::Gather(AbstractCellPopulation<DIM>& rCellPopulation)
+{
+    AbstractMesh<DIM,DIM>& r_mesh = rCellPopulation.rGetMesh();
+    unsigned num_nodes = r_mesh.GetNumAllNodes();
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        // Reassigning keeps the storage, so after the first timestep this only allocates when the crypt grows
+        mLocations[dim].assign(num_nodes, 0.0);
+        mForces[dim].assign(num_nodes, 0.0);
+    }
+    mRadii.assign(num_nodes, 0.0);
+
+    for (typename AbstractMesh<DIM,DIM>::NodeIterator node_iter = r_mesh.GetNodeIteratorBegin();
+         node_iter != r_mesh.GetNodeIteratorEnd();
+         ++node_iter)
+    {
+        CopyLocation(&(*node_iter));
+        mRadii[node_iter->GetIndex()] = node_iter->GetRadius();
+    }
+}
+
+template<unsigned DIM>
+void NodeStateArrays<DIM>::AddNodeForces(AbstractCellPopulation<DIM>& rCellPopulation)
+{
+    AbstractMesh<DIM,DIM>& r_mesh = rCellPopulation.rGetMesh();
+    for (typename AbstractMesh<DIM,DIM>::NodeIterator node_iter = r_mesh.GetNodeIteratorBegin();
+         node_iter != r_mesh.GetNodeIteratorEnd();
+         ++node_iter)
+    {
+        AddForceContribution(node_iter->GetIndex(), node_iter->rGetAppliedForce());
+    }
+}
+
+template<unsigned DIM>
+void NodeStateArrays<DIM>::ScatterForces(AbstractCellPopulation<DIM>& rCellPopulation) const
+{
+    AbstractMesh<DIM,DIM>& r_mesh = rCellPopulation.rGetMesh();
+    for (typename AbstractMesh<DIM,DIM>::NodeIterator node_iter = r_mesh.GetNodeIteratorBegin();
+         node_iter != r_mesh.GetNodeIteratorEnd();
+         ++node_iter)
+    {
+        node_iter->ClearAppliedForce();
+        node_iter->AddAppliedForceContribution(GetForce(node_iter->GetIndex()));
+    }
+}
+
+template<unsigned DIM>
+unsigned NodeStateArrays<DIM>::GetNumNodes() const
+{
+    return mRadii.size();
+}
+
+template<unsigned DIM>
+NodeStateValue* NodeStateArrays<DIM>::GetLocations(unsigned dimension)
+{
+    assert(dimension < DIM);
+    return mLocations[dimension].empty() ? NULL : &mLocations[dimension][0];
+}
+
+template<unsigned DIM>
+NodeStateValue* NodeStateArrays<DIM>::GetForces(unsigned dimension)
+{
+    assert(dimension < DIM);
+    return mForces[dimension].empty() ? NULL : &mForces[dimension][0];
+}
+
+template<unsigned DIM>
+NodeStateValue* NodeStateArrays<DIM>::GetRadii()
+{
+    return mRadii.empty() ? NULL : &mRadii[0];
+}
+
+template<unsigned DIM>
+c_vector<double, DIM> NodeStateArrays<DIM>::GetLocation(unsigned index) const
+{
+    c_vector<double, DIM> location;
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        location[dim] = mLocations[dim][index];
+    }
+    return location;
+}
+
+template<unsigned DIM>
+c_vector<double, DIM> NodeStateArrays<DIM>::GetForce(unsigned index) const
+{
+    c_vector<double, DIM> force;
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        force[dim] = mForces[dim][index];
+    }
+    return force;
+}
+
+template<unsigned DIM>
+void NodeStateArrays<DIM>::SetLocation(AbstractCentreBasedCellPopulation<DIM>& rCellPopulation, unsigned index,
+                                       const c_vector<double, DIM>& rLocation)
+{
+    ChastePoint<DIM> new_point(rLocation);
+    rCellPopulation.SetNode(index, new_point);
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        mLocations[dim][index] = rLocation[dim];
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class NodeStateArrays<1>;
+template class NodeStateArrays<2>;
+template class NodeStateArrays<3>;
@@ -0,0 +1,192 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef NODESTATEARRAYS_HPP_
+#define NODESTATEARRAYS_HPP_
+
+#include <vector>
+
+#include "UblasVectorInclude.hpp"
+#include "AbstractCentreBasedCellPopulation.hpp"
+
+#ifdef CRYPT_SINGLE_PRECISION_NODE_STATE
+/**
+ * The type in which NodeStateArrays stores locations, forces and radii.  Building with
+ * CRYPT_SINGLE_PRECISION_NODE_STATE defined, e.g.
+ *   scons chaste_libs=1 build=GccOptNative CPPDEFINES=CRYPT_SINGLE_PRECISION_NODE_STATE projects/Wisc2013
+ * stores them as float, halving the memory they occupy and the data the hot loops read.
+ */
+typedef float NodeStateValue;
+#else
+/** The type in which NodeStateArrays stores locations, forces and radii; see above. */
+typedef double NodeStateValue;
+#endif
+
+/**
+ * The state of the nodes of a centre-based cell population held as a structure of arrays: one contiguous array
+ * of each coordinate of node locations, one of each component of the force applied to the nodes, and one of node
+ * radii, each indexed by node index.
+ *
+ * CryptProliferationSimulation gathers these from the population's Node objects at the start of each force
+ * calculation (after remeshing, so indices are current).  From then until the end of the timestep the arrays are
+ * what the hot loops read and write: forces that know about them read locations and radii from the arrays and
+ * add their contributions straight into the force arrays, nodes are moved from the locations and forces in the
+ * arrays, and cell volumes are computed from the locations (see NodeStateVolumeTrackingModifier).  Whatever
+ * moves a node writes its new location to both the arrays and the Node object, so the two stay in step for the
+ * mesh and for code that only knows about Node objects.  GetLocation and GetForce give the familiar c_vector
+ * view of a single node.
+ *
+ * Values are stored as NodeStateValue, which may be single precision.  Each force contribution and each
+ * displacement is computed in double precision from the stored values, but nodes are moved from their stored
+ * locations, so in single precision node locations carry single precision rounding from one timestep to the next.
+ */
+template<unsigned DIM>
+class NodeStateArrays
+{
+private:
+    /** Each coordinate of each node's location. */
+    std::vector<NodeStateValue> mLocations[DIM];
+
+    /** Each component of the force applied to each node. */
+    std::vector<NodeStateValue> mForces[DIM];
+
+    /** Each node's radius. */
+    std::vector<NodeStateValue> mRadii;
+
+public:
+    /**
+     * Copy the locations and radii of a population's nodes, and zero the forces.  Arrays are sized to include
+     * any deleted nodes, whose entries are zero.
+     *
+     * @param rCellPopulation  the population
+     */
+    void Gather(AbstractCellPopulation<DIM>& rCellPopulation);
+
+    /**
+     * Add the forces applied to a population's Node objects to the force arrays, for forces that don't know
+     * about these arrays.
+     *
+     * @param rCellPopulation  the population, which must be the one last gathered from
+     */
+    void AddNodeForces(AbstractCellPopulation<DIM>& rCellPopulation);
+
+    /**
+     * Set the applied force on each of a population's Node objects to the force in the arrays.
+     *
+     * @param rCellPopulation  the population, which must be the one last gathered from
+     */
+    void ScatterForces(AbstractCellPopulation<DIM>& rCellPopulation) const;
+
+    /** @return  the number of nodes, including deleted ones. */
+    unsigned GetNumNodes() const;
+
+    /**
+     * @param dimension  the coordinate
+     * @return  the given coordinate of every node's location
+     */
+    NodeStateValue* GetLocations(unsigned dimension);
+
+    /**
+     * @param dimension  the component
+     * @return  the given component of the force on every node
+     */
+    NodeStateValue* GetForces(unsigned dimension);
+
+    /** @return  every node's radius. */
+    NodeStateValue* GetRadii();
+
+    /**
+     * @param index  a node index
+     * @return  the node's location
+     */
+    c_vector<double, DIM> GetLocation(unsigned index) const;
+
+    /**
+     * @param index  a node index
+     * @return  the force applied to the node
+     */
+    c_vector<double, DIM> GetForce(unsigned index) const;
+
+    /**
+     * @param index  a node index
+     * @return  the node's radius
+     */
+    double GetRadius(unsigned index) const
+    {
+        return mRadii[index];
+    }
+
+    /**
+     * Move a node, in both the arrays and the population.
+     *
+     * @param rCellPopulation  the population, which must be the one last gathered from
+     * @param index  a node index
+     * @param rLocation  the node's new location
+     */
+    void SetLocation(AbstractCentreBasedCellPopulation<DIM>& rCellPopulation, unsigned index,
+                     const c_vector<double, DIM>& rLocation);
+
+    /**
+     * Copy a node's location from the population into the arrays, after something that only knows about Node
+     * objects (such as a boundary condition) has moved it.
+     *
+     * @param pNode  the node, from the population last gathered from
+     */
+    void CopyLocation(const Node<DIM>* pNode)
+    {
+        const c_vector<double, DIM>& r_location = pNode->rGetLocation();
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            mLocations[dim][pNode->GetIndex()] = r_location[dim];
+        }
+    }
+
+    /**
+     * Add to the force applied to a node.
+     *
+     * @param index  a node index
+     * @param rForce  the force to add
+     */
+    void AddForceContribution(unsigned index, const c_vector<double, DIM>& rForce)
+    {
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            mForces[dim][index] += rForce[dim];
+        }
+    }
+};
+
+#endif /*NODESTATEARRAYS_HPP_*/
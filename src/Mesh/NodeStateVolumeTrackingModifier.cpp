@@ -0,0 +1,140 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "NodeStateVolumeTrackingModifier.hpp"
+
+#include <cfloat>
+#include <cmath>
+
+NodeStateVolumeTrackingModifier::NodeStateVolumeTrackingModifier()
+    : VolumeTrackingModifier<2>()
+{
+}
+
+NodeStateVolumeTrackingModifier::~NodeStateVolumeTrackingModifier()
+{
+}
+
+void NodeStateVolumeTrackingModifier::SetNodeState(boost::shared_ptr<NodeStateArrays<2> > pNodeState)
+{
+    mpNodeState = pNodeState;
+}
+
+double NodeStateVolumeTrackingModifier::GetVoronoiArea(MutableMesh<2,2>& rMesh, const NodeStateArrays<2>& rNodeState,
+                                                       unsigned nodeIndex)
+{
+    Node<2>* p_node = rMesh.GetNode(nodeIndex);
+    c_vector<double, 2> location = rNodeState.GetLocation(nodeIndex);
+    double area = 0.0;
+    for (Node<2>::ContainingElementIterator elem_iter = p_node->ContainingElementsBegin();
+         elem_iter != p_node->ContainingElementsEnd();
+         ++elem_iter)
+    {
+        Element<2,2>* p_element = rMesh.GetElement(*elem_iter);
+        unsigned local_index = p_element->GetNodeLocalIndex(nodeIndex);
+
+        // The other two vertices, taken in the element's own order, relative to this node
+        c_vector<double, 2> a = rMesh.GetVectorFromAtoB(location,
+                rNodeState.GetLocation(p_element->GetNodeGlobalIndex((local_index+1)%3)));
+        c_vector<double, 2> b = rMesh.GetVectorFromAtoB(location,
+                rNodeState.GetLocation(p_element->GetNodeGlobalIndex((local_index+2)%3)));
+        double cross_ab = a[0]*b[1] - a[1]*b[0];
+        double a_squared = a[0]*a[0] + a[1]*a[1];
+        double b_squared = b[0]*b[0] + b[1]*b[1];
+
+        // The circumcentre, relative to this node
+        double c_x = (b[1]*a_squared - a[1]*b_squared)/(2.0*cross_ab);
+        double c_y = (a[0]*b_squared - b[0]*a_squared)/(2.0*cross_ab);
+
+        // The quadrilateral from the node to the midpoint of a, the circumcentre and the midpoint of b, which is
+        // traversed anticlockwise if the element is
+        double quad_area = 0.25*((a[0]*c_y - a[1]*c_x) + (c_x*b[1] - c_y*b[0]));
+        area += (cross_ab > 0.0) ? quad_area : -quad_area;
+    }
+    return area;
+}
+
+void NodeStateVolumeTrackingModifier::UpdateCellDataFromNodeState(AbstractCellPopulation<2,2>& rCellPopulation)
+{
+    // As in VolumeTrackingModifier::UpdateCellData, the population must be up to date before volumes are computed
+    rCellPopulation.Update();
+
+    MeshBasedCellPopulation<2>* p_population = dynamic_cast<MeshBasedCellPopulation<2>*>(&rCellPopulation);
+    if (p_population == NULL)
+    {
+        EXCEPTION("NodeStateVolumeTrackingModifier is to be used with a MeshBasedCellPopulation only");
+    }
+    MutableMesh<2,2>& r_mesh = p_population->rGetMesh();
+
+    // Remeshing may have renumbered the nodes
+    mpNodeState->Gather(rCellPopulation);
+    for (AbstractCellPopulation<2>::Iterator cell_iter = rCellPopulation.Begin();
+         cell_iter != rCellPopulation.End();
+         ++cell_iter)
+    {
+        unsigned node_index = p_population->GetLocationIndexUsingCell(*cell_iter);
+        double cell_volume = DBL_MAX;
+        if (!r_mesh.GetNode(node_index)->IsBoundaryNode())
+        {
+            cell_volume = GetVoronoiArea(r_mesh, *mpNodeState, node_index);
+        }
+        cell_iter->GetCellData()->SetItem("volume", cell_volume);
+    }
+}
+
+void NodeStateVolumeTrackingModifier::UpdateAtEndOfTimeStep(AbstractCellPopulation<2,2>& rCellPopulation)
+{
+    if (!mpNodeState)
+    {
+        VolumeTrackingModifier<2>::UpdateAtEndOfTimeStep(rCellPopulation);
+        return;
+    }
+    UpdateCellDataFromNodeState(rCellPopulation);
+}
+
+void NodeStateVolumeTrackingModifier::SetupSolve(AbstractCellPopulation<2,2>& rCellPopulation, std::string outputDirectory)
+{
+    if (!mpNodeState)
+    {
+        VolumeTrackingModifier<2>::SetupSolve(rCellPopulation, outputDirectory);
+        return;
+    }
+    UpdateCellDataFromNodeState(rCellPopulation);
+}
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+CHASTE_CLASS_EXPORT(NodeStateVolumeTrackingModifier)
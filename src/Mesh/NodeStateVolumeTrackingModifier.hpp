@@ -0,0 +1,135 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef NODESTATEVOLUMETRACKINGMODIFIER_HPP_
+#define NODESTATEVOLUMETRACKINGMODIFIER_HPP_
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "VolumeTrackingModifier.hpp"
+#include "NodeStateArrays.hpp"
+#include "MeshBasedCellPopulation.hpp"
+
+/**
+ * A VolumeTrackingModifier for 2d mesh-based populations that computes each cell's volume (area) from node state
+ * arrays, rather than by building the population's Voronoi tessellation.
+ *
+ * Once the population has been updated, the locations are gathered into the arrays, and the area of each real
+ * node's Voronoi cell is summed over the Delaunay triangles containing the node: each contributes the
+ * quadrilateral between the node, the midpoints of its two edges from the node, and its circumcentre.  As for
+ * VolumeTrackingModifier, nodes on the boundary of the mesh are given volume DBL_MAX.  The volumes agree with
+ * the tessellation's to rounding error.
+ *
+ * Until the arrays are set by SetNodeState (CryptProliferationSimulation does so when it uses node state arrays)
+ * this behaves exactly as its parent class.
+ */
+class NodeStateVolumeTrackingModifier : public VolumeTrackingModifier<2>
+{
+private:
+    /** The node state arrays to compute volumes from, if set.  This is not archived. */
+    boost::shared_ptr<NodeStateArrays<2> > mpNodeState;
+
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<VolumeTrackingModifier<2> >(*this);
+    }
+
+    /**
+     * Update the population, gather its node locations into mpNodeState, and set each cell's "volume" CellData
+     * item from them.
+     *
+     * @param rCellPopulation reference to the cell population, which must be mesh-based
+     */
+    void UpdateCellDataFromNodeState(AbstractCellPopulation<2,2>& rCellPopulation);
+
+public:
+    /**
+     * Default constructor.
+     */
+    NodeStateVolumeTrackingModifier();
+
+    /**
+     * Destructor.
+     */
+    virtual ~NodeStateVolumeTrackingModifier();
+
+    /**
+     * Set the node state arrays to compute volumes from.
+     *
+     * @param pNodeState  the arrays, which are gathered from the population before each use
+     */
+    void SetNodeState(boost::shared_ptr<NodeStateArrays<2> > pNodeState);
+
+    /**
+     * Compute the area of a node's Voronoi cell from node state arrays.
+     *
+     * @param rMesh  the mesh the arrays were gathered from
+     * @param rNodeState  the arrays
+     * @param nodeIndex  the index of a node not on the boundary of the mesh
+     * @return  the area
+     */
+    static double GetVoronoiArea(MutableMesh<2,2>& rMesh, const NodeStateArrays<2>& rNodeState, unsigned nodeIndex);
+
+    /**
+     * Overridden UpdateAtEndOfTimeStep() method.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfTimeStep(AbstractCellPopulation<2,2>& rCellPopulation);
+
+    /**
+     * Overridden SetupSolve() method.
+     *
+     * @param rCellPopulation reference to the cell population
+     * @param outputDirectory the output directory, relative to where Chaste output is stored
+     */
+    virtual void SetupSolve(AbstractCellPopulation<2,2>& rCellPopulation, std::string outputDirectory);
+};
+
+#include "SerializationExportWrapper.hpp"
+CHASTE_CLASS_EXPORT(NodeStateVolumeTrackingModifier)
+
+#endif /*NODESTATEVOLUMETRACKINGMODIFIER_HPP_*/
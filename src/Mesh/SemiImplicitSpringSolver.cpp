@@ -0,0 +1,271 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "SemiImplicitSpringSolver.hpp"
+
+#include <cassert>
+#include <cmath>
+
+#include "Exception.hpp"
+
+template<unsigned DIM>
+SemiImplicitSpringSolver<DIM>::SemiImplicitSpringSolver()
+    : mTolerance(1e-8),
+      mMaxIterations(1000u),
+      mNumIterations(0u)
+{
+}
+
+template<unsigned DIM>
+void SemiImplicitSpringSolver<DIM>::Reset(unsigned numNodes)
+{
+    // Clearing keeps the storage, so it is only allocated while the population grows
+    mNodeA.clear();
+    mNodeB.clear();
+    mStiffnesses.clear();
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        mUnitVectors[dim].clear();
+    }
+    mDiagonal.assign(numNodes, 0.0);
+}
+
+template<unsigned DIM>
+void SemiImplicitSpringSolver<DIM>::SetDampingTerm(unsigned index, double dampingOverDt)
+{
+    assert(index < mDiagonal.size());
+    assert(dampingOverDt > 0.0);
+    mDiagonal[index] = dampingOverDt;
+}
+
+template<unsigned DIM>
+void SemiImplicitSpringSolver<DIM>::AddSpring(unsigned nodeAIndex, unsigned nodeBIndex,
+                                              const c_vector<double, DIM>& rUnitVector, double stiffness)
+{
+    mNodeA.push_back(nodeAIndex);
+    mNodeB.push_back(nodeBIndex);
+    mStiffnesses.push_back(stiffness);
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        mUnitVectors[dim].push_back(rUnitVector[dim]);
+    }
+}
+
+template<unsigned DIM>
+unsigned SemiImplicitSpringSolver<DIM>::GetNumSprings() const
+{
+    return mStiffnesses.size();
+}
+
+template<unsigned DIM>
+void SemiImplicitSpringSolver<DIM>::SetTolerance(double tolerance, unsigned maxIterations)
+{
+    mTolerance = tolerance;
+    mMaxIterations = maxIterations;
+}
+
+template<unsigned DIM>
+unsigned SemiImplicitSpringSolver<DIM>::GetNumIterations() const
+{
+    return mNumIterations;
+}
+
+template<unsigned DIM>
+c_vector<double, DIM> SemiImplicitSpringSolver<DIM>::GetDisplacement(unsigned index) const
+{
+    c_vector<double, DIM> displacement;
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        displacement[dim] = mDisplacements[dim][index];
+    }
+    return displacement;
+}
+
+template<unsigned DIM>
+void SemiImplicitSpringSolver<DIM>::Multiply(const std::vector<double> (&rX)[DIM], std::vector<double> (&rY)[DIM]) const
+{
+    unsigned num_nodes = mDiagonal.size();
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        for (unsigned i=0; i<num_nodes; i++)
+        {
+            rY[dim][i] = mDiagonal[i]*rX[dim][i];
+        }
+    }
+
+    // Each spring resists only the change in its own length: k u u^T (x_a - x_b), added to a and taken from b
+    for (unsigned s=0; s<mStiffnesses.size(); s++)
+    {
+        unsigned a = mNodeA[s];
+        unsigned b = mNodeB[s];
+        double stretch = 0.0;
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            stretch += mUnitVectors[dim][s]*(rX[dim][a] - rX[dim][b]);
+        }
+        stretch *= mStiffnesses[s];
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            rY[dim][a] += stretch*mUnitVectors[dim][s];
+            rY[dim][b] -= stretch*mUnitVectors[dim][s];
+        }
+    }
+
+    // Fixed rows are left out of the system, even where springs join them to free nodes
+    for (unsigned i=0; i<num_nodes; i++)
+    {
+        if (mDiagonal[i] == 0.0)
+        {
+            for (unsigned dim=0; dim<DIM; dim++)
+            {
+                rY[dim][i] = 0.0;
+            }
+        }
+    }
+}
+
+template<unsigned DIM>
+void SemiImplicitSpringSolver<DIM>::Solve(NodeStateArrays<DIM>& rNodeState)
+{
+    unsigned num_nodes = mDiagonal.size();
+    assert(rNodeState.GetNumNodes() == num_nodes);
+
+    // Jacobi preconditioner, which is zero for fixed rows so that they never move
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        mInverseDiagonal[dim].assign(num_nodes, 0.0);
+        for (unsigned i=0; i<num_nodes; i++)
+        {
+            mInverseDiagonal[dim][i] = mDiagonal[i];
+        }
+    }
+    for (unsigned s=0; s<mStiffnesses.size(); s++)
+    {
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            double contribution = mStiffnesses[s]*mUnitVectors[dim][s]*mUnitVectors[dim][s];
+            mInverseDiagonal[dim][mNodeA[s]] += contribution;
+            mInverseDiagonal[dim][mNodeB[s]] += contribution;
+        }
+    }
+
+    // Start from no displacement, so the residual is the force on each free node
+    double force_norm_squared = 0.0;
+    double residual_dot_preconditioned = 0.0;
+    for (unsigned dim=0; dim<DIM; dim++)
+    {
+        const NodeStateValue* p_forces = rNodeState.GetForces(dim);
+        mDisplacements[dim].assign(num_nodes, 0.0);
+        mResidual[dim].resize(num_nodes);
+        mPreconditioned[dim].resize(num_nodes);
+        mSearchDirection[dim].resize(num_nodes);
+        mProduct[dim].resize(num_nodes);
+        for (unsigned i=0; i<num_nodes; i++)
+        {
+            if (mDiagonal[i] > 0.0)
+            {
+                mInverseDiagonal[dim][i] = 1.0/mInverseDiagonal[dim][i];
+                mResidual[dim][i] = p_forces[i];
+            }
+            else
+            {
+                mInverseDiagonal[dim][i] = 0.0;
+                mResidual[dim][i] = 0.0;
+            }
+            mPreconditioned[dim][i] = mInverseDiagonal[dim][i]*mResidual[dim][i];
+            mSearchDirection[dim][i] = mPreconditioned[dim][i];
+            force_norm_squared += mResidual[dim][i]*mResidual[dim][i];
+            residual_dot_preconditioned += mResidual[dim][i]*mPreconditioned[dim][i];
+        }
+    }
+
+    // Preconditioned conjugate gradients
+    double tolerance_squared = mTolerance*mTolerance*force_norm_squared;
+    double residual_norm_squared = force_norm_squared;
+    mNumIterations = 0u;
+    while (residual_norm_squared > tolerance_squared)
+    {
+        if (mNumIterations == mMaxIterations)
+        {
+            EXCEPTION("The semi-implicit spring solver did not converge in " << mMaxIterations << " iterations; "
+                      << "relative residual " << sqrt(residual_norm_squared/force_norm_squared) << ".");
+        }
+        mNumIterations++;
+
+        Multiply(mSearchDirection, mProduct);
+        double direction_dot_product = 0.0;
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            for (unsigned i=0; i<num_nodes; i++)
+            {
+                direction_dot_product += mSearchDirection[dim][i]*mProduct[dim][i];
+            }
+        }
+        double step = residual_dot_preconditioned/direction_dot_product;
+
+        double new_residual_dot_preconditioned = 0.0;
+        residual_norm_squared = 0.0;
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            for (unsigned i=0; i<num_nodes; i++)
+            {
+                mDisplacements[dim][i] += step*mSearchDirection[dim][i];
+                mResidual[dim][i] -= step*mProduct[dim][i];
+                mPreconditioned[dim][i] = mInverseDiagonal[dim][i]*mResidual[dim][i];
+                new_residual_dot_preconditioned += mResidual[dim][i]*mPreconditioned[dim][i];
+                residual_norm_squared += mResidual[dim][i]*mResidual[dim][i];
+            }
+        }
+
+        double beta = new_residual_dot_preconditioned/residual_dot_preconditioned;
+        residual_dot_preconditioned = new_residual_dot_preconditioned;
+        for (unsigned dim=0; dim<DIM; dim++)
+        {
+            for (unsigned i=0; i<num_nodes; i++)
+            {
+                mSearchDirection[dim][i] = mPreconditioned[dim][i] + beta*mSearchDirection[dim][i];
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class SemiImplicitSpringSolver<1>;
+template class SemiImplicitSpringSolver<2>;
+template class SemiImplicitSpringSolver<3>;
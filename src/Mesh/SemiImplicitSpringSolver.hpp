@@ -0,0 +1,175 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef SEMIIMPLICITSPRINGSOLVER_HPP_
+#define SEMIIMPLICITSPRINGSOLVER_HPP_
+
+#include <vector>
+
+#include "UblasVectorInclude.hpp"
+#include "NodeStateArrays.hpp"
+
+/**
+ * Solves for node displacements over a timestep with the spring forces between nodes treated implicitly.
+ *
+ * Explicit (forward Euler) movement of node i is dx_i = dt f_i / eta_i, which is only stable while dt is small
+ * compared with eta / k for spring stiffness k.  Here the forces are instead linearised about the current
+ * locations, each spring contributing a stiffness k u u^T along its unit vector u, and the displacements
+ * solve the linearly implicit Euler system
+ *
+ *   (eta_i/dt) dx_i + sum over springs (i,j) of k u u^T (dx_i - dx_j) = f_i
+ *
+ * where f_i is the total force on node i at the current locations.  The matrix is symmetric positive
+ * definite, and is never formed: conjugate gradients with a Jacobi preconditioner works directly from
+ * the list of springs.  As dt tends to zero this gives the explicit displacement, so the method is first
+ * order accurate like forward Euler, but stiff spring modes are damped rather than amplified at large dt.
+ *
+ * Rows whose diagonal (eta_i/dt) has not been set are held fixed, so ghost and deleted nodes can be left out.
+ */
+template<unsigned DIM>
+class SemiImplicitSpringSolver
+{
+private:
+    /** The first node of each spring. */
+    std::vector<unsigned> mNodeA;
+
+    /** The second node of each spring. */
+    std::vector<unsigned> mNodeB;
+
+    /** The stiffness of each spring. */
+    std::vector<double> mStiffnesses;
+
+    /** Each component of the unit vector along each spring. */
+    std::vector<double> mUnitVectors[DIM];
+
+    /** The damping term eta_i/dt for each node, or zero for nodes held fixed. */
+    std::vector<double> mDiagonal;
+
+    /** Each component of each node's displacement, as found by the last call to Solve. */
+    std::vector<double> mDisplacements[DIM];
+
+    /** Conjugate gradient work space: the residual. */
+    std::vector<double> mResidual[DIM];
+
+    /** Conjugate gradient work space: the preconditioned residual. */
+    std::vector<double> mPreconditioned[DIM];
+
+    /** Conjugate gradient work space: the search direction. */
+    std::vector<double> mSearchDirection[DIM];
+
+    /** Conjugate gradient work space: the matrix times the search direction. */
+    std::vector<double> mProduct[DIM];
+
+    /** The inverse of each diagonal entry of the matrix, or zero for fixed rows. */
+    std::vector<double> mInverseDiagonal[DIM];
+
+    /** The residual norm, relative to the norm of the forces, at which to stop iterating. */
+    double mTolerance;
+
+    /** The most iterations to take before giving up. */
+    unsigned mMaxIterations;
+
+    /** The number of iterations taken by the last call to Solve. */
+    unsigned mNumIterations;
+
+    /**
+     * Multiply by the matrix.
+     *
+     * @param rX  each component of the vector to multiply
+     * @param rY  filled in with each component of the product
+     */
+    void Multiply(const std::vector<double> (&rX)[DIM], std::vector<double> (&rY)[DIM]) const;
+
+public:
+    /**
+     * Constructor.
+     */
+    SemiImplicitSpringSolver();
+
+    /**
+     * Remove all springs and damping terms, ready to set up the system for a timestep.
+     *
+     * @param numNodes  the number of nodes, including any ghost or deleted nodes
+     */
+    void Reset(unsigned numNodes);
+
+    /**
+     * Set the damping term for a node, which is then free to move.
+     *
+     * @param index  the node index
+     * @param dampingOverDt  the node's damping constant divided by the timestep
+     */
+    void SetDampingTerm(unsigned index, double dampingOverDt);
+
+    /**
+     * Add the linearised stiffness of a spring between two nodes.
+     *
+     * @param nodeAIndex  the first node
+     * @param nodeBIndex  the second node
+     * @param rUnitVector  the unit vector along the spring (either way round)
+     * @param stiffness  the spring stiffness
+     */
+    void AddSpring(unsigned nodeAIndex, unsigned nodeBIndex, const c_vector<double, DIM>& rUnitVector, double stiffness);
+
+    /** @return  the number of springs added since the last Reset. */
+    unsigned GetNumSprings() const;
+
+    /**
+     * Set when to stop iterating.
+     *
+     * @param tolerance  the residual norm, relative to the norm of the forces, at which to stop
+     * @param maxIterations  the most iterations to take; Solve throws if the tolerance isn't reached
+     */
+    void SetTolerance(double tolerance, unsigned maxIterations);
+
+    /**
+     * Solve for the displacements of the nodes, given the forces on them.
+     *
+     * @param rNodeState  the node state, whose force arrays hold the total force on each node
+     */
+    void Solve(NodeStateArrays<DIM>& rNodeState);
+
+    /** @return  the number of iterations taken by the last call to Solve. */
+    unsigned GetNumIterations() const;
+
+    /**
+     * @param index  a node index
+     * @return  the node's displacement, as found by the last call to Solve
+     */
+    c_vector<double, DIM> GetDisplacement(unsigned index) const;
+};
+
+#endif /*SEMIIMPLICITSPRINGSOLVER_HPP_*/
@@ -0,0 +1,187 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "NodeStateSpringForce.hpp"
+#include "MeshBasedCellPopulation.hpp"
+#include "SimulationTime.hpp"
+#include "Exception.hpp"
+
+template<unsigned DIM>
+NodeStateSpringForce<DIM>::NodeStateSpringForce()
+    : GeneralisedLinearSpringForce<DIM>()
+{
+}
+
+template<unsigned DIM>
+void NodeStateSpringForce<DIM>::SetSlabDecomposition(boost::shared_ptr<CryptSlabDecomposition> pDecomposition)
+{
+    mpSlabDecomposition = pDecomposition;
+}
+
+template<unsigned DIM>
+c_vector<double, DIM> NodeStateSpringForce<DIM>::CalculateForceBetweenNodes(NodeStateArrays<DIM>& rNodeState,
+                                                                          unsigned nodeAGlobalIndex,
+                                                                          unsigned nodeBGlobalIndex,
+                                                                          AbstractCellPopulation<DIM>& rCellPopulation,
+                                                                          bool& rIsCloserThanRestLength)
+{
+    // This follows GeneralisedLinearSpringForce::CalculateForceBetweenNodes, operation for operation, so that
+    // forces are identical when the arrays are double precision
+    assert(nodeAGlobalIndex != nodeBGlobalIndex);
+    rIsCloserThanRestLength = false;
+
+    // The mesh gives the vector between the nodes, so that it can allow for periodicity
+    c_vector<double, DIM> unit_difference = rCellPopulation.rGetMesh().GetVectorFromAtoB(
+            rNodeState.GetLocation(nodeAGlobalIndex), rNodeState.GetLocation(nodeBGlobalIndex));
+    double distance_between_nodes = norm_2(unit_difference);
+    assert(distance_between_nodes > 0);
+    unit_difference /= distance_between_nodes;
+
+    if (this->GetUseCutOffLength() && distance_between_nodes >= this->GetCutOffLength())
+    {
+        return zero_vector<double>(DIM);
+    }
+
+    // Newly divided cells are joined by a spring whose rest length grows over the growth duration
+    double rest_length_final = 1.0;
+    double rest_length = rest_length_final;
+    CellPtr p_cell_a = rCellPopulation.GetCellUsingLocationIndex(nodeAGlobalIndex);
+    CellPtr p_cell_b = rCellPopulation.GetCellUsingLocationIndex(nodeBGlobalIndex);
+    double age_a = p_cell_a->GetAge();
+    double age_b = p_cell_b->GetAge();
+    double growth_duration = this->GetMeinekeSpringGrowthDuration();
+    if (age_a < growth_duration && age_b < growth_duration)
+    {
+        AbstractCentreBasedCellPopulation<DIM>* p_population = static_cast<AbstractCentreBasedCellPopulation<DIM>*>(&rCellPopulation);
+        std::pair<CellPtr,CellPtr> cell_pair = p_population->CreateCellPair(p_cell_a, p_cell_b);
+        if (p_population->IsMarkedSpring(cell_pair))
+        {
+            double lambda = this->GetMeinekeDivisionRestingSpringLength();
+            rest_length = lambda + (rest_length_final - lambda) * age_a/growth_duration;
+        }
+        if (age_a + SimulationTime::Instance()->GetTimeStep() >= growth_duration)
+        {
+            // This spring is about to go out of scope
+            p_population->UnmarkSpring(cell_pair);
+        }
+    }
+
+    // Each node's share of the rest length, which shrinks for a cell undergoing apoptosis
+    double a_rest_length = rest_length*0.5;
+    double b_rest_length = a_rest_length;
+    double radius_a = rNodeState.GetRadius(nodeAGlobalIndex);
+    double radius_b = rNodeState.GetRadius(nodeBGlobalIndex);
+    if (radius_a > 0.0 && radius_b > 0.0)
+    {
+        a_rest_length = (radius_a/(radius_a+radius_b))*rest_length;
+        b_rest_length = (radius_b/(radius_a+radius_b))*rest_length;
+    }
+    if (p_cell_a->HasApoptosisBegun())
+    {
+        a_rest_length = a_rest_length * p_cell_a->GetTimeUntilDeath() / p_cell_a->GetApoptosisTime();
+    }
+    if (p_cell_b->HasApoptosisBegun())
+    {
+        b_rest_length = b_rest_length * p_cell_b->GetTimeUntilDeath() / p_cell_b->GetApoptosisTime();
+    }
+    rest_length = a_rest_length + b_rest_length;
+
+    double overlap = distance_between_nodes - rest_length;
+    rIsCloserThanRestLength = (overlap <= 0);
+    double multiplication_factor = this->VariableSpringConstantMultiplicationFactor(nodeAGlobalIndex, nodeBGlobalIndex,
+                                                                                    rCellPopulation,
+                                                                                    rIsCloserThanRestLength);
+    double spring_stiffness = this->GetMeinekeSpringStiffness();
+    return multiplication_factor * spring_stiffness * unit_difference * overlap;
+}
+
+template<unsigned DIM>
+void NodeStateSpringForce<DIM>::AddForceContribution(NodeStateArrays<DIM>& rNodeState,
+                                                     AbstractCellPopulation<DIM>& rCellPopulation,
+                                                     SemiImplicitSpringSolver<DIM>* pSolver)
+{
+    MeshBasedCellPopulation<DIM>* p_population = dynamic_cast<MeshBasedCellPopulation<DIM>*>(&rCellPopulation);
+    if (!p_population)
+    {
+        EXCEPTION("NodeStateSpringForce can only add to node state arrays for a MeshBasedCellPopulation.");
+    }
+
+    // This follows AbstractTwoBodyInteractionForce::AddForceContribution, working on the arrays instead of nodes
+    const NodeStateValue* p_heights = rNodeState.GetLocations(DIM-1);
+    for (typename MeshBasedCellPopulation<DIM>::SpringIterator spring_iterator = p_population->SpringsBegin();
+         spring_iterator != p_population->SpringsEnd();
+         ++spring_iterator)
+    {
+        unsigned node_a_index = spring_iterator.GetNodeA()->GetIndex();
+        unsigned node_b_index = spring_iterator.GetNodeB()->GetIndex();
+        if (mpSlabDecomposition && !mpSlabDecomposition->IsLocal(p_heights[node_a_index]))
+        {
+            continue;
+        }
+        bool is_closer_than_rest_length;
+        c_vector<double, DIM> force = CalculateForceBetweenNodes(rNodeState, node_a_index, node_b_index,
+                                                                 rCellPopulation, is_closer_than_rest_length);
+        c_vector<double, DIM> negative_force = -1.0*force;
+        rNodeState.AddForceContribution(node_b_index, negative_force);
+        rNodeState.AddForceContribution(node_a_index, force);
+
+        if (pSolver)
+        {
+            // Springs beyond the cut-off length exert no force, and so have no stiffness either
+            double force_magnitude = norm_2(force);
+            if (force_magnitude > 0.0)
+            {
+                c_vector<double, DIM> unit_vector = force/force_magnitude;
+                double stiffness = this->GetMeinekeSpringStiffness()
+                        *this->VariableSpringConstantMultiplicationFactor(node_a_index, node_b_index, rCellPopulation,
+                                                                          is_closer_than_rest_length);
+                pSolver->AddSpring(node_a_index, node_b_index, unit_vector, stiffness);
+            }
+        }
+    }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class NodeStateSpringForce<1>;
+template class NodeStateSpringForce<2>;
+template class NodeStateSpringForce<3>;
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(NodeStateSpringForce)
@@ -0,0 +1,132 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef NODESTATESPRINGFORCE_HPP_
+#define NODESTATESPRINGFORCE_HPP_
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "GeneralisedLinearSpringForce.hpp"
+#include "NodeStateArrays.hpp"
+#include "SemiImplicitSpringSolver.hpp"
+#include "CryptSlabDecomposition.hpp"
+
+/**
+ * A GeneralisedLinearSpringForce which can also work on NodeStateArrays rather than the population's Node
+ * objects: node locations and radii are read from the arrays, and forces added straight into them.  The force
+ * between each pair of nodes is computed as by the parent class for a mesh-based population, which is the only
+ * kind the array version supports.  The array version can also give the linearised stiffness of each spring to a
+ * SemiImplicitSpringSolver.  With a CryptSlabDecomposition, it only computes the springs whose first node is in
+ * this process's slab.
+ */
+template<unsigned DIM>
+class NodeStateSpringForce : public GeneralisedLinearSpringForce<DIM>
+{
+private:
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<GeneralisedLinearSpringForce<DIM> >(*this);
+        // mpSlabDecomposition depends on the processes running, so is set up again by the simulation
+    }
+
+    /** If set, the decomposition giving which springs this process computes. */
+    boost::shared_ptr<CryptSlabDecomposition> mpSlabDecomposition;
+
+    /**
+     * Calculate the force between two nodes, as GeneralisedLinearSpringForce::CalculateForceBetweenNodes does for
+     * a mesh-based population with the default rest length of 1, but with node locations and radii read from the
+     * node state arrays.  Radii only matter if both are set, in which case the rest length is shared between the
+     * nodes in proportion to their radii (equally, as in the parent class, if they are the same).
+     *
+     * @param rNodeState  the node state
+     * @param nodeAGlobalIndex  index of one node
+     * @param nodeBGlobalIndex  index of the other node
+     * @param rCellPopulation  the population
+     * @param rIsCloserThanRestLength  set to whether the nodes are no further apart than the spring's rest length
+     * @return  the force on node A; that on node B is its negative
+     */
+    c_vector<double, DIM> CalculateForceBetweenNodes(NodeStateArrays<DIM>& rNodeState,
+                                                     unsigned nodeAGlobalIndex,
+                                                     unsigned nodeBGlobalIndex,
+                                                     AbstractCellPopulation<DIM>& rCellPopulation,
+                                                     bool& rIsCloserThanRestLength);
+
+public:
+    /**
+     * Constructor.
+     */
+    NodeStateSpringForce();
+
+    using GeneralisedLinearSpringForce<DIM>::AddForceContribution;
+    using GeneralisedLinearSpringForce<DIM>::CalculateForceBetweenNodes;
+
+    /**
+     * Set the decomposition of the crypt across processes, so that only the springs whose first node is in
+     * this process's slab (by its last coordinate) are added to the node state arrays.  The forces must then be
+     * summed over processes with CryptSlabDecomposition::SumForces.
+     *
+     * @param pDecomposition  the decomposition, or an empty pointer to compute every spring
+     */
+    void SetSlabDecomposition(boost::shared_ptr<CryptSlabDecomposition> pDecomposition);
+
+    /**
+     * Add the spring forces to the force arrays of the nodes of a mesh-based population, computed from the
+     * locations and radii in the arrays.
+     *
+     * @param rNodeState  the node state, gathered from the population
+     * @param rCellPopulation  the population
+     * @param pSolver  if given, the stiffness of each spring that exerts a force is added to this solver, which
+     *     should have been reset for the population's nodes
+     */
+    void AddForceContribution(NodeStateArrays<DIM>& rNodeState, AbstractCellPopulation<DIM>& rCellPopulation,
+                              SemiImplicitSpringSolver<DIM>* pSolver=NULL);
+};
+
+#include "SerializationExportWrapper.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(NodeStateSpringForce)
+
+#endif /*NODESTATESPRINGFORCE_HPP_*/
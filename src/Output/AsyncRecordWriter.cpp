@@ -0,0 +1,342 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "AsyncRecordWriter.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <sstream>
+
+#include "Exception.hpp"
+#include "TraceRecorder.hpp"
+
+AsyncRecordWriter::AsyncRecordWriter(unsigned maxQueueLength)
+    : mMaxQueueLength(maxQueueLength),
+      mNumFlushesQueued(0ul),
+      mNumFlushesDone(0ul),
+      mClosing(false),
+      mClosed(false),
+      mStatistics(NUM_STATISTICS, 0.0)
+{
+    if (maxQueueLength == 0u)
+    {
+        EXCEPTION("The output queue must be able to hold at least one record.");
+    }
+    pthread_mutex_init(&mMutex, NULL);
+    pthread_cond_init(&mQueueNotEmpty, NULL);
+    pthread_cond_init(&mQueueNotFull, NULL);
+    pthread_cond_init(&mFlushesDone, NULL);
+    int error = pthread_create(&mThread, NULL, ThreadMain, this);
+    if (error != 0)
+    {
+        pthread_cond_destroy(&mFlushesDone);
+        pthread_cond_destroy(&mQueueNotFull);
+        pthread_cond_destroy(&mQueueNotEmpty);
+        pthread_mutex_destroy(&mMutex);
+        EXCEPTION("Unable to start output writer thread: " << strerror(error));
+    }
+}
+
+
+AsyncRecordWriter::~AsyncRecordWriter()
+{
+    if (!mClosed)
+    {
+        try
+        {
+            Close();
+        }
+        catch (const Exception&)
+        {
+            // Destructors mustn't throw; the caller should have used Close to find out about errors
+        }
+    }
+    pthread_cond_destroy(&mFlushesDone);
+    pthread_cond_destroy(&mQueueNotFull);
+    pthread_cond_destroy(&mQueueNotEmpty);
+    pthread_mutex_destroy(&mMutex);
+}
+
+
+unsigned AsyncRecordWriter::OpenFile(const std::string& rPath)
+{
+    if (mClosed)
+    {
+        EXCEPTION("Unable to open " << rPath << " as the output writer has been closed.");
+    }
+    FILE* p_file = fopen(rPath.c_str(), "w");
+    if (p_file == NULL)
+    {
+        EXCEPTION("Unable to open " << rPath << " for writing: " << strerror(errno));
+    }
+    pthread_mutex_lock(&mMutex);
+    mFiles.push_back(p_file);
+    mPaths.push_back(rPath);
+    unsigned file = mFiles.size() - 1u;
+    pthread_mutex_unlock(&mMutex);
+    return file;
+}
+
+
+void AsyncRecordWriter::Write(unsigned file, const std::string& rText)
+{
+    Record record;
+    record.mFile = file;
+    record.mText = rText;
+    Enqueue(record);
+}
+
+
+void AsyncRecordWriter::WriteRow(unsigned file, const std::vector<double>& rValues)
+{
+    Record record;
+    record.mFile = file;
+    record.mValues = rValues;
+    Enqueue(record);
+}
+
+
+void AsyncRecordWriter::Flush()
+{
+    Record record;
+    record.mFile = UINT_MAX;
+    Enqueue(record);
+    mStatistics[NUM_FLUSHES] += 1.0;
+}
+
+
+void AsyncRecordWriter::Sync()
+{
+    Flush();
+    pthread_mutex_lock(&mMutex);
+    unsigned long num_flushes = mNumFlushesQueued;
+    while (mNumFlushesDone < num_flushes)
+    {
+        pthread_cond_wait(&mFlushesDone, &mMutex);
+    }
+    std::string error = mError;
+    pthread_mutex_unlock(&mMutex);
+    if (!error.empty())
+    {
+        EXCEPTION(error);
+    }
+}
+
+
+void AsyncRecordWriter::Enqueue(Record& rRecord)
+{
+    if (mClosed)
+    {
+        EXCEPTION("Unable to write a record as the output writer has been closed.");
+    }
+    assert(rRecord.mFile == UINT_MAX || rRecord.mFile < mFiles.size());
+    pthread_mutex_lock(&mMutex);
+    if (mQueue.size() >= mMaxQueueLength)
+    {
+        // Back-pressure: wait for the writer thread to catch up
+        double start_time = TraceRecorder::GetTimestamp();
+        while (mQueue.size() >= mMaxQueueLength)
+        {
+            pthread_cond_wait(&mQueueNotFull, &mMutex);
+        }
+        mStatistics[NUM_BLOCKED_WRITES] += 1.0;
+        mStatistics[BLOCKED_SECONDS] += (TraceRecorder::GetTimestamp() - start_time) * 1e-6;
+    }
+    if (rRecord.mFile == UINT_MAX)
+    {
+        mNumFlushesQueued++;
+    }
+    else
+    {
+        mStatistics[NUM_RECORDS] += 1.0;
+        mStatistics[NUM_BYTES] += rRecord.mText.size();
+    }
+    mQueue.push_back(Record());
+    mQueue.back().mFile = rRecord.mFile;
+    mQueue.back().mText.swap(rRecord.mText);
+    mQueue.back().mValues.swap(rRecord.mValues);
+    if (mQueue.size() > mStatistics[MAX_QUEUE_LENGTH])
+    {
+        mStatistics[MAX_QUEUE_LENGTH] = mQueue.size();
+    }
+    pthread_cond_signal(&mQueueNotEmpty);
+    pthread_mutex_unlock(&mMutex);
+}
+
+
+void AsyncRecordWriter::Close()
+{
+    if (mClosed)
+    {
+        return;
+    }
+    pthread_mutex_lock(&mMutex);
+    mClosing = true;
+    pthread_cond_signal(&mQueueNotEmpty);
+    pthread_mutex_unlock(&mMutex);
+    pthread_join(mThread, NULL);
+    mClosed = true;
+
+    for (unsigned i=0; i<mFiles.size(); i++)
+    {
+        if (fclose(mFiles[i]) != 0 && mError.empty())
+        {
+            mError = "Error closing " + mPaths[i] + ": " + strerror(errno);
+        }
+    }
+    mFiles.clear();
+    if (!mError.empty())
+    {
+        EXCEPTION(mError);
+    }
+}
+
+
+bool AsyncRecordWriter::IsClosed() const
+{
+    return mClosed;
+}
+
+
+std::vector<double> AsyncRecordWriter::GetStatistics() const
+{
+    return mStatistics;
+}
+
+
+std::string AsyncRecordWriter::GetStatisticName(Statistic statistic)
+{
+    switch (statistic)
+    {
+        case NUM_RECORDS:
+            return "num_records";
+        case NUM_BYTES:
+            return "num_bytes";
+        case NUM_BLOCKED_WRITES:
+            return "num_blocked_writes";
+        case BLOCKED_SECONDS:
+            return "blocked_seconds";
+        case MAX_QUEUE_LENGTH:
+            return "max_queue_length";
+        case NUM_FLUSHES:
+            return "num_flushes";
+        default:
+            NEVER_REACHED;
+    }
+    return "";
+}
+
+
+void* AsyncRecordWriter::ThreadMain(void* pWriter)
+{
+    static_cast<AsyncRecordWriter*>(pWriter)->DrainQueue();
+    return NULL;
+}
+
+
+void AsyncRecordWriter::DrainQueue()
+{
+    std::deque<Record> batch;
+    std::vector<FILE*> files;
+    std::ostringstream formatter;
+    pthread_mutex_lock(&mMutex);
+    while (true)
+    {
+        while (mQueue.empty() && !mClosing)
+        {
+            pthread_cond_wait(&mQueueNotEmpty, &mMutex);
+        }
+        if (mQueue.empty())
+        {
+            break;
+        }
+        // Take everything queued in one go, so the main thread only contends for the lock briefly
+        batch.swap(mQueue);
+        files = mFiles;
+        pthread_cond_broadcast(&mQueueNotFull);
+        pthread_mutex_unlock(&mMutex);
+
+        unsigned error_file = UINT_MAX;
+        int error_number = 0;
+        unsigned long num_flushes = 0ul;
+        for (std::deque<Record>::const_iterator it = batch.begin(); it != batch.end(); ++it)
+        {
+            if (it->mFile == UINT_MAX)
+            {
+                for (unsigned i=0; i<files.size(); i++)
+                {
+                    fflush(files[i]);
+                }
+                num_flushes++;
+                continue;
+            }
+            const std::string* p_text = &it->mText;
+            std::string formatted;
+            if (p_text->empty() && !it->mValues.empty())
+            {
+                formatter.str("");
+                for (unsigned i=0; i<it->mValues.size(); i++)
+                {
+                    formatter << (i == 0 ? "" : "\t") << it->mValues[i];
+                }
+                formatter << "\n";
+                formatted = formatter.str();
+                p_text = &formatted;
+            }
+            if (fwrite(p_text->data(), 1, p_text->size(), files[it->mFile]) != p_text->size()
+                && error_file == UINT_MAX)
+            {
+                error_file = it->mFile;
+                error_number = errno;
+            }
+        }
+        batch.clear();
+
+        pthread_mutex_lock(&mMutex);
+        if (error_file != UINT_MAX && mError.empty())
+        {
+            mError = "Error writing to " + mPaths[error_file] + ": " + strerror(error_number);
+        }
+        if (num_flushes > 0ul)
+        {
+            mNumFlushesDone += num_flushes;
+            pthread_cond_broadcast(&mFlushesDone);
+        }
+    }
+    pthread_mutex_unlock(&mMutex);
+}
@@ -0,0 +1,221 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef ASYNCRECORDWRITER_HPP_
+#define ASYNCRECORDWRITER_HPP_
+
+#include <cstdio>
+#include <deque>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <boost/utility.hpp>
+
+/**
+ * Writes records to files from a background thread, so that the simulation doesn't stall on filesystem
+ * latency (which can be considerable on network scratch space).
+ *
+ * Records are placed on a bounded queue and drained by the writer thread.  A record is either text to write
+ * verbatim, or a row of numbers which the writer thread formats as tab-separated values (as an ostream with
+ * default settings would) followed by a newline, so that formatting costs are moved off the calling thread
+ * too.  Records for each file are written in the order queued.  If the queue is full, Write blocks until the
+ * writer thread has made room; how often and for how long this happens is recorded, along with other
+ * statistics (see GetStatistics), so the queue length can be tuned.
+ *
+ * Only one thread may call the methods of this class.  The writer thread only does file I/O, so it is safe
+ * to use in MPI programs that don't request thread support.
+ */
+class AsyncRecordWriter : private boost::noncopyable
+{
+public:
+    /** The statistics reported by GetStatistics, in order. */
+    enum Statistic
+    {
+        NUM_RECORDS,        ///< Number of records written
+        NUM_BYTES,          ///< Number of bytes of text records (formatted records aren't counted)
+        NUM_BLOCKED_WRITES, ///< Number of calls to Write that had to wait for room on the queue
+        BLOCKED_SECONDS,    ///< Total wall-clock time spent waiting for room on the queue
+        MAX_QUEUE_LENGTH,   ///< The most records ever waiting on the queue
+        NUM_FLUSHES,        ///< Number of calls to Flush or Sync
+        NUM_STATISTICS      ///< Not a statistic; the number of statistics
+    };
+
+    /** The default maximum number of records waiting to be written. */
+    static const unsigned DEFAULT_MAX_QUEUE_LENGTH = 4096u;
+
+    /**
+     * Create a writer, starting its background thread.
+     *
+     * @param maxQueueLength  the maximum number of records waiting to be written
+     */
+    AsyncRecordWriter(unsigned maxQueueLength=DEFAULT_MAX_QUEUE_LENGTH);
+
+    /**
+     * Destructor.  Closes the writer if Close hasn't been called, ignoring any errors.
+     */
+    ~AsyncRecordWriter();
+
+    /**
+     * Open (and truncate) a file to write records to.
+     *
+     * @param rPath  the absolute path to the file
+     * @return  an identifier for the file, to pass to Write
+     */
+    unsigned OpenFile(const std::string& rPath);
+
+    /**
+     * Queue text to be written to a file.
+     *
+     * @param file  the file, as returned by OpenFile
+     * @param rText  the text to write
+     */
+    void Write(unsigned file, const std::string& rText);
+
+    /**
+     * Queue a row of numbers to be formatted and written to a file.
+     *
+     * @param file  the file, as returned by OpenFile
+     * @param rValues  the numbers to write
+     */
+    void WriteRow(unsigned file, const std::vector<double>& rValues);
+
+    /**
+     * Ask for everything queued so far to be flushed through to the operating system, e.g. at output
+     * sampling boundaries, so that partial results can be monitored.  This doesn't wait for the flush.
+     */
+    void Flush();
+
+    /**
+     * Wait until everything queued so far has been written and flushed through to the operating system, e.g. so
+     * that a checkpoint can include the file.  Throws if any write failed.
+     */
+    void Sync();
+
+    /**
+     * Wait for all queued records to be written, close all files, and stop the background thread.  No more
+     * records may be written afterwards.  Throws if any write failed.
+     */
+    void Close();
+
+    /** @return  whether Close has been called. */
+    bool IsClosed() const;
+
+    /** @return  the statistics described by the Statistic enumeration, in that order. */
+    std::vector<double> GetStatistics() const;
+
+    /**
+     * @param statistic  a statistic
+     * @return  its name
+     */
+    static std::string GetStatisticName(Statistic statistic);
+
+private:
+    /** A queued record. */
+    struct Record
+    {
+        /** The file to write to, or UINT_MAX for a flush request. */
+        unsigned mFile;
+        /** Text to write verbatim. */
+        std::string mText;
+        /** Numbers to format, if mText is empty. */
+        std::vector<double> mValues;
+    };
+
+    /**
+     * Queue a record, blocking if the queue is full.
+     *
+     * @param rRecord  the record; its contents are moved to the queue
+     */
+    void Enqueue(Record& rRecord);
+
+    /**
+     * Entry point for the background thread.
+     *
+     * @param pWriter  the AsyncRecordWriter
+     * @return  nothing
+     */
+    static void* ThreadMain(void* pWriter);
+
+    /** Write records until the writer is closed and the queue is empty. */
+    void DrainQueue();
+
+    /** Records waiting to be written. */
+    std::deque<Record> mQueue;
+
+    /** The maximum length of mQueue. */
+    unsigned mMaxQueueLength;
+
+    /** The open files.  Only ever appended to while the background thread is running. */
+    std::vector<FILE*> mFiles;
+
+    /** The paths of the open files, for error messages. */
+    std::vector<std::string> mPaths;
+
+    /** Protects mQueue, mFiles, mPaths, mClosing, mError and the flush counts. */
+    pthread_mutex_t mMutex;
+
+    /** Signalled when records are added to the queue, or the writer is closing. */
+    pthread_cond_t mQueueNotEmpty;
+
+    /** Signalled when records are removed from the queue. */
+    pthread_cond_t mQueueNotFull;
+
+    /** Signalled when flush requests have been carried out. */
+    pthread_cond_t mFlushesDone;
+
+    /** The number of flush requests queued. */
+    unsigned long mNumFlushesQueued;
+
+    /** The number of flush requests carried out by the background thread. */
+    unsigned long mNumFlushesDone;
+
+    /** The background thread. */
+    pthread_t mThread;
+
+    /** Whether the background thread should exit once the queue is empty. */
+    bool mClosing;
+
+    /** Whether Close has completed. */
+    bool mClosed;
+
+    /** Description of the first write error, if any. */
+    std::string mError;
+
+    /** The statistics, indexed by Statistic. */
+    std::vector<double> mStatistics;
+};
+
+#endif // ASYNCRECORDWRITER_HPP_
@@ -0,0 +1,158 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "SnapshotCodec.hpp"
+
+#include <cmath>
+#include <cstring>
+#include <zlib.h>
+
+#include "Exception.hpp"
+
+void SnapshotCodec::AppendUnsigned(std::string& rBuffer, uint64_t value)
+{
+    while (value >= 0x80u)
+    {
+        rBuffer.push_back((char)((value & 0x7Fu) | 0x80u));
+        value >>= 7;
+    }
+    rBuffer.push_back((char)value);
+}
+
+uint64_t SnapshotCodec::ReadUnsigned(const std::string& rBuffer, size_t& rPos)
+{
+    uint64_t value = 0u;
+    for (unsigned shift = 0u; shift < 64u; shift += 7u)
+    {
+        if (rPos >= rBuffer.size())
+        {
+            EXCEPTION("Corrupt snapshot data: integer runs past the end of the data.");
+        }
+        unsigned char byte = (unsigned char)rBuffer[rPos++];
+        value |= (uint64_t)(byte & 0x7Fu) << shift;
+        if ((byte & 0x80u) == 0u)
+        {
+            return value;
+        }
+    }
+    EXCEPTION("Corrupt snapshot data: integer is too long.");
+}
+
+void SnapshotCodec::AppendSigned(std::string& rBuffer, int64_t value)
+{
+    // Zig-zag encoding maps 0, -1, 1, -2, ... to 0, 1, 2, 3, ...
+    AppendUnsigned(rBuffer, value < 0 ? ((~(uint64_t)value) << 1) | 1u : (uint64_t)value << 1);
+}
+
+int64_t SnapshotCodec::ReadSigned(const std::string& rBuffer, size_t& rPos)
+{
+    uint64_t encoded = ReadUnsigned(rBuffer, rPos);
+    return (encoded & 1u) ? (int64_t)(~(encoded >> 1)) : (int64_t)(encoded >> 1);
+}
+
+void SnapshotCodec::AppendFixed(std::string& rBuffer, uint64_t value)
+{
+    for (unsigned i=0; i<8u; i++)
+    {
+        rBuffer.push_back((char)(value & 0xFFu));
+        value >>= 8;
+    }
+}
+
+uint64_t SnapshotCodec::ReadFixed(const std::string& rBuffer, size_t& rPos)
+{
+    if (rPos + 8u > rBuffer.size())
+    {
+        EXCEPTION("Corrupt snapshot data: number runs past the end of the data.");
+    }
+    uint64_t value = 0u;
+    for (unsigned i=0; i<8u; i++)
+    {
+        value |= (uint64_t)(unsigned char)rBuffer[rPos + i] << (8u*i);
+    }
+    rPos += 8u;
+    return value;
+}
+
+void SnapshotCodec::AppendDouble(std::string& rBuffer, double value)
+{
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    AppendFixed(rBuffer, bits);
+}
+
+double SnapshotCodec::ReadDouble(const std::string& rBuffer, size_t& rPos)
+{
+    uint64_t bits = ReadFixed(rBuffer, rPos);
+    double value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+int64_t SnapshotCodec::Quantise(double value, double quantum)
+{
+    return (int64_t)floor(value/quantum + 0.5);
+}
+
+std::string SnapshotCodec::Compress(const std::string& rData)
+{
+    uLongf compressed_size = compressBound(rData.size());
+    std::string compressed(compressed_size, '\0');
+    int result = compress2((Bytef*)&compressed[0], &compressed_size,
+                           (const Bytef*)rData.data(), rData.size(), Z_BEST_SPEED);
+    if (result != Z_OK)
+    {
+        EXCEPTION("Unable to compress snapshot data (zlib error " << result << ").");
+    }
+    compressed.resize(compressed_size);
+    return compressed;
+}
+
+std::string SnapshotCodec::Decompress(const std::string& rData, size_t rawSize)
+{
+    std::string raw(rawSize, '\0');
+    uLongf raw_size = rawSize;
+    int result = Z_OK;
+    if (rawSize > 0u)
+    {
+        result = uncompress((Bytef*)&raw[0], &raw_size, (const Bytef*)rData.data(), rData.size());
+    }
+    if (result != Z_OK || raw_size != rawSize)
+    {
+        EXCEPTION("Corrupt snapshot data: unable to decompress a frame (zlib error " << result << ").");
+    }
+    return raw;
+}
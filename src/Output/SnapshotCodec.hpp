@@ -0,0 +1,134 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef SNAPSHOTCODEC_HPP_
+#define SNAPSHOTCODEC_HPP_
+
+#include <string>
+#include <stdint.h>
+
+/**
+ * Low-level encoding helpers for the snapshot file format (see SnapshotWriter).
+ *
+ * Integers are written as variable-length little-endian base-128 values, so small numbers (which quantised
+ * position deltas mostly are) take a single byte; signed integers are zig-zag encoded first.  Doubles are
+ * written as their 8-byte IEEE representation in little-endian order, so files are portable.  Buffers are
+ * compressed with zlib at its fastest setting.
+ *
+ * The Read methods decode a value starting at position rPos in the buffer and advance rPos past it; they
+ * throw if the buffer ends first, since that means the file is corrupt.
+ */
+class SnapshotCodec
+{
+public:
+    /**
+     * @param rBuffer  the buffer to append to
+     * @param value  the value to encode
+     */
+    static void AppendUnsigned(std::string& rBuffer, uint64_t value);
+
+    /**
+     * @param rBuffer  the buffer to read from
+     * @param rPos  the position to read from; updated to just past the value
+     * @return  the decoded value
+     */
+    static uint64_t ReadUnsigned(const std::string& rBuffer, size_t& rPos);
+
+    /**
+     * @param rBuffer  the buffer to append to
+     * @param value  the value to encode
+     */
+    static void AppendSigned(std::string& rBuffer, int64_t value);
+
+    /**
+     * @param rBuffer  the buffer to read from
+     * @param rPos  the position to read from; updated to just past the value
+     * @return  the decoded value
+     */
+    static int64_t ReadSigned(const std::string& rBuffer, size_t& rPos);
+
+    /**
+     * Append an integer in a fixed 8 bytes, so that it can be found from the end of a file.
+     *
+     * @param rBuffer  the buffer to append to
+     * @param value  the value to encode
+     */
+    static void AppendFixed(std::string& rBuffer, uint64_t value);
+
+    /**
+     * @param rBuffer  the buffer to read from
+     * @param rPos  the position to read from; updated to just past the value
+     * @return  the decoded value
+     */
+    static uint64_t ReadFixed(const std::string& rBuffer, size_t& rPos);
+
+    /**
+     * @param rBuffer  the buffer to append to
+     * @param value  the value to encode
+     */
+    static void AppendDouble(std::string& rBuffer, double value);
+
+    /**
+     * @param rBuffer  the buffer to read from
+     * @param rPos  the position to read from; updated to just past the value
+     * @return  the decoded value
+     */
+    static double ReadDouble(const std::string& rBuffer, size_t& rPos);
+
+    /**
+     * Round a value to the nearest multiple of a quantum.
+     *
+     * @param value  the value
+     * @param quantum  the quantum
+     * @return  the number of quanta
+     */
+    static int64_t Quantise(double value, double quantum);
+
+    /**
+     * @param rData  the data to compress
+     * @return  the compressed data
+     */
+    static std::string Compress(const std::string& rData);
+
+    /**
+     * @param rData  data returned by Compress
+     * @param rawSize  the size of the original data
+     * @return  the original data
+     */
+    static std::string Decompress(const std::string& rData, size_t rawSize);
+};
+
+#endif // SNAPSHOTCODEC_HPP_
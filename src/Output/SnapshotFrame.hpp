@@ -0,0 +1,68 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef SNAPSHOTFRAME_HPP_
+#define SNAPSHOTFRAME_HPP_
+
+#include <vector>
+
+/**
+ * The state of a cell population at one time, as stored in a snapshot file (see SnapshotWriter).
+ *
+ * Cells may be given in any order when writing; frames read back from a file have their cells sorted by id.
+ */
+struct SnapshotFrame
+{
+    /** The simulation time of the frame. */
+    double mTime;
+
+    /** The id of each cell. */
+    std::vector<unsigned> mCellIds;
+
+    /** The colour of each cell, as used by the visualiser. */
+    std::vector<int> mColours;
+
+    /** The location of each cell centre, with the coordinates of each cell stored contiguously. */
+    std::vector<double> mLocations;
+
+    /**
+     * The elements of the population's mesh (if any), as the indices into the cell vectors of the vertices
+     * of each element, stored contiguously.
+     */
+    std::vector<unsigned> mElements;
+};
+
+#endif // SNAPSHOTFRAME_HPP_
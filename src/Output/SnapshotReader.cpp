@@ -0,0 +1,473 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "SnapshotReader.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+#include "Exception.hpp"
+#include "SnapshotCodec.hpp"
+
+/** The largest possible size of a frame block header: kind, time, and two integers. */
+static const unsigned MAX_BLOCK_HEADER_SIZE = 1u + 8u + 10u + 10u;
+
+SnapshotReader::SnapshotReader(const std::string& rPath)
+    : mFile(rPath.c_str(), std::ios::in | std::ios::binary),
+      mPath(rPath),
+      mFileSize(0u),
+      mIndexRebuilt(false),
+      mCurrentIndex(UINT_MAX)
+{
+    if (!mFile.is_open())
+    {
+        EXCEPTION("Unable to open snapshot file " << rPath);
+    }
+    mFile.seekg(0, std::ios::end);
+    mFileSize = mFile.tellg();
+
+    std::string header = ReadBytes(0u, 8u + 10u + 8u + 10u + 10u);
+    if (header.substr(0u, 8u) != "CRSNAP01")
+    {
+        EXCEPTION("File " << rPath << " is not a snapshot file.");
+    }
+    size_t pos = 8u;
+    mDimension = SnapshotCodec::ReadUnsigned(header, pos);
+    mQuantum = SnapshotCodec::ReadDouble(header, pos);
+    SnapshotCodec::ReadUnsigned(header, pos); // The keyframe interval, which the index makes redundant
+    uint64_t setup_size = SnapshotCodec::ReadUnsigned(header, pos);
+    mSetupText = ReadBytes(pos, setup_size);
+    if (mSetupText.size() != setup_size || mDimension == 0u || mDimension > 3u)
+    {
+        EXCEPTION("Corrupt snapshot file " << rPath << ": bad header.");
+    }
+    mFirstBlockOffset = pos + setup_size;
+
+    if (!ReadIndex())
+    {
+        RebuildIndex();
+    }
+}
+
+unsigned SnapshotReader::GetNumFrames() const
+{
+    return mFrameTimes.size();
+}
+
+double SnapshotReader::GetFrameTime(unsigned index) const
+{
+    assert(index < mFrameTimes.size());
+    return mFrameTimes[index];
+}
+
+unsigned SnapshotReader::GetDimension() const
+{
+    return mDimension;
+}
+
+double SnapshotReader::GetQuantum() const
+{
+    return mQuantum;
+}
+
+const std::string& SnapshotReader::rGetSetupText() const
+{
+    return mSetupText;
+}
+
+bool SnapshotReader::WasIndexRebuilt() const
+{
+    return mIndexRebuilt;
+}
+
+const SnapshotFrame& SnapshotReader::rReadFrame(unsigned index)
+{
+    if (index >= mFrameTimes.size())
+    {
+        EXCEPTION("Snapshot file " << mPath << " has " << mFrameTimes.size() << " frames; there is no frame " << index << ".");
+    }
+    unsigned keyframe = index;
+    while (!mFrameIsKey[keyframe])
+    {
+        if (keyframe == 0u)
+        {
+            EXCEPTION("Corrupt snapshot file " << mPath << ": it doesn't start with a keyframe.");
+        }
+        keyframe--;
+    }
+
+    // Carry on from the current frame if it's between the keyframe and the one wanted
+    unsigned start = keyframe;
+    if (mCurrentIndex != UINT_MAX && mCurrentIndex >= keyframe && mCurrentIndex <= index)
+    {
+        start = mCurrentIndex + 1u;
+    }
+    for (unsigned i=start; i<=index; i++)
+    {
+        // If decoding fails part way, the current frame is no longer valid
+        mCurrentIndex = UINT_MAX;
+        DecodeFrame(i);
+        mCurrentIndex = i;
+    }
+    return mFrame;
+}
+
+void SnapshotReader::ExportVisualizerFiles(const std::string& rDirectory)
+{
+    std::string prefix = rDirectory + "/results.";
+    std::ofstream nodes_file((prefix + "viznodes").c_str());
+    std::ofstream types_file((prefix + "vizcelltypes").c_str());
+    std::ofstream elements_file((prefix + "vizelements").c_str());
+    std::ofstream setup_file((prefix + "vizsetup").c_str());
+    if (!nodes_file.is_open() || !types_file.is_open() || !elements_file.is_open() || !setup_file.is_open())
+    {
+        EXCEPTION("Unable to create visualiser files in " << rDirectory);
+    }
+    setup_file << mSetupText << "Complete\n";
+
+    for (unsigned index=0; index<mFrameTimes.size(); index++)
+    {
+        const SnapshotFrame& r_frame = rReadFrame(index);
+        nodes_file << r_frame.mTime << "\t";
+        for (unsigned i=0; i<r_frame.mLocations.size(); i++)
+        {
+            nodes_file << r_frame.mLocations[i] << " ";
+        }
+        nodes_file << "\n";
+        types_file << r_frame.mTime << "\t";
+        for (unsigned i=0; i<r_frame.mColours.size(); i++)
+        {
+            types_file << r_frame.mColours[i] << " ";
+        }
+        types_file << "\n";
+        elements_file << r_frame.mTime << "\t";
+        for (unsigned i=0; i<r_frame.mElements.size(); i++)
+        {
+            elements_file << r_frame.mElements[i] << " ";
+        }
+        elements_file << "\n";
+    }
+    nodes_file.close();
+    types_file.close();
+    elements_file.close();
+    if (nodes_file.fail() || types_file.fail() || elements_file.fail())
+    {
+        EXCEPTION("Unable to write visualiser files in " << rDirectory);
+    }
+}
+
+std::string SnapshotReader::ReadBytes(uint64_t offset, uint64_t maxBytes)
+{
+    if (offset >= mFileSize)
+    {
+        return "";
+    }
+    std::string bytes(std::min(maxBytes, mFileSize - offset), '\0');
+    mFile.clear();
+    mFile.seekg(offset);
+    mFile.read(&bytes[0], bytes.size());
+    bytes.resize(mFile.gcount());
+    return bytes;
+}
+
+bool SnapshotReader::ReadIndex()
+{
+    if (mFileSize < mFirstBlockOffset + 16u)
+    {
+        return false;
+    }
+    std::string trailer = ReadBytes(mFileSize - 16u, 16u);
+    if (trailer.substr(8u) != "CRSNAPIX")
+    {
+        return false;
+    }
+    size_t pos = 0u;
+    uint64_t index_offset = SnapshotCodec::ReadFixed(trailer, pos);
+    if (index_offset < mFirstBlockOffset || index_offset >= mFileSize - 16u)
+    {
+        return false;
+    }
+    std::string index = ReadBytes(index_offset, mFileSize - 16u - index_offset);
+    try
+    {
+        pos = 0u;
+        if (index[pos++] != 'I')
+        {
+            return false;
+        }
+        uint64_t num_frames = SnapshotCodec::ReadUnsigned(index, pos);
+        for (uint64_t i=0; i<num_frames; i++)
+        {
+            double time = SnapshotCodec::ReadDouble(index, pos);
+            uint64_t offset = SnapshotCodec::ReadUnsigned(index, pos);
+            if (pos >= index.size() || offset < mFirstBlockOffset || offset >= index_offset)
+            {
+                EXCEPTION("Corrupt snapshot index.");
+            }
+            mFrameTimes.push_back(time);
+            mFrameOffsets.push_back(offset);
+            mFrameIsKey.push_back(index[pos++] == 'K');
+        }
+    }
+    catch (const Exception&)
+    {
+        mFrameTimes.clear();
+        mFrameOffsets.clear();
+        mFrameIsKey.clear();
+        return false;
+    }
+    return true;
+}
+
+void SnapshotReader::RebuildIndex()
+{
+    mIndexRebuilt = true;
+    uint64_t offset = mFirstBlockOffset;
+    while (true)
+    {
+        std::string header = ReadBytes(offset, MAX_BLOCK_HEADER_SIZE);
+        if (header.empty() || (header[0] != 'K' && header[0] != 'D'))
+        {
+            break;
+        }
+        try
+        {
+            size_t pos = 1u;
+            double time = SnapshotCodec::ReadDouble(header, pos);
+            SnapshotCodec::ReadUnsigned(header, pos);
+            uint64_t compressed_size = SnapshotCodec::ReadUnsigned(header, pos);
+            uint64_t block_end = offset + pos + compressed_size;
+            if (block_end > mFileSize)
+            {
+                // A partly written frame
+                break;
+            }
+            mFrameTimes.push_back(time);
+            mFrameOffsets.push_back(offset);
+            mFrameIsKey.push_back(header[0] == 'K');
+            offset = block_end;
+        }
+        catch (const Exception&)
+        {
+            break;
+        }
+    }
+}
+
+void SnapshotReader::DecodeFrame(unsigned index)
+{
+    std::string header = ReadBytes(mFrameOffsets[index], MAX_BLOCK_HEADER_SIZE);
+    size_t pos = 0u;
+    if (header.empty() || header[pos++] != (mFrameIsKey[index] ? 'K' : 'D'))
+    {
+        EXCEPTION("Corrupt snapshot file " << mPath << ": frame " << index << " is missing.");
+    }
+    double time = SnapshotCodec::ReadDouble(header, pos);
+    uint64_t raw_size = SnapshotCodec::ReadUnsigned(header, pos);
+    uint64_t compressed_size = SnapshotCodec::ReadUnsigned(header, pos);
+    std::string compressed = ReadBytes(mFrameOffsets[index] + pos, compressed_size);
+    if (compressed.size() != compressed_size)
+    {
+        EXCEPTION("Corrupt snapshot file " << mPath << ": frame " << index << " is truncated.");
+    }
+    std::string payload = SnapshotCodec::Decompress(compressed, raw_size);
+    pos = 0u;
+
+    std::vector<unsigned> ids;
+    std::vector<int> colours;
+    std::vector<int64_t> locations;
+    std::vector<unsigned> elements;
+    bool topology_changed = true;
+    if (mFrameIsKey[index])
+    {
+        unsigned num_cells = SnapshotCodec::ReadUnsigned(payload, pos);
+        ids.resize(num_cells);
+        colours.resize(num_cells);
+        locations.resize(num_cells*mDimension);
+        unsigned last_id = 0u;
+        for (unsigned i=0; i<num_cells; i++)
+        {
+            last_id += SnapshotCodec::ReadUnsigned(payload, pos);
+            ids[i] = last_id;
+        }
+        for (unsigned i=0; i<num_cells; i++)
+        {
+            colours[i] = SnapshotCodec::ReadSigned(payload, pos);
+        }
+        for (unsigned d=0; d<mDimension; d++)
+        {
+            for (unsigned i=0; i<num_cells; i++)
+            {
+                locations[i*mDimension + d] = SnapshotCodec::ReadSigned(payload, pos);
+            }
+        }
+    }
+    else
+    {
+        // Cells which have gone
+        std::vector<unsigned> removed(SnapshotCodec::ReadUnsigned(payload, pos));
+        unsigned last_id = 0u;
+        for (unsigned i=0; i<removed.size(); i++)
+        {
+            last_id += SnapshotCodec::ReadUnsigned(payload, pos);
+            removed[i] = last_id;
+        }
+
+        // New cells
+        std::vector<unsigned> added_ids(SnapshotCodec::ReadUnsigned(payload, pos));
+        std::vector<int> added_colours(added_ids.size());
+        std::vector<int64_t> added_locations(added_ids.size()*mDimension);
+        last_id = 0u;
+        for (unsigned i=0; i<added_ids.size(); i++)
+        {
+            last_id += SnapshotCodec::ReadUnsigned(payload, pos);
+            added_ids[i] = last_id;
+            added_colours[i] = SnapshotCodec::ReadSigned(payload, pos);
+            for (unsigned d=0; d<mDimension; d++)
+            {
+                added_locations[i*mDimension + d] = SnapshotCodec::ReadSigned(payload, pos);
+            }
+        }
+
+        // The remaining cells of the previous frame
+        std::vector<unsigned> persisting;
+        for (unsigned i_old=0, i_removed=0; i_old<mFrame.mCellIds.size(); i_old++)
+        {
+            if (i_removed < removed.size() && removed[i_removed] == mFrame.mCellIds[i_old])
+            {
+                i_removed++;
+            }
+            else
+            {
+                persisting.push_back(i_old);
+            }
+        }
+        std::vector<int64_t> persisting_locations(persisting.size()*mDimension);
+        for (unsigned d=0; d<mDimension; d++)
+        {
+            for (unsigned i=0; i<persisting.size(); i++)
+            {
+                persisting_locations[i*mDimension + d] = mQuantisedLocations[persisting[i]*mDimension + d]
+                                                         + SnapshotCodec::ReadSigned(payload, pos);
+            }
+        }
+        std::vector<int> persisting_colours(persisting.size());
+        for (unsigned i=0; i<persisting.size(); i++)
+        {
+            persisting_colours[i] = mFrame.mColours[persisting[i]];
+        }
+        unsigned num_recoloured = SnapshotCodec::ReadUnsigned(payload, pos);
+        unsigned last_index = 0u;
+        for (unsigned i=0; i<num_recoloured; i++)
+        {
+            last_index += SnapshotCodec::ReadUnsigned(payload, pos);
+            if (last_index >= persisting.size())
+            {
+                EXCEPTION("Corrupt snapshot file " << mPath << ": frame " << index << " recolours a missing cell.");
+            }
+            persisting_colours[last_index] = SnapshotCodec::ReadSigned(payload, pos);
+        }
+
+        // Merge the remaining and new cells in id order
+        unsigned i_persisting = 0u, i_added = 0u;
+        while (i_persisting < persisting.size() || i_added < added_ids.size())
+        {
+            bool take_added = (i_persisting == persisting.size()
+                               || (i_added < added_ids.size() && added_ids[i_added] < mFrame.mCellIds[persisting[i_persisting]]));
+            if (take_added)
+            {
+                ids.push_back(added_ids[i_added]);
+                colours.push_back(added_colours[i_added]);
+                locations.insert(locations.end(), added_locations.begin() + i_added*mDimension,
+                                 added_locations.begin() + (i_added + 1u)*mDimension);
+                i_added++;
+            }
+            else
+            {
+                ids.push_back(mFrame.mCellIds[persisting[i_persisting]]);
+                colours.push_back(persisting_colours[i_persisting]);
+                locations.insert(locations.end(), persisting_locations.begin() + i_persisting*mDimension,
+                                 persisting_locations.begin() + (i_persisting + 1u)*mDimension);
+                i_persisting++;
+            }
+        }
+        topology_changed = (SnapshotCodec::ReadUnsigned(payload, pos) != 0u);
+    }
+
+    std::vector<unsigned> element_ids;
+    if (topology_changed)
+    {
+        elements.resize(SnapshotCodec::ReadUnsigned(payload, pos)*(mDimension + 1u));
+        element_ids.resize(elements.size());
+        for (unsigned i=0; i<elements.size(); i++)
+        {
+            elements[i] = SnapshotCodec::ReadUnsigned(payload, pos);
+            if (elements[i] >= ids.size())
+            {
+                EXCEPTION("Corrupt snapshot file " << mPath << ": frame " << index << " has an element vertex which isn't a cell.");
+            }
+            element_ids[i] = ids[elements[i]];
+        }
+    }
+    else
+    {
+        // Same connectivity, but cells may have moved in the id order
+        element_ids = mElementIds;
+        elements.resize(element_ids.size());
+        for (unsigned i=0; i<element_ids.size(); i++)
+        {
+            std::vector<unsigned>::const_iterator it = std::lower_bound(ids.begin(), ids.end(), element_ids[i]);
+            if (it == ids.end() || *it != element_ids[i])
+            {
+                EXCEPTION("Corrupt snapshot file " << mPath << ": frame " << index << " has an element vertex which isn't a cell.");
+            }
+            elements[i] = it - ids.begin();
+        }
+    }
+
+    mFrame.mTime = time;
+    mFrame.mCellIds.swap(ids);
+    mFrame.mColours.swap(colours);
+    mFrame.mElements.swap(elements);
+    mFrame.mLocations.resize(locations.size());
+    for (unsigned i=0; i<locations.size(); i++)
+    {
+        mFrame.mLocations[i] = locations[i]*mQuantum;
+    }
+    mQuantisedLocations.swap(locations);
+    mElementIds.swap(element_ids);
+}
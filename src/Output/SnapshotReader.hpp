@@ -0,0 +1,179 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef SNAPSHOTREADER_HPP_
+#define SNAPSHOTREADER_HPP_
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/utility.hpp>
+
+#include "SnapshotFrame.hpp"
+
+/**
+ * Reads population snapshots written by SnapshotWriter, giving random access to any frame.
+ *
+ * A frame is reconstructed by decoding from the nearest keyframe at or before it, or by carrying on from the
+ * last frame read if that is closer, so reading frames in order only decodes each frame once.  Reconstructed
+ * frames have their cells sorted by id, and their locations rounded to the writer's quantum.
+ *
+ * ExportVisualizerFiles converts the snapshots to the text files that the Visualize2dCentreCells tool reads.
+ */
+class SnapshotReader : private boost::noncopyable
+{
+public:
+    /**
+     * Open a snapshot file, and read its index.  If the file has no index, e.g. because the simulation
+     * writing it died, the index is rebuilt from the complete frames in the file.
+     *
+     * @param rPath  the absolute path to the file
+     */
+    SnapshotReader(const std::string& rPath);
+
+    /** @return  the number of frames in the file. */
+    unsigned GetNumFrames() const;
+
+    /**
+     * @param index  the index of a frame
+     * @return  the time of the frame
+     */
+    double GetFrameTime(unsigned index) const;
+
+    /** @return  the spatial dimension of the snapshots. */
+    unsigned GetDimension() const;
+
+    /** @return  the grid spacing of stored locations. */
+    double GetQuantum() const;
+
+    /** @return  the setup text given to the writer. */
+    const std::string& rGetSetupText() const;
+
+    /** @return  whether the index was rebuilt because the file didn't have one. */
+    bool WasIndexRebuilt() const;
+
+    /**
+     * Reconstruct a frame.
+     *
+     * @param index  the index of the frame
+     * @return  the frame; only valid until the next call
+     */
+    const SnapshotFrame& rReadFrame(unsigned index);
+
+    /**
+     * Write every frame to results.viznodes, results.vizcelltypes and results.vizelements in the given
+     * directory, in the format of the text output of a cell-based simulation, along with results.vizsetup.
+     *
+     * @param rDirectory  the absolute path to an existing directory
+     */
+    void ExportVisualizerFiles(const std::string& rDirectory);
+
+private:
+    /**
+     * Read bytes from the file.
+     *
+     * @param offset  where to start reading
+     * @param maxBytes  how many bytes to read
+     * @return  the bytes read; fewer than maxBytes if the end of the file is reached
+     */
+    std::string ReadBytes(uint64_t offset, uint64_t maxBytes);
+
+    /**
+     * Read the index at the end of the file.
+     *
+     * @return  whether a valid index was found
+     */
+    bool ReadIndex();
+
+    /** Rebuild the index by scanning the frame blocks. */
+    void RebuildIndex();
+
+    /**
+     * Decode a frame into mFrame.  A delta frame is applied to the frame already in mFrame, which must be
+     * the frame before it.
+     *
+     * @param index  the index of the frame
+     */
+    void DecodeFrame(unsigned index);
+
+    /** The file. */
+    std::ifstream mFile;
+
+    /** The path of the file, for error messages. */
+    std::string mPath;
+
+    /** The size of the file. */
+    uint64_t mFileSize;
+
+    /** The spatial dimension. */
+    unsigned mDimension;
+
+    /** The grid spacing of stored locations. */
+    double mQuantum;
+
+    /** The setup text given to the writer. */
+    std::string mSetupText;
+
+    /** The offset of the first frame block. */
+    uint64_t mFirstBlockOffset;
+
+    /** Whether the index was rebuilt. */
+    bool mIndexRebuilt;
+
+    /** The time of each frame. */
+    std::vector<double> mFrameTimes;
+
+    /** The file offset of each frame. */
+    std::vector<uint64_t> mFrameOffsets;
+
+    /** Whether each frame is a keyframe. */
+    std::vector<bool> mFrameIsKey;
+
+    /** The index of the frame in mFrame, or UINT_MAX if none. */
+    unsigned mCurrentIndex;
+
+    /** The frame last reconstructed. */
+    SnapshotFrame mFrame;
+
+    /** The quantised locations of the cells of mFrame. */
+    std::vector<int64_t> mQuantisedLocations;
+
+    /** The elements of mFrame, as the ids of their vertex cells. */
+    std::vector<unsigned> mElementIds;
+};
+
+#endif // SNAPSHOTREADER_HPP_
@@ -0,0 +1,356 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "SnapshotWriter.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include "Exception.hpp"
+#include "SnapshotCodec.hpp"
+
+/** Comparison used to sort cells by id. */
+class CompareCellIds
+{
+public:
+    /**
+     * Constructor.
+     *
+     * @param rIds  the cell ids
+     */
+    CompareCellIds(const std::vector<unsigned>& rIds)
+        : mrIds(rIds)
+    {
+    }
+
+    /**
+     * @param i  the index of a cell
+     * @param j  the index of another cell
+     * @return  whether the first cell has the smaller id
+     */
+    bool operator()(unsigned i, unsigned j) const
+    {
+        return mrIds[i] < mrIds[j];
+    }
+
+private:
+    /** The cell ids. */
+    const std::vector<unsigned>& mrIds;
+};
+
+SnapshotWriter::SnapshotWriter(const std::string& rPath, unsigned dimension, double quantum,
+                               unsigned keyframeInterval, const std::string& rSetupText)
+    : mpFile(NULL),
+      mPath(rPath),
+      mDimension(dimension),
+      mQuantum(quantum),
+      mKeyframeInterval(keyframeInterval),
+      mNumBytes(0u)
+{
+    if (dimension == 0u || dimension > 3u || !(quantum > 0.0) || keyframeInterval == 0u)
+    {
+        EXCEPTION("Snapshots need a dimension of 1 to 3, a positive quantum, and a non-zero keyframe interval.");
+    }
+    mpFile = fopen(rPath.c_str(), "wb");
+    if (mpFile == NULL)
+    {
+        EXCEPTION("Unable to open snapshot file " << rPath << ": " << strerror(errno));
+    }
+    std::string header("CRSNAP01");
+    SnapshotCodec::AppendUnsigned(header, dimension);
+    SnapshotCodec::AppendDouble(header, quantum);
+    SnapshotCodec::AppendUnsigned(header, keyframeInterval);
+    SnapshotCodec::AppendUnsigned(header, rSetupText.size());
+    header += rSetupText;
+    WriteBytes(header);
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    if (mpFile != NULL)
+    {
+        try
+        {
+            Close();
+        }
+        catch (const Exception&)
+        {
+            // Destructors mustn't throw
+        }
+    }
+}
+
+void SnapshotWriter::WriteFrame(const SnapshotFrame& rFrame)
+{
+    if (mpFile == NULL)
+    {
+        EXCEPTION("Snapshot file " << mPath << " has been closed.");
+    }
+    const unsigned num_cells = rFrame.mCellIds.size();
+    const unsigned vertices_per_element = mDimension + 1u;
+    if (rFrame.mColours.size() != num_cells || rFrame.mLocations.size() != num_cells*mDimension
+        || rFrame.mElements.size() % vertices_per_element != 0u)
+    {
+        EXCEPTION("Snapshot frame has inconsistent numbers of cells, colours, locations and element vertices.");
+    }
+    if (!mFrameTimes.empty() && rFrame.mTime < mFrameTimes.back())
+    {
+        EXCEPTION("Snapshot frames must be written in time order.");
+    }
+
+    // Put the cells in id order, so that cells can be matched up between frames by a merge
+    std::vector<unsigned> order(num_cells);
+    for (unsigned i=0; i<num_cells; i++)
+    {
+        order[i] = i;
+    }
+    std::sort(order.begin(), order.end(), CompareCellIds(rFrame.mCellIds));
+    std::vector<unsigned> ids(num_cells);
+    std::vector<int> colours(num_cells);
+    std::vector<int64_t> locations(num_cells*mDimension);
+    std::vector<unsigned> sorted_index(num_cells);
+    for (unsigned i=0; i<num_cells; i++)
+    {
+        ids[i] = rFrame.mCellIds[order[i]];
+        if (i > 0u && ids[i] == ids[i-1])
+        {
+            EXCEPTION("Cell " << ids[i] << " appears more than once in a snapshot frame.");
+        }
+        colours[i] = rFrame.mColours[order[i]];
+        for (unsigned d=0; d<mDimension; d++)
+        {
+            locations[i*mDimension + d] = SnapshotCodec::Quantise(rFrame.mLocations[order[i]*mDimension + d], mQuantum);
+        }
+        sorted_index[order[i]] = i;
+    }
+    std::vector<unsigned> elements(rFrame.mElements.size());
+    std::vector<unsigned> element_ids(rFrame.mElements.size());
+    for (unsigned i=0; i<elements.size(); i++)
+    {
+        if (rFrame.mElements[i] >= num_cells)
+        {
+            EXCEPTION("Snapshot frame has an element vertex which isn't a cell.");
+        }
+        elements[i] = sorted_index[rFrame.mElements[i]];
+        element_ids[i] = rFrame.mCellIds[rFrame.mElements[i]];
+    }
+
+    std::string payload;
+    const bool is_key = (mFrameTimes.size() % mKeyframeInterval == 0u);
+    if (is_key)
+    {
+        // The whole population; coordinates are grouped by dimension as they compress better that way
+        SnapshotCodec::AppendUnsigned(payload, num_cells);
+        unsigned last_id = 0u;
+        for (unsigned i=0; i<num_cells; i++)
+        {
+            SnapshotCodec::AppendUnsigned(payload, ids[i] - last_id);
+            last_id = ids[i];
+        }
+        for (unsigned i=0; i<num_cells; i++)
+        {
+            SnapshotCodec::AppendSigned(payload, colours[i]);
+        }
+        for (unsigned d=0; d<mDimension; d++)
+        {
+            for (unsigned i=0; i<num_cells; i++)
+            {
+                SnapshotCodec::AppendSigned(payload, locations[i*mDimension + d]);
+            }
+        }
+        AppendElements(payload, elements);
+    }
+    else
+    {
+        // Match cells with the previous frame
+        std::vector<unsigned> removed, added, persisting_old, persisting_new;
+        unsigned i_old = 0u, i_new = 0u;
+        while (i_old < mPreviousIds.size() || i_new < num_cells)
+        {
+            if (i_new == num_cells || (i_old < mPreviousIds.size() && mPreviousIds[i_old] < ids[i_new]))
+            {
+                removed.push_back(mPreviousIds[i_old++]);
+            }
+            else if (i_old == mPreviousIds.size() || ids[i_new] < mPreviousIds[i_old])
+            {
+                added.push_back(i_new++);
+            }
+            else
+            {
+                persisting_old.push_back(i_old++);
+                persisting_new.push_back(i_new++);
+            }
+        }
+
+        // Cells which have gone
+        SnapshotCodec::AppendUnsigned(payload, removed.size());
+        unsigned last_id = 0u;
+        for (unsigned i=0; i<removed.size(); i++)
+        {
+            SnapshotCodec::AppendUnsigned(payload, removed[i] - last_id);
+            last_id = removed[i];
+        }
+
+        // New cells, in full
+        SnapshotCodec::AppendUnsigned(payload, added.size());
+        last_id = 0u;
+        for (unsigned i=0; i<added.size(); i++)
+        {
+            SnapshotCodec::AppendUnsigned(payload, ids[added[i]] - last_id);
+            last_id = ids[added[i]];
+            SnapshotCodec::AppendSigned(payload, colours[added[i]]);
+            for (unsigned d=0; d<mDimension; d++)
+            {
+                SnapshotCodec::AppendSigned(payload, locations[added[i]*mDimension + d]);
+            }
+        }
+
+        // Movement of the remaining cells
+        for (unsigned d=0; d<mDimension; d++)
+        {
+            for (unsigned i=0; i<persisting_new.size(); i++)
+            {
+                SnapshotCodec::AppendSigned(payload, locations[persisting_new[i]*mDimension + d]
+                                                     - mPreviousLocations[persisting_old[i]*mDimension + d]);
+            }
+        }
+
+        // Changes of colour of the remaining cells
+        std::vector<unsigned> recoloured;
+        for (unsigned i=0; i<persisting_new.size(); i++)
+        {
+            if (colours[persisting_new[i]] != mPreviousColours[persisting_old[i]])
+            {
+                recoloured.push_back(i);
+            }
+        }
+        SnapshotCodec::AppendUnsigned(payload, recoloured.size());
+        unsigned last_index = 0u;
+        for (unsigned i=0; i<recoloured.size(); i++)
+        {
+            SnapshotCodec::AppendUnsigned(payload, recoloured[i] - last_index);
+            last_index = recoloured[i];
+            SnapshotCodec::AppendSigned(payload, colours[persisting_new[recoloured[i]]]);
+        }
+
+        // The mesh is only stored if its connectivity has changed
+        if (element_ids == mPreviousElementIds)
+        {
+            SnapshotCodec::AppendUnsigned(payload, 0u);
+        }
+        else
+        {
+            SnapshotCodec::AppendUnsigned(payload, 1u);
+            AppendElements(payload, elements);
+        }
+    }
+
+    std::string compressed = SnapshotCodec::Compress(payload);
+    std::string block(1u, is_key ? 'K' : 'D');
+    SnapshotCodec::AppendDouble(block, rFrame.mTime);
+    SnapshotCodec::AppendUnsigned(block, payload.size());
+    SnapshotCodec::AppendUnsigned(block, compressed.size());
+    block += compressed;
+    mFrameTimes.push_back(rFrame.mTime);
+    mFrameOffsets.push_back(mNumBytes);
+    mFrameIsKey.push_back(is_key);
+    WriteBytes(block);
+
+    mPreviousIds.swap(ids);
+    mPreviousColours.swap(colours);
+    mPreviousLocations.swap(locations);
+    mPreviousElementIds.swap(element_ids);
+}
+
+void SnapshotWriter::Close()
+{
+    if (mpFile == NULL)
+    {
+        return;
+    }
+    uint64_t index_offset = mNumBytes;
+    std::string index(1u, 'I');
+    SnapshotCodec::AppendUnsigned(index, mFrameTimes.size());
+    for (unsigned i=0; i<mFrameTimes.size(); i++)
+    {
+        SnapshotCodec::AppendDouble(index, mFrameTimes[i]);
+        SnapshotCodec::AppendUnsigned(index, mFrameOffsets[i]);
+        index.push_back(mFrameIsKey[i] ? 'K' : 'D');
+    }
+    // The trailer has a fixed size, so the reader can find it from the end of the file
+    SnapshotCodec::AppendFixed(index, index_offset);
+    index += "CRSNAPIX";
+    WriteBytes(index);
+
+    FILE* p_file = mpFile;
+    mpFile = NULL;
+    if (fclose(p_file) != 0)
+    {
+        EXCEPTION("Unable to close snapshot file " << mPath << ": " << strerror(errno));
+    }
+}
+
+unsigned SnapshotWriter::GetNumFrames() const
+{
+    return mFrameTimes.size();
+}
+
+uint64_t SnapshotWriter::GetNumBytes() const
+{
+    return mNumBytes;
+}
+
+void SnapshotWriter::WriteBytes(const std::string& rData)
+{
+    if (fwrite(rData.data(), 1u, rData.size(), mpFile) != rData.size())
+    {
+        int error = errno;
+        fclose(mpFile);
+        mpFile = NULL;
+        EXCEPTION("Unable to write to snapshot file " << mPath << ": " << strerror(error));
+    }
+    mNumBytes += rData.size();
+}
+
+void SnapshotWriter::AppendElements(std::string& rPayload, const std::vector<unsigned>& rElements) const
+{
+    SnapshotCodec::AppendUnsigned(rPayload, rElements.size()/(mDimension + 1u));
+    for (unsigned i=0; i<rElements.size(); i++)
+    {
+        SnapshotCodec::AppendUnsigned(rPayload, rElements[i]);
+    }
+}
@@ -0,0 +1,164 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef SNAPSHOTWRITER_HPP_
+#define SNAPSHOTWRITER_HPP_
+
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <boost/utility.hpp>
+
+#include "SnapshotFrame.hpp"
+
+/**
+ * Writes a stream of population snapshots to a compact file, for visualising long simulations whose text
+ * output would run to gigabytes.  Read files back with SnapshotReader.
+ *
+ * Cell locations are quantised to a fixed grid.  Every keyframeInterval frames a keyframe stores the whole
+ * population; other frames store only the changes from the frame before: the ids of cells that have gone
+ * (e.g. by sloughing), the cells that have appeared (e.g. by division), the quantised movement of the
+ * remaining cells, any changes of colour, and the mesh elements if they have changed.  Each frame is then
+ * compressed separately with a fast codec.  Since consecutive frames differ only slightly, most of the
+ * movements are a byte or less before compression.
+ *
+ * The file layout is:
+ *  - a header: the magic string "CRSNAP01", the spatial dimension, the quantum, the keyframe interval, and
+ *    free-form setup text for the visualiser;
+ *  - one block per frame: a kind byte ('K' for a keyframe, 'D' for a delta frame), the time, the raw and
+ *    compressed sizes of the payload, and the compressed payload;
+ *  - an index, written by Close: 'I', the number of frames, then the time, file offset and kind of each;
+ *  - a trailer: the offset of the index, and the magic string "CRSNAPIX".
+ *
+ * If a simulation dies before Close is called, the frames written so far can still be read: the reader
+ * rebuilds the index by scanning the blocks.
+ */
+class SnapshotWriter : private boost::noncopyable
+{
+public:
+    /**
+     * Open a snapshot file for writing, and write its header.
+     *
+     * @param rPath  the absolute path to the file
+     * @param dimension  the spatial dimension of cell locations
+     * @param quantum  the grid spacing to which locations are rounded
+     * @param keyframeInterval  the number of frames between keyframes (1 to make every frame a keyframe)
+     * @param rSetupText  text to write to results.vizsetup on export
+     */
+    SnapshotWriter(const std::string& rPath, unsigned dimension, double quantum=1e-4,
+                   unsigned keyframeInterval=50u, const std::string& rSetupText="");
+
+    /**
+     * Destructor.  Closes the file if Close hasn't been called, ignoring any errors.
+     */
+    ~SnapshotWriter();
+
+    /**
+     * Write a frame.  Frames must be written in time order, and each cell id may appear only once.
+     *
+     * @param rFrame  the frame
+     */
+    void WriteFrame(const SnapshotFrame& rFrame);
+
+    /**
+     * Write the index and close the file.
+     */
+    void Close();
+
+    /** @return  the number of frames written. */
+    unsigned GetNumFrames() const;
+
+    /** @return  the number of bytes written to the file so far. */
+    uint64_t GetNumBytes() const;
+
+private:
+    /**
+     * Write bytes to the file, throwing on error.
+     *
+     * @param rData  the bytes to write
+     */
+    void WriteBytes(const std::string& rData);
+
+    /**
+     * Append the elements of a frame to a payload.
+     *
+     * @param rPayload  the payload
+     * @param rElements  the elements, as indices into the sorted cells
+     */
+    void AppendElements(std::string& rPayload, const std::vector<unsigned>& rElements) const;
+
+    /** The file being written, or NULL once closed. */
+    FILE* mpFile;
+
+    /** The path of the file, for error messages. */
+    std::string mPath;
+
+    /** The spatial dimension. */
+    unsigned mDimension;
+
+    /** The grid spacing of stored locations. */
+    double mQuantum;
+
+    /** The number of frames between keyframes. */
+    unsigned mKeyframeInterval;
+
+    /** The number of bytes written so far, i.e. the offset of the next block. */
+    uint64_t mNumBytes;
+
+    /** The time of each frame written. */
+    std::vector<double> mFrameTimes;
+
+    /** The file offset of each frame written. */
+    std::vector<uint64_t> mFrameOffsets;
+
+    /** Whether each frame written is a keyframe. */
+    std::vector<bool> mFrameIsKey;
+
+    /** The cell ids of the last frame written, in ascending order. */
+    std::vector<unsigned> mPreviousIds;
+
+    /** The colours of the cells of the last frame written. */
+    std::vector<int> mPreviousColours;
+
+    /** The quantised locations of the cells of the last frame written. */
+    std::vector<int64_t> mPreviousLocations;
+
+    /** The elements of the last frame written, as the ids of their vertex cells. */
+    std::vector<unsigned> mPreviousElementIds;
+};
+
+#endif // SNAPSHOTWRITER_HPP_
@@ -0,0 +1,206 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "SnapshotWritingModifier.hpp"
+
+#include <map>
+#include <sstream>
+
+#include "Cell.hpp"
+#include "CellLabel.hpp"
+#include "WildTypeCellMutationState.hpp"
+#include "MeshBasedCellPopulation.hpp"
+#include "Cylindrical2dMesh.hpp"
+#include "Exception.hpp"
+#include "FileFinder.hpp"
+#include "SimulationTime.hpp"
+
+/** The colour the visualiser gives apoptotic cells (that of ApoptoticCellProperty). */
+static const int APOPTOTIC_COLOUR = 6;
+
+template<unsigned DIM>
+SnapshotWritingModifier<DIM>::SnapshotWritingModifier(unsigned samplingTimestepMultiple, double quantum,
+                                                      unsigned keyframeInterval)
+    : AbstractCellBasedSimulationModifier<DIM,DIM>(),
+      mSamplingTimestepMultiple(samplingTimestepMultiple),
+      mQuantum(quantum),
+      mKeyframeInterval(keyframeInterval),
+      mNumSteps(0u)
+{
+    if (samplingTimestepMultiple == 0u)
+    {
+        EXCEPTION("Snapshots must be written at least every so many timesteps, not every 0.");
+    }
+}
+
+template<unsigned DIM>
+SnapshotWritingModifier<DIM>::~SnapshotWritingModifier()
+{
+}
+
+template<unsigned DIM>
+unsigned SnapshotWritingModifier<DIM>::GetSamplingTimestepMultiple() const
+{
+    return mSamplingTimestepMultiple;
+}
+
+template<unsigned DIM>
+void SnapshotWritingModifier<DIM>::SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory)
+{
+    // Give the visualiser the same set-up information as the text output does
+    std::ostringstream setup;
+    MeshBasedCellPopulation<DIM,DIM>* p_mesh_population = dynamic_cast<MeshBasedCellPopulation<DIM,DIM>*>(&rCellPopulation);
+    if (p_mesh_population && dynamic_cast<Cylindrical2dMesh*>(&(p_mesh_population->rGetMesh())))
+    {
+        setup << "MeshWidth\t" << rCellPopulation.GetWidth(0) << "\n";
+    }
+
+    FileFinder snapshot_file(outputDirectory + "/results.snapshots", RelativeTo::ChasteTestOutput);
+    mpWriter.reset(new SnapshotWriter(snapshot_file.GetAbsolutePath(), DIM, mQuantum, mKeyframeInterval, setup.str()));
+    mNumSteps = 0u;
+    WriteFrame(rCellPopulation);
+}
+
+template<unsigned DIM>
+void SnapshotWritingModifier<DIM>::UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    mNumSteps++;
+    if (mNumSteps % mSamplingTimestepMultiple == 0u)
+    {
+        WriteFrame(rCellPopulation);
+    }
+}
+
+template<unsigned DIM>
+void SnapshotWritingModifier<DIM>::UpdateAtEndOfSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    if (mNumSteps % mSamplingTimestepMultiple != 0u)
+    {
+        WriteFrame(rCellPopulation);
+    }
+    mpWriter->Close();
+    mpWriter.reset();
+}
+
+template<unsigned DIM>
+void SnapshotWritingModifier<DIM>::WriteFrame(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    SnapshotFrame frame;
+    frame.mTime = SimulationTime::Instance()->GetTime();
+    std::map<unsigned, unsigned> cell_index_of_location;
+    for (typename AbstractCellPopulation<DIM,DIM>::Iterator cell_iter = rCellPopulation.Begin();
+         cell_iter != rCellPopulation.End();
+         ++cell_iter)
+    {
+        cell_index_of_location[rCellPopulation.GetLocationIndexUsingCell(*cell_iter)] = frame.mCellIds.size();
+        frame.mCellIds.push_back(cell_iter->GetCellId());
+
+        // Colour cells as the visualiser would
+        int colour = cell_iter->GetCellProliferativeType()->GetColour();
+        if (!cell_iter->GetMutationState()->template IsType<WildTypeCellMutationState>())
+        {
+            colour = cell_iter->GetMutationState()->GetColour();
+        }
+        if (cell_iter->template HasCellProperty<CellLabel>())
+        {
+            CellPropertyCollection collection = cell_iter->rGetCellPropertyCollection().template GetProperties<CellLabel>();
+            colour = boost::static_pointer_cast<CellLabel>(collection.GetProperty())->GetColour();
+        }
+        if (cell_iter->HasApoptosisBegun())
+        {
+            colour = APOPTOTIC_COLOUR;
+        }
+        frame.mColours.push_back(colour);
+
+        c_vector<double, DIM> location = rCellPopulation.GetLocationOfCellCentre(*cell_iter);
+        for (unsigned d=0; d<DIM; d++)
+        {
+            frame.mLocations.push_back(location[d]);
+        }
+    }
+
+    // Mesh elements between real cells
+    MeshBasedCellPopulation<DIM,DIM>* p_mesh_population = dynamic_cast<MeshBasedCellPopulation<DIM,DIM>*>(&rCellPopulation);
+    if (p_mesh_population)
+    {
+        MutableMesh<DIM,DIM>& r_mesh = p_mesh_population->rGetMesh();
+        for (typename MutableMesh<DIM,DIM>::ElementIterator elem_iter = r_mesh.GetElementIteratorBegin();
+             elem_iter != r_mesh.GetElementIteratorEnd();
+             ++elem_iter)
+        {
+            std::vector<unsigned> vertices;
+            for (unsigned i=0; i<elem_iter->GetNumNodes(); i++)
+            {
+                std::map<unsigned, unsigned>::const_iterator it = cell_index_of_location.find(elem_iter->GetNodeGlobalIndex(i));
+                if (it == cell_index_of_location.end())
+                {
+                    // A ghost node
+                    break;
+                }
+                vertices.push_back(it->second);
+            }
+            if (vertices.size() == DIM + 1u)
+            {
+                frame.mElements.insert(frame.mElements.end(), vertices.begin(), vertices.end());
+            }
+        }
+    }
+
+    mpWriter->WriteFrame(frame);
+}
+
+template<unsigned DIM>
+void SnapshotWritingModifier<DIM>::OutputSimulationModifierParameters(out_stream& rParamsFile)
+{
+    *rParamsFile << "\t\t\t<SamplingTimestepMultiple>" << mSamplingTimestepMultiple << "</SamplingTimestepMultiple>\n";
+    *rParamsFile << "\t\t\t<Quantum>" << mQuantum << "</Quantum>\n";
+    *rParamsFile << "\t\t\t<KeyframeInterval>" << mKeyframeInterval << "</KeyframeInterval>\n";
+
+    // Call method on direct parent class
+    AbstractCellBasedSimulationModifier<DIM,DIM>::OutputSimulationModifierParameters(rParamsFile);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class SnapshotWritingModifier<1>;
+template class SnapshotWritingModifier<2>;
+template class SnapshotWritingModifier<3>;
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(SnapshotWritingModifier)
@@ -0,0 +1,153 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef SNAPSHOTWRITINGMODIFIER_HPP_
+#define SNAPSHOTWRITINGMODIFIER_HPP_
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "AbstractCellBasedSimulationModifier.hpp"
+#include "SnapshotFrame.hpp"
+#include "SnapshotWriter.hpp"
+
+/**
+ * A modifier class which records the cell population to a compressed snapshot file, results.snapshots in the
+ * simulation output directory, as a compact alternative to the text visualiser output for long simulations.
+ * See SnapshotWriter for the format, and SnapshotReader for how to read it back or convert it to the files
+ * Visualize2dCentreCells reads.
+ *
+ * Frames are written at the start of the simulation, every few timesteps, and at the end.  Each frame holds
+ * the id, colour (as the visualiser would draw it) and location of every real cell, and for mesh-based
+ * populations the mesh elements which don't involve ghost nodes.
+ */
+template<unsigned DIM>
+class SnapshotWritingModifier : public AbstractCellBasedSimulationModifier<DIM,DIM>
+{
+private:
+    /** The number of timesteps between frames. */
+    unsigned mSamplingTimestepMultiple;
+
+    /** The grid spacing to which locations are rounded. */
+    double mQuantum;
+
+    /** The number of frames between keyframes. */
+    unsigned mKeyframeInterval;
+
+    /** Timesteps taken since SetupSolve. */
+    unsigned mNumSteps;
+
+    /** The writer, while a simulation is running. */
+    boost::shared_ptr<SnapshotWriter> mpWriter;
+
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<AbstractCellBasedSimulationModifier<DIM,DIM> >(*this);
+        archive & mSamplingTimestepMultiple;
+        archive & mQuantum;
+        archive & mKeyframeInterval;
+    }
+
+    /**
+     * Write the current state of the population as a frame.
+     *
+     * @param rCellPopulation  the cell population
+     */
+    void WriteFrame(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param samplingTimestepMultiple  the number of timesteps between frames
+     * @param quantum  the grid spacing to which locations are rounded
+     * @param keyframeInterval  the number of frames between keyframes
+     */
+    SnapshotWritingModifier(unsigned samplingTimestepMultiple=1u, double quantum=1e-4, unsigned keyframeInterval=50u);
+
+    /**
+     * Destructor.
+     */
+    virtual ~SnapshotWritingModifier();
+
+    /** @return  the number of timesteps between frames. */
+    unsigned GetSamplingTimestepMultiple() const;
+
+    /**
+     * Overridden UpdateAtEndOfTimeStep() method.  Writes a frame if it's time to.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Overridden SetupSolve() method.  Opens the snapshot file and writes the initial frame.
+     *
+     * @param rCellPopulation reference to the cell population
+     * @param outputDirectory the output directory, relative to where Chaste output is stored
+     */
+    virtual void SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory);
+
+    /**
+     * Overridden UpdateAtEndOfSolve() method.  Writes the final frame, unless it was just written, and
+     * closes the file.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Overridden OutputSimulationModifierParameters() method.
+     *
+     * @param rParamsFile the file stream to which the parameters are output
+     */
+    void OutputSimulationModifierParameters(out_stream& rParamsFile);
+};
+
+#include "SerializationExportWrapper.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(SnapshotWritingModifier)
+
+#endif /*SNAPSHOTWRITINGMODIFIER_HPP_*/
@@ -0,0 +1,142 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "CryptSlabDecomposition.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "PetscTools.hpp"
+#include "Exception.hpp"
+#include "ProcessIsolation.hpp"
+
+#ifdef CRYPT_SINGLE_PRECISION_NODE_STATE
+/** The MPI type matching NodeStateValue. */
+#define NODE_STATE_MPI_TYPE MPI_FLOAT
+#else
+/** The MPI type matching NodeStateValue. */
+#define NODE_STATE_MPI_TYPE MPI_DOUBLE
+#endif
+
+CryptSlabDecomposition::CryptSlabDecomposition(double cryptLength)
+    : mCryptLength(cryptLength)
+{
+    if (cryptLength <= 0.0)
+    {
+        EXCEPTION("The crypt length must be positive to divide it into slabs.");
+    }
+    if (ProcessIsolation::DoProcessesRunSeparateJobs())
+    {
+        EXCEPTION("A crypt can't be divided into slabs while processes are running separate jobs.");
+    }
+    mNumSlabs = GetNumProcesses();
+    int rank;
+    MPI_Comm_rank(PETSC_COMM_WORLD, &rank);
+    mLocalSlab = rank;
+}
+
+unsigned CryptSlabDecomposition::GetNumProcesses()
+{
+    // Ask MPI directly, since PetscTools reports one process when processes are isolated
+    int num_procs;
+    MPI_Comm_size(PETSC_COMM_WORLD, &num_procs);
+    return num_procs;
+}
+
+unsigned CryptSlabDecomposition::GetNumSlabs() const
+{
+    return mNumSlabs;
+}
+
+unsigned CryptSlabDecomposition::GetLocalSlab() const
+{
+    return mLocalSlab;
+}
+
+double CryptSlabDecomposition::GetSlabBottom(unsigned slab) const
+{
+    return slab*mCryptLength/mNumSlabs;
+}
+
+double CryptSlabDecomposition::GetSlabTop(unsigned slab) const
+{
+    return (slab+1)*mCryptLength/mNumSlabs;
+}
+
+unsigned CryptSlabDecomposition::GetSlab(double height) const
+{
+    if (height <= 0.0)
+    {
+        return 0u;
+    }
+    unsigned slab = (unsigned)floor(height*mNumSlabs/mCryptLength);
+    return std::min(slab, mNumSlabs-1);
+}
+
+bool CryptSlabDecomposition::IsLocal(double height) const
+{
+    return GetSlab(height) == mLocalSlab;
+}
+
+void CryptSlabDecomposition::SumForces(NodeStateValue* pForces, unsigned numNodes)
+{
+    if (mNumSlabs == 1u)
+    {
+        return;
+    }
+
+    // Every process must take part in the sum for the same nodes, or the processes' populations differ
+    int node_counts[2] = {(int)numNodes, -(int)numNodes};
+    int count_range[2];
+    MPI_Allreduce(node_counts, count_range, 2, MPI_INT, MPI_MIN, PETSC_COMM_WORLD);
+    if (count_range[0] != -count_range[1])
+    {
+        EXCEPTION("Processes sharing a crypt have between " << count_range[0] << " and " << -count_range[1]
+                  << " nodes, so are not running the same simulation.");
+    }
+    if (numNodes == 0u)
+    {
+        return;
+    }
+    // Reduce then broadcast, rather than all-reduce, so every process is guaranteed the same rounding
+    mSumBuffer.resize(numNodes);
+    MPI_Reduce(pForces, &mSumBuffer[0], numNodes, NODE_STATE_MPI_TYPE, MPI_SUM, 0, PETSC_COMM_WORLD);
+    if (mLocalSlab == 0u)
+    {
+        std::copy(mSumBuffer.begin(), mSumBuffer.end(), pForces);
+    }
+    MPI_Bcast(pForces, numNodes, NODE_STATE_MPI_TYPE, 0, PETSC_COMM_WORLD);
+}
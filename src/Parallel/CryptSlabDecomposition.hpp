@@ -0,0 +1,131 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef CRYPTSLABDECOMPOSITION_HPP_
+#define CRYPTSLABDECOMPOSITION_HPP_
+
+#include "NodeStateArrays.hpp"
+
+/**
+ * Splits the work of computing spring forces in a single crypt across MPI processes, by dividing the crypt
+ * into equal-height axial slabs and giving one slab to each process.
+ *
+ * Every process holds the whole cell population, and runs the same simulation with the same random number
+ * seed.  Each process computes only the springs whose first node lies in its own slab, and SumForces then adds
+ * up the contributions from all processes, so that every process moves its nodes by exactly the same forces.
+ * Populations therefore stay identical on all processes without any halo exchange, and a cell moving from one
+ * slab into another is simply computed by the new slab's process from the next timestep.  Everything other than
+ * the spring forces (remeshing, cell cycles, births and deaths, output) is repeated on every process.
+ *
+ * The forces are summed in a different order to the sequential code, so results agree with a run on one process
+ * only statistically.  They do not depend on anything other than the number of processes.
+ *
+ * The communication uses PETSC_COMM_WORLD directly, and so works with processes isolated, as they must be for
+ * each process to write its own output.  It does assume that every process is running the same simulation, so
+ * crypts can't be divided while processes run separate jobs, as under DynamicJobQueue or CryptJobServer.
+ */
+class CryptSlabDecomposition
+{
+private:
+    /** The number of slabs, i.e. of processes. */
+    unsigned mNumSlabs;
+
+    /** This process's slab. */
+    unsigned mLocalSlab;
+
+    /** The height of the crypt, which is divided into slabs. */
+    double mCryptLength;
+
+    /** Space for the total forces, kept to reuse its storage. */
+    std::vector<NodeStateValue> mSumBuffer;
+
+public:
+    /**
+     * Constructor.  Heights below zero are in the bottom slab, and those above cryptLength in the top slab.
+     * Throws if processes are running separate jobs (see ProcessIsolation).
+     *
+     * @param cryptLength  the height of the crypt
+     */
+    CryptSlabDecomposition(double cryptLength);
+
+    /**
+     * @return  the number of processes, and hence of slabs a crypt would be divided into.  This is the
+     *     number actually running, even if processes are isolated.
+     */
+    static unsigned GetNumProcesses();
+
+    /** @return  the number of slabs, one per process. */
+    unsigned GetNumSlabs() const;
+
+    /** @return  the slab owned by this process. */
+    unsigned GetLocalSlab() const;
+
+    /**
+     * @param slab  a slab
+     * @return  the height of the bottom of the slab
+     */
+    double GetSlabBottom(unsigned slab) const;
+
+    /**
+     * @param slab  a slab
+     * @return  the height of the top of the slab
+     */
+    double GetSlabTop(unsigned slab) const;
+
+    /**
+     * @param height  a height up the crypt
+     * @return  the slab containing that height
+     */
+    unsigned GetSlab(double height) const;
+
+    /**
+     * @param height  a height up the crypt
+     * @return  whether that height is in this process's slab
+     */
+    bool IsLocal(double height) const;
+
+    /**
+     * Replace a force component on every node by its total over all processes.  This is a collective operation
+     * on PETSC_COMM_WORLD, and gives identical results on every process.  Throws on every process if they don't
+     * all have the same number of nodes, since they can't then be running the same simulation.
+     *
+     * @param pForces  the force component, as given by NodeStateArrays::GetForces
+     * @param numNodes  the number of entries
+     */
+    void SumForces(NodeStateValue* pForces, unsigned numNodes);
+};
+
+#endif // CRYPTSLABDECOMPOSITION_HPP_
@@ -0,0 +1,97 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef PROCESSISOLATION_HPP_
+#define PROCESSISOLATION_HPP_
+
+/**
+ * Records how the MPI processes are being shared out, so that code which needs every process to run the same
+ * simulation (such as CryptSlabDecomposition) can refuse to run while they are each running their own jobs (as
+ * under DynamicJobQueue or CryptJobServer), without either knowing about the other.
+ *
+ * The state is only changed through the guards below, which restore the previous setting when they go out of
+ * scope, whether normally or because an exception is thrown.
+ */
+class ProcessIsolation
+{
+private:
+    /** Whether processes are currently running separate jobs. */
+    static bool mProcessesRunSeparateJobs;
+
+public:
+    /** @return  whether processes are currently running separate jobs. */
+    static bool DoProcessesRunSeparateJobs();
+
+    /**
+     * Marks processes as running separate jobs for as long as it exists.
+     */
+    class SeparateJobsGuard
+    {
+    private:
+        /** Whether processes were already running separate jobs. */
+        bool mWereSeparate;
+
+    public:
+        /** Constructor.  Marks processes as running separate jobs. */
+        SeparateJobsGuard();
+
+        /** Destructor.  Restores the previous setting. */
+        ~SeparateJobsGuard();
+    };
+
+    /**
+     * Sets PetscTools::IsolateProcesses for as long as it exists.
+     */
+    class IsolationGuard
+    {
+    private:
+        /** Whether processes were already isolated. */
+        bool mWereIsolated;
+
+    public:
+        /**
+         * Constructor.
+         *
+         * @param isolate  whether to isolate processes
+         */
+        IsolationGuard(bool isolate=true);
+
+        /** Destructor.  Restores the previous setting. */
+        ~IsolationGuard();
+    };
+};
+
+#endif /*PROCESSISOLATION_HPP_*/
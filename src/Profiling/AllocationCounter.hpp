@@ -0,0 +1,96 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef ALLOCATIONCOUNTER_HPP_
+#define ALLOCATIONCOUNTER_HPP_
+
+#include <cstddef>
+
+/**
+ * Counts heap allocations made through operator new, so that tests can catch regressions in the number
+ * of allocations made per timestep of a simulation.
+ *
+ * Counting requires replacing the global operator new and delete, which is only done if this project is
+ * compiled with CRYPT_COUNT_ALLOCATIONS defined, e.g.
+ * {{{
+ * scons chaste_libs=1 build=GccOpt CPPDEFINES=CRYPT_COUNT_ALLOCATIONS projects/Wisc2013
+ * }}}
+ * Otherwise IsAvailable() returns false and the counts stay at zero.  Even when compiled in, allocations
+ * are only counted between calls to StartCounting() and StopCounting(), and counting is not thread safe,
+ * so should only be enabled while a single thread is allocating.
+ */
+class AllocationCounter
+{
+public:
+    /** @return  whether allocation counting has been compiled in. */
+    static bool IsAvailable();
+
+    /** Zero the counts. */
+    static void Reset();
+
+    /** Start (or resume) counting allocations. */
+    static void StartCounting();
+
+    /** Stop counting allocations. */
+    static void StopCounting();
+
+    /** @return  whether allocations are currently being counted. */
+    static bool IsCounting();
+
+    /** @return  the number of allocations made while counting. */
+    static unsigned long GetNumAllocations();
+
+    /** @return  the total bytes requested by allocations made while counting. */
+    static unsigned long GetNumBytesAllocated();
+
+    /**
+     * Record an allocation.  Called by the replacement operator new.
+     *
+     * @param size  the number of bytes requested
+     */
+    static void RecordAllocation(std::size_t size);
+
+private:
+    /** Whether we are counting. */
+    static bool mCounting;
+
+    /** Number of allocations counted. */
+    static unsigned long mNumAllocations;
+
+    /** Bytes requested by allocations counted. */
+    static unsigned long mNumBytes;
+};
+
+#endif // ALLOCATIONCOUNTER_HPP_
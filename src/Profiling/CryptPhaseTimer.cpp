@@ -0,0 +1,231 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "CryptPhaseTimer.hpp"
+
+#include <cassert>
+#include <iomanip>
+
+#include "PetscTools.hpp"
+#include "Exception.hpp"
+
+CryptPhaseTimer::CryptPhaseTimer()
+{
+    Reset();
+}
+
+void CryptPhaseTimer::Reset()
+{
+    mStartTimes.assign(NUM_PHASES, -1.0);
+    mElapsedTimes.assign(NUM_PHASES, 0.0);
+    mNumCalls.assign(NUM_PHASES, 0u);
+    mCounterStarts.assign(NUM_PHASES, std::vector<double>(PerfCounterGroup::NUM_COUNTERS, 0.0));
+    mCounterTotals.assign(NUM_PHASES, std::vector<double>(PerfCounterGroup::NUM_COUNTERS, 0.0));
+}
+
+void CryptPhaseTimer::BeginPhase(Phase phase)
+{
+    assert(phase < NUM_PHASES);
+    assert(!IsPhaseInProgress(phase));
+    mStartTimes[phase] = MPI_Wtime();
+    if (mpCounters)
+    {
+        mpCounters->Read(mCounterStarts[phase]);
+    }
+}
+
+void CryptPhaseTimer::EndPhase(Phase phase)
+{
+    assert(phase < NUM_PHASES);
+    if (IsPhaseInProgress(phase))
+    {
+        mElapsedTimes[phase] += MPI_Wtime() - mStartTimes[phase];
+        if (mpCounters)
+        {
+            mpCounters->Read(mCounterValues);
+            for (unsigned counter=0; counter<PerfCounterGroup::NUM_COUNTERS; counter++)
+            {
+                mCounterTotals[phase][counter] += mCounterValues[counter] - mCounterStarts[phase][counter];
+            }
+        }
+        mNumCalls[phase]++;
+        mStartTimes[phase] = -1.0;
+    }
+}
+
+bool CryptPhaseTimer::IsPhaseInProgress(Phase phase) const
+{
+    return mStartTimes[phase] >= 0.0;
+}
+
+double CryptPhaseTimer::GetElapsedTime(Phase phase) const
+{
+    return mElapsedTimes[phase];
+}
+
+unsigned CryptPhaseTimer::GetNumCalls(Phase phase) const
+{
+    return mNumCalls[phase];
+}
+
+std::string CryptPhaseTimer::GetPhaseName(Phase phase)
+{
+    std::string name;
+    switch (phase)
+    {
+    case SLOUGHING:
+        name = "sloughing";
+        break;
+    case CELL_CYCLE:
+        name = "cell_cycle";
+        break;
+    case REMESH:
+        name = "remesh";
+        break;
+    case SPRING_FORCE:
+        name = "spring_force";
+        break;
+    case RETAINER_FORCE:
+        name = "retainer_force";
+        break;
+    case POSITION_UPDATE:
+        name = "position_update";
+        break;
+    case VOLUME_TRACKING:
+        name = "volume_tracking";
+        break;
+    case OUTPUT:
+        name = "output";
+        break;
+    case TIMESTEP:
+        name = "timestep";
+        break;
+    default:
+        NEVER_REACHED;
+    }
+    return name;
+}
+
+std::vector<double> CryptPhaseTimer::GetTimings() const
+{
+    std::vector<double> timings;
+    for (unsigned phase=0; phase<NUM_PHASES; phase++)
+    {
+        timings.push_back(mElapsedTimes[phase]);
+        timings.push_back(mNumCalls[phase]);
+    }
+    return timings;
+}
+
+void CryptPhaseTimer::SetPerfCounters(boost::shared_ptr<PerfCounterGroup> pCounters)
+{
+    if (pCounters && pCounters->IsAvailable())
+    {
+        mpCounters = pCounters;
+    }
+    else
+    {
+        mpCounters.reset();
+    }
+    mUnavailableReason = pCounters ? pCounters->rGetUnavailableReason() : "";
+}
+
+bool CryptPhaseTimer::HasPerfCounters() const
+{
+    return mpCounters.get() != NULL;
+}
+
+double CryptPhaseTimer::GetCounterTotal(Phase phase, PerfCounterGroup::Counter counter) const
+{
+    return mCounterTotals[phase][counter];
+}
+
+std::vector<double> CryptPhaseTimer::GetCounterTotals() const
+{
+    std::vector<double> totals;
+    for (unsigned phase=0; phase<NUM_PHASES; phase++)
+    {
+        totals.insert(totals.end(), mCounterTotals[phase].begin(), mCounterTotals[phase].end());
+    }
+    return totals;
+}
+
+void CryptPhaseTimer::WriteCounterSummary(out_stream& rFile) const
+{
+    if (!mpCounters)
+    {
+        *rFile << "# Hardware performance counters unavailable";
+        if (!mUnavailableReason.empty())
+        {
+            *rFile << ": " << mUnavailableReason;
+        }
+        *rFile << std::endl;
+        return;
+    }
+    *rFile << "# phase";
+    for (unsigned counter=0; counter<PerfCounterGroup::NUM_COUNTERS; counter++)
+    {
+        *rFile << "\t" << PerfCounterGroup::GetCounterName((PerfCounterGroup::Counter)counter);
+    }
+    *rFile << "\tinstructions_per_cycle\tcache_misses_per_kilo_instruction\tbranch_misses_per_kilo_instruction" << std::endl;
+    for (unsigned phase=0; phase<NUM_PHASES; phase++)
+    {
+        const std::vector<double>& r_totals = mCounterTotals[phase];
+        *rFile << GetPhaseName((Phase)phase);
+        for (unsigned counter=0; counter<PerfCounterGroup::NUM_COUNTERS; counter++)
+        {
+            *rFile << "\t" << std::setprecision(12) << r_totals[counter];
+        }
+        const double cycles = r_totals[PerfCounterGroup::CYCLES];
+        const double kilo_instructions = r_totals[PerfCounterGroup::INSTRUCTIONS] / 1000.0;
+        *rFile << std::setprecision(4)
+               << "\t" << (cycles > 0.0 ? r_totals[PerfCounterGroup::INSTRUCTIONS]/cycles : 0.0)
+               << "\t" << (kilo_instructions > 0.0 ? r_totals[PerfCounterGroup::CACHE_MISSES]/kilo_instructions : 0.0)
+               << "\t" << (kilo_instructions > 0.0 ? r_totals[PerfCounterGroup::BRANCH_MISSES]/kilo_instructions : 0.0)
+               << std::setprecision(6) << std::endl;
+    }
+}
+
+void CryptPhaseTimer::WriteSummary(out_stream& rFile) const
+{
+    const double total = mElapsedTimes[TIMESTEP];
+    *rFile << "# phase\tseconds\tcalls\tpercent_of_timestep" << std::endl;
+    for (unsigned phase=0; phase<NUM_PHASES; phase++)
+    {
+        *rFile << GetPhaseName((Phase)phase) << "\t" << mElapsedTimes[phase] << "\t" << mNumCalls[phase] << "\t"
+               << std::setprecision(4) << (total > 0.0 ? 100.0*mElapsedTimes[phase]/total : 0.0)
+               << std::setprecision(6) << std::endl;
+    }
+}
@@ -0,0 +1,196 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CRYPTPHASETIMER_HPP_
+#define CRYPTPHASETIMER_HPP_
+
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "OutputFileHandler.hpp"
+#include "PerfCounterGroup.hpp"
+
+/**
+ * Accumulates wall-clock time and call counts for each phase of the crypt simulation timestep loop,
+ * so that it is possible to see where the time goes in a slow run.
+ *
+ * Phases are timed by calling BeginPhase and EndPhase around the relevant code.  Phases may nest (e.g.
+ * the whole timestep encloses everything else) but a phase may not be begun again before it has ended.
+ *
+ * Optionally, hardware performance counters may also be accumulated for each phase; see SetPerfCounters.
+ */
+class CryptPhaseTimer
+{
+public:
+    /** The phases of a timestep that are timed. */
+    enum Phase
+    {
+        SLOUGHING = 0,   ///< Checking for and removing dead cells
+        CELL_CYCLE,      ///< Updating cell-cycle models, and dividing cells that are ready
+        REMESH,          ///< Updating the cell population topology after births and deaths
+        SPRING_FORCE,    ///< Spring forces between neighbouring cells
+        RETAINER_FORCE,  ///< The CellRetainerForce holding stem cells at the crypt base
+        POSITION_UPDATE, ///< Moving nodes, and applying boundary conditions
+        VOLUME_TRACKING, ///< Computing the Voronoi tessellation and recording cell volumes
+        OUTPUT,          ///< Writing results to file
+        TIMESTEP,        ///< The whole timestep, which encloses all the above
+        NUM_PHASES       ///< Not a phase; the number of phases
+    };
+
+    /**
+     * Create a timer with all phases zeroed.
+     */
+    CryptPhaseTimer();
+
+    /**
+     * Zero all the accumulated times and counts.
+     */
+    void Reset();
+
+    /**
+     * Start timing a phase.
+     *
+     * @param phase  the phase
+     */
+    void BeginPhase(Phase phase);
+
+    /**
+     * Stop timing a phase, adding the time since BeginPhase to its total and incrementing its call count.
+     * Does nothing if the phase wasn't begun.
+     *
+     * @param phase  the phase
+     */
+    void EndPhase(Phase phase);
+
+    /**
+     * @param phase  the phase
+     * @return  whether the phase has been begun but not yet ended
+     */
+    bool IsPhaseInProgress(Phase phase) const;
+
+    /**
+     * @param phase  the phase
+     * @return  the total wall-clock time spent in the phase, in seconds
+     */
+    double GetElapsedTime(Phase phase) const;
+
+    /**
+     * @param phase  the phase
+     * @return  how many times the phase has been timed
+     */
+    unsigned GetNumCalls(Phase phase) const;
+
+    /**
+     * @param phase  the phase
+     * @return  a short name for the phase, suitable for use in output files
+     */
+    static std::string GetPhaseName(Phase phase);
+
+    /**
+     * Get all the timings as a flat array, suitable for wrapping as a model output.
+     *
+     * @return  for each phase in order, its elapsed time then its call count
+     */
+    std::vector<double> GetTimings() const;
+
+    /**
+     * Also accumulate hardware performance counter values for each phase.  Counting has some overhead,
+     * since the counters are read at the start and end of every phase.  If the group is not available
+     * then it is ignored, and all counter totals remain zero.
+     *
+     * @param pCounters  the counters to read
+     */
+    void SetPerfCounters(boost::shared_ptr<PerfCounterGroup> pCounters);
+
+    /** @return  whether hardware counters are being accumulated. */
+    bool HasPerfCounters() const;
+
+    /**
+     * @param phase  the phase
+     * @param counter  the counter
+     * @return  the total counter value accumulated over all calls of the phase
+     */
+    double GetCounterTotal(Phase phase, PerfCounterGroup::Counter counter) const;
+
+    /**
+     * Get all the counter totals as a flat array, suitable for wrapping as a model output.
+     *
+     * @return  for each phase in order, its total for each PerfCounterGroup::Counter in order
+     */
+    std::vector<double> GetCounterTotals() const;
+
+    /**
+     * Write a human-readable summary table of the hardware counter totals, with derived instructions per
+     * cycle and misses per thousand instructions.  If counters were not available, just says why.
+     *
+     * @param rFile  the stream to write to
+     */
+    void WriteCounterSummary(out_stream& rFile) const;
+
+    /**
+     * Write a human-readable summary table of the timings.
+     *
+     * @param rFile  the stream to write to
+     */
+    void WriteSummary(out_stream& rFile) const;
+
+private:
+    /** When each phase in progress was begun, or a negative number if it isn't in progress. */
+    std::vector<double> mStartTimes;
+
+    /** Total time for each phase. */
+    std::vector<double> mElapsedTimes;
+
+    /** Call count for each phase. */
+    std::vector<unsigned> mNumCalls;
+
+    /** Optional hardware counters. */
+    boost::shared_ptr<PerfCounterGroup> mpCounters;
+
+    /** Counter values when each phase in progress was begun, indexed by phase then counter. */
+    std::vector<std::vector<double> > mCounterStarts;
+
+    /** Total counter values for each phase, indexed by phase then counter. */
+    std::vector<std::vector<double> > mCounterTotals;
+
+    /** Scratch space for reading counters. */
+    std::vector<double> mCounterValues;
+
+    /** Why the counters given to SetPerfCounters are unavailable, if they are. */
+    std::string mUnavailableReason;
+};
+
+#endif // CRYPTPHASETIMER_HPP_
@@ -0,0 +1,171 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "PerfCounterGroup.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "Exception.hpp"
+
+#ifdef __linux__
+/**
+ * Open a single counter for the calling thread.  There's no glibc wrapper for this system call.
+ *
+ * @param config  which hardware event to count
+ * @param groupFd  the group leader's file descriptor, or -1 to create a new group
+ * @return  the new file descriptor, or -1 on failure (with errno set)
+ */
+static int OpenCounter(unsigned long long config, int groupFd)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = config;
+    attr.disabled = (groupFd == -1 ? 1 : 0); // The leader starts the whole group
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP;
+    return syscall(__NR_perf_event_open, &attr, 0 /* this thread */, -1 /* any cpu */, groupFd, 0);
+}
+#endif // __linux__
+
+PerfCounterGroup::PerfCounterGroup()
+    : mFileDescriptors(NUM_COUNTERS, -1)
+{
+#ifdef __linux__
+    const unsigned long long configs[NUM_COUNTERS] = {PERF_COUNT_HW_CPU_CYCLES,
+                                                      PERF_COUNT_HW_INSTRUCTIONS,
+                                                      PERF_COUNT_HW_CACHE_MISSES,
+                                                      PERF_COUNT_HW_BRANCH_MISSES};
+    mFileDescriptors[CYCLES] = OpenCounter(configs[CYCLES], -1);
+    if (mFileDescriptors[CYCLES] == -1)
+    {
+        mUnavailableReason = std::string("perf_event_open failed: ") + strerror(errno);
+        return;
+    }
+    mReadOrder.push_back(CYCLES);
+    for (unsigned counter=CYCLES+1; counter<NUM_COUNTERS; counter++)
+    {
+        mFileDescriptors[counter] = OpenCounter(configs[counter], mFileDescriptors[CYCLES]);
+        if (mFileDescriptors[counter] != -1)
+        {
+            mReadOrder.push_back(counter);
+        }
+    }
+    ioctl(mFileDescriptors[CYCLES], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(mFileDescriptors[CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+    mUnavailableReason = "hardware counters are only supported on Linux";
+#endif // __linux__
+}
+
+PerfCounterGroup::~PerfCounterGroup()
+{
+#ifdef __linux__
+    // Close members before the leader
+    for (unsigned i=mFileDescriptors.size(); i-- > 0; )
+    {
+        if (mFileDescriptors[i] != -1)
+        {
+            close(mFileDescriptors[i]);
+        }
+    }
+#endif // __linux__
+}
+
+bool PerfCounterGroup::IsAvailable() const
+{
+    return mUnavailableReason.empty();
+}
+
+const std::string& PerfCounterGroup::rGetUnavailableReason() const
+{
+    return mUnavailableReason;
+}
+
+void PerfCounterGroup::Read(std::vector<double>& rValues) const
+{
+    rValues.assign(NUM_COUNTERS, 0.0);
+#ifdef __linux__
+    if (IsAvailable())
+    {
+        // The group read format is the number of counters followed by each value
+        unsigned long long buffer[1 + NUM_COUNTERS];
+        ssize_t bytes_read = read(mFileDescriptors[CYCLES], buffer, sizeof(buffer));
+        if (bytes_read >= (ssize_t)sizeof(buffer[0]))
+        {
+            const unsigned num_read = buffer[0];
+            assert(num_read == mReadOrder.size());
+            for (unsigned i=0; i<num_read; i++)
+            {
+                rValues[mReadOrder[i]] = buffer[1+i];
+            }
+        }
+    }
+#endif // __linux__
+}
+
+std::string PerfCounterGroup::GetCounterName(Counter counter)
+{
+    std::string name;
+    switch (counter)
+    {
+    case CYCLES:
+        name = "cycles";
+        break;
+    case INSTRUCTIONS:
+        name = "instructions";
+        break;
+    case CACHE_MISSES:
+        name = "cache_misses";
+        break;
+    case BRANCH_MISSES:
+        name = "branch_misses";
+        break;
+    default:
+        NEVER_REACHED;
+    }
+    return name;
+}
@@ -0,0 +1,115 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef PERFCOUNTERGROUP_HPP_
+#define PERFCOUNTERGROUP_HPP_
+
+#include <string>
+#include <vector>
+
+/**
+ * A group of hardware performance counters for the calling thread, read together so that their values
+ * are consistent.  Used by CryptPhaseTimer to attribute cycles, instructions, cache misses and branch
+ * mispredictions to the phases of the timestep loop.
+ *
+ * Counters are opened with the Linux perf_event_open system call, counting user-space events only.  If
+ * this isn't possible (a different OS, a virtual machine without a PMU, or a restrictive
+ * /proc/sys/kernel/perf_event_paranoid setting) then IsAvailable() returns false, GetUnavailableReason()
+ * says why, and Read() returns zeros.  No exception is thrown, so callers can always create a group.
+ * Individual counters that the hardware doesn't support likewise just read as zero.
+ */
+class PerfCounterGroup
+{
+public:
+    /** The events counted. */
+    enum Counter
+    {
+        CYCLES = 0,    ///< CPU cycles
+        INSTRUCTIONS,  ///< Instructions retired
+        CACHE_MISSES,  ///< Last-level cache misses
+        BRANCH_MISSES, ///< Mispredicted branches
+        NUM_COUNTERS   ///< Not a counter; the number of counters
+    };
+
+    /**
+     * Open and start the counters.
+     */
+    PerfCounterGroup();
+
+    /**
+     * Close the counters.
+     */
+    ~PerfCounterGroup();
+
+    /** @return  whether hardware counters could be opened. */
+    bool IsAvailable() const;
+
+    /** @return  why counters are unavailable, or the empty string if they are available. */
+    const std::string& rGetUnavailableReason() const;
+
+    /**
+     * Read the current counter values.
+     *
+     * @param rValues  filled in with NUM_COUNTERS values since the group was opened, indexed by Counter
+     */
+    void Read(std::vector<double>& rValues) const;
+
+    /**
+     * @param counter  the counter
+     * @return  a short name for the counter, suitable for use in output files
+     */
+    static std::string GetCounterName(Counter counter);
+
+private:
+    /** File descriptor for each counter, or -1 if it couldn't be opened.  The first is the group leader. */
+    std::vector<int> mFileDescriptors;
+
+    /** Which counter each value in a group read refers to, in the order counters joined the group. */
+    std::vector<unsigned> mReadOrder;
+
+    /** Why counters are unavailable; empty if they are available. */
+    std::string mUnavailableReason;
+
+    /** Copying is not allowed, since we own file descriptors. */
+    PerfCounterGroup(const PerfCounterGroup&);
+
+    /**
+     * Copying is not allowed, since we own file descriptors.
+     * @return  nothing
+     */
+    PerfCounterGroup& operator=(const PerfCounterGroup&);
+};
+
+#endif // PERFCOUNTERGROUP_HPP_
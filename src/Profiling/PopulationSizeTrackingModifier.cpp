@@ -0,0 +1,217 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "PopulationSizeTrackingModifier.hpp"
+
+#include <cassert>
+#include <boost/shared_ptr.hpp>
+
+#include "Cell.hpp"
+#include "Node.hpp"
+#include "AbstractCellProperty.hpp"
+#include "SimpleWntUniformDistCellCycleModel.hpp"
+#include "VariableWntCellCycleModel.hpp"
+#include "StochasticDurationGenerationBasedCellCycleModel.hpp"
+#include "ContactInhibitionGenerationBasedCellCycleModel.hpp"
+#include "TraceRecorder.hpp"
+
+/**
+ * Estimate the size of a cell-cycle model, which depends on its concrete type.
+ *
+ * @param pModel  the model
+ * @return  its size in bytes
+ */
+static std::size_t EstimateCellCycleModelSize(AbstractCellCycleModel* pModel)
+{
+    if (dynamic_cast<VariableWntCellCycleModel*>(pModel))
+    {
+        return sizeof(VariableWntCellCycleModel);
+    }
+    if (dynamic_cast<SimpleWntUniformDistCellCycleModel*>(pModel))
+    {
+        return sizeof(SimpleWntUniformDistCellCycleModel);
+    }
+    if (dynamic_cast<ContactInhibitionGenerationBasedCellCycleModel*>(pModel))
+    {
+        return sizeof(ContactInhibitionGenerationBasedCellCycleModel);
+    }
+    if (dynamic_cast<StochasticDurationGenerationBasedCellCycleModel*>(pModel))
+    {
+        return sizeof(StochasticDurationGenerationBasedCellCycleModel);
+    }
+    return sizeof(AbstractCellCycleModel);
+}
+
+/**
+ * Approximate heap cost of one entry in a std::set of property pointers: the red-black tree
+ * node's three pointers and colour, plus the stored shared pointer.
+ */
+static const std::size_t PROPERTY_ENTRY_BYTES = 4*sizeof(void*) + sizeof(boost::shared_ptr<AbstractCellProperty>);
+
+template<unsigned DIM>
+PopulationSizeTrackingModifier<DIM>::PopulationSizeTrackingModifier()
+    : AbstractCellBasedSimulationModifier<DIM,DIM>(),
+      mPeakNumCells(0u),
+      mPeakNumNodes(0u),
+      mPeakNumGhostNodes(0u),
+      mMemorySamplingInterval(10u),
+      mNumSteps(0u),
+      mPeakBytes(NUM_MEMORY_CATEGORIES, 0.0)
+{
+}
+
+template<unsigned DIM>
+PopulationSizeTrackingModifier<DIM>::~PopulationSizeTrackingModifier()
+{
+}
+
+template<unsigned DIM>
+void PopulationSizeTrackingModifier<DIM>::UpdatePeaks(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    unsigned num_cells = rCellPopulation.GetNumRealCells();
+    if (num_cells > mPeakNumCells)
+    {
+        mPeakNumCells = num_cells;
+    }
+    unsigned num_nodes = rCellPopulation.GetNumNodes();
+    if (num_nodes > mPeakNumNodes)
+    {
+        mPeakNumNodes = num_nodes;
+    }
+    // Nodes without a cell attached are ghost nodes
+    unsigned num_ghosts = (num_nodes > num_cells) ? num_nodes - num_cells : 0u;
+    if (num_ghosts > mPeakNumGhostNodes)
+    {
+        mPeakNumGhostNodes = num_ghosts;
+    }
+}
+
+template<unsigned DIM>
+void PopulationSizeTrackingModifier<DIM>::UpdatePeakBytes(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    std::vector<double> bytes(NUM_MEMORY_CATEGORIES, 0.0);
+    for (typename AbstractCellPopulation<DIM,DIM>::Iterator cell_iter = rCellPopulation.Begin();
+         cell_iter != rCellPopulation.End();
+         ++cell_iter)
+    {
+        bytes[CELLS] += sizeof(Cell);
+        bytes[CELL_CYCLE_MODELS] += EstimateCellCycleModelSize(cell_iter->GetCellCycleModel());
+        bytes[CELL_PROPERTIES] += cell_iter->rGetCellPropertyCollection().GetSize() * PROPERTY_ENTRY_BYTES;
+    }
+    bytes[NODES] = rCellPopulation.rGetMesh().GetNumAllNodes() * (sizeof(Node<DIM>) + sizeof(Node<DIM>*));
+
+    for (unsigned i=0; i<NUM_MEMORY_CATEGORIES; i++)
+    {
+        if (bytes[i] > mPeakBytes[i])
+        {
+            mPeakBytes[i] = bytes[i];
+        }
+    }
+}
+
+template<unsigned DIM>
+void PopulationSizeTrackingModifier<DIM>::UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    UpdatePeaks(rCellPopulation);
+    if (++mNumSteps % mMemorySamplingInterval == 0u)
+    {
+        UpdatePeakBytes(rCellPopulation);
+        TraceRecorder::RecordCounter("num_cells", rCellPopulation.GetNumRealCells());
+    }
+}
+
+template<unsigned DIM>
+void PopulationSizeTrackingModifier<DIM>::SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory)
+{
+    mPeakNumCells = 0u;
+    mPeakNumNodes = 0u;
+    mPeakNumGhostNodes = 0u;
+    mNumSteps = 0u;
+    mPeakBytes.assign(NUM_MEMORY_CATEGORIES, 0.0);
+    UpdatePeaks(rCellPopulation);
+    UpdatePeakBytes(rCellPopulation);
+}
+
+template<unsigned DIM>
+unsigned PopulationSizeTrackingModifier<DIM>::GetPeakNumCells() const
+{
+    return mPeakNumCells;
+}
+
+template<unsigned DIM>
+unsigned PopulationSizeTrackingModifier<DIM>::GetPeakNumNodes() const
+{
+    return mPeakNumNodes;
+}
+
+template<unsigned DIM>
+unsigned PopulationSizeTrackingModifier<DIM>::GetPeakNumGhostNodes() const
+{
+    return mPeakNumGhostNodes;
+}
+
+template<unsigned DIM>
+const std::vector<double>& PopulationSizeTrackingModifier<DIM>::rGetPeakBytes() const
+{
+    return mPeakBytes;
+}
+
+template<unsigned DIM>
+void PopulationSizeTrackingModifier<DIM>::SetMemorySamplingInterval(unsigned interval)
+{
+    assert(interval > 0u);
+    mMemorySamplingInterval = interval;
+}
+
+template<unsigned DIM>
+void PopulationSizeTrackingModifier<DIM>::OutputSimulationModifierParameters(out_stream& rParamsFile)
+{
+    *rParamsFile << "\t\t\t<MemorySamplingInterval>" << mMemorySamplingInterval << "</MemorySamplingInterval>\n";
+
+    // Call method on direct parent class
+    AbstractCellBasedSimulationModifier<DIM,DIM>::OutputSimulationModifierParameters(rParamsFile);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class PopulationSizeTrackingModifier<1>;
+template class PopulationSizeTrackingModifier<2>;
+template class PopulationSizeTrackingModifier<3>;
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(PopulationSizeTrackingModifier)
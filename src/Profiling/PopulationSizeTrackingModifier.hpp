@@ -0,0 +1,185 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef POPULATIONSIZETRACKINGMODIFIER_HPP_
+#define POPULATIONSIZETRACKINGMODIFIER_HPP_
+
+#include <vector>
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "AbstractCellBasedSimulationModifier.hpp"
+
+/**
+ * A modifier class which records the largest number of cells, mesh nodes and ghost nodes seen at the
+ * end of any timestep of a simulation, so that the cost of a run can be related to its size.
+ *
+ * It also periodically estimates the memory held by cells, their cell-cycle models and property
+ * collections, and by mesh nodes, and records the peak of each.  These are estimates based on object
+ * sizes and container overheads, rather than measurements of the heap, but are good enough for working
+ * out how many simulations will fit on a machine.
+ */
+template<unsigned DIM>
+class PopulationSizeTrackingModifier : public AbstractCellBasedSimulationModifier<DIM,DIM>
+{
+private:
+    /** The largest number of real cells seen. */
+    unsigned mPeakNumCells;
+
+    /** The largest number of mesh nodes (including any ghost nodes) seen. */
+    unsigned mPeakNumNodes;
+
+    /** The largest number of ghost nodes seen. */
+    unsigned mPeakNumGhostNodes;
+
+    /** How many timesteps between memory estimates. */
+    unsigned mMemorySamplingInterval;
+
+    /** Timesteps since SetupSolve. */
+    unsigned mNumSteps;
+
+    /** Peak estimated bytes for each category of MemoryCategory. */
+    std::vector<double> mPeakBytes;
+
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<AbstractCellBasedSimulationModifier<DIM,DIM> >(*this);
+        archive & mPeakNumCells;
+        archive & mPeakNumNodes;
+        archive & mPeakNumGhostNodes;
+        archive & mMemorySamplingInterval;
+        archive & mPeakBytes;
+    }
+
+    /**
+     * Update the peak counts from the current state of the population.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    void UpdatePeaks(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Update the peak memory estimates from the current state of the population.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    void UpdatePeakBytes(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+public:
+    /** The categories of memory use estimated. */
+    enum MemoryCategory
+    {
+        CELLS = 0,          ///< Cell objects themselves
+        CELL_CYCLE_MODELS,  ///< Cell-cycle models owned by cells
+        CELL_PROPERTIES,    ///< Entries in cell property collections
+        NODES,              ///< Mesh nodes, including deleted nodes awaiting a remesh
+        NUM_MEMORY_CATEGORIES ///< Not a category; the number of categories
+    };
+
+    /**
+     * Default constructor.
+     */
+    PopulationSizeTrackingModifier();
+
+    /**
+     * Destructor.
+     */
+    virtual ~PopulationSizeTrackingModifier();
+
+    /**
+     * Overridden UpdateAtEndOfTimeStep() method.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Overridden SetupSolve() method.  Resets the peak counts to the initial population size.
+     *
+     * @param rCellPopulation reference to the cell population
+     * @param outputDirectory the output directory, relative to where Chaste output is stored
+     */
+    virtual void SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory);
+
+    /**
+     * @return  the largest number of real cells seen
+     */
+    unsigned GetPeakNumCells() const;
+
+    /**
+     * @return  the largest number of mesh nodes seen
+     */
+    unsigned GetPeakNumNodes() const;
+
+    /**
+     * @return  the largest number of ghost nodes seen
+     */
+    unsigned GetPeakNumGhostNodes() const;
+
+    /**
+     * @return  the peak estimated memory use, in bytes, for each MemoryCategory
+     */
+    const std::vector<double>& rGetPeakBytes() const;
+
+    /**
+     * Set how often to estimate memory use, and record the cell count if a TraceRecorder is enabled.
+     *
+     * @param interval  the number of timesteps between estimates
+     */
+    void SetMemorySamplingInterval(unsigned interval);
+
+    /**
+     * Overridden OutputSimulationModifierParameters() method.
+     *
+     * @param rParamsFile the file stream to which the parameters are output
+     */
+    void OutputSimulationModifierParameters(out_stream& rParamsFile);
+};
+
+#include "SerializationExportWrapper.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(PopulationSizeTrackingModifier)
+
+#endif /*POPULATIONSIZETRACKINGMODIFIER_HPP_*/
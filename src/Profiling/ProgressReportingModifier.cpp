@@ -0,0 +1,179 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "ProgressReportingModifier.hpp"
+
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+#include "SimulationTime.hpp"
+#include "Exception.hpp"
+
+template<unsigned DIM>
+ProgressReportingModifier<DIM>::ProgressReportingModifier(double reportingInterval, double endTime)
+    : AbstractCellBasedSimulationModifier<DIM,DIM>(),
+      mReportingInterval(reportingInterval),
+      mStepsBetweenChecks(10u),
+      mEndTime(endTime),
+      mSimStartTime(0.0),
+      mWallStartTime(0.0),
+      mLastReportTime(0.0),
+      mNumSteps(0u),
+      mLastReportSteps(0u)
+{
+}
+
+template<unsigned DIM>
+ProgressReportingModifier<DIM>::~ProgressReportingModifier()
+{
+}
+
+template<unsigned DIM>
+void ProgressReportingModifier<DIM>::SetStatusFile(const FileFinder& rStatusFile)
+{
+    mStatusFilePath = rStatusFile.GetAbsolutePath();
+}
+
+template<unsigned DIM>
+double ProgressReportingModifier<DIM>::GetReportingInterval() const
+{
+    return mReportingInterval;
+}
+
+template<unsigned DIM>
+void ProgressReportingModifier<DIM>::SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory)
+{
+    if (mStatusFilePath.empty())
+    {
+        FileFinder status_file(outputDirectory + "/status.txt", RelativeTo::ChasteTestOutput);
+        mStatusFilePath = status_file.GetAbsolutePath();
+    }
+    mSimStartTime = SimulationTime::Instance()->GetTime();
+    mWallStartTime = MPI_Wtime();
+    mLastReportTime = mWallStartTime;
+    mNumSteps = 0u;
+    mLastReportSteps = 0u;
+    WriteStatus(rCellPopulation, "starting", mWallStartTime);
+}
+
+template<unsigned DIM>
+void ProgressReportingModifier<DIM>::UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    mNumSteps++;
+    if (mNumSteps % mStepsBetweenChecks == 0u)
+    {
+        double wall_time = MPI_Wtime();
+        if (wall_time - mLastReportTime >= mReportingInterval)
+        {
+            WriteStatus(rCellPopulation, "running", wall_time);
+        }
+    }
+}
+
+template<unsigned DIM>
+void ProgressReportingModifier<DIM>::UpdateAtEndOfSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    WriteStatus(rCellPopulation, "finished", MPI_Wtime());
+}
+
+template<unsigned DIM>
+void ProgressReportingModifier<DIM>::WriteStatus(AbstractCellPopulation<DIM,DIM>& rCellPopulation,
+                                                 const std::string& rState, double wallTime)
+{
+    double sim_time = SimulationTime::Instance()->GetTime();
+    double elapsed = wallTime - mWallStartTime;
+
+    // Rates are measured since the last report, so they track the current speed of the simulation
+    double interval = wallTime - mLastReportTime;
+    double steps_per_second = (interval > 0.0 && mNumSteps > mLastReportSteps)
+                              ? (mNumSteps - mLastReportSteps)/interval : 0.0;
+    double remaining = -1.0; // Unknown
+    double sim_hours_done = sim_time - mSimStartTime;
+    if (elapsed > 0.0 && sim_hours_done > 0.0 && mEndTime > sim_time)
+    {
+        remaining = (mEndTime - sim_time) * elapsed / sim_hours_done;
+    }
+
+    // Write to a temporary file then rename, so readers never see a partial file
+    std::string temp_path = mStatusFilePath + ".tmp";
+    {
+        std::ofstream status(temp_path.c_str());
+        if (!status.is_open())
+        {
+            // Progress reporting is advisory, so don't stop the simulation
+            return;
+        }
+        status << std::setprecision(8)
+               << "state " << rState << std::endl
+               << "rank " << PetscTools::GetMyRank() << std::endl
+               << "simulated_time " << sim_time << std::endl
+               << "end_time " << mEndTime << std::endl
+               << "wall_time " << elapsed << std::endl
+               << "steps " << mNumSteps << std::endl
+               << "steps_per_second " << steps_per_second << std::endl
+               << "num_cells " << rCellPopulation.GetNumRealCells() << std::endl
+               << "estimated_seconds_remaining " << remaining << std::endl
+               << "estimated_completion_unix_time " << (remaining >= 0.0 ? (double)time(NULL) + remaining : -1.0) << std::endl;
+    }
+    rename(temp_path.c_str(), mStatusFilePath.c_str());
+
+    mLastReportTime = wallTime;
+    mLastReportSteps = mNumSteps;
+}
+
+template<unsigned DIM>
+void ProgressReportingModifier<DIM>::OutputSimulationModifierParameters(out_stream& rParamsFile)
+{
+    *rParamsFile << "\t\t\t<ReportingInterval>" << mReportingInterval << "</ReportingInterval>\n";
+
+    // Call method on direct parent class
+    AbstractCellBasedSimulationModifier<DIM,DIM>::OutputSimulationModifierParameters(rParamsFile);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class ProgressReportingModifier<1>;
+template class ProgressReportingModifier<2>;
+template class ProgressReportingModifier<3>;
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(ProgressReportingModifier)
@@ -0,0 +1,172 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef PROGRESSREPORTINGMODIFIER_HPP_
+#define PROGRESSREPORTINGMODIFIER_HPP_
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+
+#include "AbstractCellBasedSimulationModifier.hpp"
+#include "FileFinder.hpp"
+
+/**
+ * A modifier class which periodically writes a small status file describing the progress of a long
+ * simulation: simulated time, elapsed wall time, timesteps per second, number of cells and an estimate
+ * of when the simulation will finish.  A job scheduler can watch this file to spot runs which have
+ * stalled or whose population has grown out of control.
+ *
+ * To keep the cost negligible, the wall clock is only consulted every few timesteps, and the file is
+ * only rewritten once the given wall-clock interval has passed.  The file is written to a temporary
+ * name and then renamed, so a reader never sees a partially written status.
+ */
+template<unsigned DIM>
+class ProgressReportingModifier : public AbstractCellBasedSimulationModifier<DIM,DIM>
+{
+private:
+    /** The minimum wall-clock time between status file updates, in seconds. */
+    double mReportingInterval;
+
+    /** Number of timesteps between checks of the wall clock. */
+    unsigned mStepsBetweenChecks;
+
+    /** The simulation end time, used to estimate the time remaining. */
+    double mEndTime;
+
+    /** Full path of the status file. */
+    std::string mStatusFilePath;
+
+    /** Simulated time when SetupSolve was called. */
+    double mSimStartTime;
+
+    /** Wall-clock time when SetupSolve was called. */
+    double mWallStartTime;
+
+    /** Wall-clock time of the last status file update. */
+    double mLastReportTime;
+
+    /** Timesteps taken since SetupSolve. */
+    unsigned mNumSteps;
+
+    /** Timesteps taken at the last status file update. */
+    unsigned mLastReportSteps;
+
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<AbstractCellBasedSimulationModifier<DIM,DIM> >(*this);
+        archive & mReportingInterval;
+        archive & mStepsBetweenChecks;
+        archive & mEndTime;
+    }
+
+    /**
+     * Write the status file.
+     *
+     * @param rCellPopulation  the cell population
+     * @param rState  a word describing the state of the simulation, e.g. "running"
+     * @param wallTime  the current wall-clock time
+     */
+    void WriteStatus(AbstractCellPopulation<DIM,DIM>& rCellPopulation, const std::string& rState, double wallTime);
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param reportingInterval  the minimum wall-clock time between status updates, in seconds
+     * @param endTime  the simulation end time, in hours
+     */
+    ProgressReportingModifier(double reportingInterval=30.0, double endTime=0.0);
+
+    /**
+     * Destructor.
+     */
+    virtual ~ProgressReportingModifier();
+
+    /**
+     * Set where the status file should be written.  By default it is written as "status.txt" in the
+     * directory given to SetupSolve.
+     *
+     * @param rStatusFile  the status file location
+     */
+    void SetStatusFile(const FileFinder& rStatusFile);
+
+    /**
+     * @return  the minimum wall-clock time between status updates, in seconds
+     */
+    double GetReportingInterval() const;
+
+    /**
+     * Overridden UpdateAtEndOfTimeStep() method.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Overridden SetupSolve() method.  Writes an initial status file to the simulation output directory.
+     *
+     * @param rCellPopulation reference to the cell population
+     * @param outputDirectory the output directory, relative to where Chaste output is stored
+     */
+    virtual void SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory);
+
+    /**
+     * Overridden UpdateAtEndOfSolve() method.  Writes a final status file.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Overridden OutputSimulationModifierParameters() method.
+     *
+     * @param rParamsFile the file stream to which the parameters are output
+     */
+    void OutputSimulationModifierParameters(out_stream& rParamsFile);
+};
+
+#include "SerializationExportWrapper.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(ProgressReportingModifier)
+
+#endif /*PROGRESSREPORTINGMODIFIER_HPP_*/
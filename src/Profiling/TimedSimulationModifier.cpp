@@ -0,0 +1,108 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "TimedSimulationModifier.hpp"
+
+#include <cassert>
+
+template<unsigned DIM>
+TimedSimulationModifier<DIM>::TimedSimulationModifier(boost::shared_ptr<AbstractCellBasedSimulationModifier<DIM,DIM> > pModifier,
+                                                      boost::shared_ptr<CryptPhaseTimer> pTimer,
+                                                      CryptPhaseTimer::Phase phase)
+    : AbstractCellBasedSimulationModifier<DIM,DIM>(),
+      mpModifier(pModifier),
+      mpTimer(pTimer),
+      mPhase(phase)
+{
+}
+
+template<unsigned DIM>
+TimedSimulationModifier<DIM>::~TimedSimulationModifier()
+{
+}
+
+template<unsigned DIM>
+void TimedSimulationModifier<DIM>::SetTimer(boost::shared_ptr<CryptPhaseTimer> pTimer)
+{
+    mpTimer = pTimer;
+}
+
+template<unsigned DIM>
+boost::shared_ptr<AbstractCellBasedSimulationModifier<DIM,DIM> > TimedSimulationModifier<DIM>::GetModifier() const
+{
+    return mpModifier;
+}
+
+template<unsigned DIM>
+void TimedSimulationModifier<DIM>::UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    assert(mpModifier && mpTimer);
+    mpTimer->BeginPhase(mPhase);
+    mpModifier->UpdateAtEndOfTimeStep(rCellPopulation);
+    mpTimer->EndPhase(mPhase);
+}
+
+template<unsigned DIM>
+void TimedSimulationModifier<DIM>::SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory)
+{
+    assert(mpModifier);
+    mpModifier->SetupSolve(rCellPopulation, outputDirectory);
+}
+
+template<unsigned DIM>
+void TimedSimulationModifier<DIM>::UpdateAtEndOfSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation)
+{
+    assert(mpModifier);
+    mpModifier->UpdateAtEndOfSolve(rCellPopulation);
+}
+
+template<unsigned DIM>
+void TimedSimulationModifier<DIM>::OutputSimulationModifierParameters(out_stream& rParamsFile)
+{
+    // Report the wrapped modifier, rather than ourselves
+    mpModifier->OutputSimulationModifierParameters(rParamsFile);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Explicit instantiation
+/////////////////////////////////////////////////////////////////////////////
+
+template class TimedSimulationModifier<1>;
+template class TimedSimulationModifier<2>;
+template class TimedSimulationModifier<3>;
+
+// Serialization for Boost >= 1.36
+#include "SerializationExportWrapperForCpp.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(TimedSimulationModifier)
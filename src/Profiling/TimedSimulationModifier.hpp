@@ -0,0 +1,141 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TIMEDSIMULATIONMODIFIER_HPP_
+#define TIMEDSIMULATIONMODIFIER_HPP_
+
+#include "ChasteSerialization.hpp"
+#include <boost/serialization/base_object.hpp>
+#include <boost/serialization/shared_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+
+#include "AbstractCellBasedSimulationModifier.hpp"
+#include "CryptPhaseTimer.hpp"
+
+/**
+ * Wraps another simulation modifier, timing its end-of-timestep updates under a given phase of a CryptPhaseTimer.
+ * All calls are forwarded to the wrapped modifier.
+ */
+template<unsigned DIM>
+class TimedSimulationModifier : public AbstractCellBasedSimulationModifier<DIM,DIM>
+{
+private:
+    /** The modifier being timed. */
+    boost::shared_ptr<AbstractCellBasedSimulationModifier<DIM,DIM> > mpModifier;
+
+    /** The timer to accumulate into.  This is not archived. */
+    boost::shared_ptr<CryptPhaseTimer> mpTimer;
+
+    /** The phase to time the modifier under. */
+    CryptPhaseTimer::Phase mPhase;
+
+    /** Needed for serialization. */
+    friend class boost::serialization::access;
+    /**
+     * Boost Serialization method for archiving/checkpointing.
+     *
+     * @param archive  The boost archive.
+     * @param version  The current version of this class.
+     */
+    template<class Archive>
+    void serialize(Archive & archive, const unsigned int version)
+    {
+        archive & boost::serialization::base_object<AbstractCellBasedSimulationModifier<DIM,DIM> >(*this);
+        archive & mpModifier;
+        archive & mPhase;
+    }
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param pModifier  the modifier to time
+     * @param pTimer  the timer to accumulate into
+     * @param phase  the phase to time the modifier under
+     */
+    TimedSimulationModifier(boost::shared_ptr<AbstractCellBasedSimulationModifier<DIM,DIM> > pModifier =
+                                boost::shared_ptr<AbstractCellBasedSimulationModifier<DIM,DIM> >(),
+                            boost::shared_ptr<CryptPhaseTimer> pTimer = boost::shared_ptr<CryptPhaseTimer>(),
+                            CryptPhaseTimer::Phase phase = CryptPhaseTimer::VOLUME_TRACKING);
+
+    /**
+     * Destructor.
+     */
+    virtual ~TimedSimulationModifier();
+
+    /**
+     * Set the timer to accumulate into, e.g. after loading from an archive.
+     *
+     * @param pTimer  the timer
+     */
+    void SetTimer(boost::shared_ptr<CryptPhaseTimer> pTimer);
+
+    /** @return  the modifier being timed. */
+    boost::shared_ptr<AbstractCellBasedSimulationModifier<DIM,DIM> > GetModifier() const;
+
+    /**
+     * Overridden UpdateAtEndOfTimeStep() method.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfTimeStep(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Overridden SetupSolve() method.
+     *
+     * @param rCellPopulation reference to the cell population
+     * @param outputDirectory the output directory, relative to where Chaste output is stored
+     */
+    virtual void SetupSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation, std::string outputDirectory);
+
+    /**
+     * Overridden UpdateAtEndOfSolve() method.
+     *
+     * @param rCellPopulation reference to the cell population
+     */
+    virtual void UpdateAtEndOfSolve(AbstractCellPopulation<DIM,DIM>& rCellPopulation);
+
+    /**
+     * Overridden OutputSimulationModifierParameters() method.
+     *
+     * @param rParamsFile the file stream to which the parameters are output
+     */
+    void OutputSimulationModifierParameters(out_stream& rParamsFile);
+};
+
+#include "SerializationExportWrapper.hpp"
+EXPORT_TEMPLATE_CLASS_SAME_DIMS(TimedSimulationModifier)
+
+#endif /*TIMEDSIMULATIONMODIFIER_HPP_*/
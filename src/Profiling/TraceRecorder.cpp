@@ -0,0 +1,197 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "TraceRecorder.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <sys/time.h>
+
+#include "PetscTools.hpp"
+#include "Exception.hpp"
+
+std::vector<std::string> TraceRecorder::mEvents;
+bool TraceRecorder::mEnabled = false;
+
+void TraceRecorder::Enable()
+{
+    mEvents.clear();
+    mEnabled = true;
+}
+
+void TraceRecorder::Disable()
+{
+    mEnabled = false;
+}
+
+bool TraceRecorder::IsEnabled()
+{
+    return mEnabled;
+}
+
+double TraceRecorder::GetTimestamp()
+{
+    timeval now;
+    gettimeofday(&now, NULL);
+    return now.tv_sec*1e6 + now.tv_usec;
+}
+
+void TraceRecorder::RecordSpan(const std::string& rName, const std::string& rCategory,
+                               double startTime, double endTime,
+                               const std::vector<std::pair<std::string, std::string> >& rArguments)
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+    std::stringstream event;
+    event << std::fixed << std::setprecision(0)
+          << "{\"name\": " << Quote(rName) << ", \"cat\": " << Quote(rCategory) << ", \"ph\": \"X\""
+          << ", \"ts\": " << startTime << ", \"dur\": " << endTime - startTime
+          << ", \"pid\": " << PetscTools::GetMyRank() << ", \"tid\": 0, \"args\": {";
+    for (unsigned i=0; i<rArguments.size(); i++)
+    {
+        event << (i == 0 ? "" : ", ") << Quote(rArguments[i].first) << ": " << Quote(rArguments[i].second);
+    }
+    event << "}}";
+    mEvents.push_back(event.str());
+}
+
+void TraceRecorder::RecordCounter(const std::string& rName, double value)
+{
+    if (!mEnabled)
+    {
+        return;
+    }
+    std::stringstream event;
+    event << std::fixed << std::setprecision(0)
+          << "{\"name\": " << Quote(rName) << ", \"ph\": \"C\", \"ts\": " << GetTimestamp()
+          << ", \"pid\": " << PetscTools::GetMyRank() << ", \"args\": {" << Quote(rName) << ": "
+          << std::setprecision(6) << value << "}}";
+    mEvents.push_back(event.str());
+}
+
+void TraceRecorder::WriteRankFile(const std::string& rPath)
+{
+    std::ofstream file(rPath.c_str());
+    if (!file.is_open())
+    {
+        EXCEPTION("Unable to write trace events to " << rPath);
+    }
+    for (unsigned i=0; i<mEvents.size(); i++)
+    {
+        file << mEvents[i] << std::endl;
+    }
+}
+
+void TraceRecorder::MergeRankFiles(const std::vector<std::string>& rRankFilePaths, const std::string& rOutputPath)
+{
+    std::ofstream trace(rOutputPath.c_str());
+    if (!trace.is_open())
+    {
+        EXCEPTION("Unable to write trace file " << rOutputPath);
+    }
+    trace << "{\"traceEvents\": [" << std::endl;
+    // Label each process's track with its rank
+    for (unsigned rank=0; rank<rRankFilePaths.size(); rank++)
+    {
+        trace << (rank == 0 ? "" : ",\n") << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << rank
+              << ", \"args\": {\"name\": \"rank " << rank << "\"}}";
+    }
+    for (unsigned rank=0; rank<rRankFilePaths.size(); rank++)
+    {
+        std::ifstream rank_file(rRankFilePaths[rank].c_str());
+        std::string event;
+        while (std::getline(rank_file, event))
+        {
+            if (!event.empty())
+            {
+                trace << ",\n" << event;
+            }
+        }
+        rank_file.close();
+        std::remove(rRankFilePaths[rank].c_str());
+    }
+    trace << "\n]}" << std::endl;
+}
+
+std::string TraceRecorder::Quote(const std::string& rString)
+{
+    std::string quoted = "\"";
+    for (std::string::const_iterator it = rString.begin(); it != rString.end(); ++it)
+    {
+        if (*it == '"' || *it == '\\')
+        {
+            quoted += '\\';
+            quoted += *it;
+        }
+        else if (*it == '\n')
+        {
+            quoted += "\\n";
+        }
+        else
+        {
+            quoted += *it;
+        }
+    }
+    return quoted + "\"";
+}
+
+
+TraceSpan::TraceSpan(const std::string& rName, const std::string& rCategory)
+    : mActive(TraceRecorder::IsEnabled()),
+      mName(rName),
+      mCategory(rCategory),
+      mStartTime(mActive ? TraceRecorder::GetTimestamp() : 0.0)
+{
+}
+
+void TraceSpan::AddArgument(const std::string& rKey, const std::string& rValue)
+{
+    if (mActive)
+    {
+        mArguments.push_back(std::make_pair(rKey, rValue));
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (mActive)
+    {
+        TraceRecorder::RecordSpan(mName, mCategory, mStartTime, TraceRecorder::GetTimestamp(), mArguments);
+    }
+}
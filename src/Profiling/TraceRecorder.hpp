@@ -0,0 +1,167 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TRACERECORDER_HPP_
+#define TRACERECORDER_HPP_
+
+#include <string>
+#include <vector>
+#include <utility>
+
+/**
+ * Records a timeline of what this process is doing, in the Chrome trace event format that can be loaded
+ * into chrome://tracing or https://ui.perfetto.dev.  Used to see how sweep jobs overlap across MPI ranks,
+ * where ranks wait, and how long each stage of a job takes.
+ *
+ * Recording is off by default, in which case the recording methods return immediately.  Spans are most
+ * conveniently recorded using a TraceSpan object.  Each process keeps its own events in memory; at the end
+ * of a run each process writes them to a file with WriteRankFile, and the master combines these into a
+ * single trace with MergeRankFiles.  Each process appears as a separate track, labelled by its rank.
+ *
+ * Timestamps are taken from the system wall clock, so ranks on different nodes will only line up if the
+ * nodes' clocks are synchronised.
+ */
+class TraceRecorder
+{
+public:
+    /** Start recording events.  Any previously recorded events are discarded. */
+    static void Enable();
+
+    /** Stop recording events. */
+    static void Disable();
+
+    /** @return  whether events are being recorded. */
+    static bool IsEnabled();
+
+    /** @return  the current time in microseconds, as used for event timestamps. */
+    static double GetTimestamp();
+
+    /**
+     * Record a completed span of work.
+     *
+     * @param rName  what was being done
+     * @param rCategory  a category for filtering spans in the trace viewer
+     * @param startTime  when it started, from GetTimestamp
+     * @param endTime  when it finished, from GetTimestamp
+     * @param rArguments  extra details to show for the span, as (key, value) pairs
+     */
+    static void RecordSpan(const std::string& rName, const std::string& rCategory,
+                           double startTime, double endTime,
+                           const std::vector<std::pair<std::string, std::string> >& rArguments);
+
+    /**
+     * Record the current value of a counter, e.g. the number of cells.
+     *
+     * @param rName  the counter name
+     * @param value  its value
+     */
+    static void RecordCounter(const std::string& rName, double value);
+
+    /**
+     * Write this process's events to a file, one JSON event object per line.
+     *
+     * @param rPath  the file to write
+     */
+    static void WriteRankFile(const std::string& rPath);
+
+    /**
+     * Combine the files written by WriteRankFile on each process into a single trace file, and delete them.
+     *
+     * @param rRankFilePaths  the per-rank files, indexed by rank
+     * @param rOutputPath  the combined trace file to write
+     */
+    static void MergeRankFiles(const std::vector<std::string>& rRankFilePaths, const std::string& rOutputPath);
+
+private:
+    /** A recorded event, already formatted as a JSON object. */
+    static std::vector<std::string> mEvents;
+
+    /** Whether we are recording. */
+    static bool mEnabled;
+
+    /**
+     * @param rString  a string
+     * @return  the string quoted and escaped for inclusion in JSON
+     */
+    static std::string Quote(const std::string& rString);
+};
+
+/**
+ * Records a span with TraceRecorder covering the lifetime of this object, if recording is enabled when it
+ * is created.  Because the span is recorded by the destructor, it is still recorded if an exception is
+ * thrown out of the traced code.
+ */
+class TraceSpan
+{
+public:
+    /**
+     * Start a span.
+     *
+     * @param rName  what is being done
+     * @param rCategory  a category for filtering spans in the trace viewer
+     */
+    TraceSpan(const std::string& rName, const std::string& rCategory);
+
+    /**
+     * Add a detail to show for the span.
+     *
+     * @param rKey  the detail name
+     * @param rValue  its value
+     */
+    void AddArgument(const std::string& rKey, const std::string& rValue);
+
+    /**
+     * End the span and record it.
+     */
+    ~TraceSpan();
+
+private:
+    /** Whether to record this span. */
+    bool mActive;
+
+    /** What is being done. */
+    std::string mName;
+
+    /** The span category. */
+    std::string mCategory;
+
+    /** When the span started. */
+    double mStartTime;
+
+    /** Extra details to show for the span. */
+    std::vector<std::pair<std::string, std::string> > mArguments;
+};
+
+#endif // TRACERECORDER_HPP_
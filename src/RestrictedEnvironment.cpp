@@ -35,9 +35,13 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include "RestrictedEnvironment.hpp"
 
+#include <iomanip>
+#include <sstream>
 #include <typeinfo>
 #include <boost/foreach.hpp>
 #include "BacktraceException.hpp"
+#include "ValueTypes.hpp"
+#include "ProtoHelperMacros.hpp"
 
 typedef std::pair<std::string, AbstractValuePtr> StringValuePair;
 
@@ -48,28 +52,100 @@ RestrictedEnvironment::RestrictedEnvironment(const std::map<std::string,
     BOOST_FOREACH(StringValuePair definition, rInitialDefinitions)
     {
         Environment::DefineName(definition.first, definition.second, "RestrictedEnvironment constructor");
+        DefinitionInfo& r_info = mDefinitionInfo[definition.first];
+        r_info.mIsDouble = definition.second->IsDouble();
+        r_info.mIsArray = definition.second->IsArray();
+        r_info.mpType = &typeid(*definition.second);
+        r_info.mpSlot = NULL;
+        r_info.mBinding = mBindings.find(definition.first);
     }
 }
 
 /**
- * Modify a name-value mapping in the environment.  This checks that the type of the supplied
- * value matches the current definition, then calls the base class method.
+ * Get the handle for a definition, for overwriting it without looking up its name.
+ */
+RestrictedEnvironment::DefinitionHandle RestrictedEnvironment::GetHandle(const std::string& rName)
+{
+    std::map<std::string, DefinitionInfo>::iterator it = mDefinitionInfo.find(rName);
+    if (it == mDefinitionInfo.end())
+    {
+        PROTO_EXCEPTION2("Name " << rName << " is not defined and may not be overwritten.",
+                         "RestrictedEnvironment::GetHandle");
+    }
+    return &it->second;
+}
+
+/**
+ * Modify a name-value mapping in the environment, looking up the name's handle.
  */
 void RestrictedEnvironment::OverwriteDefinition(const std::string& rName, const AbstractValuePtr pValue,
                                                 const std::string& rCallerLocation)
 {
-    std::map<std::string, AbstractValuePtr>::iterator it = mBindings.find(rName);
-    if (it != mBindings.end())
+    std::map<std::string, DefinitionInfo>::iterator it = mDefinitionInfo.find(rName);
+    if (it == mDefinitionInfo.end())
+    {
+        PROTO_EXCEPTION2("Name " << rName << " is not defined and may not be overwritten.",
+                         rCallerLocation);
+    }
+    OverwriteDefinition(&it->second, pValue, rCallerLocation);
+}
+
+/**
+ * Modify a definition through its handle.  The type checks are those of the original environment, but the
+ * common case of a value of the same type is settled by a single comparison.
+ */
+void RestrictedEnvironment::OverwriteDefinition(DefinitionHandle handle, const AbstractValuePtr pValue,
+                                                const std::string& rCallerLocation)
+{
+    const std::type_info& r_type = typeid(*pValue);
+    const bool same_type = (r_type == *handle->mpType);
+    if (!same_type
+        && pValue->IsDouble() != handle->mIsDouble
+        && pValue->IsArray() != handle->mIsArray)
+    {
+        PROTO_EXCEPTION2("New definition for '" << handle->mBinding->first << "' has a different type.",
+                         rCallerLocation);
+    }
+    if (handle->mpSlot)
     {
-        if (!((pValue->IsDouble() == it->second->IsDouble())
-              || (pValue->IsArray() == it->second->IsArray())
-              || (typeid(*pValue) == typeid(*it->second))))
+        // Bound definitions hold simple values, so one of the same type is too
+        if (!same_type && !pValue->IsDouble())
         {
-            PROTO_EXCEPTION2("New definition for '" << rName << "' has a different type.",
-                             rCallerLocation);
+            PROTO_EXCEPTION2("New definition for '" << handle->mBinding->first
+                             << "' is not a simple value, but is bound to a variable.", rCallerLocation);
         }
+        *handle->mpSlot = GET_SIMPLE_VALUE(pValue);
+    }
+    handle->mBinding->second = pValue;
+    if (!same_type)
+    {
+        handle->mIsDouble = pValue->IsDouble();
+        handle->mIsArray = pValue->IsArray();
+        handle->mpType = &r_type;
+    }
+}
+
+/**
+ * Bind a variable to a simple value definition.
+ */
+void RestrictedEnvironment::BindValue(const std::string& rName, double* pSlot)
+{
+    std::map<std::string, DefinitionInfo>::iterator it = mDefinitionInfo.find(rName);
+    if (it == mDefinitionInfo.end())
+    {
+        PROTO_EXCEPTION2("Name " << rName << " is not defined and may not be bound.",
+                         "RestrictedEnvironment::BindValue");
+    }
+    if (pSlot && !it->second.mIsDouble)
+    {
+        PROTO_EXCEPTION2("Only simple values may be bound to a variable, and '" << rName << "' is not one.",
+                         "RestrictedEnvironment::BindValue");
+    }
+    it->second.mpSlot = pSlot;
+    if (pSlot)
+    {
+        *pSlot = GET_SIMPLE_VALUE(it->second.mBinding->second);
     }
-    Environment::OverwriteDefinition(rName, pValue, rCallerLocation);
 }
 
 /**
@@ -90,3 +166,41 @@ void RestrictedEnvironment::RemoveDefinition(const std::string& rName, const std
     PROTO_EXCEPTION2("Definitions may not be removed from a restricted environment.",
                      rCallerLocation);
 }
+
+/**
+ * Describe the current definitions as text, with one "name = value" line per definition in name order.
+ */
+std::string RestrictedEnvironment::GetDefinitionsAsText() const
+{
+    std::stringstream text;
+    text << std::setprecision(17);
+    BOOST_FOREACH(StringValuePair definition, mBindings)
+    {
+        text << definition.first << " =";
+        const AbstractValue* p_value = definition.second.get();
+        if (const SimpleValue* p_simple = dynamic_cast<const SimpleValue*>(p_value))
+        {
+            text << " " << p_simple->GetValue();
+        }
+        else if (const ArrayValue* p_array = dynamic_cast<const ArrayValue*>(p_value))
+        {
+            NdArray<double> array = p_array->GetArray();
+            text << " shape";
+            BOOST_FOREACH(unsigned extent, array.GetShape())
+            {
+                text << " " << extent;
+            }
+            text << " values";
+            for (NdArray<double>::Iterator it = array.Begin(); it != array.End(); ++it)
+            {
+                text << " " << *it;
+            }
+        }
+        else
+        {
+            text << " <" << typeid(*p_value).name() << ">";
+        }
+        text << std::endl;
+    }
+    return text.str();
+}
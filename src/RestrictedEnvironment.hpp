@@ -38,6 +38,7 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <map>
 #include <string>
+#include <typeinfo>
 
 #include "AbstractValue.hpp"
 #include "Environment.hpp"
@@ -47,10 +48,40 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * which are initialised with default values on construction.  Any subsequent
  * assignment to one of these names must also have the same type as the
  * original definition.
+ *
+ * Simple (number) definitions may also be bound to a variable with BindValue,
+ * which is then kept up to date with the definition, so that code using the
+ * parameters can read them directly rather than looking them up by name.
+ *
+ * Each definition's type and binding are resolved once, into a handle.  Code
+ * that sets a definition repeatedly should get its handle once with GetHandle
+ * and overwrite through that; overwriting by name looks the handle up each time.
  */
 class RestrictedEnvironment : public Environment
 {
 public:
+    /** Information about a definition, resolved once so that overwriting it is cheap. */
+    struct DefinitionInfo
+    {
+        /** Whether the current value is a double. */
+        bool mIsDouble;
+
+        /** Whether the current value is an array. */
+        bool mIsArray;
+
+        /** The dynamic type of the current value. */
+        const std::type_info* mpType;
+
+        /** Variable bound to the definition, if any. */
+        double* mpSlot;
+
+        /** The definition's entry in the environment's bindings. */
+        std::map<std::string, AbstractValuePtr>::iterator mBinding;
+    };
+
+    /** A pre-resolved handle to a definition. */
+    typedef DefinitionInfo* DefinitionHandle;
+
     /**
      * Create a new restricted environment.
      *
@@ -60,7 +91,8 @@ public:
 
     /**
      * Modify a name-value mapping in the environment.  This checks that the type of the supplied
-     * value matches the current definition, then calls the base class method.
+     * value matches the current definition, and updates any bound variable.  The name is looked up
+     * on every call; see GetHandle.
      *
      * @param rName
      * @param pValue
@@ -69,6 +101,26 @@ public:
     void OverwriteDefinition(const std::string& rName, const AbstractValuePtr pValue,
                              const std::string& rCallerLocation);
 
+    /**
+     * Modify a definition through its handle, with the same checks as for overwriting it by name.
+     * If the definition is bound to a variable, the new value must be a simple value.
+     *
+     * @param handle  the definition's handle
+     * @param pValue  the new value
+     * @param rCallerLocation  location information to use in error backtrace
+     */
+    void OverwriteDefinition(DefinitionHandle handle, const AbstractValuePtr pValue,
+                             const std::string& rCallerLocation);
+
+    /**
+     * Get the handle for a definition, for overwriting it without looking up its name.  Handles remain
+     * valid for the lifetime of this environment.
+     *
+     * @param rName  the definition name
+     * @return  its handle
+     */
+    DefinitionHandle GetHandle(const std::string& rName);
+
     /**
      * Adding new definitions to a restricted environment is not allowed: this method always throws.
      *
@@ -86,6 +138,29 @@ public:
      * @param rCallerLocation  location information to use in error backtrace
      */
     void RemoveDefinition(const std::string& rName, const std::string& rCallerLocation);
+
+    /**
+     * Describe the current definitions as text, with one "name = value" line per definition in name order.
+     * Numbers are written with enough precision to distinguish any two different values, so the text can be
+     * used to identify the exact parameter set, e.g. as a cache key.
+     *
+     * @return  the description
+     */
+    std::string GetDefinitionsAsText() const;
+
+    /**
+     * Bind a variable to a definition, which must be a simple value.  The variable is set to the current
+     * value, and is updated whenever the definition is overwritten.  The variable must outlive this
+     * environment, or be unbound by binding the name to NULL.
+     *
+     * @param rName  the definition name
+     * @param pSlot  the variable to keep up to date, or NULL to unbind
+     */
+    void BindValue(const std::string& rName, double* pSlot);
+
+private:
+    /** Information about each definition. */
+    std::map<std::string, DefinitionInfo> mDefinitionInfo;
 };
 
 #endif // RESTRICTEDENVIRONMENT_HPP_
@@ -0,0 +1,559 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "CryptJobServer.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <boost/algorithm/string/trim.hpp>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+
+#include "ProcessIsolation.hpp"
+
+// Functional curation includes
+#include "Protocol.hpp"
+#include "ProtocolParser.hpp"
+#include "ValueExpression.hpp"
+#include "ValueTypes.hpp"
+
+// Core Chaste includes
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+#include "Exception.hpp"
+
+/** MPI tag for messages from the master giving a worker the name of its next job. */
+const int CRYPT_JOB_SERVER_JOB_TAG = 5311;
+/** MPI tag for messages from a worker saying whether its job succeeded. */
+const int CRYPT_JOB_SERVER_RESULT_TAG = 5312;
+
+namespace
+{
+/**
+ * Send a job to a worker process.
+ *
+ * @param worker  the worker's rank
+ * @param rJobName  the job's name; empty to tell the worker to stop
+ */
+void SendJobName(unsigned worker, const std::string& rJobName)
+{
+    MPI_Send(const_cast<char*>(rJobName.data()), rJobName.size(), MPI_CHAR, worker,
+             CRYPT_JOB_SERVER_JOB_TAG, PETSC_COMM_WORLD);
+}
+
+/**
+ * Tells a range of worker processes to stop when it goes out of scope, so that they aren't left waiting for
+ * jobs if the master stops serving because of an exception.
+ */
+class WorkerStopper
+{
+private:
+    /** The first worker's rank. */
+    unsigned mFirstWorker;
+
+    /** One past the last worker's rank. */
+    unsigned mEndWorker;
+
+public:
+    /**
+     * Constructor.
+     *
+     * @param firstWorker  the first worker's rank
+     * @param endWorker  one past the last worker's rank
+     */
+    WorkerStopper(unsigned firstWorker, unsigned endWorker)
+        : mFirstWorker(firstWorker),
+          mEndWorker(endWorker)
+    {}
+
+    /** Destructor.  Tells each worker to stop. */
+    ~WorkerStopper()
+    {
+        for (unsigned worker=mFirstWorker; worker<mEndWorker; worker++)
+        {
+            SendJobName(worker, "");
+        }
+    }
+};
+
+/**
+ * Waits for every process when it goes out of scope, so that a process leaving because of an exception doesn't
+ * leave the others waiting for it.
+ */
+class BarrierOnExit
+{
+public:
+    /** Destructor.  Waits for every process. */
+    ~BarrierOnExit()
+    {
+        PetscTools::Barrier("CryptJobServer::Serve");
+    }
+};
+}
+
+
+CryptJobServer::CryptJobServer(const std::string& rJobFolderName)
+    : mJobFolder(rJobFolderName, RelativeTo::ChasteTestOutput),
+      mMaxWorkers(0u),
+      mPollInterval(1.0),
+      mExitWhenIdle(false),
+      mResultCacheMode(ResultCache::BYPASS)
+{
+}
+
+
+void CryptJobServer::SetMaxWorkers(unsigned maxWorkers)
+{
+    mMaxWorkers = maxWorkers;
+}
+
+
+void CryptJobServer::SetPollInterval(double seconds)
+{
+    mPollInterval = seconds;
+}
+
+
+void CryptJobServer::SetExitWhenIdle(bool exitWhenIdle)
+{
+    mExitWhenIdle = exitWhenIdle;
+}
+
+
+void CryptJobServer::SetResultCacheMode(ResultCache::Mode mode)
+{
+    mResultCacheMode = mode;
+}
+
+
+CryptProliferationModel::ModelType CryptJobServer::ParseModelType(const std::string& rName)
+{
+    if (rName == "UNIFORM_WNT")
+    {
+        return CryptProliferationModel::UNIFORM_WNT;
+    }
+    else if (rName == "VARIABLE_WNT")
+    {
+        return CryptProliferationModel::VARIABLE_WNT;
+    }
+    else if (rName == "STOCHASTIC_GEN_BASED")
+    {
+        return CryptProliferationModel::STOCHASTIC_GEN_BASED;
+    }
+    else if (rName != "CONTACT_INHIBITION")
+    {
+        EXCEPTION("Unknown model type '" << rName
+                  << "'; use UNIFORM_WNT, VARIABLE_WNT, STOCHASTIC_GEN_BASED or CONTACT_INHIBITION.");
+    }
+    return CryptProliferationModel::CONTACT_INHIBITION;
+}
+
+
+CryptJobServer::Job CryptJobServer::ParseJobFile(const FileFinder& rJobFile)
+{
+    std::ifstream file(rJobFile.GetAbsolutePath().c_str());
+    if (!file.is_open())
+    {
+        EXCEPTION("Unable to open job file " << rJobFile.GetAbsolutePath());
+    }
+    Job job;
+    bool have_model = false;
+    std::string line;
+    unsigned line_number = 0u;
+    while (std::getline(file, line))
+    {
+        line_number++;
+        line = boost::algorithm::trim_copy(line.substr(0, line.find('#')));
+        if (line.empty())
+        {
+            continue;
+        }
+        std::string::size_type equals = line.find('=');
+        std::string name, value;
+        if (equals != std::string::npos)
+        {
+            name = boost::algorithm::trim_copy(line.substr(0, equals));
+            value = boost::algorithm::trim_copy(line.substr(equals + 1));
+        }
+        if (name.empty() || value.empty())
+        {
+            EXCEPTION("Line " << line_number << " of job file " << rJobFile.GetAbsolutePath()
+                      << " is not of the form 'name = value'.");
+        }
+
+        if (name == "model")
+        {
+            job.mModelType = ParseModelType(value);
+            have_model = true;
+        }
+        else if (name == "protocol")
+        {
+            job.mProtocolPath = value;
+        }
+        else
+        {
+            std::istringstream value_stream(value);
+            double input_value;
+            value_stream >> input_value;
+            if (value_stream.fail() || !value_stream.eof())
+            {
+                EXCEPTION("The value '" << value << "' for protocol input '" << name << "' in job file "
+                          << rJobFile.GetAbsolutePath() << " is not a number.");
+            }
+            job.mInputs[name] = input_value;
+        }
+    }
+    if (!have_model || job.mProtocolPath.empty())
+    {
+        EXCEPTION("Job file " << rJobFile.GetAbsolutePath() << " must give both a model and a protocol.");
+    }
+    return job;
+}
+
+
+FileFinder CryptJobServer::GetSubFolder(const std::string& rSubFolderName) const
+{
+    return FileFinder(rSubFolderName, mJobFolder);
+}
+
+
+void CryptJobServer::RequeueRunningJobs()
+{
+    std::vector<FileFinder> running_jobs = GetSubFolder("running").FindMatches("*.job");
+    BOOST_FOREACH(const FileFinder& r_job, running_jobs)
+    {
+        FileFinder incoming_job(r_job.GetLeafName(), GetSubFolder("incoming"));
+        if (rename(r_job.GetAbsolutePath().c_str(), incoming_job.GetAbsolutePath().c_str()) != 0)
+        {
+            EXCEPTION("Unable to requeue job file " << r_job.GetAbsolutePath());
+        }
+        Log("Requeued job " + r_job.GetLeafNameNoExtension());
+    }
+}
+
+
+bool CryptJobServer::StartNextJob(std::string& rJobName)
+{
+    std::vector<FileFinder> incoming_jobs = GetSubFolder("incoming").FindMatches("*.job");
+    std::vector<std::string> job_names;
+    BOOST_FOREACH(const FileFinder& r_job, incoming_jobs)
+    {
+        job_names.push_back(r_job.GetLeafNameNoExtension());
+    }
+    std::sort(job_names.begin(), job_names.end());
+
+    BOOST_FOREACH(const std::string& r_job_name, job_names)
+    {
+        FileFinder incoming_job(r_job_name + ".job", GetSubFolder("incoming"));
+        FileFinder running_job(r_job_name + ".job", GetSubFolder("running"));
+        // If the move fails the client has withdrawn the job, so try the next one
+        if (rename(incoming_job.GetAbsolutePath().c_str(), running_job.GetAbsolutePath().c_str()) == 0)
+        {
+            rJobName = r_job_name;
+            Log("Started job " + rJobName);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void CryptJobServer::FinishJob(const std::string& rJobName, bool succeeded)
+{
+    FileFinder running_job(rJobName + ".job", GetSubFolder("running"));
+    FileFinder finished_job(rJobName + ".job", GetSubFolder(succeeded ? "done" : "failed"));
+    if (finished_job.Exists())
+    {
+        // Left by an earlier job of the same name
+        finished_job.Remove();
+    }
+    if (rename(running_job.GetAbsolutePath().c_str(), finished_job.GetAbsolutePath().c_str()) != 0)
+    {
+        EXCEPTION("Unable to move job file " << running_job.GetAbsolutePath() << " to "
+                  << finished_job.GetAbsolutePath());
+    }
+    Log((succeeded ? "Finished job " : "Failed job ") + rJobName);
+}
+
+
+void CryptJobServer::Log(const std::string& rMessage)
+{
+    if (mpLog)
+    {
+        // Flushed straight away, so the log can be watched while the server runs
+        *mpLog << rMessage << std::endl;
+    }
+}
+
+
+bool CryptJobServer::IsStopRequested() const
+{
+    return FileFinder("stop", mJobFolder).Exists();
+}
+
+
+void CryptJobServer::Wait() const
+{
+    usleep((useconds_t)(mPollInterval * 1e6));
+}
+
+
+bool CryptJobServer::RunJob(const std::string& rJobName)
+{
+    FileFinder results_folder(rJobName, GetSubFolder("results"));
+    std::string error_message;
+    try
+    {
+        OutputFileHandler results_handler(results_folder);
+        Job job = ParseJobFile(FileFinder(rJobName + ".job", GetSubFolder("running")));
+
+        // Converting a protocol to the form the parser reads is slow, so is only done once per process
+        boost::shared_ptr<ProtocolFileFinder>& rp_protocol_file = mProtocols[job.mProtocolPath];
+        if (!rp_protocol_file)
+        {
+            rp_protocol_file.reset(new ProtocolFileFinder(job.mProtocolPath, RelativeTo::AbsoluteOrCwd));
+        }
+
+        boost::shared_ptr<CryptProliferationModel> p_model(new CryptProliferationModel(job.mModelType));
+        p_model->SetResultCache(mResultCacheMode);
+        ProtocolParser parser;
+        ProtocolPtr p_protocol = parser.ParseFile(*rp_protocol_file);
+        p_protocol->SetOutputFolder(results_handler);
+        p_protocol->SetModel(p_model);
+        typedef std::pair<std::string, double> StringDoublePair;
+        BOOST_FOREACH(StringDoublePair input, job.mInputs)
+        {
+            p_protocol->SetInput(input.first, boost::make_shared<ValueExpression>(boost::make_shared<SimpleValue>(input.second)));
+        }
+        p_protocol->RunAndWrite("outputs");
+        return true;
+    }
+    catch (const Exception& r_error)
+    {
+        error_message = r_error.GetMessage();
+    }
+    catch (const std::exception& r_error)
+    {
+        // Not everything the simulation uses reports errors as Chaste exceptions
+        error_message = r_error.what();
+    }
+    try
+    {
+        OutputFileHandler results_handler(results_folder, false);
+        out_stream p_error_file = results_handler.OpenOutputFile("error.txt");
+        *p_error_file << error_message << std::endl;
+        p_error_file->close();
+    }
+    catch (const Exception& r_error)
+    {
+        // The failure is still recorded by the job file moving to failed/
+        std::cerr << error_message << std::endl << r_error.GetMessage() << std::endl;
+    }
+    return false;
+}
+
+
+unsigned CryptJobServer::Serve()
+{
+    // Keep any jobs which were submitted before we started
+    const char* sub_folders[] = {"incoming", "running", "results", "done", "failed"};
+    for (unsigned i=0; i<sizeof(sub_folders)/sizeof(sub_folders[0]); i++)
+    {
+        OutputFileHandler handler(GetSubFolder(sub_folders[i]), false);
+    }
+    OutputFileHandler job_folder_handler(mJobFolder, false);
+    if (PetscTools::AmMaster())
+    {
+        mpLog = job_folder_handler.OpenOutputFile("server_log.txt", std::ios::out | std::ios::app);
+    }
+
+    unsigned num_finished = 0u;
+    {
+        // Processes serve separate jobs, so none may take part in a distributed simulation
+        ProcessIsolation::SeparateJobsGuard separate_jobs;
+        if (!PetscTools::IsParallel())
+        {
+            RequeueRunningJobs();
+            num_finished = ServeSequentially();
+        }
+        else
+        {
+            // Declared first, so that processes are no longer isolated when it waits
+            BarrierOnExit barrier;
+            // Jobs must be able to write output files etc. independently of other processes
+            ProcessIsolation::IsolationGuard isolated;
+            if (PetscTools::GetMyRank() == 0)
+            {
+                RequeueRunningJobs();
+                num_finished = ServeMaster();
+            }
+            else
+            {
+                ServeWorker();
+            }
+        }
+    }
+    if (mpLog)
+    {
+        mpLog->close();
+        mpLog.reset();
+    }
+    return num_finished;
+}
+
+
+unsigned CryptJobServer::ServeSequentially()
+{
+    unsigned num_finished = 0u;
+    while (!IsStopRequested())
+    {
+        std::string job_name;
+        if (StartNextJob(job_name))
+        {
+            FinishJob(job_name, RunJob(job_name));
+            num_finished++;
+        }
+        else if (mExitWhenIdle)
+        {
+            break;
+        }
+        else
+        {
+            Wait();
+        }
+    }
+    return num_finished;
+}
+
+
+unsigned CryptJobServer::ServeMaster()
+{
+    const unsigned num_procs = PetscTools::GetNumProcs();
+    unsigned num_workers = num_procs - 1u;
+    if (mMaxWorkers > 0u)
+    {
+        num_workers = std::min(num_workers, mMaxWorkers);
+    }
+    // Processes beyond the limit aren't needed
+    for (unsigned worker=num_workers+1u; worker<num_procs; worker++)
+    {
+        SendJobName(worker, "");
+    }
+    // However we leave, the workers must be told to stop
+    WorkerStopper workers(1u, num_workers+1u);
+
+    // The job each worker is running, indexed by rank; empty if it is free
+    std::vector<std::string> running_jobs(num_workers + 1u);
+    unsigned num_busy_workers = 0u;
+    unsigned num_finished = 0u;
+    bool stopping = false;
+    while (true)
+    {
+        bool made_progress = false;
+
+        // Record any jobs which have finished
+        int result_waiting;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, CRYPT_JOB_SERVER_RESULT_TAG, PETSC_COMM_WORLD, &result_waiting, &status);
+        while (result_waiting)
+        {
+            unsigned succeeded;
+            MPI_Recv(&succeeded, 1, MPI_UNSIGNED, status.MPI_SOURCE, CRYPT_JOB_SERVER_RESULT_TAG,
+                     PETSC_COMM_WORLD, &status);
+            FinishJob(running_jobs[status.MPI_SOURCE], succeeded != 0u);
+            running_jobs[status.MPI_SOURCE].clear();
+            num_busy_workers--;
+            num_finished++;
+            made_progress = true;
+            MPI_Iprobe(MPI_ANY_SOURCE, CRYPT_JOB_SERVER_RESULT_TAG, PETSC_COMM_WORLD, &result_waiting, &status);
+        }
+
+        // Give free workers the next jobs, unless we've been told to stop
+        stopping = stopping || IsStopRequested();
+        bool no_jobs_waiting = false;
+        for (unsigned worker=1u; !stopping && worker<=num_workers; worker++)
+        {
+            if (running_jobs[worker].empty())
+            {
+                if (!StartNextJob(running_jobs[worker]))
+                {
+                    no_jobs_waiting = true;
+                    break;
+                }
+                SendJobName(worker, running_jobs[worker]);
+                num_busy_workers++;
+                made_progress = true;
+            }
+        }
+
+        if (num_busy_workers == 0u && (stopping || (mExitWhenIdle && no_jobs_waiting)))
+        {
+            break;
+        }
+        if (!made_progress)
+        {
+            Wait();
+        }
+    }
+    return num_finished;
+}
+
+
+void CryptJobServer::ServeWorker()
+{
+    while (true)
+    {
+        MPI_Status status;
+        MPI_Probe(0, CRYPT_JOB_SERVER_JOB_TAG, PETSC_COMM_WORLD, &status);
+        int name_length;
+        MPI_Get_count(&status, MPI_CHAR, &name_length);
+        // Allow for an empty name, which tells us to stop
+        std::vector<char> job_name(name_length + 1);
+        MPI_Recv(&job_name[0], name_length, MPI_CHAR, 0, CRYPT_JOB_SERVER_JOB_TAG, PETSC_COMM_WORLD, &status);
+        if (name_length == 0)
+        {
+            break;
+        }
+
+        unsigned succeeded = RunJob(std::string(job_name.begin(), job_name.begin() + name_length)) ? 1u : 0u;
+        MPI_Send(&succeeded, 1, MPI_UNSIGNED, 0, CRYPT_JOB_SERVER_RESULT_TAG, PETSC_COMM_WORLD);
+    }
+}
@@ -0,0 +1,244 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef CRYPTJOBSERVER_HPP_
+#define CRYPTJOBSERVER_HPP_
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+
+#include "CryptProliferationModel.hpp"
+#include "ResultCache.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "ProtocolFileFinder.hpp"
+
+/**
+ * A long-running server for crypt simulation jobs, so that many short jobs needn't each pay for process
+ * start-up, PETSc initialisation and protocol conversion.
+ *
+ * Jobs are submitted as files in a job folder, which has the sub-folders:
+ *  - incoming/  where clients place job files, named <name>.job; these should be written elsewhere and then
+ *    renamed into place, so that the server never sees a partial file.  Jobs are started in order of name.
+ *  - running/  to which the server moves each job file when it starts the job.
+ *  - results/<name>/  where each job's protocol outputs are written.  While the simulation runs, the model's
+ *    status file (see the progress_interval parameter) shows how far it has got, under raw_results0/.
+ *  - done/ and failed/  to which each job file is moved once its results are complete, or the job has failed;
+ *    failed jobs also leave error.txt in their results folder.
+ * The master process appends a line to server_log.txt in the job folder as each job starts and finishes.
+ * Creating a file named 'stop' in the job folder makes the server exit once any jobs it is running finish.
+ *
+ * Each job file has a line 'name = value' for each setting, and may contain blank lines and comments
+ * starting with '#'.  The settings are 'model', giving the CryptProliferationModel::ModelType by name (e.g.
+ * CONTACT_INHIBITION), 'protocol', giving the protocol file's path (absolute or relative to the current
+ * directory), and any number of protocol inputs to override, with numerical values.
+ *
+ * When run in parallel, the master process hands jobs to the other processes as they become free, in the same
+ * way as DynamicJobQueue, so up to one job per worker process runs at once.  Chaste's simulation singletons are
+ * global to a process, so the worker processes play the part of warm worker threads.  Each worker converts each
+ * protocol it is given only once.  When run sequentially the one process runs jobs in turn.
+ *
+ * Only one server should serve a job folder at a time.  Jobs left in running/ by a server that was killed are
+ * moved back to incoming/ when the next server starts.
+ */
+class CryptJobServer
+{
+public:
+    /** A job read from a job file. */
+    struct Job
+    {
+        /** Which model to run. */
+        CryptProliferationModel::ModelType mModelType;
+
+        /** Path to the protocol to run. */
+        std::string mProtocolPath;
+
+        /** Protocol inputs to override. */
+        std::map<std::string, double> mInputs;
+    };
+
+    /**
+     * Create a server.
+     *
+     * @param rJobFolderName  the job folder, relative to CHASTE_TEST_OUTPUT; it is created if need be, but not
+     *     cleaned
+     */
+    CryptJobServer(const std::string& rJobFolderName);
+
+    /**
+     * Limit how many jobs run at once.  By default every process other than the master runs jobs.
+     *
+     * @param maxWorkers  the most worker processes to use; zero for no limit
+     */
+    void SetMaxWorkers(unsigned maxWorkers);
+
+    /**
+     * Set how often to look for new jobs when there is nothing else to do.  The default is one second.
+     *
+     * @param seconds  the time between looking in the incoming folder
+     */
+    void SetPollInterval(double seconds);
+
+    /**
+     * Set whether to exit as soon as there are no jobs running or waiting, rather than waiting for a stop file.
+     * This suits working through a batch of jobs submitted beforehand.
+     *
+     * @param exitWhenIdle  whether to exit when idle
+     */
+    void SetExitWhenIdle(bool exitWhenIdle);
+
+    /**
+     * Set how each job's model should use the on-disk result cache; see CryptProliferationModel::SetResultCache.
+     * By default the cache is bypassed.
+     *
+     * @param mode  the cache mode
+     */
+    void SetResultCacheMode(ResultCache::Mode mode);
+
+    /**
+     * Run jobs until told to stop.  This is a collective operation.
+     *
+     * @return  on the master process, the number of jobs finished, whether or not they succeeded
+     */
+    unsigned Serve();
+
+    /**
+     * Run a single job from the running folder, writing its results.  This is called on whichever process the
+     * job has been given to.
+     *
+     * @param rJobName  the job's name
+     * @return  whether the job succeeded
+     */
+    bool RunJob(const std::string& rJobName);
+
+    /**
+     * Read a job file.
+     *
+     * @param rJobFile  the file
+     * @return  the job it describes
+     */
+    static Job ParseJobFile(const FileFinder& rJobFile);
+
+    /**
+     * @param rName  the name of a model type, as in the enumeration
+     * @return  the model type
+     */
+    static CryptProliferationModel::ModelType ParseModelType(const std::string& rName);
+
+private:
+    /** The job folder. */
+    FileFinder mJobFolder;
+
+    /** The most worker processes to use, or zero for no limit. */
+    unsigned mMaxWorkers;
+
+    /** Seconds between looking for new jobs when idle. */
+    double mPollInterval;
+
+    /** Whether to exit when there are no jobs to run. */
+    bool mExitWhenIdle;
+
+    /** How jobs should use the result cache. */
+    ResultCache::Mode mResultCacheMode;
+
+    /** Protocols converted so far by this process, by path, to be reused by later jobs. */
+    std::map<std::string, boost::shared_ptr<ProtocolFileFinder> > mProtocols;
+
+    /** The server log, open on the master process while serving. */
+    out_stream mpLog;
+
+    /**
+     * @param rSubFolderName  the name of a sub-folder of the job folder
+     * @return  the sub-folder
+     */
+    FileFinder GetSubFolder(const std::string& rSubFolderName) const;
+
+    /**
+     * Move any jobs left running by an earlier server back to the incoming folder.  Called on the master.
+     */
+    void RequeueRunningJobs();
+
+    /**
+     * Move the next incoming job to the running folder.  Called on the master.
+     *
+     * @param rJobName  set to the job's name, if there is one
+     * @return  whether there was a job to start
+     */
+    bool StartNextJob(std::string& rJobName);
+
+    /**
+     * Move a job from the running folder to the done or failed folder.  Called on the master.
+     *
+     * @param rJobName  the job
+     * @param succeeded  whether it succeeded
+     */
+    void FinishJob(const std::string& rJobName, bool succeeded);
+
+    /**
+     * Write a line to the server log, if this process has it open.
+     *
+     * @param rMessage  the line
+     */
+    void Log(const std::string& rMessage);
+
+    /** @return  whether a stop file has been created. */
+    bool IsStopRequested() const;
+
+    /** Wait for the poll interval. */
+    void Wait() const;
+
+    /**
+     * Serve jobs on the one process.
+     *
+     * @return  the number of jobs finished
+     */
+    unsigned ServeSequentially();
+
+    /**
+     * The master side of a parallel server: hand out jobs and record when they finish.
+     *
+     * @return  the number of jobs finished
+     */
+    unsigned ServeMaster();
+
+    /** The worker side of a parallel server: run jobs until told to stop. */
+    void ServeWorker();
+};
+
+#endif // CRYPTJOBSERVER_HPP_
@@ -0,0 +1,702 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "CryptSweepRunner.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdlib>
+#include <set>
+#include <sstream>
+#include <iomanip>
+#include <boost/foreach.hpp>
+#include <boost/make_shared.hpp>
+
+// Functional curation includes
+#include "Protocol.hpp"
+#include "ProtocolParser.hpp"
+#include "ValueExpression.hpp"
+#include "ValueTypes.hpp"
+#include "NdArray.hpp"
+#include "ProtoHelperMacros.hpp"
+
+// Core Chaste includes
+#include "PetscTools.hpp"
+#include "Warnings.hpp"
+
+#include "TraceRecorder.hpp"
+#include "ProcessIsolation.hpp"
+
+CryptSweepRunner::CryptSweepRunner(const ProtocolFileFinder& rProtocol,
+                                   const std::string& rOutputFolderName,
+                                   const std::vector<CryptProliferationModel::ModelType>& rModelTypes)
+    : mProtocol(rProtocol),
+      mOutputFolderName(rOutputFolderName),
+      mModelTypes(rModelTypes),
+      mCopyPlots(false),
+      mRecordTrace(false),
+      mResultCacheMode(ResultCache::BYPASS),
+      mAdaptive(false),
+      mBudget(0.0),
+      mMaxPointsPerRound(0u),
+      mMinSpacing(0.0),
+      mTolerance(0.0)
+{
+}
+
+
+void CryptSweepRunner::AddSweepAxis(const std::string& rInputName, const std::string& rOutputName,
+                                    const std::string& rDescription, const std::vector<double>& rValues,
+                                    bool costScalesWithValue)
+{
+    if (rValues.empty())
+    {
+        EXCEPTION("Sweep axis for input '" << rInputName << "' has no values.");
+    }
+    SweepAxis axis;
+    axis.mInputName = rInputName;
+    axis.mOutputName = rOutputName;
+    axis.mDescription = rDescription;
+    axis.mValues = rValues;
+    axis.mCostScalesWithValue = costScalesWithValue;
+    mAxes.push_back(axis);
+}
+
+
+void CryptSweepRunner::SetProtocolInputs(const std::map<std::string, double>& rProtocolInputs)
+{
+    mProtocolInputs = rProtocolInputs;
+}
+
+
+void CryptSweepRunner::SetPlotTitle(CryptProliferationModel::ModelType modelType, const std::string& rTitle)
+{
+    mPlotTitles[modelType] = rTitle;
+}
+
+
+void CryptSweepRunner::SetGnuplotTerminal(const std::string& rTerminal)
+{
+    mGnuplotTerminal = rTerminal;
+}
+
+
+void CryptSweepRunner::SetCopyPlots(bool copyPlots)
+{
+    mCopyPlots = copyPlots;
+}
+
+
+void CryptSweepRunner::SetRecordTrace(bool recordTrace)
+{
+    mRecordTrace = recordTrace;
+}
+
+
+void CryptSweepRunner::SetResultCacheMode(ResultCache::Mode mode)
+{
+    mResultCacheMode = mode;
+}
+
+
+void CryptSweepRunner::SetAdaptiveRefinement(double budget, unsigned maxPointsPerRound, double minSpacing,
+                                             double tolerance)
+{
+    mAdaptive = true;
+    mBudget = budget;
+    mMaxPointsPerRound = maxPointsPerRound;
+    mMinSpacing = minSpacing;
+    mTolerance = tolerance;
+}
+
+
+std::string CryptSweepRunner::GetModelFolderName(CryptProliferationModel::ModelType modelType)
+{
+    std::string folder_name = CryptProliferationModel::GetModelName(modelType);
+    FileFinder::ReplaceSpacesWithUnderscores(folder_name);
+    return folder_name;
+}
+
+
+unsigned CryptSweepRunner::GetNumPoints() const
+{
+    unsigned num_points = 1u;
+    BOOST_FOREACH(const SweepAxis& r_axis, mAxes)
+    {
+        num_points *= r_axis.mValues.size();
+    }
+    return num_points;
+}
+
+
+std::map<std::string, double> CryptSweepRunner::GetPointInputs(unsigned pointIndex) const
+{
+    std::map<std::string, double> inputs;
+    for (unsigned i=mAxes.size(); i-- > 0; )
+    {
+        const std::vector<double>& r_values = mAxes[i].mValues;
+        inputs[mAxes[i].mInputName] = r_values[pointIndex % r_values.size()];
+        pointIndex /= r_values.size();
+    }
+    return inputs;
+}
+
+
+std::string CryptSweepRunner::GetJobFolderName(unsigned jobIndex) const
+{
+    unsigned point_index = jobIndex % GetNumPoints();
+    std::stringstream folder;
+    folder << mOutputFolderName << "/" << GetModelFolderName(mModelTypes[jobIndex / GetNumPoints()]);
+    if (!mAxes.empty())
+    {
+        std::map<std::string, double> point_inputs = GetPointInputs(point_index);
+        folder << "/";
+        for (unsigned i=0; i<mAxes.size(); i++)
+        {
+            folder << (i == 0 ? "" : "_") << mAxes[i].mInputName << "_" << point_inputs[mAxes[i].mInputName];
+        }
+    }
+    return folder.str();
+}
+
+
+unsigned CryptSweepRunner::GetNumJobs() const
+{
+    return mModelTypes.size() * GetNumPoints();
+}
+
+
+double CryptSweepRunner::GetJobCost(unsigned jobIndex) const
+{
+    double cost = 1.0;
+    std::map<std::string, double> point_inputs = GetPointInputs(jobIndex % GetNumPoints());
+    BOOST_FOREACH(const SweepAxis& r_axis, mAxes)
+    {
+        if (r_axis.mCostScalesWithValue)
+        {
+            cost *= point_inputs[r_axis.mInputName];
+        }
+    }
+    return cost;
+}
+
+
+std::vector<double> CryptSweepRunner::RunJob(unsigned jobIndex)
+{
+    CryptProliferationModel::ModelType model_type = mModelTypes[jobIndex / GetNumPoints()];
+    TraceSpan job_span("job", "sweep");
+    job_span.AddArgument("model", CryptProliferationModel::GetModelName(model_type));
+    job_span.AddArgument("folder", GetJobFolderName(jobIndex));
+    OutputFileHandler job_handler(GetJobFolderName(jobIndex));
+
+    // Each job builds its own model instance and protocol
+    boost::shared_ptr<CryptProliferationModel> p_model(new CryptProliferationModel(model_type));
+    p_model->SetResultCache(mResultCacheMode);
+    ProtocolPtr p_protocol;
+    {
+        TraceSpan parse_span("parse_protocol", "sweep");
+        ProtocolParser parser;
+        p_protocol = parser.ParseFile(mProtocol);
+    }
+    p_protocol->SetOutputFolder(job_handler);
+    p_protocol->SetModel(p_model);
+
+    std::map<std::string, double> inputs(mProtocolInputs);
+    std::map<std::string, double> point_inputs = GetPointInputs(jobIndex % GetNumPoints());
+    inputs.insert(point_inputs.begin(), point_inputs.end());
+    typedef std::pair<std::string, double> StringDoublePair;
+    BOOST_FOREACH(StringDoublePair input, inputs)
+    {
+        p_protocol->SetInput(input.first, boost::make_shared<ValueExpression>(boost::make_shared<SimpleValue>(input.second)));
+    }
+
+    // Plots made by the protocol itself are only wanted when it isn't being swept over
+    if (mAxes.empty())
+    {
+        BOOST_FOREACH(PlotSpecificationPtr p_plot_spec, p_protocol->rGetPlotSpecifications())
+        {
+            if (mPlotTitles.find(model_type) != mPlotTitles.end())
+            {
+                p_plot_spec->SetDisplayTitle(mPlotTitles[model_type]);
+            }
+            if (!mGnuplotTerminal.empty())
+            {
+                p_plot_spec->SetGnuplotTerminal(mGnuplotTerminal);
+            }
+        }
+    }
+
+    {
+        // The model records its own spans for simulation and output retrieval; the rest is post-processing
+        TraceSpan run_span("run_protocol", "sweep");
+        p_protocol->RunAndWrite("outputs");
+    }
+
+    std::vector<double> results;
+    if (!mAxes.empty())
+    {
+        // Extract the division histogram
+        const Environment& r_outputs = p_protocol->rGetOutputsCollection();
+        NdArray<double> freqs = GET_ARRAY(r_outputs.Lookup("freqs", "CryptSweepRunner::RunJob"));
+        results.assign(freqs.Begin(), freqs.End());
+    }
+    return results;
+}
+
+
+bool CryptSweepRunner::Run()
+{
+    // Create (and clean) the main output folder
+    OutputFileHandler handler(mOutputFolderName);
+
+    if (mRecordTrace)
+    {
+        TraceRecorder::Enable();
+    }
+    std::set<unsigned> failed_models;
+    std::vector<std::vector<double> > results;
+    if (mAdaptive)
+    {
+        results = RunAdaptive(failed_models);
+    }
+    else
+    {
+        DynamicJobQueue queue;
+        results = queue.Run(*this);
+        ReportFailedJobs(queue.rGetFailedJobs(), failed_models);
+    }
+    if (mRecordTrace)
+    {
+        TraceRecorder::Disable();
+        WriteTrace(handler);
+    }
+
+    bool all_succeeded = failed_models.empty();
+    if (PetscTools::GetMyRank() == 0)
+    {
+        // Only the master writes the combined outputs, so output file handlers mustn't wait for other processes
+        ProcessIsolation::IsolationGuard isolated;
+        for (unsigned model_index=0; model_index<mModelTypes.size(); model_index++)
+        {
+            if (failed_models.find(model_index) != failed_models.end())
+            {
+                // Don't write partial outputs for this model
+                continue;
+            }
+            if (!mAxes.empty())
+            {
+                WriteModelOutputs(model_index, results);
+            }
+            if (mCopyPlots)
+            {
+                CopyModelPlots(mModelTypes[model_index]);
+            }
+        }
+    }
+    PetscTools::Barrier("CryptSweepRunner::Run");
+    return all_succeeded;
+}
+
+
+void CryptSweepRunner::ReportFailedJobs(const std::vector<unsigned>& rFailedJobs,
+                                        std::set<unsigned>& rFailedModels) const
+{
+    BOOST_FOREACH(unsigned job, rFailedJobs)
+    {
+        std::cerr << "Job for " << CryptProliferationModel::GetModelName(mModelTypes[job / GetNumPoints()])
+                  << " in " << GetJobFolderName(job) << " failed." << std::endl;
+        rFailedModels.insert(job / GetNumPoints());
+    }
+}
+
+
+std::vector<std::vector<double> > CryptSweepRunner::RunAdaptive(std::set<unsigned>& rFailedModels)
+{
+    if (mAxes.size() != 1u)
+    {
+        EXCEPTION("Adaptive sweep refinement needs exactly one sweep axis.");
+    }
+    SweepAxis& r_axis = mAxes[0];
+    const unsigned num_models = mModelTypes.size();
+    unsigned max_points_per_round = mMaxPointsPerRound;
+    if (max_points_per_round == 0u)
+    {
+        // Enough points to give every worker process a job
+        unsigned num_workers = std::max(1u, PetscTools::GetNumProcs() - 1u);
+        max_points_per_round = std::max(1u, num_workers / num_models);
+    }
+
+    // Every process keeps track of the points run, so they agree on the jobs in each round
+    std::vector<double> all_values;
+    std::vector<double> all_rounds;
+    // On the master, the histogram for each model at each point run so far
+    std::vector<std::map<double, std::vector<double> > > model_results(num_models);
+    double cost_used = 0.0;
+
+    std::vector<double> new_values(r_axis.mValues);
+    std::sort(new_values.begin(), new_values.end());
+    new_values.erase(std::unique(new_values.begin(), new_values.end()), new_values.end());
+    for (unsigned round=0; !new_values.empty(); round++)
+    {
+        TraceSpan round_span("refinement_round", "sweep");
+        r_axis.mValues = new_values;
+        for (unsigned job=0; job<GetNumJobs(); job++)
+        {
+            cost_used += GetJobCost(job);
+        }
+        all_values.insert(all_values.end(), new_values.begin(), new_values.end());
+        all_rounds.insert(all_rounds.end(), new_values.size(), round);
+
+        DynamicJobQueue queue;
+        std::vector<std::vector<double> > results = queue.Run(*this);
+        new_values.clear();
+        if (PetscTools::GetMyRank() == 0)
+        {
+            ReportFailedJobs(queue.rGetFailedJobs(), rFailedModels);
+            for (unsigned job=0; job<results.size(); job++)
+            {
+                model_results[job / GetNumPoints()][r_axis.mValues[job % GetNumPoints()]] = results[job];
+            }
+
+            // Score intervals using the models which have run successfully throughout
+            std::vector<double> values(all_values);
+            std::sort(values.begin(), values.end());
+            std::vector<std::vector<std::vector<double> > > norm_freqs;
+            for (unsigned model_index=0; model_index<num_models; model_index++)
+            {
+                if (rFailedModels.find(model_index) == rFailedModels.end())
+                {
+                    norm_freqs.push_back(std::vector<std::vector<double> >());
+                    BOOST_FOREACH(double value, values)
+                    {
+                        norm_freqs.back().push_back(NormaliseHistogram(model_results[model_index][value]));
+                    }
+                }
+            }
+            std::vector<double> candidates = ChooseRefinementPoints(values, norm_freqs, max_points_per_round,
+                                                                    mMinSpacing, mTolerance);
+
+            // Take the most promising points that fit within the budget
+            double round_cost = 0.0;
+            BOOST_FOREACH(double value, candidates)
+            {
+                double point_cost = num_models * (r_axis.mCostScalesWithValue ? value : 1.0);
+                if (cost_used + round_cost + point_cost <= mBudget)
+                {
+                    new_values.push_back(value);
+                    round_cost += point_cost;
+                }
+            }
+        }
+
+        // Tell every process which points to run next
+        if (PetscTools::IsParallel())
+        {
+            unsigned num_new_values = new_values.size();
+            MPI_Bcast(&num_new_values, 1, MPI_UNSIGNED, 0, PETSC_COMM_WORLD);
+            new_values.resize(num_new_values);
+            if (num_new_values > 0u)
+            {
+                MPI_Bcast(&new_values[0], num_new_values, MPI_DOUBLE, 0, PETSC_COMM_WORLD);
+            }
+        }
+    }
+
+    // Present the results as for a fixed sweep over every point run
+    std::map<double, double> point_rounds;
+    for (unsigned i=0; i<all_values.size(); i++)
+    {
+        point_rounds[all_values[i]] = all_rounds[i];
+    }
+    r_axis.mValues.clear();
+    mPointRounds.clear();
+    typedef std::pair<double, double> DoublePair;
+    BOOST_FOREACH(DoublePair point, point_rounds)
+    {
+        r_axis.mValues.push_back(point.first);
+        mPointRounds.push_back(point.second);
+    }
+    std::vector<std::vector<double> > results(GetNumJobs());
+    if (PetscTools::GetMyRank() == 0)
+    {
+        for (unsigned job=0; job<results.size(); job++)
+        {
+            results[job] = model_results[job / GetNumPoints()][r_axis.mValues[job % GetNumPoints()]];
+        }
+    }
+    return results;
+}
+
+
+std::vector<double> CryptSweepRunner::ChooseRefinementPoints(const std::vector<double>& rValues,
+                                                             const std::vector<std::vector<std::vector<double> > >& rNormFreqs,
+                                                             unsigned maxNumPoints, double minSpacing, double tolerance)
+{
+    // Score each interval by the largest change in any box of any model's histogram across it
+    std::multimap<double, double> midpoints_by_score;
+    for (unsigned i=0; i+1<rValues.size(); i++)
+    {
+        double midpoint = (rValues[i] + rValues[i+1])/2;
+        if (midpoint - rValues[i] < minSpacing || midpoint == rValues[i] || midpoint == rValues[i+1])
+        {
+            continue;
+        }
+        double score = 0.0;
+        BOOST_FOREACH(const std::vector<std::vector<double> >& r_model_freqs, rNormFreqs)
+        {
+            const std::vector<double>& r_lower = r_model_freqs[i];
+            const std::vector<double>& r_upper = r_model_freqs[i+1];
+            if (r_lower.size() != r_upper.size())
+            {
+                EXCEPTION("Inconsistent histogram sizes in adaptive sweep refinement.");
+            }
+            for (unsigned box=0; box<r_lower.size(); box++)
+            {
+                score = std::max(score, fabs(r_upper[box] - r_lower[box]));
+            }
+        }
+        if (score > tolerance)
+        {
+            midpoints_by_score.insert(std::make_pair(score, midpoint));
+        }
+    }
+
+    std::vector<double> points;
+    for (std::multimap<double, double>::reverse_iterator it = midpoints_by_score.rbegin();
+         it != midpoints_by_score.rend() && points.size() < maxNumPoints;
+         ++it)
+    {
+        points.push_back(it->second);
+    }
+    return points;
+}
+
+
+std::vector<double> CryptSweepRunner::NormaliseHistogram(const std::vector<double>& rFreqs)
+{
+    double total = 0.0;
+    BOOST_FOREACH(double freq, rFreqs)
+    {
+        total += freq;
+    }
+    std::vector<double> norm_freqs(rFreqs.size(), 0.0);
+    if (total > 0.0)
+    {
+        for (unsigned i=0; i<rFreqs.size(); i++)
+        {
+            norm_freqs[i] = rFreqs[i]/total*100;
+        }
+    }
+    return norm_freqs;
+}
+
+
+void CryptSweepRunner::WriteModelOutputs(unsigned modelIndex, const std::vector<std::vector<double> >& rResults)
+{
+    CryptProliferationModel::ModelType model_type = mModelTypes[modelIndex];
+    OutputFileHandler handler(mOutputFolderName + "/" + GetModelFolderName(model_type), false);
+    const unsigned num_points = GetNumPoints();
+    const unsigned num_boxes = rResults[modelIndex*num_points].size();
+
+    // Assemble the [num_points, num_boxes] histogram array, and normalise it
+    std::vector<double> freqs;
+    std::vector<double> norm_freqs;
+    for (unsigned i=0; i<num_points; i++)
+    {
+        const std::vector<double>& r_job_freqs = rResults[modelIndex*num_points + i];
+        if (r_job_freqs.size() != num_boxes)
+        {
+            EXCEPTION("Inconsistent histogram sizes for " << CryptProliferationModel::GetModelName(model_type) << ".");
+        }
+        std::vector<double> job_norm_freqs = NormaliseHistogram(r_job_freqs);
+        freqs.insert(freqs.end(), r_job_freqs.begin(), r_job_freqs.end());
+        norm_freqs.insert(norm_freqs.end(), job_norm_freqs.begin(), job_norm_freqs.end());
+    }
+
+    std::vector<double> centres_percent(num_boxes);
+    for (unsigned box=0; box<num_boxes; box++)
+    {
+        centres_percent[box] = (100.0/num_boxes)*(box+0.5);
+    }
+
+    std::vector<unsigned> shape_2d(2);
+    shape_2d[0] = num_points;
+    shape_2d[1] = num_boxes;
+    std::vector<unsigned> shape_boxes(1, num_boxes);
+    WriteOutputArray(handler, "outputs_freqs.csv", "Number of divisions per box", shape_2d, freqs);
+    WriteOutputArray(handler, "outputs_norm_freqs.csv", "Percentage of divisions per box", shape_2d, norm_freqs);
+    WriteOutputArray(handler, "outputs_centres_percent.csv", "Percentage height up the crypt", shape_boxes, centres_percent);
+    BOOST_FOREACH(const SweepAxis& r_axis, mAxes)
+    {
+        std::vector<unsigned> shape_axis(1, r_axis.mValues.size());
+        WriteOutputArray(handler, "outputs_" + r_axis.mOutputName + ".csv", r_axis.mDescription, shape_axis, r_axis.mValues);
+    }
+    if (mAdaptive)
+    {
+        WriteOutputArray(handler, "outputs_refinement_round.csv", "Adaptive refinement round in which each point was run",
+                         std::vector<unsigned>(1, num_points), mPointRounds);
+    }
+
+    std::string title = CryptProliferationModel::GetModelName(model_type);
+    if (mPlotTitles.find(model_type) != mPlotTitles.end())
+    {
+        title = mPlotTitles[model_type];
+    }
+    PlotModelOutputs(handler, title, norm_freqs, centres_percent);
+}
+
+
+void CryptSweepRunner::WriteTrace(OutputFileHandler& rHandler)
+{
+    const std::string full_path = rHandler.GetOutputDirectoryFullPath();
+    std::vector<std::string> rank_files;
+    for (unsigned rank=0; rank<PetscTools::GetNumProcs(); rank++)
+    {
+        std::stringstream file_name;
+        file_name << full_path << "trace_rank" << rank << ".json";
+        rank_files.push_back(file_name.str());
+    }
+    TraceRecorder::WriteRankFile(rank_files[PetscTools::GetMyRank()]);
+    PetscTools::Barrier("CryptSweepRunner::WriteTrace");
+    if (PetscTools::GetMyRank() == 0)
+    {
+        TraceRecorder::MergeRankFiles(rank_files, full_path + "trace.json");
+    }
+}
+
+
+void CryptSweepRunner::CopyModelPlots(CryptProliferationModel::ModelType modelType)
+{
+    std::string folder_name = GetModelFolderName(modelType);
+    OutputFileHandler main_handler(mOutputFolderName, false);
+    BOOST_FOREACH(FileFinder graph, main_handler.FindFile(folder_name).FindMatches("*.eps"))
+    {
+        graph.CopyTo(main_handler.FindFile(folder_name + "-" + graph.GetLeafName()));
+    }
+}
+
+
+void CryptSweepRunner::PlotModelOutputs(OutputFileHandler& rHandler, const std::string& rTitle,
+                                        const std::vector<double>& rNormFreqs, const std::vector<double>& rCentres)
+{
+    const std::string base_name = "outputs_Cell_division_locations";
+    const std::string full_path = rHandler.GetOutputDirectoryFullPath();
+    const unsigned num_boxes = rCentres.size();
+    const unsigned num_points = GetNumPoints();
+
+    // Data file has one column for the box centres, then a column per parameter point
+    out_stream p_data = rHandler.OpenOutputFile(base_name + "_gnuplot_data.csv");
+    *p_data << std::setprecision(16);
+    for (unsigned box=0; box<num_boxes; box++)
+    {
+        *p_data << rCentres[box];
+        for (unsigned i=0; i<num_points; i++)
+        {
+            *p_data << "," << rNormFreqs[i*num_boxes + box];
+        }
+        *p_data << std::endl;
+    }
+    p_data->close();
+
+    out_stream p_script = rHandler.OpenOutputFile(base_name + ".gp");
+    *p_script << "set terminal " << (mGnuplotTerminal.empty() ? "postscript eps enhanced" : mGnuplotTerminal) << std::endl
+              << "set output '" << full_path << base_name << ".eps'" << std::endl
+              << "set title '" << rTitle << "'" << std::endl
+              << "set xlabel 'Percentage height up the crypt (%)'" << std::endl
+              << "set ylabel 'Percentage of divisions per box (%)'" << std::endl
+              << "set datafile separator ','" << std::endl;
+    if (mAxes.size() == 1u)
+    {
+        *p_script << "set key title '" << mAxes[0].mDescription << "'" << std::endl;
+    }
+    *p_script << "plot ";
+    for (unsigned i=0; i<num_points; i++)
+    {
+        // Label each line with the parameter values for its point
+        std::map<std::string, double> point_inputs = GetPointInputs(i);
+        std::stringstream key;
+        for (unsigned j=0; j<mAxes.size(); j++)
+        {
+            if (mAxes.size() > 1u)
+            {
+                key << (j == 0 ? "" : ", ") << mAxes[j].mInputName << "=";
+            }
+            key << point_inputs[mAxes[j].mInputName];
+        }
+        *p_script << (i == 0 ? "" : ", ") << "'" << full_path << base_name << "_gnuplot_data.csv' using 1:"
+                  << i+2 << " title '" << key.str() << "' with linespoints";
+    }
+    *p_script << std::endl;
+    p_script->close();
+
+    std::string command = "gnuplot " + full_path + base_name + ".gp";
+    if (system(command.c_str()) != 0)
+    {
+        WARNING("Unable to generate plot with gnuplot; the data and script remain in " << full_path);
+    }
+}
+
+
+void CryptSweepRunner::WriteOutputArray(OutputFileHandler& rHandler, const std::string& rFileName,
+                                        const std::string& rDescription, const std::vector<unsigned>& rShape,
+                                        const std::vector<double>& rValues)
+{
+    out_stream p_file = rHandler.OpenOutputFile(rFileName);
+    *p_file << "# " << rDescription << std::endl << std::setprecision(16);
+    if (rShape.size() == 1u)
+    {
+        assert(rValues.size() == rShape[0]);
+        *p_file << "1," << rShape[0] << std::endl;
+        BOOST_FOREACH(double value, rValues)
+        {
+            *p_file << value << std::endl;
+        }
+    }
+    else
+    {
+        assert(rShape.size() == 2u);
+        assert(rValues.size() == rShape[0]*rShape[1]);
+        for (unsigned j=0; j<rShape[1]; j++)
+        {
+            for (unsigned i=0; i<rShape[0]; i++)
+            {
+                *p_file << (i == 0 ? "" : ",") << rValues[i*rShape[1] + j];
+            }
+            *p_file << std::endl;
+        }
+    }
+    p_file->close();
+}
@@ -0,0 +1,374 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CRYPTSWEEPRUNNER_HPP_
+#define CRYPTSWEEPRUNNER_HPP_
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "DynamicJobQueue.hpp"
+#include "CryptProliferationModel.hpp"
+#include "ResultCache.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "ProtocolFileFinder.hpp"
+
+/**
+ * Runs a protocol over several crypt models and, optionally, the cross product of values for some of
+ * the protocol's inputs, treating every (model, parameter point) combination as an independent job.
+ * A DynamicJobQueue is used to balance these jobs across however many processes are available, so
+ * e.g. 3 models by 5 crypt heights can make use of 15 processes.
+ *
+ * Each job runs the protocol on a fresh model instance.  If no sweep axes are given, each model's job
+ * writes its protocol outputs (and plots) directly into a sub-folder named after the model.
+ *
+ * If sweep axes are given, each job instead writes into a sub-folder of the model's folder named after
+ * the parameter point, and returns the division histogram (the protocol's 'freqs' output).  Once all
+ * jobs are done the master process assembles, for each model, the same outputs as the
+ * CryptProliferationSweep.txt protocol produces - outputs_freqs.csv, outputs_norm_freqs.csv,
+ * outputs_centres_percent.csv, plus a file giving the values along each sweep axis - along with a plot of
+ * normalised division frequency against height up the crypt.  The histogram arrays have shape
+ * [num_points, num_boxes], where the parameter points are ordered with the last axis varying fastest.
+ *
+ * With a single sweep axis, the points may instead be chosen adaptively (see SetAdaptiveRefinement): the
+ * axis values given are a coarse initial grid, and further points are added in rounds wherever adjacent
+ * histograms differ most, until a compute budget is used up.
+ */
+class CryptSweepRunner : public AbstractQueuedJobs
+{
+public:
+    /**
+     * Create a sweep runner.
+     *
+     * @param rProtocol  the protocol to run for each job
+     * @param rOutputFolderName  the folder (relative to CHASTE_TEST_OUTPUT) in which to write results
+     * @param rModelTypes  the models to run
+     */
+    CryptSweepRunner(const ProtocolFileFinder& rProtocol,
+                     const std::string& rOutputFolderName,
+                     const std::vector<CryptProliferationModel::ModelType>& rModelTypes);
+
+    /**
+     * Add a protocol input to sweep over.  Jobs are created for the cross product of all axes.
+     *
+     * @param rInputName  the protocol input to set
+     * @param rOutputName  the name of the output giving the values along this axis (e.g. "heights")
+     * @param rDescription  description of the values along this axis, for the output file header
+     * @param rValues  the values to sweep over
+     * @param costScalesWithValue  whether a job's run time is expected to grow with this input's value
+     *     (as for crypt height), which is used to hand out the longest jobs first
+     */
+    void AddSweepAxis(const std::string& rInputName, const std::string& rOutputName,
+                      const std::string& rDescription, const std::vector<double>& rValues,
+                      bool costScalesWithValue=false);
+
+    /**
+     * Override further inputs of the protocol, for every job.
+     *
+     * @param rProtocolInputs  map from input name to value
+     */
+    void SetProtocolInputs(const std::map<std::string, double>& rProtocolInputs);
+
+    /**
+     * Set the title to use for plots generated for the given model.  By default the model name is used
+     * for sweep plots, and the protocol's own titles for plots generated by the protocol.
+     *
+     * @param modelType  the model
+     * @param rTitle  the plot title
+     */
+    void SetPlotTitle(CryptProliferationModel::ModelType modelType, const std::string& rTitle);
+
+    /**
+     * Set the gnuplot terminal specification used for all plots.
+     *
+     * @param rTerminal  the terminal, e.g. "postscript eps enhanced size 4,3 font 16"
+     */
+    void SetGnuplotTerminal(const std::string& rTerminal);
+
+    /**
+     * Set whether to copy the plots generated for each model into the main output folder, with the
+     * model's folder name as a prefix, for easy inclusion in a paper.
+     *
+     * @param copyPlots  whether to copy plots
+     */
+    void SetCopyPlots(bool copyPlots);
+
+    /**
+     * Set whether to record a timeline of the run, showing each job and the stages within it on a separate
+     * track for each process, along with cell counts.  This is written to trace.json in the main output
+     * folder, for viewing in chrome://tracing or https://ui.perfetto.dev.
+     *
+     * @param recordTrace  whether to record a trace
+     */
+    void SetRecordTrace(bool recordTrace);
+
+    /**
+     * Set how each job's model should use the on-disk result cache; see CryptProliferationModel::SetResultCache.
+     * By default the cache is bypassed.
+     *
+     * @param mode  the cache mode
+     */
+    void SetResultCacheMode(ResultCache::Mode mode);
+
+    /**
+     * Refine the sweep adaptively, rather than just running the axis values given.  There must be exactly
+     * one sweep axis, whose values form the initial grid.  After running these, each round adds a point at
+     * the midpoint of those intervals between adjacent values where the normalised histograms differ most
+     * (taking the largest difference, in percentage points, over all boxes and models).  All the jobs in a
+     * round run concurrently.  Refinement stops when the next points would exceed the budget, or no interval
+     * can be split further.  The outputs are as for a fixed sweep over all the points run, in increasing
+     * order, along with outputs_refinement_round.csv giving the round in which each point was added.
+     *
+     * @param budget  the total estimated cost (see GetJobCost) allowed for all jobs, including the initial grid
+     * @param maxPointsPerRound  the most points to add in each round; if zero, enough to keep every worker
+     *     process busy
+     * @param minSpacing  intervals are only split if the new point would be at least this far from others
+     * @param tolerance  intervals are only split if their histograms differ by more than this
+     */
+    void SetAdaptiveRefinement(double budget, unsigned maxPointsPerRound=0u, double minSpacing=0.0,
+                               double tolerance=0.0);
+
+    /**
+     * Choose where to add points in a round of adaptive refinement.
+     *
+     * @param rValues  the axis values run so far, in increasing order
+     * @param rNormFreqs  for each model, the normalised histogram at each value
+     * @param maxNumPoints  the most points to choose
+     * @param minSpacing  only split intervals at least twice this wide
+     * @param tolerance  only split intervals whose histograms differ by more than this
+     * @return  the midpoints of the chosen intervals, in order of decreasing difference
+     */
+    static std::vector<double> ChooseRefinementPoints(const std::vector<double>& rValues,
+                                                      const std::vector<std::vector<std::vector<double> > >& rNormFreqs,
+                                                      unsigned maxNumPoints, double minSpacing, double tolerance);
+
+    /**
+     * Normalise a division histogram to percentages of the total.
+     *
+     * @param rFreqs  the number of divisions per box
+     * @return  the percentage of divisions per box (all zero if there were no divisions)
+     */
+    static std::vector<double> NormaliseHistogram(const std::vector<double>& rFreqs);
+
+    /**
+     * Run all the jobs.  This is a collective operation.
+     *
+     * @return  whether all jobs succeeded (only meaningful on the master process)
+     */
+    bool Run();
+
+    /**
+     * Get the name of the sub-folder in which outputs for the given model are written.
+     *
+     * @param modelType  the model
+     * @return  its folder name
+     */
+    static std::string GetModelFolderName(CryptProliferationModel::ModelType modelType);
+
+    /**
+     * Write a results array to file in the same layout as the Functional Curation protocol outputs,
+     * i.e. a comment line giving the description followed by the data.  1d arrays are written with
+     * a shape line then one value per line; 2d arrays are written with one row per entry along the
+     * second dimension.
+     *
+     * @param rHandler  the folder to write to
+     * @param rFileName  the file name
+     * @param rDescription  description for the header line
+     * @param rShape  the shape of the array (1 or 2 dimensions)
+     * @param rValues  the array values, in row-major order
+     */
+    static void WriteOutputArray(OutputFileHandler& rHandler, const std::string& rFileName,
+                                 const std::string& rDescription, const std::vector<unsigned>& rShape,
+                                 const std::vector<double>& rValues);
+
+    /** @return  the number of (model, parameter point) jobs. */
+    unsigned GetNumJobs() const;
+
+    /**
+     * Estimate the cost of a job as the product of the values along any axes flagged as affecting cost.
+     *
+     * @param jobIndex  the job
+     * @return  its estimated cost
+     */
+    double GetJobCost(unsigned jobIndex) const;
+
+    /**
+     * Run the protocol for a single (model, parameter point) pair.
+     *
+     * @param jobIndex  the job
+     * @return  the division histogram for this point, or nothing if there are no sweep axes
+     */
+    std::vector<double> RunJob(unsigned jobIndex);
+
+private:
+    /** A protocol input to sweep over. */
+    struct SweepAxis
+    {
+        /** The protocol input name. */
+        std::string mInputName;
+        /** The name of the output listing values along this axis. */
+        std::string mOutputName;
+        /** Description of the values. */
+        std::string mDescription;
+        /** The values to take. */
+        std::vector<double> mValues;
+        /** Whether job cost scales with the value. */
+        bool mCostScalesWithValue;
+    };
+
+    /** @return  the number of parameter points, i.e. the product of the axis lengths (1 if no axes). */
+    unsigned GetNumPoints() const;
+
+    /**
+     * Get the protocol inputs to set for a given parameter point.
+     *
+     * @param pointIndex  the point, with the last axis varying fastest
+     * @return  the value for each axis' input
+     */
+    std::map<std::string, double> GetPointInputs(unsigned pointIndex) const;
+
+    /**
+     * Get the folder in which a job writes its protocol outputs.
+     *
+     * @param jobIndex  the job
+     * @return  the path relative to CHASTE_TEST_OUTPUT
+     */
+    std::string GetJobFolderName(unsigned jobIndex) const;
+
+    /**
+     * Assemble and write the sweep outputs for a single model, on the master process.
+     *
+     * @param modelIndex  index into mModelTypes
+     * @param rResults  results for all jobs
+     */
+    void WriteModelOutputs(unsigned modelIndex, const std::vector<std::vector<double> >& rResults);
+
+    /**
+     * Plot normalised division frequencies against height for a single model, using gnuplot.
+     *
+     * @param rHandler  the model's output folder
+     * @param rTitle  the plot title
+     * @param rNormFreqs  the normalised frequencies, of shape [num_points, num_boxes]
+     * @param rCentres  the box centres as a percentage of crypt height
+     */
+    void PlotModelOutputs(OutputFileHandler& rHandler, const std::string& rTitle,
+                          const std::vector<double>& rNormFreqs, const std::vector<double>& rCentres);
+
+    /**
+     * Run the jobs for each round of adaptive refinement.  This is a collective operation.  On return the
+     * sweep axis lists every point run, in increasing order.
+     *
+     * @param rFailedModels  filled in with the indices of models for which any job failed
+     * @return  on the master, results for all jobs indexed as for a fixed sweep over the final points
+     */
+    std::vector<std::vector<double> > RunAdaptive(std::set<unsigned>& rFailedModels);
+
+    /**
+     * Report jobs which failed in the last run of the job queue, on the master process.
+     *
+     * @param rFailedJobs  the failed job indices
+     * @param rFailedModels  updated with the models these jobs were for
+     */
+    void ReportFailedJobs(const std::vector<unsigned>& rFailedJobs, std::set<unsigned>& rFailedModels) const;
+
+    /**
+     * Write the timeline recorded by each process to file, and merge them on the master.  This is a
+     * collective operation.
+     *
+     * @param rHandler  the main output folder
+     */
+    void WriteTrace(OutputFileHandler& rHandler);
+
+    /**
+     * Copy the plots generated for a model into the main output folder.
+     *
+     * @param modelType  the model
+     */
+    void CopyModelPlots(CryptProliferationModel::ModelType modelType);
+
+    /** The protocol to run for each job. */
+    ProtocolFileFinder mProtocol;
+
+    /** The main output folder. */
+    std::string mOutputFolderName;
+
+    /** The models to run. */
+    std::vector<CryptProliferationModel::ModelType> mModelTypes;
+
+    /** The protocol inputs to sweep over. */
+    std::vector<SweepAxis> mAxes;
+
+    /** Extra protocol inputs to set for every job. */
+    std::map<std::string, double> mProtocolInputs;
+
+    /** Plot titles for each model, if not the default. */
+    std::map<CryptProliferationModel::ModelType, std::string> mPlotTitles;
+
+    /** The gnuplot terminal to use, if not the default. */
+    std::string mGnuplotTerminal;
+
+    /** Whether to copy plots to the main output folder. */
+    bool mCopyPlots;
+
+    /** Whether to record a timeline of the run. */
+    bool mRecordTrace;
+
+    /** How models should use the result cache. */
+    ResultCache::Mode mResultCacheMode;
+
+    /** Whether to refine the sweep adaptively. */
+    bool mAdaptive;
+
+    /** Total estimated cost allowed for adaptive refinement. */
+    double mBudget;
+
+    /** The most points to add per round of adaptive refinement, or zero to match the number of workers. */
+    unsigned mMaxPointsPerRound;
+
+    /** Minimum spacing between points added by adaptive refinement. */
+    double mMinSpacing;
+
+    /** Histogram difference below which adaptive refinement won't split an interval. */
+    double mTolerance;
+
+    /** After adaptive refinement, the round in which each point along the sweep axis was run. */
+    std::vector<double> mPointRounds;
+};
+
+#endif // CRYPTSWEEPRUNNER_HPP_
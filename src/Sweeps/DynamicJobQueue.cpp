@@ -0,0 +1,244 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "DynamicJobQueue.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <exception>
+#include <iostream>
+
+#include "PetscTools.hpp"
+#include "Exception.hpp"
+#include "TraceRecorder.hpp"
+#include "ProcessIsolation.hpp"
+
+/** MPI tag for messages from the master assigning a job. */
+const int DYNAMIC_QUEUE_JOB_TAG = 5301;
+/** MPI tag for messages from a worker returning results. */
+const int DYNAMIC_QUEUE_RESULT_TAG = 5302;
+/** Job index used to tell a worker that there is no more work. */
+const unsigned DYNAMIC_QUEUE_STOP = UINT_MAX;
+
+/**
+ * Comparison functor for sorting job indices by decreasing cost.
+ */
+struct DecreasingJobCost
+{
+    /** The jobs being sorted. */
+    const AbstractQueuedJobs& mrJobs;
+
+    /**
+     * Constructor.
+     * @param rJobs  the jobs being sorted
+     */
+    DecreasingJobCost(const AbstractQueuedJobs& rJobs)
+        : mrJobs(rJobs)
+    {}
+
+    /**
+     * @param i  first job index
+     * @param j  second job index
+     * @return  whether job i should be run before job j
+     */
+    bool operator()(unsigned i, unsigned j) const
+    {
+        return mrJobs.GetJobCost(i) > mrJobs.GetJobCost(j);
+    }
+};
+
+
+std::vector<unsigned> DynamicJobQueue::GetJobOrder(const AbstractQueuedJobs& rJobs)
+{
+    std::vector<unsigned> order(rJobs.GetNumJobs());
+    for (unsigned i=0; i<order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), DecreasingJobCost(rJobs));
+    return order;
+}
+
+
+const std::vector<unsigned>& DynamicJobQueue::rGetFailedJobs() const
+{
+    return mFailedJobs;
+}
+
+
+std::vector<std::vector<double> > DynamicJobQueue::Run(AbstractQueuedJobs& rJobs)
+{
+    mFailedJobs.clear();
+    std::vector<std::vector<double> > results(rJobs.GetNumJobs());
+
+    // Each process runs its own jobs, so none of them may share a crypt with other processes
+    ProcessIsolation::SeparateJobsGuard separate_jobs;
+
+    if (!PetscTools::IsParallel())
+    {
+        // Just run everything here, biggest first for consistency with the parallel case
+        std::vector<unsigned> order = GetJobOrder(rJobs);
+        for (unsigned i=0; i<order.size(); i++)
+        {
+            try
+            {
+                results[order[i]] = rJobs.RunJob(order[i]);
+            }
+            catch (const Exception& r_error)
+            {
+                std::cerr << r_error.GetMessage() << std::endl;
+                mFailedJobs.push_back(order[i]);
+            }
+            catch (const std::exception& r_error)
+            {
+                // Not everything a job uses reports errors as Chaste exceptions
+                std::cerr << r_error.what() << std::endl;
+                mFailedJobs.push_back(order[i]);
+            }
+        }
+    }
+    else
+    {
+        {
+            // Jobs must be able to write output files etc. independently of other processes
+            ProcessIsolation::IsolationGuard isolated;
+            if (PetscTools::GetMyRank() == 0)
+            {
+                RunMaster(rJobs, results);
+            }
+            else
+            {
+                RunWorker(rJobs);
+            }
+        }
+        PetscTools::Barrier("DynamicJobQueue::Run");
+    }
+    return results;
+}
+
+
+void DynamicJobQueue::RunMaster(const AbstractQueuedJobs& rJobs, std::vector<std::vector<double> >& rResults)
+{
+    std::vector<unsigned> order = GetJobOrder(rJobs);
+    unsigned next_job = 0u;
+    unsigned num_busy_workers = 0u;
+
+    // Give every worker its first job (or tell it to stop if there aren't enough jobs)
+    for (unsigned worker=1; worker<PetscTools::GetNumProcs(); worker++)
+    {
+        unsigned job = DYNAMIC_QUEUE_STOP;
+        if (next_job < order.size())
+        {
+            job = order[next_job++];
+            num_busy_workers++;
+        }
+        MPI_Send(&job, 1, MPI_UNSIGNED, worker, DYNAMIC_QUEUE_JOB_TAG, PETSC_COMM_WORLD);
+    }
+
+    // Collect results, handing out the next job to whoever has just finished
+    while (num_busy_workers > 0u)
+    {
+        MPI_Status status;
+        {
+            TraceSpan wait_span("wait_for_result", "queue");
+            MPI_Probe(MPI_ANY_SOURCE, DYNAMIC_QUEUE_RESULT_TAG, PETSC_COMM_WORLD, &status);
+        }
+        int message_size;
+        MPI_Get_count(&status, MPI_DOUBLE, &message_size);
+        // The message is [job index, success flag, results...]
+        std::vector<double> message(message_size);
+        MPI_Recv(&message[0], message_size, MPI_DOUBLE, status.MPI_SOURCE, DYNAMIC_QUEUE_RESULT_TAG,
+                 PETSC_COMM_WORLD, &status);
+        unsigned finished_job = (unsigned)message[0];
+        if (message[1] != 0.0)
+        {
+            rResults[finished_job].assign(message.begin() + 2, message.end());
+        }
+        else
+        {
+            mFailedJobs.push_back(finished_job);
+        }
+
+        unsigned job = DYNAMIC_QUEUE_STOP;
+        if (next_job < order.size())
+        {
+            job = order[next_job++];
+        }
+        else
+        {
+            num_busy_workers--;
+        }
+        MPI_Send(&job, 1, MPI_UNSIGNED, status.MPI_SOURCE, DYNAMIC_QUEUE_JOB_TAG, PETSC_COMM_WORLD);
+    }
+}
+
+
+void DynamicJobQueue::RunWorker(AbstractQueuedJobs& rJobs)
+{
+    while (true)
+    {
+        unsigned job;
+        MPI_Status status;
+        {
+            TraceSpan wait_span("wait_for_job", "queue");
+            MPI_Recv(&job, 1, MPI_UNSIGNED, 0, DYNAMIC_QUEUE_JOB_TAG, PETSC_COMM_WORLD, &status);
+        }
+        if (job == DYNAMIC_QUEUE_STOP)
+        {
+            break;
+        }
+
+        std::vector<double> message(2);
+        message[0] = job;
+        try
+        {
+            std::vector<double> results = rJobs.RunJob(job);
+            message[1] = 1.0;
+            message.insert(message.end(), results.begin(), results.end());
+        }
+        // Report any failure rather than leaving the master waiting for ever
+        catch (const Exception& r_error)
+        {
+            std::cerr << r_error.GetMessage() << std::endl;
+            message[1] = 0.0;
+        }
+        catch (const std::exception& r_error)
+        {
+            std::cerr << r_error.what() << std::endl;
+            message[1] = 0.0;
+        }
+        MPI_Send(&message[0], message.size(), MPI_DOUBLE, 0, DYNAMIC_QUEUE_RESULT_TAG, PETSC_COMM_WORLD);
+    }
+}
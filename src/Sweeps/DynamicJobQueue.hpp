@@ -0,0 +1,133 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef DYNAMICJOBQUEUE_HPP_
+#define DYNAMICJOBQUEUE_HPP_
+
+#include <vector>
+
+/**
+ * Interface for a collection of independent jobs which can be farmed out to processes by a DynamicJobQueue.
+ *
+ * Each job is identified by its index, and produces a vector of doubles as its result.
+ */
+class AbstractQueuedJobs
+{
+public:
+    /** Virtual destructor, since we have virtual methods. */
+    virtual ~AbstractQueuedJobs()
+    {}
+
+    /** @return  the number of jobs in this collection. */
+    virtual unsigned GetNumJobs() const=0;
+
+    /**
+     * Get an estimate of how expensive a job is to run.  Only the relative size matters: jobs are
+     * handed out in order of decreasing cost, so that the longest jobs don't get left until last.
+     *
+     * @param jobIndex  the job
+     * @return  its estimated cost
+     */
+    virtual double GetJobCost(unsigned jobIndex) const=0;
+
+    /**
+     * Run a single job.  This will be called on whichever process the job has been assigned to,
+     * with process isolation turned on, so the job must not use collective operations.
+     *
+     * @param jobIndex  the job to run
+     * @return  the job's results, which will be sent to the master process
+     */
+    virtual std::vector<double> RunJob(unsigned jobIndex)=0;
+};
+
+/**
+ * A simple master/worker job queue for running a collection of independent jobs across MPI processes.
+ *
+ * When running in parallel the master process does no work itself, but hands out jobs one at a time,
+ * largest first, to worker processes as they become free.  This gives much better load balance than
+ * a static round-robin split when job costs vary widely.  When running sequentially all jobs are
+ * simply run in turn on the one process.
+ */
+class DynamicJobQueue
+{
+public:
+    /**
+     * Run all the given jobs.
+     *
+     * This is a collective operation, and must be called on all processes.
+     *
+     * @param rJobs  the jobs to run
+     * @return  on the master process, the results of every job, indexed by job number; on other processes
+     *     a vector of empty results.  If a job failed (threw an Exception or std::exception) its results will
+     *     also be empty, and its index will be listed in rGetFailedJobs().
+     */
+    std::vector<std::vector<double> > Run(AbstractQueuedJobs& rJobs);
+
+    /**
+     * Determine the order in which jobs will be handed out, i.e. in order of decreasing cost.
+     * Jobs of equal cost retain their original relative order.
+     *
+     * @param rJobs  the jobs to run
+     * @return  job indices, most expensive first
+     */
+    static std::vector<unsigned> GetJobOrder(const AbstractQueuedJobs& rJobs);
+
+    /**
+     * @return  the indices of any jobs which failed during the last call to Run.
+     * Only meaningful on the master process.
+     */
+    const std::vector<unsigned>& rGetFailedJobs() const;
+
+private:
+    /**
+     * The master side of the queue: hand out jobs and collect results.
+     *
+     * @param rJobs  the jobs to run
+     * @param rResults  filled in with the results of each job
+     */
+    void RunMaster(const AbstractQueuedJobs& rJobs, std::vector<std::vector<double> >& rResults);
+
+    /**
+     * The worker side of the queue: run jobs until told to stop.
+     *
+     * @param rJobs  the jobs to run
+     */
+    void RunWorker(AbstractQueuedJobs& rJobs);
+
+    /** Indices of jobs which threw during the last run. */
+    std::vector<unsigned> mFailedJobs;
+};
+
+#endif // DYNAMICJOBQUEUE_HPP_
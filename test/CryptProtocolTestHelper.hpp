@@ -0,0 +1,218 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef CRYPTPROTOCOLTESTHELPER_HPP_
+#define CRYPTPROTOCOLTESTHELPER_HPP_
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/make_shared.hpp>
+
+#include "CryptProliferationModel.hpp"
+#include "Protocol.hpp"
+#include "ProtocolParser.hpp"
+#include "ProtocolFileFinder.hpp"
+#include "ValueExpression.hpp"
+#include "ValueTypes.hpp"
+#include "ProtoHelperMacros.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+
+/**
+ * Helper for the test suites that run the protocols in test/protocols on a crypt model, with some of the
+ * protocol inputs changed, and compare the division location histograms from different runs.
+ */
+class CryptProtocolTestHelper
+{
+public:
+    /**
+     * Set up one of the protocols in test/protocols to run a model.
+     *
+     * @param rProtocolName  the protocol's file name, without the .txt extension
+     * @param rOutputFolder  the output folder, relative to CHASTE_TEST_OUTPUT; cleaned first
+     * @param pModel  the model to run
+     * @param rInputs  the value for each protocol input to set
+     * @return  the protocol, ready to run
+     */
+    static ProtocolPtr Create(const std::string& rProtocolName, const std::string& rOutputFolder,
+                              boost::shared_ptr<AbstractSystemWithOutputs> pModel,
+                              const std::map<std::string, double>& rInputs=std::map<std::string, double>())
+    {
+        FileFinder this_file(__FILE__, RelativeTo::ChasteSourceRoot);
+        ProtocolFileFinder proto_file("protocols/" + rProtocolName + ".txt", this_file);
+        OutputFileHandler handler(rOutputFolder);
+
+        ProtocolParser parser;
+        ProtocolPtr p_protocol = parser.ParseFile(proto_file);
+        p_protocol->SetOutputFolder(handler);
+        p_protocol->SetModel(pModel);
+        for (std::map<std::string, double>::const_iterator it = rInputs.begin(); it != rInputs.end(); ++it)
+        {
+            p_protocol->SetInput(it->first, boost::make_shared<ValueExpression>(boost::make_shared<SimpleValue>(it->second)));
+        }
+        return p_protocol;
+    }
+
+    /**
+     * Run one of the protocols in test/protocols on a model, writing its outputs.
+     *
+     * @param rProtocolName  the protocol's file name, without the .txt extension
+     * @param rOutputFolder  the output folder, relative to CHASTE_TEST_OUTPUT; cleaned first
+     * @param pModel  the model to run
+     * @param rInputs  the value for each protocol input to set
+     * @return  the protocol, from which outputs may be read
+     */
+    static ProtocolPtr Run(const std::string& rProtocolName, const std::string& rOutputFolder,
+                           boost::shared_ptr<AbstractSystemWithOutputs> pModel,
+                           const std::map<std::string, double>& rInputs=std::map<std::string, double>())
+    {
+        ProtocolPtr p_protocol = Create(rProtocolName, rOutputFolder, pModel, rInputs);
+        p_protocol->RunAndWrite("outputs");
+        return p_protocol;
+    }
+
+    /**
+     * @param pProtocol  a protocol that has been run
+     * @param rName  the name of an array output
+     * @return  the output's entries, flattened
+     */
+    static std::vector<double> GetArrayOutput(ProtocolPtr pProtocol, const std::string& rName)
+    {
+        NdArray<double> array = GET_ARRAY(pProtocol->rGetOutputsCollection().Lookup(rName, "CryptProtocolTestHelper"));
+        return std::vector<double>(array.Begin(), array.End());
+    }
+
+    /**
+     * @param pProtocol  a protocol that has been run
+     * @param rName  the name of a single valued output
+     * @return  the output's value
+     */
+    static double GetValueOutput(ProtocolPtr pProtocol, const std::string& rName)
+    {
+        return GET_SIMPLE_VALUE(pProtocol->rGetOutputsCollection().Lookup(rName, "CryptProtocolTestHelper"));
+    }
+
+    /**
+     * Count divisions by height up the crypt, as the freqs output of CryptProliferation.txt does: the crypt
+     * is split into boxes of equal height, with the bottom and top boxes also counting any divisions below
+     * or above the crypt.
+     *
+     * @param rDivisions  the divisions output, flattened, with rows of time, x, y, age
+     * @param cryptHeight  the crypt height
+     * @param numBoxes  the number of boxes
+     * @return  the number of divisions in each box
+     */
+    static std::vector<double> GetDivisionHistogram(const std::vector<double>& rDivisions, double cryptHeight,
+                                                    unsigned numBoxes)
+    {
+        std::vector<double> freqs(numBoxes, 0.0);
+        for (unsigned i=2; i<rDivisions.size(); i+=4)
+        {
+            double box = floor(rDivisions[i] * numBoxes / cryptHeight);
+            freqs[(unsigned)std::min(std::max(box, 0.0), numBoxes - 1.0)] += 1.0;
+        }
+        return freqs;
+    }
+
+    /**
+     * @param rFreqs  the number of divisions in each box
+     * @return  the percentage of divisions in each box
+     */
+    static std::vector<double> GetPercentages(const std::vector<double>& rFreqs)
+    {
+        double total = GetTotal(rFreqs);
+        std::vector<double> percentages(rFreqs);
+        for (unsigned i=0; i<percentages.size(); i++)
+        {
+            percentages[i] *= 100.0/total;
+        }
+        return percentages;
+    }
+
+    /**
+     * @param rFreqs  the number of divisions in each box
+     * @param rReferenceFreqs  the number of divisions in each box in a reference run
+     * @return  the largest difference, in percentage points, between the percentages of divisions in a box
+     */
+    static double GetMaxPercentageDifference(const std::vector<double>& rFreqs,
+                                             const std::vector<double>& rReferenceFreqs)
+    {
+        std::vector<double> percentages = GetPercentages(rFreqs);
+        std::vector<double> reference_percentages = GetPercentages(rReferenceFreqs);
+        double max_difference = 0.0;
+        for (unsigned i=0; i<std::min(percentages.size(), reference_percentages.size()); i++)
+        {
+            max_difference = std::max(max_difference, fabs(percentages[i] - reference_percentages[i]));
+        }
+        return max_difference;
+    }
+
+    /**
+     * The largest difference between two histograms' percentages of divisions in a box that is expected if
+     * the runs sample the same steady state.  If each box's count were binomial, the standard error of the
+     * difference in a box's percentage would be at most 50*sqrt(1/N1 + 1/N2) percentage points, where N1
+     * and N2 are the total numbers of divisions.  Divisions are not independent, since daughter cells tend
+     * to divide close together, so four standard errors are allowed rather than the usual two.
+     *
+     * @param rFreqs  the number of divisions in each box
+     * @param rReferenceFreqs  the number of divisions in each box in a reference run
+     * @return  the tolerance, in percentage points
+     */
+    static double GetPercentageTolerance(const std::vector<double>& rFreqs,
+                                         const std::vector<double>& rReferenceFreqs)
+    {
+        return 4.0 * 50.0 * sqrt(1.0/GetTotal(rFreqs) + 1.0/GetTotal(rReferenceFreqs));
+    }
+
+    /**
+     * @param rFreqs  the number of divisions in each box
+     * @return  the total number of divisions
+     */
+    static double GetTotal(const std::vector<double>& rFreqs)
+    {
+        double total = 0.0;
+        for (unsigned i=0; i<rFreqs.size(); i++)
+        {
+            total += rFreqs[i];
+        }
+        return total;
+    }
+};
+
+#endif // CRYPTPROTOCOLTESTHELPER_HPP_
@@ -0,0 +1,149 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTASYNCRECORDWRITER_HPP_
+#define TESTASYNCRECORDWRITER_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "AsyncRecordWriter.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestAsyncRecordWriter : public CxxTest::TestSuite
+{
+    /**
+     * @param rFile  a file
+     * @return  its contents
+     */
+    std::string ReadFile(const FileFinder& rFile)
+    {
+        std::ifstream file(rFile.GetAbsolutePath().c_str());
+        std::stringstream contents;
+        contents << file.rdbuf();
+        return contents.str();
+    }
+
+public:
+    void TestWriteRecords() throw (Exception)
+    {
+        OutputFileHandler handler("TestAsyncRecordWriter");
+        const std::string folder = handler.GetOutputDirectoryFullPath();
+
+        // A short queue, so the writer thread is likely to fall behind and apply back-pressure
+        AsyncRecordWriter writer(4u);
+        unsigned text_file = writer.OpenFile(folder + "text.txt");
+        unsigned rows_file = writer.OpenFile(folder + "rows.txt");
+        std::stringstream expected_text;
+        std::stringstream expected_rows;
+        const unsigned num_records = 10000u;
+        std::vector<double> row(3u);
+        for (unsigned i=0; i<num_records; i++)
+        {
+            std::stringstream text;
+            text << "record " << i << std::endl;
+            writer.Write(text_file, text.str());
+            expected_text << text.str();
+
+            // Rows are formatted as by an ostream with default settings
+            row[0] = i * 0.1;
+            row[1] = 1.0 / 3.0;
+            row[2] = i;
+            writer.WriteRow(rows_file, row);
+            expected_rows << row[0] << "\t" << row[1] << "\t" << row[2] << "\n";
+
+            if (i % 1000u == 0u)
+            {
+                writer.Flush();
+            }
+        }
+        // Syncing waits for everything queued so far to reach the files, without closing them
+        writer.Sync();
+        TS_ASSERT(!writer.IsClosed());
+        TS_ASSERT_EQUALS(ReadFile(handler.FindFile("text.txt")), expected_text.str());
+        TS_ASSERT_EQUALS(ReadFile(handler.FindFile("rows.txt")), expected_rows.str());
+        writer.Write(text_file, "last\n");
+        expected_text << "last\n";
+        writer.Close();
+        TS_ASSERT(writer.IsClosed());
+
+        TS_ASSERT_EQUALS(ReadFile(handler.FindFile("text.txt")), expected_text.str());
+        TS_ASSERT_EQUALS(ReadFile(handler.FindFile("rows.txt")), expected_rows.str());
+
+        std::vector<double> stats = writer.GetStatistics();
+        TS_ASSERT_EQUALS(stats.size(), (unsigned)AsyncRecordWriter::NUM_STATISTICS);
+        TS_ASSERT_EQUALS(stats[AsyncRecordWriter::NUM_RECORDS], 2.0 * num_records + 1.0);
+        TS_ASSERT_EQUALS(stats[AsyncRecordWriter::NUM_BYTES], (double)expected_text.str().size());
+        TS_ASSERT_EQUALS(stats[AsyncRecordWriter::NUM_FLUSHES], 11.0);
+        TS_ASSERT_LESS_THAN_EQUALS(stats[AsyncRecordWriter::MAX_QUEUE_LENGTH], 4.0);
+        TS_ASSERT_LESS_THAN_EQUALS(0.0, stats[AsyncRecordWriter::BLOCKED_SECONDS]);
+        TS_ASSERT_EQUALS(AsyncRecordWriter::GetStatisticName(AsyncRecordWriter::NUM_BLOCKED_WRITES), "num_blocked_writes");
+
+        // Closing again does nothing, but no more records may be written
+        writer.Close();
+        TS_ASSERT_THROWS_THIS(writer.Write(text_file, "late"),
+                              "Unable to write a record as the output writer has been closed.");
+    }
+
+    void TestErrors() throw (Exception)
+    {
+        TS_ASSERT_THROWS_THIS(AsyncRecordWriter writer(0u),
+                              "The output queue must be able to hold at least one record.");
+
+        AsyncRecordWriter writer;
+        TS_ASSERT_THROWS_CONTAINS(writer.OpenFile("/no/such/folder/file.txt"),
+                                  "Unable to open /no/such/folder/file.txt for writing");
+
+        // Write errors are reported when the writer is synced or closed
+        FileFinder full_device("/dev/full", RelativeTo::Absolute);
+        if (full_device.Exists())
+        {
+            unsigned file = writer.OpenFile(full_device.GetAbsolutePath());
+            writer.Write(file, std::string(100000u, 'x'));
+            TS_ASSERT_THROWS_CONTAINS(writer.Sync(), "Error writing to /dev/full");
+            TS_ASSERT_THROWS_CONTAINS(writer.Close(), "Error writing to /dev/full");
+        }
+    }
+};
+
+#endif // TESTASYNCRECORDWRITER_HPP_
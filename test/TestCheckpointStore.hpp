@@ -0,0 +1,142 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTCHECKPOINTSTORE_HPP_
+#define TESTCHECKPOINTSTORE_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "CheckpointStore.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestCheckpointStore : public CxxTest::TestSuite
+{
+private:
+    /**
+     * Write a checkpoint containing a single file.
+     *
+     * @param rStore  the store to write to
+     * @param time  the checkpoint time
+     * @param rContents  what to write in the file
+     */
+    void WriteCheckpoint(CheckpointStore& rStore, double time, const std::string& rContents)
+    {
+        FileFinder folder = rStore.BeginCheckpoint();
+        TS_ASSERT(folder.IsDir());
+        OutputFileHandler handler(folder, false);
+        out_stream p_file = handler.OpenOutputFile("state.txt");
+        *p_file << rContents << std::endl;
+        p_file->close();
+        rStore.CommitCheckpoint(time);
+    }
+
+    /**
+     * @param rStore  the store to read from
+     * @return  the contents of the file in its latest checkpoint
+     */
+    std::string ReadCheckpoint(const CheckpointStore& rStore)
+    {
+        std::ifstream file(FileFinder("state.txt", rStore.GetCheckpointFolder()).GetAbsolutePath().c_str());
+        std::string contents;
+        file >> contents;
+        return contents;
+    }
+
+public:
+    void TestCommitAndReplace() throw (Exception)
+    {
+        OutputFileHandler handler("TestCheckpointStore");
+        FileFinder store_folder = handler.FindFile("store");
+
+        CheckpointStore store(store_folder, "model = A\n");
+        TS_ASSERT(!store.HasCheckpoint());
+        TS_ASSERT_THROWS_CONTAINS(store.GetCheckpointFolder(), "There is no checkpoint in ");
+        TS_ASSERT_THROWS_THIS(store.CommitCheckpoint(1.0), "BeginCheckpoint must be called before CommitCheckpoint.");
+
+        WriteCheckpoint(store, 2.5, "first");
+        TS_ASSERT(store.HasCheckpoint());
+        TS_ASSERT_EQUALS(store.GetCheckpointTime(), 2.5);
+        TS_ASSERT_EQUALS(ReadCheckpoint(store), "first");
+        TS_ASSERT_EQUALS(store.GetCheckpointFolder().GetLeafName(), "latest");
+
+        // Another accessor for the same key sees it; one for a different key doesn't
+        CheckpointStore same_store(store_folder, "model = A\n");
+        TS_ASSERT(same_store.HasCheckpoint());
+        CheckpointStore other_store(store_folder, "model = B\n");
+        TS_ASSERT(!other_store.HasCheckpoint());
+
+        // A new checkpoint replaces the old, leaving no temporary folders behind; times are stored exactly
+        WriteCheckpoint(store, 0.1 + 0.2, "second");
+        TS_ASSERT_EQUALS(store.GetCheckpointTime(), 0.1 + 0.2);
+        TS_ASSERT_EQUALS(ReadCheckpoint(store), "second");
+        std::vector<FileFinder> entries = store.GetCheckpointFolder().GetParent().FindMatches("*");
+        TS_ASSERT_EQUALS(entries.size(), 1u);
+    }
+
+    void TestFallBackToPreviousCheckpoint() throw (Exception)
+    {
+        OutputFileHandler handler("TestCheckpointStore", false);
+        FileFinder store_folder = handler.FindFile("store");
+
+        // Pretend a process was killed while replacing the latest checkpoint, just after moving it aside
+        CheckpointStore store(store_folder, "model = A\n");
+        TS_ASSERT(store.HasCheckpoint());
+        FileFinder latest = store.GetCheckpointFolder();
+        TS_ASSERT_EQUALS(rename(latest.GetAbsolutePath().c_str(),
+                                FileFinder("previous", latest.GetParent()).GetAbsolutePath().c_str()), 0);
+        TS_ASSERT(!latest.Exists());
+
+        TS_ASSERT(store.HasCheckpoint());
+        TS_ASSERT_EQUALS(store.GetCheckpointFolder().GetLeafName(), "previous");
+        TS_ASSERT_EQUALS(ReadCheckpoint(store), "second");
+
+        // Writing a new checkpoint tidies up
+        WriteCheckpoint(store, 5.0, "third");
+        TS_ASSERT_EQUALS(store.GetCheckpointFolder().GetLeafName(), "latest");
+        TS_ASSERT(!FileFinder("previous", latest.GetParent()).Exists());
+        TS_ASSERT_EQUALS(ReadCheckpoint(store), "third");
+    }
+};
+
+#endif // TESTCHECKPOINTSTORE_HPP_
@@ -0,0 +1,199 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTCRYPTEMULATOR_HPP_
+#define TESTCRYPTEMULATOR_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <cmath>
+#include <vector>
+#include <boost/make_shared.hpp>
+
+#include "CryptEmulatorModel.hpp"
+#include "GaussianProcessEmulator.hpp"
+#include "Protocol.hpp"
+#include "ProtocolParser.hpp"
+#include "ProtocolFileFinder.hpp"
+
+#include "ValueTypes.hpp"
+#include "ValueExpression.hpp"
+#include "ProtoHelperMacros.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestCryptEmulator : public CxxTest::TestSuite
+{
+public:
+    void TestSmoothFunction() throw (Exception)
+    {
+        GaussianProcessEmulator emulator;
+        TS_ASSERT(!emulator.IsTrained());
+
+        // Train on two outputs of one input, sampled at 7 points
+        std::vector<std::vector<double> > inputs;
+        std::vector<std::vector<double> > outputs;
+        for (unsigned i=0; i<7; i++)
+        {
+            double x = i/6.0;
+            inputs.push_back(std::vector<double>(1, x));
+            std::vector<double> output(2);
+            output[0] = sin(3*x);
+            output[1] = 100 + 10*x;
+            outputs.push_back(output);
+        }
+        emulator.Train(inputs, outputs);
+        TS_ASSERT(emulator.IsTrained());
+        TS_ASSERT_EQUALS(emulator.GetNumInputs(), 1u);
+        TS_ASSERT_EQUALS(emulator.GetNumOutputs(), 2u);
+
+        // Predictions at and between the training points are accurate
+        std::vector<double> mean, sd, far_mean, far_sd;
+        emulator.Predict(std::vector<double>(1, 1.0/3), mean, sd);
+        TS_ASSERT_DELTA(mean[0], sin(1.0), 0.01);
+        emulator.Predict(std::vector<double>(1, 0.25), mean, sd);
+        TS_ASSERT_DELTA(mean[0], sin(0.75), 0.01);
+        TS_ASSERT_DELTA(mean[1], 102.5, 0.01);
+
+        // Far from the data, predictions are much less certain
+        emulator.Predict(std::vector<double>(1, 10.0), far_mean, far_sd);
+        TS_ASSERT_LESS_THAN(100*sd[0], far_sd[0]);
+
+        // Errors
+        TS_ASSERT_THROWS_THIS(emulator.Predict(std::vector<double>(2, 0.0), mean, sd),
+                              "The emulator expects 1 inputs, not 2.");
+        inputs.push_back(std::vector<double>(1, 0.5));
+        TS_ASSERT_THROWS_THIS(emulator.Train(inputs, outputs),
+                              "Emulator training needs the same, non-zero, number of inputs and outputs.");
+    }
+
+    void TestEmulateSweep() throw (Exception)
+    {
+        FileFinder data_folder("data", FileFinder(__FILE__, RelativeTo::ChasteSourceRoot));
+
+        std::vector<unsigned> shape;
+        std::vector<double> heights = CryptEmulatorModel::ReadSweepOutput(
+                FileFinder("Uniform_Wnt-outputs_heights.csv", data_folder), shape);
+        TS_ASSERT_EQUALS(shape.size(), 1u);
+        TS_ASSERT_EQUALS(heights.size(), 5u);
+        TS_ASSERT_EQUALS(heights[2], 20.0);
+        std::vector<double> freqs = CryptEmulatorModel::ReadSweepOutput(
+                FileFinder("Uniform_Wnt-outputs_freqs.csv", data_folder), shape);
+        TS_ASSERT_EQUALS(shape.size(), 2u);
+        TS_ASSERT_EQUALS(shape[0], 5u);
+        TS_ASSERT_EQUALS(shape[1], 10u);
+        TS_ASSERT_EQUALS(freqs[0], 1578.0);
+        TS_ASSERT_EQUALS(freqs[1], 1660.0);
+        TS_ASSERT_EQUALS(freqs[10], 2791.0);
+
+        // Hold out the crypt height of 20, and check the emulator predicts the total number of divisions there
+        const unsigned held_out = 2u;
+        const unsigned num_boxes = shape[1];
+        std::vector<std::vector<double> > inputs;
+        std::vector<std::vector<double> > outputs;
+        for (unsigned i=0; i<heights.size(); i++)
+        {
+            if (i != held_out)
+            {
+                inputs.push_back(std::vector<double>(1, heights[i]));
+                outputs.push_back(std::vector<double>(freqs.begin() + i*num_boxes, freqs.begin() + (i+1)*num_boxes));
+            }
+        }
+        GaussianProcessEmulator emulator;
+        emulator.Train(inputs, outputs);
+
+        std::vector<double> mean, sd, training_mean, training_sd;
+        emulator.Predict(std::vector<double>(1, heights[held_out]), mean, sd);
+        emulator.Predict(std::vector<double>(1, heights[held_out-1]), training_mean, training_sd);
+        double predicted_total = 0.0, actual_total = 0.0, total_sd = 0.0, total_training_sd = 0.0;
+        for (unsigned box=0; box<num_boxes; box++)
+        {
+            predicted_total += mean[box];
+            actual_total += freqs[held_out*num_boxes + box];
+            total_sd += sd[box];
+            total_training_sd += training_sd[box];
+            if (freqs[held_out*num_boxes + box] == 0.0)
+            {
+                // Boxes above the proliferative region never have divisions
+                TS_ASSERT_DELTA(mean[box], 0.0, 1e-6);
+                TS_ASSERT_DELTA(sd[box], 0.0, 1e-6);
+            }
+        }
+        TS_ASSERT_DELTA(predicted_total / actual_total, 1.0, 0.05);
+        TS_ASSERT_LESS_THAN(total_training_sd, total_sd);
+    }
+
+    void TestRunProtocolOnEmulator() throw (Exception)
+    {
+        OutputFileHandler handler("TestCryptEmulator");
+        FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
+        ProtocolFileFinder proto_file("protocols/CryptProliferation.txt", this_test);
+
+        boost::shared_ptr<CryptEmulatorModel> p_emulator(
+                new CryptEmulatorModel(FileFinder("data", this_test), "Uniform_Wnt-"));
+        TS_ASSERT_EQUALS(p_emulator->rGetFreqsEmulator().GetNumOutputs(), 10u);
+        TS_ASSERT_THROWS_CONTAINS(CryptEmulatorModel(FileFinder("data", this_test), "Missing-"),
+                                  "Missing-outputs_heights.csv does not exist.");
+
+        // The core protocol runs as-is, with a crypt height not in the training sweep
+        ProtocolParser parser;
+        ProtocolPtr p_protocol = parser.ParseFile(proto_file);
+        p_protocol->SetOutputFolder(handler);
+        p_protocol->SetInput("crypt_height", boost::make_shared<ValueExpression>(CV(22.5)));
+        p_protocol->SetModel(p_emulator);
+        p_protocol->RunAndWrite("outputs");
+
+        // Its histogram matches the emulator's predictions
+        NdArray<double> freqs = GET_ARRAY(p_protocol->rGetOutputsCollection().Lookup("freqs", "TestCryptEmulator"));
+        EnvironmentCPtr p_model_outputs = p_emulator->GetOutputs();
+        NdArray<double> freqs_mean = GET_ARRAY(p_model_outputs->Lookup("freqs_mean", "TestCryptEmulator"));
+        NdArray<double> freqs_sd = GET_ARRAY(p_model_outputs->Lookup("freqs_sd", "TestCryptEmulator"));
+        TS_ASSERT_EQUALS(freqs.GetNumElements(), 10u);
+        TS_ASSERT_EQUALS(freqs_mean.GetNumElements(), 10u);
+        NdArray<double>::Iterator p_freq = freqs.Begin();
+        NdArray<double>::Iterator p_mean = freqs_mean.Begin();
+        NdArray<double>::Iterator p_sd = freqs_sd.Begin();
+        for (unsigned box=0; box<10u; ++box, ++p_freq, ++p_mean, ++p_sd)
+        {
+            TS_ASSERT_DELTA(*p_freq, *p_mean, 0.5);
+            TS_ASSERT_LESS_THAN_EQUALS(0.0, *p_sd);
+        }
+    }
+};
+
+#endif // TESTCRYPTEMULATOR_HPP_
@@ -0,0 +1,206 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTCRYPTJOBSERVER_HPP_
+#define TESTCRYPTJOBSERVER_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <fstream>
+#include <string>
+
+#include "CryptJobServer.hpp"
+#include "ProcessIsolation.hpp"
+
+#include "FileComparison.hpp"
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "SimulationTime.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestCryptJobServer : public CxxTest::TestSuite
+{
+private:
+    /**
+     * Write a job file.
+     *
+     * @param rHandler  the folder to write it in
+     * @param rFileName  the file name
+     * @param rContents  the job settings
+     */
+    void WriteJobFile(OutputFileHandler& rHandler, const std::string& rFileName, const std::string& rContents)
+    {
+        out_stream p_file = rHandler.OpenOutputFile(rFileName);
+        *p_file << rContents;
+        p_file->close();
+    }
+
+    /** @return  the absolute path to our short test protocol. */
+    std::string GetProtocolPath()
+    {
+        FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
+        return FileFinder("protocols/TestOptimisationOptions.txt", this_test).GetAbsolutePath();
+    }
+
+public:
+    void TestParseJobFile() throw (Exception)
+    {
+        OutputFileHandler handler("TestCryptJobServer_Parsing");
+        WriteJobFile(handler, "good.job", "# A calibration run\n"
+                                          "model = VARIABLE_WNT\n"
+                                          "\n"
+                                          "protocol = " + GetProtocolPath() + "\n"
+                                          "end_time = 2.5  # hours\n"
+                                          "dt_divisor=120\n");
+        CryptJobServer::Job job = CryptJobServer::ParseJobFile(handler.FindFile("good.job"));
+        TS_ASSERT_EQUALS(job.mModelType, CryptProliferationModel::VARIABLE_WNT);
+        TS_ASSERT_EQUALS(job.mProtocolPath, GetProtocolPath());
+        TS_ASSERT_EQUALS(job.mInputs.size(), 2u);
+        TS_ASSERT_EQUALS(job.mInputs["end_time"], 2.5);
+        TS_ASSERT_EQUALS(job.mInputs["dt_divisor"], 120.0);
+
+        TS_ASSERT_EQUALS(CryptJobServer::ParseModelType("UNIFORM_WNT"), CryptProliferationModel::UNIFORM_WNT);
+        TS_ASSERT_EQUALS(CryptJobServer::ParseModelType("STOCHASTIC_GEN_BASED"), CryptProliferationModel::STOCHASTIC_GEN_BASED);
+        TS_ASSERT_EQUALS(CryptJobServer::ParseModelType("CONTACT_INHIBITION"), CryptProliferationModel::CONTACT_INHIBITION);
+        TS_ASSERT_THROWS_THIS(CryptJobServer::ParseModelType("Uniform Wnt"),
+                              "Unknown model type 'Uniform Wnt'; use UNIFORM_WNT, VARIABLE_WNT, STOCHASTIC_GEN_BASED or CONTACT_INHIBITION.");
+
+        WriteJobFile(handler, "no_protocol.job", "model = UNIFORM_WNT\n");
+        TS_ASSERT_THROWS_CONTAINS(CryptJobServer::ParseJobFile(handler.FindFile("no_protocol.job")),
+                                  "must give both a model and a protocol.");
+        WriteJobFile(handler, "bad_line.job", "model = UNIFORM_WNT\nend_time\n");
+        TS_ASSERT_THROWS_CONTAINS(CryptJobServer::ParseJobFile(handler.FindFile("bad_line.job")),
+                                  "Line 2 of job file");
+        WriteJobFile(handler, "bad_value.job", "model = UNIFORM_WNT\nend_time = 10h\n");
+        TS_ASSERT_THROWS_CONTAINS(CryptJobServer::ParseJobFile(handler.FindFile("bad_value.job")),
+                                  "The value '10h' for protocol input 'end_time'");
+        TS_ASSERT_THROWS_CONTAINS(CryptJobServer::ParseJobFile(handler.FindFile("missing.job")),
+                                  "Unable to open job file");
+    }
+
+    void TestServeJobs() throw (Exception)
+    {
+        // A fresh job folder, with two jobs waiting, two that can't run, and one left by a server that was killed
+        std::string job_folder_name = "TestCryptJobServer_Serving";
+        OutputFileHandler handler(job_folder_name);
+        OutputFileHandler incoming_handler(handler.FindFile("incoming"));
+        OutputFileHandler running_handler(handler.FindFile("running"));
+        std::string job = "model = CONTACT_INHIBITION\nprotocol = " + GetProtocolPath() + "\nend_time = 1\n";
+        WriteJobFile(incoming_handler, "first.job", job);
+        WriteJobFile(incoming_handler, "second.job", job + "dt_divisor = 180\n");
+        WriteJobFile(incoming_handler, "broken.job", job + "no_such_input = 1\n");
+        WriteJobFile(incoming_handler, "distributed.job", job + "distributed = 1\n");
+        WriteJobFile(running_handler, "interrupted.job", job);
+
+        CryptJobServer server(job_folder_name);
+        server.SetExitWhenIdle(true);
+        server.SetPollInterval(0.1);
+        TS_ASSERT_EQUALS(server.Serve(), 5u);
+
+        TS_ASSERT(handler.FindFile("incoming").FindMatches("*.job").empty());
+        TS_ASSERT(handler.FindFile("running").FindMatches("*.job").empty());
+        TS_ASSERT_EQUALS(handler.FindFile("done").FindMatches("*.job").size(), 3u);
+        TS_ASSERT(handler.FindFile("failed/broken.job").IsFile());
+        TS_ASSERT(handler.FindFile("results/broken/error.txt").IsFile());
+        // Each process serves its own jobs, so none can share a crypt with the others
+        TS_ASSERT(handler.FindFile("failed/distributed.job").IsFile());
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+        TS_ASSERT(handler.FindFile("results/first/outputs_divisions.csv").IsFile());
+        TS_ASSERT(handler.FindFile("results/second/outputs_divisions.csv").IsFile());
+        TS_ASSERT(handler.FindFile("results/interrupted/outputs_divisions.csv").IsFile());
+
+        // The same job run again gives the same results
+        handler.FindFile("done/first.job").CopyTo(handler.FindFile("incoming/again.job"));
+        TS_ASSERT_EQUALS(server.Serve(), 1u);
+        FileComparison(handler.FindFile("results/first/outputs_divisions.csv"),
+                       handler.FindFile("results/again/outputs_divisions.csv")).CompareFiles();
+
+        // A stop file stops the server even when there are jobs waiting
+        WriteJobFile(handler, "stop", "");
+        WriteJobFile(incoming_handler, "waiting.job", job);
+        server.SetExitWhenIdle(false);
+        TS_ASSERT_EQUALS(server.Serve(), 0u);
+        TS_ASSERT(handler.FindFile("incoming/waiting.job").IsFile());
+    }
+
+    void TestJobAfterFailedJob() throw (Exception)
+    {
+        // A job that fails part way through its simulation, with a job on the same process after it
+        std::string job_folder_name = "TestCryptJobServer_AfterFailure";
+        OutputFileHandler handler(job_folder_name);
+        OutputFileHandler incoming_handler(handler.FindFile("incoming"));
+        std::string job = "model = CONTACT_INHIBITION\nprotocol = " + GetProtocolPath() + "\nend_time = 1\n";
+        WriteJobFile(incoming_handler, "alone.job", job);
+
+        CryptJobServer server(job_folder_name);
+        server.SetExitWhenIdle(true);
+        server.SetPollInterval(0.1);
+        TS_ASSERT_EQUALS(server.Serve(), 1u);
+
+        WriteJobFile(incoming_handler, "failing.job", job + "fused_update = 1\nimplicit_springs = 1\n");
+        WriteJobFile(incoming_handler, "following.job", job);
+        TS_ASSERT_EQUALS(server.Serve(), 2u);
+        TS_ASSERT(handler.FindFile("failed/failing.job").IsFile());
+        FileFinder error_file = handler.FindFile("results/failing/error.txt");
+        TS_ASSERT(error_file.IsFile());
+        std::ifstream error_stream(error_file.GetAbsolutePath().c_str());
+        std::string error_message;
+        std::getline(error_stream, error_message);
+        TS_ASSERT_EQUALS(error_message, "The fused position update can't treat spring forces implicitly.");
+
+        // The failed simulation's singletons were cleaned up, so the next job ran as if it were alone
+        TS_ASSERT(!SimulationTime::Instance()->IsStartTimeSetUp());
+        SimulationTime::Destroy();
+        TS_ASSERT(handler.FindFile("done/following.job").IsFile());
+        FileComparison(handler.FindFile("results/alone/outputs_divisions.csv"),
+                       handler.FindFile("results/following/outputs_divisions.csv")).CompareFiles();
+
+        // The server logged each job
+        FileFinder log_file = handler.FindFile("server_log.txt");
+        TS_ASSERT(log_file.IsFile());
+        std::ifstream log_stream(log_file.GetAbsolutePath().c_str());
+        std::string line;
+        unsigned num_lines = 0;
+        while (std::getline(log_stream, line))
+        {
+            num_lines++;
+        }
+        TS_ASSERT_EQUALS(line, "Finished job following");
+        TS_ASSERT_EQUALS(num_lines, 6u);
+    }
+};
+
+#endif // TESTCRYPTJOBSERVER_HPP_
@@ -0,0 +1,142 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TESTCRYPTJOBSERVERPARALLEL_HPP_
+#define TESTCRYPTJOBSERVERPARALLEL_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <sstream>
+#include <string>
+
+#include "CryptJobServer.hpp"
+#include "ProcessIsolation.hpp"
+
+#include "FileComparison.hpp"
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+#include "SimulationTime.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Tests of the job server's master and worker processes, so should be run with at least 2 processes.  On one
+ * process the server runs jobs itself, and the tests still pass.
+ */
+class TestCryptJobServerParallel : public CxxTest::TestSuite
+{
+private:
+    /**
+     * Write a job file from the master process, and wait until the others can see it.
+     *
+     * @param rHandler  the folder to write it in
+     * @param rFileName  the file name
+     * @param rContents  the job settings
+     */
+    void WriteJobFile(OutputFileHandler& rHandler, const std::string& rFileName, const std::string& rContents)
+    {
+        if (PetscTools::AmMaster())
+        {
+            out_stream p_file = rHandler.OpenOutputFile(rFileName);
+            *p_file << rContents;
+            p_file->close();
+        }
+        PetscTools::Barrier("TestCryptJobServerParallel::WriteJobFile");
+    }
+
+    /** @return  the absolute path to our short test protocol. */
+    std::string GetProtocolPath()
+    {
+        FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
+        return FileFinder("protocols/TestOptimisationOptions.txt", this_test).GetAbsolutePath();
+    }
+
+public:
+    void TestServeFromWorkers() throw (Exception)
+    {
+        std::string job_folder_name = "TestCryptJobServerParallel";
+        OutputFileHandler handler(job_folder_name);
+        OutputFileHandler incoming_handler(handler.FindFile("incoming"));
+        std::string job = "model = CONTACT_INHIBITION\nprotocol = " + GetProtocolPath() + "\nend_time = 1\n";
+        const unsigned expected_finished = PetscTools::AmMaster() ? 1u : 0u;
+
+        // One worker runs a job, then a job that fails part way through its simulation, then a copy of the first
+        CryptJobServer server(job_folder_name);
+        server.SetExitWhenIdle(true);
+        server.SetPollInterval(0.1);
+        server.SetMaxWorkers(1u);
+        WriteJobFile(incoming_handler, "alone.job", job);
+        TS_ASSERT_EQUALS(server.Serve(), expected_finished);
+        WriteJobFile(incoming_handler, "failing.job", job + "fused_update = 1\nimplicit_springs = 1\n");
+        WriteJobFile(incoming_handler, "following.job", job);
+        TS_ASSERT_EQUALS(server.Serve(), 2u*expected_finished);
+        TS_ASSERT(handler.FindFile("failed/failing.job").IsFile());
+        TS_ASSERT(handler.FindFile("results/failing/error.txt").IsFile());
+        TS_ASSERT(handler.FindFile("done/following.job").IsFile());
+        FileComparison(handler.FindFile("results/alone/outputs_divisions.csv"),
+                       handler.FindFile("results/following/outputs_divisions.csv")).CompareFiles();
+
+        // Every worker runs jobs, but none may share a crypt with the others
+        const unsigned num_copies = 2u*PetscTools::GetNumProcs();
+        for (unsigned i=0; i<num_copies; i++)
+        {
+            std::stringstream name;
+            name << "copy" << i << ".job";
+            WriteJobFile(incoming_handler, name.str(), job);
+        }
+        WriteJobFile(incoming_handler, "distributed.job", job + "distributed = 1\n");
+        server.SetMaxWorkers(0u);
+        TS_ASSERT_EQUALS(server.Serve(), (num_copies + 1u)*expected_finished);
+        TS_ASSERT(handler.FindFile("incoming").FindMatches("*.job").empty());
+        TS_ASSERT(handler.FindFile("running").FindMatches("*.job").empty());
+        TS_ASSERT(handler.FindFile("failed/distributed.job").IsFile());
+        for (unsigned i=0; i<num_copies; i++)
+        {
+            std::stringstream name;
+            name << "results/copy" << i << "/outputs_divisions.csv";
+            FileComparison(handler.FindFile("results/alone/outputs_divisions.csv"),
+                           handler.FindFile(name.str())).CompareFiles();
+        }
+        TS_ASSERT(handler.FindFile("server_log.txt").IsFile());
+
+        // Every process is left as it was found
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+        TS_ASSERT(!PetscTools::IsIsolated());
+        TS_ASSERT(!SimulationTime::Instance()->IsStartTimeSetUp());
+        SimulationTime::Destroy();
+    }
+};
+
+#endif // TESTCRYPTJOBSERVERPARALLEL_HPP_
@@ -0,0 +1,104 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTCRYPTPROLIFERATIONADAPTIVESWEEP_HPP_
+#define TESTCRYPTPROLIFERATIONADAPTIVESWEEP_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <map>
+#include <string>
+#include <vector>
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+
+#include "CryptProliferationModel.hpp"
+#include "CryptSweepRunner.hpp"
+
+#include "ProtocolFileFinder.hpp"
+
+#include "FileFinder.hpp"
+#include "PetscTools.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Runs an adaptive version of the paper's parameter sweep (see TestCryptProliferationLiteratePaper), starting from
+ * crypt heights of 10, 20 and 30 and with the same total budget as the fixed sweep (the sum of all heights
+ * simulated, over the three models, is 300).  The extra heights chosen, and the round in which each was added,
+ * are listed in outputs_heights.csv and outputs_refinement_round.csv for each model.
+ *
+ * This costs as much as the paper's full sweep, so is in the Simulations test pack.
+ */
+class TestCryptProliferationAdaptiveSweep : public CxxTest::TestSuite
+{
+public:
+    void TestAdaptiveParameterSweep() throw (Exception)
+    {
+        FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
+        ProtocolFileFinder proto_file("protocols/CryptProliferation.txt", this_test);
+        std::vector<CryptProliferationModel::ModelType> model_types = boost::assign::list_of
+                (CryptProliferationModel::UNIFORM_WNT)
+                (CryptProliferationModel::VARIABLE_WNT)
+                (CryptProliferationModel::STOCHASTIC_GEN_BASED);
+        std::vector<double> heights = boost::assign::list_of(10)(20)(30);
+
+        // Refine where adjacent histograms differ most, but not below a spacing of one cell diameter
+        const std::string output_folder_name = "CryptProliferationAdaptiveSweep";
+        CryptSweepRunner runner(proto_file, output_folder_name, model_types);
+        runner.AddSweepAxis("crypt_height", "heights", "Crypt height", heights, true);
+        runner.SetAdaptiveRefinement(300.0, 0u, 1.0);
+        std::map<std::string, double> protocol_inputs;
+        protocol_inputs["num_boxes"] = 10;
+        runner.SetProtocolInputs(protocol_inputs);
+        runner.SetResultCacheMode(ResultCache::GetModeFromEnvironment(ResultCache::BYPASS));
+        bool success = runner.Run();
+
+        if (PetscTools::AmMaster())
+        {
+            TS_ASSERT(success);
+            BOOST_FOREACH(CryptProliferationModel::ModelType model_type, model_types)
+            {
+                FileFinder model_folder(output_folder_name + "/" + CryptSweepRunner::GetModelFolderName(model_type),
+                                        RelativeTo::ChasteTestOutput);
+                TS_ASSERT(FileFinder("outputs_heights.csv", model_folder).IsFile());
+                TS_ASSERT(FileFinder("outputs_refinement_round.csv", model_folder).IsFile());
+                TS_ASSERT(FileFinder("outputs_norm_freqs.csv", model_folder).IsFile());
+            }
+        }
+    }
+};
+
+#endif // TESTCRYPTPROLIFERATIONADAPTIVESWEEP_HPP_
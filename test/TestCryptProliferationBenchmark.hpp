@@ -0,0 +1,331 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TESTCRYPTPROLIFERATIONBENCHMARK_HPP_
+#define TESTCRYPTPROLIFERATIONBENCHMARK_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+
+#include "CryptProliferationModel.hpp"
+#include "CryptPhaseTimer.hpp"
+#include "CryptProtocolTestHelper.hpp"
+#include "PerfCounterGroup.hpp"
+
+#include "OutputFileHandler.hpp"
+#include "Timer.hpp"
+#include "FakePetscSetup.hpp"
+
+/**
+ * Benchmarks for how the cost of a crypt simulation grows with crypt size, for each model variant, for
+ * how renumbering nodes along a space-filling curve affects a long run, and for the cost and accuracy of
+ * treating springs implicitly with larger timesteps.
+ *
+ * Results are written to CryptProliferationBenchmark/benchmark_results.csv, with one row per configuration,
+ * CryptProliferationBenchmark_Reordering/reordering_results.csv and
+ * CryptProliferationBenchmark_SemiImplicit/accuracy_results.csv.
+ * This suite takes a long time to run, so is in the Benchmark test pack rather than Continuous.
+ */
+class TestCryptProliferationBenchmark : public CxxTest::TestSuite
+{
+private:
+    /**
+     * Reset the peak resident set size recorded by the kernel for this process, so that the next
+     * call to GetPeakRssKb() reflects only subsequent memory use.  Not all kernels support this, in
+     * which case the peak is since process start, and configurations should be run in increasing size.
+     */
+    void ResetPeakRss()
+    {
+        std::ofstream clear_refs("/proc/self/clear_refs");
+        if (clear_refs.is_open())
+        {
+            clear_refs << "5" << std::endl;
+        }
+    }
+
+    /**
+     * @return  the peak resident set size of this process, in kB, or 0 if it can't be determined
+     */
+    unsigned GetPeakRssKb()
+    {
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line))
+        {
+            if (line.compare(0, 6, "VmHWM:") == 0)
+            {
+                return atoi(line.substr(6).c_str());
+            }
+        }
+        return 0u;
+    }
+
+public:
+    void TestScalingWithCryptSize() throw (Exception)
+    {
+        OutputFileHandler handler("CryptProliferationBenchmark");
+
+        const double end_time = 10.0; // Simulated hours for each configuration
+        std::vector<CryptProliferationModel::ModelType> model_types = boost::assign::list_of
+                (CryptProliferationModel::UNIFORM_WNT)
+                (CryptProliferationModel::VARIABLE_WNT)
+                (CryptProliferationModel::STOCHASTIC_GEN_BASED)
+                (CryptProliferationModel::CONTACT_INHIBITION);
+        std::vector<double> heights = boost::assign::list_of(10)(25)(50)(75)(100); // Cell diameters
+        std::vector<double> widths = boost::assign::list_of(14)(28);               // Cells across
+        std::vector<double> sloughing_options = boost::assign::list_of(0)(1);      // Whether to use height buckets
+
+        out_stream p_results = handler.OpenOutputFile("benchmark_results.csv");
+        *p_results << "model,crypt_length,cells_across,cells_up,bucketed_sloughing,end_time,wall_time,"
+                   << "wall_time_per_hour,peak_num_cells,peak_num_nodes,peak_rss_kb,sloughing_seconds" << std::endl;
+
+        BOOST_FOREACH(CryptProliferationModel::ModelType model_type, model_types)
+        {
+            BOOST_FOREACH(double cells_across, widths)
+            {
+                BOOST_FOREACH(double height, heights)
+                {
+                    BOOST_FOREACH(double bucketed, sloughing_options)
+                    {
+                        std::stringstream folder;
+                        folder << "CryptProliferationBenchmark/" << (unsigned)model_type
+                               << "_" << cells_across << "_" << height << "_" << bucketed;
+                        std::map<std::string, double> inputs;
+                        inputs["crypt_height"] = height;
+                        inputs["cells_across"] = cells_across;
+                        inputs["end_time"] = end_time;
+                        inputs["bucketed_sloughing"] = bucketed;
+                        ProtocolPtr p_protocol = CryptProtocolTestHelper::Create(
+                                "CryptProliferationBenchmark", folder.str(),
+                                boost::shared_ptr<AbstractSystemWithOutputs>(new CryptProliferationModel(model_type)), inputs);
+
+                        ResetPeakRss();
+                        Timer::Reset();
+                        p_protocol->RunAndWrite("outputs");
+                        double wall_time = Timer::GetElapsedTime();
+
+                        unsigned peak_cells = (unsigned)CryptProtocolTestHelper::GetValueOutput(p_protocol, "peak_num_cells");
+                        unsigned peak_nodes = (unsigned)CryptProtocolTestHelper::GetValueOutput(p_protocol, "peak_num_nodes");
+                        TS_ASSERT_LESS_THAN(0u, peak_cells);
+                        TS_ASSERT_LESS_THAN_EQUALS(peak_cells, peak_nodes);
+                        // Timings have a row of (seconds, calls) per phase
+                        std::vector<double> timing_values = CryptProtocolTestHelper::GetArrayOutput(p_protocol, "timings");
+                        double sloughing_seconds = timing_values[2*CryptPhaseTimer::SLOUGHING];
+
+                        *p_results << CryptProliferationModel::GetModelName(model_type) << "," << height << ","
+                                   << cells_across << "," << ceil(height * 2 / sqrt(3.0)) << "," << bucketed << ","
+                                   << end_time << "," << wall_time << "," << wall_time/end_time << ","
+                                   << peak_cells << "," << peak_nodes << "," << GetPeakRssKb() << ","
+                                   << sloughing_seconds << std::endl;
+                    }
+                }
+            }
+        }
+        p_results->close();
+    }
+
+    void TestNodeReordering() throw (Exception)
+    {
+        OutputFileHandler handler("CryptProliferationBenchmark_Reordering");
+
+        // A long run of a large crypt, so that without reordering node numbering has time to become scrambled
+        const double end_time = 100.0;
+        const double height = 50.0;
+        const double cells_across = 28.0;
+        std::vector<double> reorder_intervals = boost::assign::list_of(0)(1)(10); // Hours
+        std::vector<CryptPhaseTimer::Phase> phases = boost::assign::list_of
+                (CryptPhaseTimer::REMESH)
+                (CryptPhaseTimer::SPRING_FORCE)
+                (CryptPhaseTimer::POSITION_UPDATE)
+                (CryptPhaseTimer::VOLUME_TRACKING)
+                (CryptPhaseTimer::TIMESTEP);
+
+        out_stream p_results = handler.OpenOutputFile("reordering_results.csv");
+        *p_results << "reorder_interval,wall_time_per_hour";
+        BOOST_FOREACH(CryptPhaseTimer::Phase phase, phases)
+        {
+            *p_results << "," << CryptPhaseTimer::GetPhaseName(phase) << "_seconds,"
+                       << CryptPhaseTimer::GetPhaseName(phase) << "_cache_misses";
+        }
+        *p_results << std::endl;
+
+        std::vector<double> reference_freqs;
+        BOOST_FOREACH(double reorder_interval, reorder_intervals)
+        {
+            std::stringstream folder;
+            folder << "CryptProliferationBenchmark_Reordering/" << reorder_interval;
+            std::map<std::string, double> inputs;
+            inputs["crypt_height"] = height;
+            inputs["cells_across"] = cells_across;
+            inputs["end_time"] = end_time;
+            inputs["reorder_interval"] = reorder_interval;
+            inputs["perf_counters"] = 1.0;
+            ProtocolPtr p_protocol = CryptProtocolTestHelper::Create(
+                    "CryptProliferationBenchmark", folder.str(),
+                    boost::shared_ptr<AbstractSystemWithOutputs>(
+                            new CryptProliferationModel(CryptProliferationModel::CONTACT_INHIBITION)), inputs);
+
+            Timer::Reset();
+            p_protocol->RunAndWrite("outputs");
+            double wall_time = Timer::GetElapsedTime();
+
+            // Timings have a row of (seconds, calls) per phase, and counters a row of PerfCounterGroup::Counter
+            std::vector<double> timing_values = CryptProtocolTestHelper::GetArrayOutput(p_protocol, "timings");
+            std::vector<double> counter_values = CryptProtocolTestHelper::GetArrayOutput(p_protocol, "perf_counters");
+            TS_ASSERT_EQUALS(timing_values.size(), 2u*CryptPhaseTimer::NUM_PHASES);
+            TS_ASSERT_EQUALS(counter_values.size(), CryptPhaseTimer::NUM_PHASES * PerfCounterGroup::NUM_COUNTERS);
+            // Reordering mustn't skip or repeat timesteps, of which there are 360 per hour by default
+            TS_ASSERT_DELTA(timing_values[2*CryptPhaseTimer::TIMESTEP + 1], end_time*360.0, 1.0);
+
+            // Renumbering nodes changes the order in which forces are summed, so trajectories diverge from the run
+            // without reordering, but divisions should be distributed up the crypt in the same way
+            std::vector<double> freqs = CryptProtocolTestHelper::GetArrayOutput(p_protocol, "freqs");
+            if (reference_freqs.empty())
+            {
+                reference_freqs = freqs;
+            }
+            TS_ASSERT_LESS_THAN(0.0, CryptProtocolTestHelper::GetTotal(freqs));
+            TS_ASSERT_LESS_THAN_EQUALS(CryptProtocolTestHelper::GetMaxPercentageDifference(freqs, reference_freqs),
+                                       CryptProtocolTestHelper::GetPercentageTolerance(freqs, reference_freqs));
+
+            *p_results << reorder_interval << "," << wall_time/end_time;
+            BOOST_FOREACH(CryptPhaseTimer::Phase phase, phases)
+            {
+                *p_results << "," << timing_values[2*phase] << ","
+                           << counter_values[phase*PerfCounterGroup::NUM_COUNTERS + PerfCounterGroup::CACHE_MISSES];
+            }
+            *p_results << std::endl;
+        }
+        p_results->close();
+    }
+
+    void TestSemiImplicitAccuracy() throw (Exception)
+    {
+        OutputFileHandler handler("CryptProliferationBenchmark_SemiImplicit");
+
+        // Long enough after steady state for the division histograms to settle
+        const double end_time = 600.0;
+        const double steady_state_time = 100.0;
+        const double height = 15.0;
+        // The explicit update at the usual timestep is the reference; the semi-implicit update is run at the
+        // same timestep, and with timesteps 10, 20 and 50 times larger.  Up to 20 times larger, the histograms
+        // must match the reference; the largest timestep shows where accuracy is lost, so is only reported.
+        const double min_checked_dt_divisor = 18.0;
+        std::vector<std::pair<double, double> > configurations = boost::assign::list_of
+                (std::make_pair(0.0, 360.0))
+                (std::make_pair(1.0, 360.0))
+                (std::make_pair(1.0, 36.0))
+                (std::make_pair(1.0, 18.0))
+                (std::make_pair(1.0, 7.0));
+        std::vector<CryptProliferationModel::ModelType> model_types = boost::assign::list_of
+                (CryptProliferationModel::UNIFORM_WNT)
+                (CryptProliferationModel::CONTACT_INHIBITION);
+
+        // Histograms are compared as percentages of divisions per box, as in the paper
+        out_stream p_results = handler.OpenOutputFile("accuracy_results.csv");
+        *p_results << "model,implicit_springs,dt_divisor,wall_time,num_divisions,max_abs_diff_percent,"
+                   << "sum_abs_diff_percent,tolerance_percent,norm_freqs" << std::endl;
+
+        BOOST_FOREACH(CryptProliferationModel::ModelType model_type, model_types)
+        {
+            std::vector<double> reference_freqs;
+            typedef std::pair<double, double> Configuration;
+            BOOST_FOREACH(Configuration configuration, configurations)
+            {
+                std::stringstream folder;
+                folder << "CryptProliferationBenchmark_SemiImplicit/" << (unsigned)model_type
+                       << "_" << configuration.first << "_" << configuration.second;
+                std::map<std::string, double> inputs;
+                inputs["crypt_height"] = height;
+                inputs["end_time"] = end_time;
+                inputs["steady_state_time"] = steady_state_time;
+                inputs["implicit_springs"] = configuration.first;
+                inputs["dt_divisor"] = configuration.second;
+                ProtocolPtr p_protocol = CryptProtocolTestHelper::Create(
+                        "CryptProliferationBenchmark", folder.str(),
+                        boost::shared_ptr<AbstractSystemWithOutputs>(new CryptProliferationModel(model_type)), inputs);
+
+                Timer::Reset();
+                p_protocol->RunAndWrite("outputs");
+                double wall_time = Timer::GetElapsedTime();
+
+                std::vector<double> freqs = CryptProtocolTestHelper::GetArrayOutput(p_protocol, "freqs");
+                double num_divisions = CryptProtocolTestHelper::GetTotal(freqs);
+                TS_ASSERT_LESS_THAN(0.0, num_divisions);
+                if (reference_freqs.empty())
+                {
+                    reference_freqs = freqs;
+                }
+                std::vector<double> norm_freqs = CryptProtocolTestHelper::GetPercentages(freqs);
+                std::vector<double> reference_norm_freqs = CryptProtocolTestHelper::GetPercentages(reference_freqs);
+
+                double max_diff = CryptProtocolTestHelper::GetMaxPercentageDifference(freqs, reference_freqs);
+                double sum_diff = 0.0;
+                for (unsigned i=0; i<norm_freqs.size(); i++)
+                {
+                    sum_diff += fabs(norm_freqs[i] - reference_norm_freqs[i]);
+                }
+                double tolerance = CryptProtocolTestHelper::GetPercentageTolerance(freqs, reference_freqs);
+                if (configuration.second >= min_checked_dt_divisor)
+                {
+                    TS_ASSERT_LESS_THAN_EQUALS(max_diff, tolerance);
+                }
+
+                *p_results << CryptProliferationModel::GetModelName(model_type) << "," << configuration.first << ","
+                           << configuration.second << "," << wall_time << "," << num_divisions << ","
+                           << max_diff << "," << sum_diff << "," << tolerance << ",";
+                for (unsigned i=0; i<norm_freqs.size(); i++)
+                {
+                    *p_results << (i == 0 ? "" : " ") << norm_freqs[i];
+                }
+                *p_results << std::endl;
+            }
+        }
+        p_results->close();
+    }
+};
+
+#endif // TESTCRYPTPROLIFERATIONBENCHMARK_HPP_
@@ -0,0 +1,185 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTCRYPTPROLIFERATIONBENCHMARKPARALLEL_HPP_
+#define TESTCRYPTPROLIFERATIONBENCHMARKPARALLEL_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+
+#include "CryptProliferationModel.hpp"
+#include "CryptPhaseTimer.hpp"
+#include "CryptProtocolTestHelper.hpp"
+#include "CryptSlabDecomposition.hpp"
+#include "ProcessIsolation.hpp"
+
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+#include "Timer.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Benchmark for whether sharing a crypt's spring forces between processes (the protocols' distributed input;
+ * see CryptSlabDecomposition) makes it run faster.
+ *
+ * Each crypt is first run on the first process alone with node state arrays, which is what a distributed run
+ * does on one process, while the others wait; then it is run distributed over all the processes.  The wall time
+ * of the distributed run is that of the slowest process.  Only the spring forces are shared out, so the spring
+ * force phase is reported separately from the whole run.
+ *
+ * Run this with the numbers of processes of interest, e.g. 1, 2, 4 and 8; each writes
+ * CryptProliferationBenchmark_Distributed/scaling_<N>_processes.csv, with one row per crypt size.
+ * This suite takes a long time to run, so is in the Benchmark test pack rather than Parallel.
+ */
+class TestCryptProliferationBenchmarkParallel : public CxxTest::TestSuite
+{
+private:
+    /**
+     * Run one crypt on this process.  Processes must be isolated.
+     *
+     * @param rFolder  the output folder
+     * @param height  the crypt height
+     * @param cellsAcross  the number of cells around the crypt
+     * @param endTime  the simulated hours
+     * @param rOptionName  the protocol input to set to 1
+     * @param rSpringSeconds  set to the time spent computing spring forces
+     * @return  the wall time of the run
+     */
+    double RunCrypt(const std::string& rFolder, double height, double cellsAcross, double endTime,
+                    const std::string& rOptionName, double& rSpringSeconds)
+    {
+        std::map<std::string, double> inputs;
+        inputs["crypt_height"] = height;
+        inputs["cells_across"] = cellsAcross;
+        inputs["end_time"] = endTime;
+        inputs[rOptionName] = 1.0;
+        ProtocolPtr p_protocol = CryptProtocolTestHelper::Create(
+                "CryptProliferationBenchmark", rFolder,
+                boost::shared_ptr<AbstractSystemWithOutputs>(
+                        new CryptProliferationModel(CryptProliferationModel::CONTACT_INHIBITION)), inputs);
+
+        Timer::Reset();
+        p_protocol->RunAndWrite("outputs");
+        double wall_time = Timer::GetElapsedTime();
+
+        // Timings have a row of (seconds, calls) per phase
+        std::vector<double> timing_values = CryptProtocolTestHelper::GetArrayOutput(p_protocol, "timings");
+        rSpringSeconds = timing_values[2*CryptPhaseTimer::SPRING_FORCE];
+        return wall_time;
+    }
+
+    /**
+     * @param value  this process's value
+     * @return  the largest value over all processes
+     */
+    double GetMaxOverProcesses(double value)
+    {
+        double max_value = value;
+        MPI_Allreduce(&value, &max_value, 1, MPI_DOUBLE, MPI_MAX, PETSC_COMM_WORLD);
+        return max_value;
+    }
+
+public:
+    void TestDistributedSpeedup() throw (Exception)
+    {
+        const double end_time = 10.0; // Simulated hours for each crypt
+        const double cells_across = 28.0;
+        std::vector<double> heights = boost::assign::list_of(25)(50)(100); // Cell diameters
+        unsigned num_processes = CryptSlabDecomposition::GetNumProcesses();
+        unsigned rank = PetscTools::GetMyRank();
+
+        std::stringstream results_name;
+        results_name << "scaling_" << num_processes << "_processes.csv";
+        OutputFileHandler handler("CryptProliferationBenchmark_Distributed", false);
+        out_stream p_results;
+        if (PetscTools::AmMaster())
+        {
+            p_results = handler.OpenOutputFile(results_name.str());
+            *p_results << "num_processes,crypt_length,cells_across,end_time,serial_wall_time,distributed_wall_time,"
+                       << "speedup,serial_spring_seconds,distributed_spring_seconds,spring_speedup" << std::endl;
+        }
+
+        BOOST_FOREACH(double height, heights)
+        {
+            std::stringstream folder;
+            folder << "CryptProliferationBenchmark_Distributed/" << height << "_";
+
+            double serial_time = 0.0;
+            double serial_spring_seconds = 0.0;
+            if (rank == 0u)
+            {
+                ProcessIsolation::IsolationGuard isolated;
+                serial_time = RunCrypt(folder.str() + "serial", height, cells_across, end_time,
+                                       "node_state_arrays", serial_spring_seconds);
+            }
+            PetscTools::Barrier("TestDistributedSpeedup");
+
+            std::stringstream distributed_folder;
+            distributed_folder << folder.str() << "distributed_" << num_processes << "/" << rank;
+            double spring_seconds = 0.0;
+            double wall_time = 0.0;
+            {
+                ProcessIsolation::IsolationGuard isolated;
+                wall_time = RunCrypt(distributed_folder.str(), height, cells_across, end_time,
+                                     "distributed", spring_seconds);
+            }
+            double distributed_time = GetMaxOverProcesses(wall_time);
+            double distributed_spring_seconds = GetMaxOverProcesses(spring_seconds);
+            TS_ASSERT_LESS_THAN(0.0, distributed_time);
+
+            if (PetscTools::AmMaster())
+            {
+                TS_ASSERT_LESS_THAN(0.0, serial_time);
+                *p_results << num_processes << "," << height << "," << cells_across << "," << end_time << ","
+                           << serial_time << "," << distributed_time << "," << serial_time/distributed_time << ","
+                           << serial_spring_seconds << "," << distributed_spring_seconds << ","
+                           << serial_spring_seconds/distributed_spring_seconds << std::endl;
+            }
+        }
+        if (PetscTools::AmMaster())
+        {
+            p_results->close();
+        }
+    }
+};
+
+#endif // TESTCRYPTPROLIFERATIONBENCHMARKPARALLEL_HPP_
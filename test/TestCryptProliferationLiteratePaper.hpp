@@ -61,12 +61,14 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  * {{{
  * scons -j4 chaste_libs=1 build=GccOptNative projects/Wisc2013/test/TestCryptProliferationLiteratePaper.hpp
  * }}}
- * to build on 4 cores.  You can additionally run the code itself in parallel, in order to run each value
- * in the main parameter sweep simultaneously, using 5 cores with the `GccOptNative_5` build type, e.g.
+ * to build on 4 cores.  You can additionally run the code itself in parallel, e.g. using 5 cores with the
+ * `GccOptNative_5` build type:
  * {{{
  * scons -j4 chaste_libs=1 build=GccOptNative_5 projects/Wisc2013/test/TestCryptProliferationLiteratePaper.hpp
  * }}}
- * With these settings on our test machine, reproducing the paper results takes about 19 hours.
+ * All the simulations, for every model and crypt height, are then run as a single pool of independent jobs,
+ * with one process handing out jobs to the others as they become free, tallest crypts first.  Up to 16
+ * processes (15 simulations plus the coordinating process) can be used effectively.
  */
 
 /* == The code itself ==
@@ -79,17 +81,16 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <vector>
 #include <boost/assign/list_of.hpp>
-#include <boost/make_shared.hpp>
 #include <boost/foreach.hpp>
 
-// Code in this project, defining the crypt model
+// Code in this project, defining the crypt model and how to run sweeps over it
 #include "CryptProliferationModel.hpp"
+#include "CryptSweepRunner.hpp"
 
 // Functional Curation headers
-#include "Protocol.hpp"
-#include "ProtocolParser.hpp"
 #include "ProtocolFileFinder.hpp"
-#include "ValueExpression.hpp"
+#include "ProtocolParser.hpp"
+#include "ProtoHelperMacros.hpp"
 
 // Core Chaste headers
 #include "FileFinder.hpp"
@@ -109,137 +110,104 @@ class TestCryptProliferationLiteratePaper : public CxxTest::TestSuite
      * Optionally some of the protocol inputs may be overridden by providing a non-empty map
      * as the third argument.
      *
-     * The fourth argument modelsInParallel specifies whether, if multiple processes are available,
-     * to run the protocol on multiple models simultaneously, or whether the protocol should try to
-     * parallelise internally.
-     *
      * If the copyPlots argument is given as true, then all automatically generated results
      * plots in the sub-folder for each model will be copied to the parent results folder,
      * with names that include the model name, for easy inclusion in the paper.
      *
      * If the rCheckResults vector is non-empty, then this list of results data files will be
      * checked against recorded values, in order to ensure that the simulation results have not changed.
+     *
+     * If the rHeights vector is non-empty, then the protocol is run for each of these crypt heights,
+     * and the division histograms gathered together as for the `CryptProliferationSweep` protocol.
      */
     void RunProtocol(const std::string& rProtocolName, const std::string& rOutputFolderName,
                      const std::map<std::string, double>& rProtocolInputs,
-                     bool modelsInParallel,
                      bool copyPlots=false,
-                     const std::vector<std::string>& rCheckResults=std::vector<std::string>())
+                     const std::vector<std::string>& rCheckResults=std::vector<std::string>(),
+                     const std::vector<double>& rHeights=std::vector<double>())
     {
-        /* Create the folder to which outputs should be written. */
-        OutputFileHandler handler(rOutputFolderName);
         /* Locate the protocol definition on the file system. */
         FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
         ProtocolFileFinder proto_file("protocols/" + rProtocolName + ".txt", this_test);
 
-        if (modelsInParallel)
-        {
-            /* Allow the different models to be run simultaneously, if multiple processes are available. */
-            PetscTools::IsolateProcesses(true);
-        }
-
-        /* Loop over available (cell cycle) models. */
+        /* The available (cell cycle) models. */
         std::vector<CryptProliferationModel::ModelType> model_types = boost::assign::list_of
                 (CryptProliferationModel::UNIFORM_WNT)
                 (CryptProliferationModel::VARIABLE_WNT)
                 (CryptProliferationModel::STOCHASTIC_GEN_BASED);
-        for (unsigned i=0; i<model_types.size(); i++)
-        {
-            if (modelsInParallel && PetscTools::IsParallel() && i % PetscTools::GetNumProcs() != PetscTools::GetMyRank())
-            {
-                // Let another process run this model
-                continue;
-            }
-
-            /* Get a human readable name for the model to run in this loop iteration. */
-            CryptProliferationModel::ModelType model_type = model_types[i];
-            std::string model_name = CryptProliferationModel::GetModelName(model_type);
-
-            /* Output for each model gets written to a sub-folder of the main output folder, named after the model. */
-            std::string sub_folder_name = model_name;
-            FileFinder::ReplaceSpacesWithUnderscores(sub_folder_name);
-            OutputFileHandler sub_handler(handler.FindFile(sub_folder_name));
-
-            /* Load the model to simulate. */
-            boost::shared_ptr<AbstractSystemWithOutputs> p_model(new CryptProliferationModel(model_type));
-
-            /* Load the protocol to run on it. */
-            ProtocolParser parser;
-            ProtocolPtr p_protocol = parser.ParseFile(proto_file);
-            p_protocol->SetOutputFolder(sub_handler);
-            p_protocol->SetModel(p_model);
 
-            /* As an alternative to running different models on different processes, the Functional Curation system
-             * can also parallelise nested simulation loops automatically in some circumstances.  This line turns
-             * that functionality on if modelsInParallel is false, which is the case for the main parameter sweep.
-             * Thus while generating the steady state plots can use at most 3 processes (corresponding to the 3 cell
-             * cycle models) the parameter sweep can use up to 5 (the number of crypt heights to test).
-             */
-            p_protocol->SetParalleliseLoops(!modelsInParallel);
+        /* Every combination of model and crypt height is an independent simulation, so we treat them all as
+         * separate jobs, which are handed out to processes largest first as the processes become free.  This
+         * is done by a `CryptSweepRunner`, which builds a fresh model instance and protocol for each job, and
+         * writes the output for each model to a sub-folder of the main output folder, named after the model.
+         * Thus the steady state plots can use up to 3 processes, and the parameter sweep up to 15.
+         *
+         * Simulating a tall crypt takes several times longer than a short one, so we tell the runner that
+         * job cost scales with crypt height.  The histograms from each height are gathered together into the
+         * same outputs as the `CryptProliferationSweep` protocol would produce.
+         */
+        CryptSweepRunner runner(proto_file, rOutputFolderName, model_types);
+        if (!rHeights.empty())
+        {
+            runner.AddSweepAxis("crypt_height", "heights", "Crypt height", rHeights, true);
+        }
 
-            /* Override some of the protocol's inputs if requested. */
-            typedef std::pair<std::string, double> StringDoublePair;
-            BOOST_FOREACH(StringDoublePair input, rProtocolInputs)
-            {
-                p_protocol->SetInput(input.first, boost::make_shared<ValueExpression>(boost::make_shared<SimpleValue>(input.second)));
-            }
+        /* Override some of the protocol's inputs if requested. */
+        runner.SetProtocolInputs(rProtocolInputs);
 
-            /* By default the Functional Curation system uses the plot titles specified in the protocol, and names
-             * the generated files after the title too.  However, where multiple models are being simulated under
-             * the same protocol, it is more useful to title plots based on the model name.  We also add a sub-figure
-             * index, and adjust the plot page size, so that the generated figures can be included directly in the paper.
-             */
+        /* By default the Functional Curation system uses the plot titles specified in the protocol, and names
+         * the generated files after the title too.  However, where multiple models are being simulated under
+         * the same protocol, it is more useful to title plots based on the model name.  We also add a sub-figure
+         * index, and adjust the plot page size, so that the generated figures can be included directly in the paper.
+         */
+        BOOST_FOREACH(CryptProliferationModel::ModelType model_type, model_types)
+        {
             std::string letter(1, 'a' + model_type);
-            std::string plot_title = letter + ") " + model_name;
-            BOOST_FOREACH(PlotSpecificationPtr p_plot_spec, p_protocol->rGetPlotSpecifications())
-            {
-                p_plot_spec->SetDisplayTitle(plot_title);
-                p_plot_spec->SetGnuplotTerminal("postscript eps enhanced size 4,3 font 16");
-            }
-
-            /* Finally, run the protocol on this model, using 'outputs' as the prefix for result file names. */
-            try
+            runner.SetPlotTitle(model_type, letter + ") " + CryptProliferationModel::GetModelName(model_type));
+        }
+        runner.SetGnuplotTerminal("postscript eps enhanced size 4,3 font 16");
+
+        /* Optionally copy generated plots, as described above. */
+        runner.SetCopyPlots(copyPlots);
+
+        /* Record a timeline of the run, showing when each process was running which job (and parsing the
+         * protocol, simulating, or post-processing within it) or waiting, along with the number of cells.  This
+         * is saved as `trace.json` in the main output folder, and can be viewed in `chrome://tracing` or at
+         * https://ui.perfetto.dev, which helps in choosing how many processes to use.
+         */
+        runner.SetRecordTrace(true);
+
+        /* Simulations are expensive, so results may be cached on disk (in `CryptProliferationResultCache` within
+         * the Chaste test output folder), keyed by the model type and all its parameter values.  Since this test
+         * checks the simulation results, it runs every simulation by default.  Set the environment variable
+         * `CRYPT_RESULT_CACHE` to `use` to reuse earlier simulations when changing only post-processing or
+         * plotting, or to `refresh` to re-run and re-cache all simulations.
+         */
+        runner.SetResultCacheMode(ResultCache::GetModeFromEnvironment(ResultCache::BYPASS));
+
+        /* Finally, run all the jobs.  If an error occurs in any job the error message is displayed,
+         * but execution isn't terminated (since the other jobs may run successfully).
+         */
+        bool success = runner.Run();
+
+        /* Check against recorded values for specific results files. */
+        OutputFileHandler handler(rOutputFolderName, false);
+        if (PetscTools::AmMaster())
+        {
+            TS_ASSERT(success);
+            BOOST_FOREACH(CryptProliferationModel::ModelType model_type, model_types)
             {
-                p_protocol->RunAndWrite("outputs");
-
-                /* Optionally copy generated plots, as described above.  We find all .eps files in the sub-folder,
-                 * and copy them, with a different name, into the main output folder.
-                 */
-                if (copyPlots && PetscTools::AmMaster())
-                {
-                    FileFinder model_output_folder = sub_handler.FindFile("");
-                    BOOST_FOREACH(FileFinder graph, model_output_folder.FindMatches("*.eps"))
-                    {
-                        FileFinder dest = handler.FindFile(sub_folder_name + "-" + graph.GetLeafName());
-                        graph.CopyTo(dest);
-                    }
-                }
-
-                /* Check against recorded values for specific results files. */
+                std::string sub_folder_name = CryptSweepRunner::GetModelFolderName(model_type);
                 BOOST_FOREACH(const std::string& r_result_name, rCheckResults)
                 {
                     std::string csv_name = "outputs_" + r_result_name + ".csv";
-                    FileFinder new_data = sub_handler.FindFile(csv_name);
+                    FileFinder new_data = handler.FindFile(sub_folder_name + "/" + csv_name);
                     FileFinder reference_data("data/" + sub_folder_name + "-" + csv_name, this_test);
                     NumericFileComparison comp(new_data, reference_data, false);
                     // The arguments to CompareFiles are absolute tolerance, number of header lines, relative tolerance
                     TS_ASSERT(comp.CompareFiles(1e-4, 1, 1e-6));
                 }
             }
-            catch (const Exception& r_error)
-            {
-                /* If an error occurs while running the protocol etc. we display the error message,
-                 * but don't terminate execution (since the other models may run successfully).
-                 */
-                std::cerr << r_error.GetMessage() << std::endl;
-                TS_FAIL("Error running " + model_name);
-            }
-        }
-
-        if (modelsInParallel)
-        {
-            // Stop isolating processes, to avoid problems running the next protocol.
-            PetscTools::IsolateProcesses(false);
         }
     }
 
@@ -268,18 +236,32 @@ public:
         std::map<std::string, double> protocol_inputs;
         protocol_inputs["end_time"] = 130.0;
         protocol_inputs["steady_state_time"] = 0.0;
-        RunProtocol("CryptProliferation", "CryptProliferationSteadyState", protocol_inputs, true, false);
+        RunProtocol("CryptProliferation", "CryptProliferationSteadyState", protocol_inputs, false);
     }
 
     /*
-     * This test runs the main parameter sweep protocol on each of our three variant models, producing
+     * This test runs the main parameter sweep on each of our three variant models, producing
      * plots (a)-(c) in Figure 2.
+     *
+     * The sweep is defined by the `CryptProliferationSweep` protocol, which varies the crypt height in a nested
+     * loop around the `CryptProliferation` protocol.  Here we run the same sweep by giving the heights to
+     * `RunProtocol`, so that all 15 simulations can be run in parallel, rather than parallelising each
+     * model's sweep separately.  The heights are read from the sweep protocol's `heights` input, so that the
+     * protocol remains the single definition of the sweep.
      */
     void TestParameterSweep() throw (Exception)
     {
+        FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
+        ProtocolFileFinder sweep_file("protocols/CryptProliferationSweep.txt", this_test);
+        ProtocolParser parser;
+        ProtocolPtr p_sweep = parser.ParseFile(sweep_file);
+        NdArray<double> sweep_heights = GET_ARRAY(p_sweep->rGetInputsCollection().Lookup("heights", "TestParameterSweep"));
+        std::vector<double> heights(sweep_heights.Begin(), sweep_heights.End());
+
         std::map<std::string, double> protocol_inputs;
+        protocol_inputs["num_boxes"] = 10;
         std::vector<std::string> outputs_to_check = boost::assign::list_of("heights")("freqs")("norm_freqs");
-        RunProtocol("CryptProliferationSweep", "CryptProliferationSweep", protocol_inputs, false, true, outputs_to_check);
+        RunProtocol("CryptProliferation", "CryptProliferationSweep", protocol_inputs, true, outputs_to_check, heights);
     }
 };
 
@@ -38,17 +38,100 @@ OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <cxxtest/TestSuite.h>
 
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
 #include "CryptProliferationModel.hpp"
+#include "CryptProtocolTestHelper.hpp"
 #include "Protocol.hpp"
 #include "ProtocolParser.hpp"
 #include "ProtocolFileFinder.hpp"
+#include "ProtoHelperMacros.hpp"
 
+#include "AllocationCounter.hpp"
+#include "AsyncRecordWriter.hpp"
+#include "SnapshotReader.hpp"
+#include "CryptPhaseTimer.hpp"
+#include "NodeStateArrays.hpp"
 #include "FileFinder.hpp"
 #include "OutputFileHandler.hpp"
 #include "FakePetscSetup.hpp"
 
 class TestCryptProliferationProtocol : public CxxTest::TestSuite
 {
+    /**
+     * Run TestOptimisationOptions.txt with optimisation options set.
+     *
+     * @param rInputs  the value for each protocol input to set
+     * @param rCheckpointFolder  if set, where the model should store checkpoints
+     * @return  the division locations output, flattened
+     */
+    std::vector<double> RunForDivisions(const std::map<std::string, double>& rInputs,
+                                        const FileFinder& rCheckpointFolder=FileFinder())
+    {
+        std::stringstream folder;
+        folder << "TestCryptProliferationProtocol_OptimisationOptions/";
+        for (std::map<std::string, double>::const_iterator it = rInputs.begin(); it != rInputs.end(); ++it)
+        {
+            folder << (it == rInputs.begin() ? "" : "_") << it->first << "_" << it->second;
+        }
+
+        boost::shared_ptr<CryptProliferationModel> p_model(
+                new CryptProliferationModel(CryptProliferationModel::CONTACT_INHIBITION));
+        if (rCheckpointFolder.IsPathSet())
+        {
+            p_model->SetCheckpointFolder(rCheckpointFolder);
+        }
+        ProtocolPtr p_protocol = CryptProtocolTestHelper::Run("TestOptimisationOptions", folder.str(), p_model, rInputs);
+
+        NdArray<double> divisions = GET_ARRAY(p_protocol->rGetOutputsCollection().Lookup("divisions", "RunForDivisions"));
+        TS_ASSERT_EQUALS(divisions.GetShape()[1], 4u);
+        return std::vector<double>(divisions.Begin(), divisions.End());
+    }
+
+    /**
+     * Run TestOptimisationOptions.txt with an optimisation option set.
+     *
+     * @param rInputName  the protocol input for the option
+     * @param value  the value for the option
+     * @return  the division locations output, flattened
+     */
+    std::vector<double> RunForDivisions(const std::string& rInputName, double value)
+    {
+        std::map<std::string, double> inputs;
+        inputs[rInputName] = value;
+        return RunForDivisions(inputs);
+    }
+
+    /**
+     * @param rDivisions  the division locations output of TestOptimisationOptions.txt, flattened
+     * @return  the number of divisions in each tenth of the crypt's default height
+     */
+    std::vector<double> GetHistogram(const std::vector<double>& rDivisions)
+    {
+        return CryptProtocolTestHelper::GetDivisionHistogram(rDivisions, 20.0, 10u);
+    }
+
+    /**
+     * Run TestProfilingOutputs.txt.
+     *
+     * @param rFolder  the output folder
+     * @param cryptHeight  the height of the crypt
+     * @return  the protocol, for reading its outputs
+     */
+    ProtocolPtr RunProfiling(const std::string& rFolder, double cryptHeight)
+    {
+        std::map<std::string, double> inputs;
+        inputs["crypt_height"] = cryptHeight;
+        return CryptProtocolTestHelper::Run("TestProfilingOutputs", rFolder,
+                                            boost::shared_ptr<AbstractSystemWithOutputs>(
+                                                    new CryptProliferationModel(CryptProliferationModel::CONTACT_INHIBITION)),
+                                            inputs);
+    }
+
 public:
     void TestBasicRun() throw (Exception)
     {
@@ -89,6 +172,214 @@ public:
         // Run protocol
         p_protocol->RunAndWrite("outputs");
     }
+
+    void TestAsyncOutput() throw (Exception)
+    {
+        ProtocolPtr p_protocol = CryptProtocolTestHelper::Run(
+                "TestAsyncOutput", "TestCryptProliferationProtocol_AsyncOutput",
+                boost::shared_ptr<AbstractSystemWithOutputs>(
+                        new CryptProliferationModel(CryptProliferationModel::CONTACT_INHIBITION)));
+
+        // Every division queued was written, and the writer was flushed at each sampling time (once an hour)
+        const Environment& r_outputs = p_protocol->rGetOutputsCollection();
+        NdArray<double> divisions = GET_ARRAY(r_outputs.Lookup("divisions", "TestAsyncOutput"));
+        std::vector<double> stats = CryptProtocolTestHelper::GetArrayOutput(p_protocol, "output_writer");
+        TS_ASSERT_EQUALS(stats.size(), (unsigned)AsyncRecordWriter::NUM_STATISTICS);
+        TS_ASSERT_EQUALS(divisions.GetShape()[1], 4u);
+        TS_ASSERT_LESS_THAN(0.0, stats[AsyncRecordWriter::NUM_RECORDS]);
+        TS_ASSERT_EQUALS(stats[AsyncRecordWriter::NUM_RECORDS], divisions.GetShape()[0]);
+        TS_ASSERT_LESS_THAN_EQUALS(10.0, stats[AsyncRecordWriter::NUM_FLUSHES]);
+    }
+
+    void TestSnapshotOutput() throw (Exception)
+    {
+        CryptProtocolTestHelper::Run("TestSnapshotOutput", "TestCryptProliferationProtocol_SnapshotOutput",
+                                     boost::shared_ptr<AbstractSystemWithOutputs>(
+                                             new CryptProliferationModel(CryptProliferationModel::CONTACT_INHIBITION)));
+
+        // A frame at the start and then every hour, each a triangulation of the real cells
+        FileFinder snapshots("TestCryptProliferationProtocol_SnapshotOutput/raw_results0/results_from_time_0/results.snapshots",
+                             RelativeTo::ChasteTestOutput);
+        TS_ASSERT(snapshots.IsFile());
+        SnapshotReader reader(snapshots.GetAbsolutePath());
+        TS_ASSERT(!reader.WasIndexRebuilt());
+        TS_ASSERT_EQUALS(reader.GetNumFrames(), 11u);
+        TS_ASSERT_EQUALS(reader.rGetSetupText().substr(0u, 10u), "MeshWidth\t");
+        for (unsigned i=0; i<reader.GetNumFrames(); i++)
+        {
+            const SnapshotFrame& r_frame = reader.rReadFrame(i);
+            TS_ASSERT_DELTA(r_frame.mTime, i, 1e-6);
+            TS_ASSERT_LESS_THAN(0u, r_frame.mCellIds.size());
+            TS_ASSERT_LESS_THAN(0u, r_frame.mElements.size());
+        }
+    }
+
+    void TestBucketedSloughing() throw (Exception)
+    {
+        // The same cells should be sloughed at the same times with either cell killer
+        std::vector<double> divisions = RunForDivisions("bucketed_sloughing", 0.0);
+        TS_ASSERT_LESS_THAN(0u, divisions.size());
+        TS_ASSERT(RunForDivisions("bucketed_sloughing", 1.0) == divisions);
+    }
+
+    void TestBatchBirths() throw (Exception)
+    {
+        // Adding daughter cells together shouldn't change anything
+        std::vector<double> divisions = RunForDivisions("batch_births", 0.0);
+        TS_ASSERT_LESS_THAN(0u, divisions.size());
+        TS_ASSERT(RunForDivisions("batch_births", 1.0) == divisions);
+    }
+
+    void TestNodeReordering() throw (Exception)
+    {
+        // Renumbering nodes changes the order in which forces are summed, so results differ by rounding
+        // error at first and then diverge, but divisions should be distributed up the crypt in the same way
+        std::vector<double> freqs = GetHistogram(RunForDivisions("reorder_interval", 0.0));
+        std::vector<double> reordered_freqs = GetHistogram(RunForDivisions("reorder_interval", 0.5));
+        TS_ASSERT_LESS_THAN(0.0, CryptProtocolTestHelper::GetTotal(reordered_freqs));
+        TS_ASSERT_LESS_THAN_EQUALS(CryptProtocolTestHelper::GetMaxPercentageDifference(reordered_freqs, freqs),
+                                   CryptProtocolTestHelper::GetPercentageTolerance(reordered_freqs, freqs));
+    }
+
+    void TestNodeStateArrays() throw (Exception)
+    {
+        std::vector<double> divisions = RunForDivisions("node_state_arrays", 0.0);
+        std::vector<double> array_divisions = RunForDivisions("node_state_arrays", 1.0);
+        TS_ASSERT_LESS_THAN(0u, divisions.size());
+        if (sizeof(NodeStateValue) == sizeof(double))
+        {
+            // Forces are summed in the same order, so node state arrays shouldn't change anything
+            TS_ASSERT(array_divisions == divisions);
+        }
+        else
+        {
+            // Node state stored in single precision rounds differently, so divisions are only distributed up the
+            // crypt in the same way
+            std::vector<double> freqs = GetHistogram(divisions);
+            std::vector<double> array_freqs = GetHistogram(array_divisions);
+            TS_ASSERT_LESS_THAN_EQUALS(CryptProtocolTestHelper::GetMaxPercentageDifference(array_freqs, freqs),
+                                       CryptProtocolTestHelper::GetPercentageTolerance(array_freqs, freqs));
+        }
+    }
+
+    void TestFusedPositionUpdate() throw (Exception)
+    {
+        // Forces are summed, and random numbers used, in the same order as by separate passes over the node state
+        // arrays, so the fused update shouldn't change anything
+        std::vector<double> divisions = RunForDivisions("node_state_arrays", 1.0);
+        TS_ASSERT_LESS_THAN(0u, divisions.size());
+        TS_ASSERT(RunForDivisions("fused_update", 1.0) == divisions);
+    }
+
+    void TestSemiImplicitPositionUpdate() throw (Exception)
+    {
+        // Treating springs implicitly with a timestep 10 times the usual gives different trajectories, but divisions
+        // should be distributed up the crypt in the same way; division rows have 4 columns
+        std::vector<double> divisions = RunForDivisions("implicit_springs", 0.0);
+        std::map<std::string, double> inputs;
+        inputs["implicit_springs"] = 1.0;
+        inputs["dt_divisor"] = 36.0;
+        std::vector<double> implicit_divisions = RunForDivisions(inputs);
+        std::vector<double> freqs = GetHistogram(divisions);
+        std::vector<double> implicit_freqs = GetHistogram(implicit_divisions);
+        TS_ASSERT_LESS_THAN(0.0, CryptProtocolTestHelper::GetTotal(implicit_freqs));
+        TS_ASSERT_LESS_THAN_EQUALS(CryptProtocolTestHelper::GetMaxPercentageDifference(implicit_freqs, freqs),
+                                   CryptProtocolTestHelper::GetPercentageTolerance(implicit_freqs, freqs));
+        for (unsigned i=2; i<implicit_divisions.size(); i+=4)
+        {
+            // Division heights stay within the crypt
+            TS_ASSERT_LESS_THAN_EQUALS(0.0, implicit_divisions[i]);
+        }
+    }
+
+    void TestCheckpointing() throw (Exception)
+    {
+        // Use fresh checkpoint stores, so nothing is resumed from earlier test runs
+        OutputFileHandler checkpoint_handler("TestCryptProliferationProtocol_Checkpoints");
+        FileFinder checkpoint_folder = checkpoint_handler.FindFile("straight");
+        FileFinder extended_checkpoint_folder = checkpoint_handler.FindFile("extended");
+
+        // Checkpointing doesn't change the results
+        std::vector<double> uninterrupted_divisions = RunForDivisions("checkpoint_interval", 0.0);
+        TS_ASSERT_LESS_THAN(0u, uninterrupted_divisions.size());
+
+        // Checkpoint every 5 hours of a 10 hour run
+        std::map<std::string, double> inputs;
+        inputs["checkpoint_interval"] = 5.0;
+        std::vector<double> divisions = RunForDivisions(inputs, checkpoint_folder);
+        TS_ASSERT(divisions == uninterrupted_divisions);
+
+        // The latest checkpoint is from before the final update at the end time, so running again starts afresh
+        TS_ASSERT(RunForDivisions(inputs, checkpoint_folder) == divisions);
+
+        // Run for 5 hours, then extend the run to 10 hours, which is just as if a run had stopped at 5 hours
+        inputs["end_time"] = 5.0;
+        std::vector<double> first_divisions = RunForDivisions(inputs, extended_checkpoint_folder);
+        TS_ASSERT_LESS_THAN(first_divisions.size(), divisions.size());
+        inputs["end_time"] = 10.0;
+        std::vector<double> extended_divisions = RunForDivisions(inputs, extended_checkpoint_folder);
+        FileFinder extended_results("TestCryptProliferationProtocol_OptimisationOptions/checkpoint_interval_5_end_time_10/raw_results0",
+                                    RelativeTo::ChasteTestOutput);
+        TS_ASSERT(FileFinder("checkpoint_divisions.dat", extended_results).IsFile());
+        TS_ASSERT(!FileFinder("results_from_time_0", extended_results).Exists());
+        TS_ASSERT(FileFinder("results_from_time_5", extended_results).IsDir());
+
+        // The resumed run carries on exactly as the uninterrupted one did
+        TS_ASSERT(std::equal(first_divisions.begin(), first_divisions.end(), divisions.begin()));
+        TS_ASSERT(extended_divisions == divisions);
+    }
+
+    void TestProfilingOutputs() throw (Exception)
+    {
+        ProtocolPtr p_protocol = RunProfiling("TestCryptProliferationProtocol_Profiling", 20.0);
+
+        // Memory estimates are always available
+        const Environment& r_outputs = p_protocol->rGetOutputsCollection();
+        NdArray<double> peak_bytes = GET_ARRAY(r_outputs.Lookup("peak_bytes", "TestProfilingOutputs"));
+        TS_ASSERT_EQUALS(peak_bytes.GetNumElements(), 4u);
+        for (NdArray<double>::Iterator it = peak_bytes.Begin(); it != peak_bytes.End(); ++it)
+        {
+            TS_ASSERT_LESS_THAN(0.0, *it);
+        }
+        TS_ASSERT_LESS_THAN(0.0, GET_SIMPLE_VALUE(r_outputs.Lookup("peak_num_ghost_nodes", "TestProfilingOutputs")));
+
+        // Hardware counters degrade quietly to zeros if unavailable
+        NdArray<double> perf_counters = GET_ARRAY(r_outputs.Lookup("perf_counters", "TestProfilingOutputs"));
+        TS_ASSERT_EQUALS(perf_counters.GetNumElements(), CryptPhaseTimer::NUM_PHASES * PerfCounterGroup::NUM_COUNTERS);
+
+        // Allocation counts are only non-zero if counting was compiled in
+        NdArray<double> allocations = GET_ARRAY(r_outputs.Lookup("allocations", "TestProfilingOutputs"));
+        TS_ASSERT_EQUALS(allocations.GetNumElements(), 4u);
+        NdArray<double>::Iterator p_count = allocations.Begin();
+        double num_steps = *p_count++;
+        double num_allocations = *p_count++;
+        ++p_count; // Skip total bytes
+        double max_allocations_per_step = *p_count;
+        if (!AllocationCounter::IsAvailable())
+        {
+            TS_WARN("Allocation counting not compiled in; define CRYPT_COUNT_ALLOCATIONS to enable it.");
+            TS_ASSERT_EQUALS(num_allocations, 0.0);
+            return;
+        }
+        TS_ASSERT_LESS_THAN(0.0, num_steps);
+        TS_ASSERT_LESS_THAN_EQUALS(num_allocations, num_steps * max_allocations_per_step);
+
+        /*
+         * Each timestep should only allocate for new cells, remeshing, and the Voronoi tessellation, all of
+         * which are linear in the number of nodes.  So the busiest timestep should allocate about as much per
+         * node as in a reference run of a crypt half the height.  The margin of 50% allows for more divisions
+         * coinciding in the busiest timestep of the larger crypt, and for the ghost node layers, whose size
+         * depends on the crypt circumference rather than its height.  Anything that allocates per pair of
+         * nodes, or keeps growing a container, fails this.
+         */
+        ProtocolPtr p_reference = RunProfiling("TestCryptProliferationProtocol_ProfilingReference", 10.0);
+        double reference_max_allocations_per_step = CryptProtocolTestHelper::GetArrayOutput(p_reference, "allocations")[3];
+        double reference_num_nodes = CryptProtocolTestHelper::GetValueOutput(p_reference, "peak_num_nodes");
+        double num_nodes = CryptProtocolTestHelper::GetValueOutput(p_protocol, "peak_num_nodes");
+        TS_ASSERT_LESS_THAN(0.0, reference_max_allocations_per_step);
+        TS_ASSERT_LESS_THAN(max_allocations_per_step / num_nodes,
+                            1.5 * reference_max_allocations_per_step / reference_num_nodes);
+    }
 };
 
 #endif // TESTCRYPTPROLIFERATIONPROTOCOL_HPP_
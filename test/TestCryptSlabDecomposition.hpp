@@ -0,0 +1,221 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTCRYPTSLABDECOMPOSITION_HPP_
+#define TESTCRYPTSLABDECOMPOSITION_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "CryptSlabDecomposition.hpp"
+#include "ProcessIsolation.hpp"
+#include "CryptProliferationModel.hpp"
+#include "CryptProtocolTestHelper.hpp"
+
+#include "PetscTools.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+class TestCryptSlabDecomposition : public CxxTest::TestSuite
+{
+    /**
+     * Run TestOptimisationOptions.txt on this process alone, with its own output folder.
+     *
+     * @param rInputName  a protocol input to set to 1
+     * @return  the division locations output, flattened
+     */
+    std::vector<double> RunForDivisions(const std::string& rInputName)
+    {
+        std::stringstream folder;
+        folder << "TestCryptSlabDecomposition/" << rInputName << "/" << PetscTools::GetMyRank();
+        std::map<std::string, double> inputs;
+        inputs[rInputName] = 1.0;
+        ProtocolPtr p_protocol = CryptProtocolTestHelper::Run(
+                "TestOptimisationOptions", folder.str(),
+                boost::shared_ptr<AbstractSystemWithOutputs>(
+                        new CryptProliferationModel(CryptProliferationModel::CONTACT_INHIBITION)), inputs);
+        return CryptProtocolTestHelper::GetArrayOutput(p_protocol, "divisions");
+    }
+
+    /**
+     * Set up processes as a job queue does, and then fail.
+     */
+    void RunFailingJob()
+    {
+        ProcessIsolation::SeparateJobsGuard separate_jobs;
+        ProcessIsolation::IsolationGuard isolated;
+        TS_ASSERT(PetscTools::IsIsolated());
+        TS_ASSERT(ProcessIsolation::DoProcessesRunSeparateJobs());
+        {
+            // Nested guards restore the outer setting
+            ProcessIsolation::SeparateJobsGuard inner_separate_jobs;
+            ProcessIsolation::IsolationGuard not_isolated(false);
+            TS_ASSERT(!PetscTools::IsIsolated());
+        }
+        TS_ASSERT(PetscTools::IsIsolated());
+        TS_ASSERT(ProcessIsolation::DoProcessesRunSeparateJobs());
+        EXCEPTION("A job failed.");
+    }
+
+public:
+    void TestSlabs() throw (Exception)
+    {
+        CryptSlabDecomposition decomposition(30.0);
+        unsigned num_slabs = decomposition.GetNumSlabs();
+        TS_ASSERT_EQUALS(num_slabs, CryptSlabDecomposition::GetNumProcesses());
+        TS_ASSERT_EQUALS(num_slabs, PetscTools::GetNumProcs());
+        TS_ASSERT_EQUALS(decomposition.GetLocalSlab(), PetscTools::GetMyRank());
+
+        // Slabs are of equal height, and cover the crypt
+        TS_ASSERT_DELTA(decomposition.GetSlabBottom(0), 0.0, 1e-12);
+        TS_ASSERT_DELTA(decomposition.GetSlabTop(num_slabs-1), 30.0, 1e-12);
+        for (unsigned slab=0; slab<num_slabs; slab++)
+        {
+            TS_ASSERT_DELTA(decomposition.GetSlabTop(slab) - decomposition.GetSlabBottom(slab), 30.0/num_slabs, 1e-12);
+            double middle = 0.5*(decomposition.GetSlabBottom(slab) + decomposition.GetSlabTop(slab));
+            TS_ASSERT_EQUALS(decomposition.GetSlab(middle), slab);
+            TS_ASSERT_EQUALS(decomposition.IsLocal(middle), slab == decomposition.GetLocalSlab());
+        }
+
+        // Nodes outside the crypt belong to the end slabs
+        TS_ASSERT_EQUALS(decomposition.GetSlab(-1.0), 0u);
+        TS_ASSERT_EQUALS(decomposition.GetSlab(100.0), num_slabs-1);
+
+        TS_ASSERT_THROWS_THIS(CryptSlabDecomposition bad_decomposition(0.0),
+                              "The crypt length must be positive to divide it into slabs.");
+
+        // Crypts can't be divided while processes run separate jobs, as under a job queue
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+        {
+            ProcessIsolation::SeparateJobsGuard separate_jobs;
+            TS_ASSERT_THROWS_THIS(CryptSlabDecomposition queued_decomposition(30.0),
+                                  "A crypt can't be divided into slabs while processes are running separate jobs.");
+        }
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+    }
+
+    void TestGuardsRestoreOnException() throw (Exception)
+    {
+        TS_ASSERT(!PetscTools::IsIsolated());
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+        TS_ASSERT_THROWS_THIS(RunFailingJob(), "A job failed.");
+        TS_ASSERT(!PetscTools::IsIsolated());
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+    }
+
+    void TestSumForces() throw (Exception)
+    {
+        CryptSlabDecomposition decomposition(30.0);
+        unsigned num_slabs = decomposition.GetNumSlabs();
+        unsigned rank = decomposition.GetLocalSlab();
+
+        // Each process contributes a different amount to each node
+        std::vector<NodeStateValue> forces(5u);
+        for (unsigned i=0; i<forces.size(); i++)
+        {
+            forces[i] = (NodeStateValue)(i*(rank+1));
+        }
+        decomposition.SumForces(&forces[0], forces.size());
+        for (unsigned i=0; i<forces.size(); i++)
+        {
+            TS_ASSERT_DELTA(forces[i], i*num_slabs*(num_slabs+1)/2.0, 1e-6);
+        }
+
+        // Summing still works with processes isolated
+        {
+            ProcessIsolation::IsolationGuard isolated;
+            std::fill(forces.begin(), forces.end(), (NodeStateValue)1.0);
+            decomposition.SumForces(&forces[0], forces.size());
+        }
+        for (unsigned i=0; i<forces.size(); i++)
+        {
+            TS_ASSERT_DELTA(forces[i], (double)num_slabs, 1e-6);
+        }
+
+        if (num_slabs > 1u)
+        {
+            // Processes with different populations are caught, rather than summing mismatched forces
+            std::stringstream message;
+            message << "Processes sharing a crypt have between 1 and " << num_slabs
+                    << " nodes, so are not running the same simulation.";
+            TS_ASSERT_THROWS_THIS(decomposition.SumForces(&forces[0], rank + 1u), message.str());
+            // Even when some have no nodes at all
+            TS_ASSERT_THROWS_CONTAINS(decomposition.SumForces(&forces[0], rank == 0u ? 0u : 5u),
+                                      "have between 0 and 5 nodes");
+        }
+    }
+
+    void TestDistributedRun() throw (Exception)
+    {
+        // Every process runs the same simulation, sharing the spring forces
+        std::vector<double> divisions;
+        std::vector<double> array_divisions;
+        {
+            ProcessIsolation::IsolationGuard isolated;
+            divisions = RunForDivisions("distributed");
+            if (CryptSlabDecomposition::GetNumProcesses() == 1u)
+            {
+                // With one slab the forces are summed exactly as before
+                array_divisions = RunForDivisions("node_state_arrays");
+            }
+        }
+        TS_ASSERT(!divisions.empty());
+
+        if (PetscTools::IsSequential())
+        {
+            TS_ASSERT(divisions == array_divisions);
+        }
+        else
+        {
+            // Every process should have found exactly the same divisions as the first
+            unsigned num_values = divisions.size();
+            MPI_Bcast(&num_values, 1, MPI_UNSIGNED, 0, PETSC_COMM_WORLD);
+            bool sizes_differ = PetscTools::ReplicateBool(num_values != divisions.size());
+            TS_ASSERT(!sizes_differ);
+            if (!sizes_differ)
+            {
+                std::vector<double> first_divisions(divisions);
+                MPI_Bcast(&first_divisions[0], num_values, MPI_DOUBLE, 0, PETSC_COMM_WORLD);
+                TS_ASSERT(divisions == first_divisions);
+            }
+        }
+    }
+};
+
+#endif // TESTCRYPTSLABDECOMPOSITION_HPP_
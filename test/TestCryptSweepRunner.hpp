@@ -0,0 +1,126 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTCRYPTSWEEPRUNNER_HPP_
+#define TESTCRYPTSWEEPRUNNER_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <string>
+#include <vector>
+#include <boost/assign/list_of.hpp>
+
+#include "CryptSweepRunner.hpp"
+#include "CryptEmulatorModel.hpp"
+
+#include "FileFinder.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestCryptSweepRunner : public CxxTest::TestSuite
+{
+    /**
+     * Read the histograms for one model from the recorded sweep, normalising them.
+     *
+     * @param rModelFolderName  the model's folder name, used as a prefix to the recorded output files
+     * @return  the normalised histogram at each height
+     */
+    std::vector<std::vector<double> > ReadNormFreqs(const std::string& rModelFolderName)
+    {
+        FileFinder data_folder("data", FileFinder(__FILE__, RelativeTo::ChasteSourceRoot));
+        std::vector<unsigned> shape;
+        std::vector<double> freqs = CryptEmulatorModel::ReadSweepOutput(
+                FileFinder(rModelFolderName + "-outputs_freqs.csv", data_folder), shape);
+        std::vector<double> recorded_norm_freqs = CryptEmulatorModel::ReadSweepOutput(
+                FileFinder(rModelFolderName + "-outputs_norm_freqs.csv", data_folder), shape);
+        std::vector<std::vector<double> > norm_freqs;
+        for (unsigned i=0; i<shape[0]; i++)
+        {
+            std::vector<double> point_freqs(freqs.begin() + i*shape[1], freqs.begin() + (i+1)*shape[1]);
+            norm_freqs.push_back(CryptSweepRunner::NormaliseHistogram(point_freqs));
+            for (unsigned box=0; box<shape[1]; box++)
+            {
+                TS_ASSERT_DELTA(norm_freqs[i][box], recorded_norm_freqs[i*shape[1] + box], 1e-10);
+            }
+        }
+        return norm_freqs;
+    }
+
+public:
+    void TestNormaliseHistogram() throw (Exception)
+    {
+        std::vector<double> freqs = boost::assign::list_of(1)(3)(0);
+        std::vector<double> norm_freqs = CryptSweepRunner::NormaliseHistogram(freqs);
+        TS_ASSERT_EQUALS(norm_freqs.size(), 3u);
+        TS_ASSERT_DELTA(norm_freqs[0], 25.0, 1e-12);
+        TS_ASSERT_DELTA(norm_freqs[1], 75.0, 1e-12);
+        TS_ASSERT_DELTA(norm_freqs[2], 0.0, 1e-12);
+
+        // No divisions at all
+        norm_freqs = CryptSweepRunner::NormaliseHistogram(std::vector<double>(2, 0.0));
+        TS_ASSERT_EQUALS(norm_freqs.size(), 2u);
+        TS_ASSERT_EQUALS(norm_freqs[0], 0.0);
+    }
+
+    void TestChooseRefinementPoints() throw (Exception)
+    {
+        std::vector<double> heights = boost::assign::list_of(10)(15)(20)(25)(30);
+        std::vector<std::vector<std::vector<double> > > norm_freqs;
+        norm_freqs.push_back(ReadNormFreqs("Uniform_Wnt"));
+
+        // For the Uniform Wnt model alone the histogram changes most between heights of 10 and 15, then 15 and 20
+        std::vector<double> points = CryptSweepRunner::ChooseRefinementPoints(heights, norm_freqs, 2u, 0.0, 0.0);
+        TS_ASSERT_EQUALS(points.size(), 2u);
+        TS_ASSERT_EQUALS(points[0], 12.5);
+        TS_ASSERT_EQUALS(points[1], 17.5);
+
+        // Only those two intervals change by more than one percentage point
+        points = CryptSweepRunner::ChooseRefinementPoints(heights, norm_freqs, 10u, 0.0, 1.0);
+        TS_ASSERT_EQUALS(points.size(), 2u);
+
+        // Points can't be placed closer together than the minimum spacing
+        points = CryptSweepRunner::ChooseRefinementPoints(heights, norm_freqs, 10u, 3.0, 0.0);
+        TS_ASSERT_EQUALS(points.size(), 0u);
+
+        // Over all models, the stochastic model dominates, changing most between heights of 25 and 30
+        norm_freqs.push_back(ReadNormFreqs("Variable_Wnt"));
+        norm_freqs.push_back(ReadNormFreqs("Stochastic_Generation-based"));
+        points = CryptSweepRunner::ChooseRefinementPoints(heights, norm_freqs, 10u, 0.0, 0.0);
+        std::vector<double> expected_points = boost::assign::list_of(27.5)(17.5)(22.5)(12.5);
+        TS_ASSERT_EQUALS(points, expected_points);
+    }
+};
+
+#endif // TESTCRYPTSWEEPRUNNER_HPP_
@@ -0,0 +1,237 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTDIVISIONLOGREADER_HPP_
+#define TESTDIVISIONLOGREADER_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "DivisionLogReader.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestDivisionLogReader : public CxxTest::TestSuite
+{
+    /**
+     * Read a division log the simple way.
+     *
+     * @param rPath  the path to the log
+     * @return  every event in it
+     */
+    std::vector<DivisionRecord> ReadAll(const std::string& rPath)
+    {
+        std::vector<DivisionRecord> records;
+        std::ifstream file(rPath.c_str());
+        std::string line;
+        while (std::getline(file, line))
+        {
+            std::stringstream line_stream(line);
+            DivisionRecord record;
+            record.mParentAge = 0.0;
+            if (line_stream >> record.mTime >> record.mX >> record.mY)
+            {
+                line_stream >> record.mParentAge;
+                records.push_back(record);
+            }
+        }
+        return records;
+    }
+
+    /**
+     * Check a query gives the same events as filtering every event.
+     *
+     * @param rReader  the reader
+     * @param rAll  every event in the log
+     * @param rQuery  the query
+     * @return  the number of matching events
+     */
+    unsigned CheckQuery(const DivisionLogReader& rReader, const std::vector<DivisionRecord>& rAll,
+                        const DivisionQuery& rQuery)
+    {
+        std::vector<DivisionRecord> expected;
+        for (unsigned i=0; i<rAll.size(); i++)
+        {
+            const DivisionRecord& r = rAll[i];
+            if (r.mTime >= rQuery.mMinTime && r.mTime <= rQuery.mMaxTime && r.mX >= rQuery.mMinX
+                && r.mX <= rQuery.mMaxX && r.mY >= rQuery.mMinY && r.mY <= rQuery.mMaxY)
+            {
+                expected.push_back(r);
+            }
+        }
+        std::vector<DivisionRecord> records = rReader.Query(rQuery);
+        TS_ASSERT_EQUALS(records.size(), expected.size());
+        for (unsigned i=0; i<std::min(records.size(), expected.size()); i++)
+        {
+            TS_ASSERT_EQUALS(records[i].mTime, expected[i].mTime);
+            TS_ASSERT_EQUALS(records[i].mX, expected[i].mX);
+            TS_ASSERT_EQUALS(records[i].mY, expected[i].mY);
+            TS_ASSERT_EQUALS(records[i].mParentAge, expected[i].mParentAge);
+        }
+        TS_ASSERT_EQUALS(rReader.Count(rQuery), expected.size());
+        return expected.size();
+    }
+
+    /**
+     * Write a file.
+     *
+     * @param rPath  the path to the file
+     * @param rContents  its contents
+     */
+    void WriteFile(const std::string& rPath, const std::string& rContents)
+    {
+        std::ofstream file(rPath.c_str());
+        file << rContents;
+    }
+
+public:
+    void TestQueriesOnLongLog() throw (Exception)
+    {
+        FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
+        FileFinder log_file("data/many_divisions.dat", this_test);
+        std::vector<DivisionRecord> all = ReadAll(log_file.GetAbsolutePath());
+
+        // A small stride, so that the index is useful for this modest file
+        OutputFileHandler handler("TestDivisionLogReader");
+        const std::string index_path = handler.GetOutputDirectoryFullPath() + "many_divisions.index";
+        DivisionLogReader reader(log_file.GetAbsolutePath(), 256u, index_path);
+        TS_ASSERT(!reader.WasIndexLoaded());
+        TS_ASSERT_EQUALS(reader.GetNumColumns(), 3u);
+        TS_ASSERT_EQUALS(reader.GetFirstTime(), all.front().mTime);
+        TS_ASSERT_EQUALS(reader.GetLastTime(), all.back().mTime);
+        TS_ASSERT_LESS_THAN(200u, reader.GetIndexSize());
+        TS_ASSERT_EQUALS(reader.GetNumBytesParsed(), 0u);
+        // This log is the logs of 30 runs one after another
+        TS_ASSERT_EQUALS(reader.GetNumSegments(), 30u);
+
+        // Opening the log again reuses the saved index, unless the stride differs
+        DivisionLogReader reopened(log_file.GetAbsolutePath(), 256u, index_path);
+        TS_ASSERT(reopened.WasIndexLoaded());
+        TS_ASSERT_EQUALS(reopened.GetIndexSize(), reader.GetIndexSize());
+        TS_ASSERT_EQUALS(reopened.GetNumSegments(), 30u);
+        TS_ASSERT_EQUALS(reopened.GetLastTime(), reader.GetLastTime());
+        DivisionLogReader restrided(log_file.GetAbsolutePath(), 512u, index_path);
+        TS_ASSERT(!restrided.WasIndexLoaded());
+
+        DivisionQuery everything;
+        TS_ASSERT_EQUALS(CheckQuery(reader, all, everything), all.size());
+
+        // Events after steady state in a height band; only the end of the file is parsed
+        DivisionQuery late_band;
+        late_band.mMinTime = 30.0;
+        late_band.mMinY = 5.0;
+        late_band.mMaxY = 12.0;
+        unsigned num_late = CheckQuery(reader, all, late_band);
+        TS_ASSERT_LESS_THAN(0u, num_late);
+        DivisionLogReader fresh(log_file.GetAbsolutePath(), 256u, index_path);
+        TS_ASSERT_EQUALS(fresh.Count(late_band), num_late);
+        TS_ASSERT_LESS_THAN(4u*fresh.GetNumBytesParsed(), fresh.GetFileSize());
+        TS_ASSERT_EQUALS(CheckQuery(reopened, all, late_band), num_late);
+
+        // A window in the middle, and an x band, including boundary times
+        DivisionQuery window;
+        window.mMinTime = all[1000].mTime;
+        window.mMaxTime = all[2000].mTime;
+        window.mMinX = 2.0;
+        window.mMaxX = 6.0;
+        TS_ASSERT_LESS_THAN(0u, CheckQuery(reader, all, window));
+
+        // Windows outside the log
+        DivisionQuery too_late;
+        too_late.mMinTime = all.back().mTime + 1.0;
+        TS_ASSERT_EQUALS(CheckQuery(reader, all, too_late), 0u);
+        DivisionQuery too_early;
+        too_early.mMaxTime = all.front().mTime - 1.0;
+        TS_ASSERT_EQUALS(CheckQuery(reader, all, too_early), 0u);
+
+        // Histograms of heights; values outside the range aren't counted
+        std::vector<unsigned> counts = reader.Histogram(late_band, DivisionLogReader::Y, 0.0, 20.0, 8u);
+        TS_ASSERT_EQUALS(counts.size(), 8u);
+        TS_ASSERT_EQUALS(counts[0] + counts[1] + counts[5] + counts[6] + counts[7], 0u);
+        TS_ASSERT_EQUALS(counts[2] + counts[3] + counts[4], num_late);
+        counts = reader.Histogram(everything, DivisionLogReader::Y, 0.0, 1e6, 1u);
+        TS_ASSERT_EQUALS(counts[0], all.size());
+        TS_ASSERT_THROWS_THIS(reader.Histogram(everything, DivisionLogReader::PARENT_AGE, 0.0, 1.0, 1u),
+                              "Division log " + log_file.GetAbsolutePath() + " doesn't record parent cell ages.");
+    }
+
+    void TestOtherLogs() throw (Exception)
+    {
+        OutputFileHandler handler("TestDivisionLogReader", false);
+        const std::string folder = handler.GetOutputDirectoryFullPath();
+
+        // Logs with parent ages, and without a final newline
+        WriteFile(folder + "ages.dat", "1\t2\t3\t4\n2\t3\t4\t5\n2\t1\t1\t0.5");
+        DivisionLogReader ages(folder + "ages.dat", 4u);
+        TS_ASSERT_EQUALS(ages.GetNumColumns(), 4u);
+        TS_ASSERT_EQUALS(ages.GetLastTime(), 2.0);
+        std::vector<DivisionRecord> all = ReadAll(folder + "ages.dat");
+        DivisionQuery query;
+        query.mMinTime = 2.0;
+        TS_ASSERT_EQUALS(CheckQuery(ages, all, query), 2u);
+        std::vector<unsigned> counts = ages.Histogram(query, DivisionLogReader::PARENT_AGE, 0.0, 6.0, 3u);
+        TS_ASSERT_EQUALS(counts[0], 1u);
+        TS_ASSERT_EQUALS(counts[2], 1u);
+
+        // Times going back start a new segment
+        WriteFile(folder + "unordered.dat", "5\t1\t1\t\n6\t1\t2\t\n\n1\t1\t3\t\n2\t1\t4\t\n");
+        DivisionLogReader unordered(folder + "unordered.dat", 8u);
+        TS_ASSERT_EQUALS(unordered.GetNumSegments(), 2u);
+        all = ReadAll(folder + "unordered.dat");
+        query.mMinTime = 1.5;
+        query.mMaxTime = 5.5;
+        TS_ASSERT_EQUALS(CheckQuery(unordered, all, query), 2u);
+
+        // Empty logs have no events
+        WriteFile(folder + "empty.dat", "");
+        DivisionLogReader empty(folder + "empty.dat");
+        TS_ASSERT_EQUALS(empty.GetNumColumns(), 0u);
+        TS_ASSERT_EQUALS(empty.Count(DivisionQuery()), 0u);
+
+        WriteFile(folder + "other.txt", "Not a division log\n");
+        TS_ASSERT_THROWS_THIS(DivisionLogReader other(folder + "other.txt"),
+                              "File " + folder + "other.txt is not a division log: line 1 doesn't hold 3 or 4 numbers.");
+        TS_ASSERT_THROWS_CONTAINS(DivisionLogReader missing(folder + "missing.dat"), "Unable to open division log");
+    }
+};
+
+#endif // TESTDIVISIONLOGREADER_HPP_
@@ -0,0 +1,217 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTDYNAMICJOBQUEUE_HPP_
+#define TESTDYNAMICJOBQUEUE_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+#include <boost/assign/list_of.hpp>
+
+#include "DynamicJobQueue.hpp"
+#include "ProcessIsolation.hpp"
+
+#include "Exception.hpp"
+#include "PetscTools.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Jobs with given costs, whose results are their index and its square.  Some jobs may be made to fail.
+ */
+class FakeQueuedJobs : public AbstractQueuedJobs
+{
+private:
+    /** The cost of each job. */
+    std::vector<double> mCosts;
+
+    /** Jobs which throw an Exception. */
+    std::vector<unsigned> mChasteFailures;
+
+    /** Jobs which throw a std::exception. */
+    std::vector<unsigned> mStdFailures;
+
+public:
+    /** The jobs run on this process, in the order they were run. */
+    std::vector<unsigned> mJobsRun;
+
+    /** Whether every job run saw processes isolated and marked as running separate jobs. */
+    bool mJobsRunSeparately;
+
+    /**
+     * Constructor.
+     *
+     * @param rCosts  the cost of each job
+     * @param rChasteFailures  jobs which throw an Exception
+     * @param rStdFailures  jobs which throw a std::exception
+     */
+    FakeQueuedJobs(const std::vector<double>& rCosts,
+                   const std::vector<unsigned>& rChasteFailures=std::vector<unsigned>(),
+                   const std::vector<unsigned>& rStdFailures=std::vector<unsigned>())
+        : mCosts(rCosts),
+          mChasteFailures(rChasteFailures),
+          mStdFailures(rStdFailures),
+          mJobsRunSeparately(true)
+    {}
+
+    unsigned GetNumJobs() const
+    {
+        return mCosts.size();
+    }
+
+    double GetJobCost(unsigned jobIndex) const
+    {
+        return mCosts[jobIndex];
+    }
+
+    std::vector<double> RunJob(unsigned jobIndex)
+    {
+        mJobsRun.push_back(jobIndex);
+        mJobsRunSeparately = mJobsRunSeparately && ProcessIsolation::DoProcessesRunSeparateJobs()
+                && (PetscTools::IsSequential() || PetscTools::IsIsolated());
+        if (std::find(mChasteFailures.begin(), mChasteFailures.end(), jobIndex) != mChasteFailures.end())
+        {
+            EXCEPTION("Job " << jobIndex << " failed.");
+        }
+        if (std::find(mStdFailures.begin(), mStdFailures.end(), jobIndex) != mStdFailures.end())
+        {
+            throw std::runtime_error("Job failed outside Chaste.");
+        }
+        return GetExpectedResults(jobIndex);
+    }
+
+    /**
+     * @param jobIndex  a job
+     * @return  the results it should give
+     */
+    static std::vector<double> GetExpectedResults(unsigned jobIndex)
+    {
+        std::vector<double> results;
+        results.push_back(jobIndex);
+        results.push_back(jobIndex*jobIndex);
+        return results;
+    }
+};
+
+/**
+ * Tests of the job queue, which may be run on any number of processes.
+ */
+class TestDynamicJobQueue : public CxxTest::TestSuite
+{
+public:
+    void TestGetJobOrder() throw (Exception)
+    {
+        // Largest first, with jobs of equal cost in their original order
+        std::vector<double> costs = boost::assign::list_of(1.0)(5.0)(2.0)(5.0)(0.5)(2.0);
+        FakeQueuedJobs jobs(costs);
+        std::vector<unsigned> expected_order = boost::assign::list_of(1)(3)(2)(5)(0)(4);
+        TS_ASSERT_EQUALS(DynamicJobQueue::GetJobOrder(jobs), expected_order);
+
+        FakeQueuedJobs no_jobs((std::vector<double>()));
+        TS_ASSERT(DynamicJobQueue::GetJobOrder(no_jobs).empty());
+    }
+
+    void TestRunAllJobs() throw (Exception)
+    {
+        std::vector<double> costs = boost::assign::list_of(1.0)(3.0)(2.0)(4.0)(0.5);
+        FakeQueuedJobs jobs(costs);
+        DynamicJobQueue queue;
+        std::vector<std::vector<double> > results = queue.Run(jobs);
+
+        TS_ASSERT_EQUALS(results.size(), costs.size());
+        TS_ASSERT(jobs.mJobsRunSeparately);
+        if (PetscTools::AmMaster())
+        {
+            TS_ASSERT(queue.rGetFailedJobs().empty());
+            for (unsigned i=0; i<results.size(); i++)
+            {
+                TS_ASSERT_EQUALS(results[i], FakeQueuedJobs::GetExpectedResults(i));
+            }
+        }
+        if (PetscTools::IsSequential())
+        {
+            // Everything is run here, largest first
+            TS_ASSERT_EQUALS(jobs.mJobsRun, DynamicJobQueue::GetJobOrder(jobs));
+        }
+        else if (PetscTools::AmMaster())
+        {
+            // The master only hands out jobs
+            TS_ASSERT(jobs.mJobsRun.empty());
+        }
+
+        // Processes are left as they were found
+        TS_ASSERT(!PetscTools::IsIsolated());
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+    }
+
+    void TestFailedJobsAreReported() throw (Exception)
+    {
+        std::vector<double> costs = boost::assign::list_of(1.0)(3.0)(2.0)(4.0)(0.5);
+        std::vector<unsigned> chaste_failures = boost::assign::list_of(1);
+        std::vector<unsigned> std_failures = boost::assign::list_of(4);
+        FakeQueuedJobs jobs(costs, chaste_failures, std_failures);
+        DynamicJobQueue queue;
+        std::vector<std::vector<double> > results = queue.Run(jobs);
+
+        if (PetscTools::AmMaster())
+        {
+            // Failed jobs have no results, but the others still complete
+            std::vector<unsigned> failed_jobs = queue.rGetFailedJobs();
+            std::sort(failed_jobs.begin(), failed_jobs.end());
+            std::vector<unsigned> expected_failures = boost::assign::list_of(1)(4);
+            TS_ASSERT_EQUALS(failed_jobs, expected_failures);
+            TS_ASSERT(results[1].empty());
+            TS_ASSERT(results[4].empty());
+            TS_ASSERT_EQUALS(results[0], FakeQueuedJobs::GetExpectedResults(0));
+            TS_ASSERT_EQUALS(results[2], FakeQueuedJobs::GetExpectedResults(2));
+            TS_ASSERT_EQUALS(results[3], FakeQueuedJobs::GetExpectedResults(3));
+        }
+        TS_ASSERT(!PetscTools::IsIsolated());
+        TS_ASSERT(!ProcessIsolation::DoProcessesRunSeparateJobs());
+
+        // Failures from a previous run are forgotten
+        FakeQueuedJobs good_jobs(costs);
+        queue.Run(good_jobs);
+        if (PetscTools::AmMaster())
+        {
+            TS_ASSERT(queue.rGetFailedJobs().empty());
+        }
+    }
+};
+
+#endif // TESTDYNAMICJOBQUEUE_HPP_
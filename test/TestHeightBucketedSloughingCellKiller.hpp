@@ -0,0 +1,188 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTHEIGHTBUCKETEDSLOUGHINGCELLKILLER_HPP_
+#define TESTHEIGHTBUCKETEDSLOUGHINGCELLKILLER_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <fstream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "CheckpointArchiveTypes.hpp"
+
+#include "HeightBucketedSloughingCellKiller.hpp"
+
+#include "CellsGenerator.hpp"
+#include "CellPropertyRegistry.hpp"
+#include "FixedDurationGenerationBasedCellCycleModel.hpp"
+#include "HoneycombMeshGenerator.hpp"
+#include "MeshBasedCellPopulation.hpp"
+#include "SimulationTime.hpp"
+
+#include "OutputFileHandler.hpp"
+#include "RandomNumberGenerator.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestHeightBucketedSloughingCellKiller : public CxxTest::TestSuite
+{
+    void setUp()
+    {
+        SimulationTime::Instance()->SetStartTime(0.0);
+        RandomNumberGenerator::Instance()->Reseed(0);
+        CellPropertyRegistry::Instance()->Clear();
+    }
+
+    void tearDown()
+    {
+        SimulationTime::Destroy();
+        RandomNumberGenerator::Destroy();
+        CellPropertyRegistry::Instance()->Clear();
+    }
+
+public:
+    void TestKillsSameCellsAsCheckingEveryCell() throw (Exception)
+    {
+        // A block of cells 6 wide and about 16 high, which we push upwards through the slough height
+        HoneycombMeshGenerator generator(6, 20, 0);
+        MutableMesh<2,2>* p_mesh = generator.GetMesh();
+        std::vector<CellPtr> cells;
+        CellsGenerator<FixedDurationGenerationBasedCellCycleModel, 2> cells_generator;
+        cells_generator.GenerateBasic(cells, p_mesh->GetNumNodes());
+        MeshBasedCellPopulation<2> cell_population(*p_mesh, cells);
+
+        const double slough_height = 10.0;
+        const double max_displacement = 0.3;
+        HeightBucketedSloughingCellKiller<2> killer(&cell_population, slough_height, 1.0, max_displacement);
+        TS_ASSERT_DELTA(killer.GetSloughHeight(), slough_height, 1e-12);
+        TS_ASSERT_DELTA(killer.GetBandHeight(), 1.0, 1e-12);
+        TS_ASSERT_DELTA(killer.GetMaxDisplacementPerStep(), max_displacement, 1e-12);
+
+        RandomNumberGenerator* p_gen = RandomNumberGenerator::Instance();
+        unsigned num_cells_checked = 0u;
+        unsigned total_killed = 0u;
+        for (unsigned step=0; step<40u; step++)
+        {
+            // Work out which cells should die
+            std::set<unsigned> expected_dead;
+            for (AbstractCellPopulation<2>::Iterator cell_iter = cell_population.Begin();
+                 cell_iter != cell_population.End();
+                 ++cell_iter)
+            {
+                if (cell_population.GetLocationOfCellCentre(*cell_iter)[1] > slough_height)
+                {
+                    expected_dead.insert(cell_iter->GetCellId());
+                }
+                num_cells_checked++;
+            }
+
+            killer.CheckAndLabelCellsForApoptosisOrDeath();
+
+            std::set<unsigned> dead;
+            for (AbstractCellPopulation<2>::Iterator cell_iter = cell_population.Begin();
+                 cell_iter != cell_population.End();
+                 ++cell_iter)
+            {
+                if (cell_iter->IsDead())
+                {
+                    dead.insert(cell_iter->GetCellId());
+                }
+            }
+            TS_ASSERT(dead == expected_dead);
+            total_killed += dead.size();
+
+            cell_population.RemoveDeadCells();
+            cell_population.Update();
+
+            // Move every cell up by a random amount, no more than the maximum displacement
+            for (AbstractCellPopulation<2>::Iterator cell_iter = cell_population.Begin();
+                 cell_iter != cell_population.End();
+                 ++cell_iter)
+            {
+                unsigned node_index = cell_population.GetLocationIndexUsingCell(*cell_iter);
+                cell_population.GetNode(node_index)->rGetModifiableLocation()[1] += max_displacement*p_gen->ranf();
+            }
+        }
+
+        // Cells were killed throughout, but only a fraction were looked at on each step
+        TS_ASSERT_LESS_THAN(50u, total_killed);
+        TS_ASSERT_LESS_THAN(0u, cell_population.GetNumRealCells());
+        TS_ASSERT_LESS_THAN(killer.GetNumCellsInspected(), num_cells_checked/2u);
+    }
+
+    void TestExceptions() throw (Exception)
+    {
+        TS_ASSERT_THROWS_THIS(HeightBucketedSloughingCellKiller<2> killer(NULL, 10.0, 0.0),
+                              "The band height and maximum displacement per step must be positive.");
+        TS_ASSERT_THROWS_THIS(HeightBucketedSloughingCellKiller<2> killer(NULL, 10.0, 1.0, -1.0),
+                              "The band height and maximum displacement per step must be positive.");
+    }
+
+    void TestArchiving() throw (Exception)
+    {
+        OutputFileHandler handler("TestHeightBucketedSloughingCellKiller", false);
+        std::string archive_filename = handler.GetOutputDirectoryFullPath() + "killer.arch";
+
+        {
+            AbstractCellKiller<2>* const p_cell_killer = new HeightBucketedSloughingCellKiller<2>(NULL, 10.0, 2.0, 0.5);
+
+            std::ofstream ofs(archive_filename.c_str());
+            boost::archive::text_oarchive output_arch(ofs);
+            output_arch << p_cell_killer;
+            delete p_cell_killer;
+        }
+
+        {
+            AbstractCellKiller<2>* p_cell_killer;
+
+            std::ifstream ifs(archive_filename.c_str(), std::ios::binary);
+            boost::archive::text_iarchive input_arch(ifs);
+            input_arch >> p_cell_killer;
+
+            HeightBucketedSloughingCellKiller<2>* p_killer = dynamic_cast<HeightBucketedSloughingCellKiller<2>*>(p_cell_killer);
+            TS_ASSERT(p_killer != NULL);
+            TS_ASSERT_DELTA(p_killer->GetSloughHeight(), 10.0, 1e-12);
+            TS_ASSERT_DELTA(p_killer->GetBandHeight(), 2.0, 1e-12);
+            TS_ASSERT_DELTA(p_killer->GetMaxDisplacementPerStep(), 0.5, 1e-12);
+            TS_ASSERT_EQUALS(p_killer->GetNumCellsInspected(), 0u);
+            delete p_cell_killer;
+        }
+    }
+};
+
+#endif // TESTHEIGHTBUCKETEDSLOUGHINGCELLKILLER_HPP_
@@ -0,0 +1,227 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+
+#ifndef TESTMORTONORDEREDCYLINDRICAL2DMESH_HPP_
+#define TESTMORTONORDEREDCYLINDRICAL2DMESH_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <map>
+#include <set>
+#include <vector>
+
+#include "MortonOrderedCylindrical2dMesh.hpp"
+
+#include "CellsGenerator.hpp"
+#include "CellPropertyRegistry.hpp"
+#include "CylindricalHoneycombMeshGenerator.hpp"
+#include "FixedDurationGenerationBasedCellCycleModel.hpp"
+#include "MeshBasedCellPopulationWithGhostNodes.hpp"
+#include "SimulationTime.hpp"
+
+#include "RandomNumberGenerator.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestMortonOrderedCylindrical2dMesh : public CxxTest::TestSuite
+{
+    /**
+     * Check that nodes are numbered along a Morton curve, and that each node's index is its position.
+     *
+     * @param rMesh  the mesh
+     */
+    void CheckOrdered(const MortonOrderedCylindrical2dMesh& rMesh)
+    {
+        std::vector<unsigned> order = rMesh.CalculateMortonOrder();
+        TS_ASSERT_EQUALS(order.size(), rMesh.GetNumNodes());
+        for (unsigned i=0; i<order.size(); i++)
+        {
+            TS_ASSERT_EQUALS(order[i], i);
+            TS_ASSERT_EQUALS(rMesh.GetNode(i)->GetIndex(), i);
+        }
+    }
+
+public:
+    void TestReorderingKeepsNodesAndMesh() throw (Exception)
+    {
+        CylindricalHoneycombMeshGenerator generator(8, 12, 0);
+        Cylindrical2dMesh* p_generated_mesh = generator.GetCylindricalMesh();
+        p_generated_mesh->ReMesh();
+
+        MortonOrderedCylindrical2dMesh mesh(*p_generated_mesh, 2u);
+        TS_ASSERT_EQUALS(mesh.GetReorderingInterval(), 2u);
+        TS_ASSERT_DELTA(mesh.GetWidth(0), p_generated_mesh->GetWidth(0), 1e-12);
+        TS_ASSERT_EQUALS(mesh.GetNumNodes(), p_generated_mesh->GetNumNodes());
+        TS_ASSERT_EQUALS(mesh.GetNumElements(), p_generated_mesh->GetNumElements());
+
+        // Nodes are copied in the same order, and aren't reordered until the second remesh
+        std::vector<c_vector<double, 2> > locations;
+        for (unsigned i=0; i<mesh.GetNumNodes(); i++)
+        {
+            TS_ASSERT_DELTA(mesh.GetNode(i)->rGetLocation()[0], p_generated_mesh->GetNode(i)->rGetLocation()[0], 1e-12);
+            TS_ASSERT_DELTA(mesh.GetNode(i)->rGetLocation()[1], p_generated_mesh->GetNode(i)->rGetLocation()[1], 1e-12);
+            locations.push_back(mesh.GetNode(i)->rGetLocation());
+        }
+        NodeMap map(mesh.GetNumAllNodes());
+        mesh.ReMesh(map);
+        TS_ASSERT(map.IsIdentityMap());
+        TS_ASSERT_EQUALS(mesh.GetNumReorderings(), 0u);
+
+        // Remove a node as well as reordering
+        mesh.DeleteNodePriorToReMesh(5u);
+        NodeMap map2(mesh.GetNumAllNodes());
+        mesh.ReMesh(map2);
+        TS_ASSERT_EQUALS(mesh.GetNumReorderings(), 1u);
+        TS_ASSERT(!map2.IsIdentityMap());
+        TS_ASSERT_EQUALS(mesh.GetNumNodes(), locations.size() - 1u);
+        TS_ASSERT_EQUALS(mesh.GetNumAllNodes(), mesh.GetNumNodes());
+        CheckOrdered(mesh);
+
+        // The map gives where each surviving node has gone
+        TS_ASSERT(map2.IsDeleted(5u));
+        std::set<unsigned> new_indices;
+        for (unsigned old_index=0; old_index<locations.size(); old_index++)
+        {
+            if (old_index != 5u)
+            {
+                unsigned new_index = map2.GetNewIndex(old_index);
+                new_indices.insert(new_index);
+                TS_ASSERT_DELTA(mesh.GetNode(new_index)->rGetLocation()[0], locations[old_index][0], 1e-12);
+                TS_ASSERT_DELTA(mesh.GetNode(new_index)->rGetLocation()[1], locations[old_index][1], 1e-12);
+            }
+        }
+        TS_ASSERT_EQUALS(new_indices.size(), mesh.GetNumNodes());
+
+        // Elements refer to the renumbered nodes, and cover the same area as without reordering
+        p_generated_mesh->DeleteNodePriorToReMesh(5u);
+        p_generated_mesh->ReMesh();
+        TS_ASSERT_EQUALS(mesh.GetNumElements(), p_generated_mesh->GetNumElements());
+        double total_area = 0.0;
+        double generated_total_area = 0.0;
+        c_matrix<double, 2, 2> jacobian;
+        double determinant;
+        for (unsigned i=0; i<mesh.GetNumElements(); i++)
+        {
+            mesh.GetElement(i)->CalculateJacobian(jacobian, determinant);
+            total_area += determinant/2.0;
+            p_generated_mesh->GetElement(i)->CalculateJacobian(jacobian, determinant);
+            generated_total_area += determinant/2.0;
+            for (unsigned j=0; j<3u; j++)
+            {
+                unsigned node_index = mesh.GetElement(i)->GetNodeGlobalIndex(j);
+                TS_ASSERT_EQUALS(mesh.GetNode(node_index), mesh.GetElement(i)->GetNode(j));
+            }
+        }
+        TS_ASSERT_DELTA(total_area, generated_total_area, 1e-9);
+
+        // Reordering an ordered mesh changes nothing
+        for (unsigned i=0; i<2u; i++)
+        {
+            NodeMap map3(mesh.GetNumAllNodes());
+            mesh.ReMesh(map3);
+            TS_ASSERT(map3.IsIdentityMap());
+        }
+        TS_ASSERT_EQUALS(mesh.GetNumReorderings(), 2u);
+    }
+
+    void TestNeverReordering() throw (Exception)
+    {
+        CylindricalHoneycombMeshGenerator generator(6, 6, 0);
+        MortonOrderedCylindrical2dMesh mesh(*generator.GetCylindricalMesh(), 0u);
+        for (unsigned i=0; i<3u; i++)
+        {
+            NodeMap map(mesh.GetNumAllNodes());
+            mesh.ReMesh(map);
+            TS_ASSERT(map.IsIdentityMap());
+        }
+        TS_ASSERT_EQUALS(mesh.GetNumReorderings(), 0u);
+    }
+
+    void TestCellPopulationFollowsReordering() throw (Exception)
+    {
+        SimulationTime::Instance()->SetStartTime(0.0);
+        RandomNumberGenerator::Instance()->Reseed(0);
+        CellPropertyRegistry::Instance()->Clear();
+
+        // A crypt with ghost nodes above and below
+        CylindricalHoneycombMeshGenerator generator(6, 12, 2);
+        MortonOrderedCylindrical2dMesh mesh(*generator.GetCylindricalMesh(), 1u);
+        std::vector<unsigned> location_indices = generator.GetCellLocationIndices();
+        std::vector<CellPtr> cells;
+        CellsGenerator<FixedDurationGenerationBasedCellCycleModel, 2> cells_generator;
+        cells_generator.GenerateBasic(cells, location_indices.size());
+        MeshBasedCellPopulationWithGhostNodes<2> cell_population(mesh, cells, location_indices);
+
+        std::map<unsigned, c_vector<double, 2> > cell_locations;
+        for (AbstractCellPopulation<2>::Iterator cell_iter = cell_population.Begin();
+             cell_iter != cell_population.End();
+             ++cell_iter)
+        {
+            cell_locations[cell_iter->GetCellId()] = cell_population.GetLocationOfCellCentre(*cell_iter);
+        }
+        unsigned num_ghosts = mesh.GetNumNodes() - cell_population.GetNumRealCells();
+
+        cell_population.Update();
+        TS_ASSERT_EQUALS(mesh.GetNumReorderings(), 1u);
+        CheckOrdered(mesh);
+
+        // Every cell is still at the same place, and the remaining nodes are still ghosts
+        for (AbstractCellPopulation<2>::Iterator cell_iter = cell_population.Begin();
+             cell_iter != cell_population.End();
+             ++cell_iter)
+        {
+            c_vector<double, 2> location = cell_population.GetLocationOfCellCentre(*cell_iter);
+            TS_ASSERT_DELTA(location[0], cell_locations[cell_iter->GetCellId()][0], 1e-12);
+            TS_ASSERT_DELTA(location[1], cell_locations[cell_iter->GetCellId()][1], 1e-12);
+            TS_ASSERT(!cell_population.IsGhostNode(cell_population.GetLocationIndexUsingCell(*cell_iter)));
+        }
+        unsigned num_ghosts_after = 0u;
+        for (unsigned i=0; i<mesh.GetNumNodes(); i++)
+        {
+            if (cell_population.IsGhostNode(i))
+            {
+                num_ghosts_after++;
+            }
+        }
+        TS_ASSERT_EQUALS(num_ghosts_after, num_ghosts);
+
+        SimulationTime::Destroy();
+        RandomNumberGenerator::Destroy();
+        CellPropertyRegistry::Instance()->Clear();
+    }
+};
+
+#endif // TESTMORTONORDEREDCYLINDRICAL2DMESH_HPP_
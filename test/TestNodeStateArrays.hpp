@@ -0,0 +1,241 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+
+#ifndef TESTNODESTATEARRAYS_HPP_
+#define TESTNODESTATEARRAYS_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <cmath>
+#include <vector>
+
+#include "NodeStateArrays.hpp"
+#include "NodeStateSpringForce.hpp"
+#include "CellRetainerForce.hpp"
+#include "NodeStateVolumeTrackingModifier.hpp"
+
+#include "CellsGenerator.hpp"
+#include "CellPropertyRegistry.hpp"
+#include "FixedDurationGenerationBasedCellCycleModel.hpp"
+#include "HoneycombMeshGenerator.hpp"
+#include "CylindricalHoneycombMeshGenerator.hpp"
+#include "MeshBasedCellPopulation.hpp"
+#include "MeshBasedCellPopulationWithGhostNodes.hpp"
+#include "SimulationTime.hpp"
+#include "StemCellProliferativeType.hpp"
+
+#include "RandomNumberGenerator.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestNodeStateArrays : public CxxTest::TestSuite
+{
+    void setUp()
+    {
+        SimulationTime::Instance()->SetStartTime(0.0);
+        SimulationTime::Instance()->SetEndTimeAndNumberOfTimeSteps(10.0, 100);
+        RandomNumberGenerator::Instance()->Reseed(0);
+        CellPropertyRegistry::Instance()->Clear();
+    }
+
+    void tearDown()
+    {
+        SimulationTime::Destroy();
+        RandomNumberGenerator::Destroy();
+        CellPropertyRegistry::Instance()->Clear();
+    }
+
+public:
+    void TestForceArraysMatchNodeForces() throw (Exception)
+    {
+        // A jiggled honeycomb, so springs aren't at their rest length, with a few stem cells
+        HoneycombMeshGenerator generator(5, 5, 0);
+        MutableMesh<2,2>* p_mesh = generator.GetMesh();
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            p_mesh->GetNode(i)->rGetModifiableLocation()[0] += 0.2*RandomNumberGenerator::Instance()->ranf() - 0.1;
+            p_mesh->GetNode(i)->rGetModifiableLocation()[1] += 0.2*RandomNumberGenerator::Instance()->ranf() - 0.1;
+        }
+        std::vector<CellPtr> cells;
+        CellsGenerator<FixedDurationGenerationBasedCellCycleModel, 2> cells_generator;
+        cells_generator.GenerateBasic(cells, p_mesh->GetNumNodes());
+        boost::shared_ptr<AbstractCellProperty> p_stem_type(CellPropertyRegistry::Instance()->Get<StemCellProliferativeType>());
+        for (unsigned i=0; i<5u; i++)
+        {
+            cells[i]->SetCellProliferativeType(p_stem_type);
+        }
+        MeshBasedCellPopulation<2> cell_population(*p_mesh, cells);
+
+        NodeStateArrays<2> node_state;
+        node_state.Gather(cell_population);
+        TS_ASSERT_EQUALS(node_state.GetNumNodes(), p_mesh->GetNumNodes());
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            TS_ASSERT_EQUALS(node_state.GetForce(i)[0], 0.0);
+            TS_ASSERT_EQUALS(node_state.GetForces(1)[i], 0.0);
+            TS_ASSERT_EQUALS(node_state.GetLocations(0)[i], (NodeStateValue)p_mesh->GetNode(i)->rGetLocation()[0]);
+            TS_ASSERT_EQUALS(node_state.GetLocation(i)[1], (double)(NodeStateValue)p_mesh->GetNode(i)->rGetLocation()[1]);
+            TS_ASSERT_EQUALS(node_state.GetRadii()[i], (NodeStateValue)p_mesh->GetNode(i)->GetRadius());
+            TS_ASSERT_EQUALS(node_state.GetRadius(i), 0.5);
+        }
+
+        // Forces added to the arrays are those added to the nodes; exactly so unless stored in single precision
+        const double tolerance = (sizeof(NodeStateValue) == sizeof(double)) ? 0.0 : 1e-4;
+        NodeStateSpringForce<2> spring_force;
+        CellRetainerForce<2> retainer_force;
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            p_mesh->GetNode(i)->ClearAppliedForce();
+        }
+        spring_force.AddForceContribution(cell_population);
+        retainer_force.AddForceContribution(cell_population);
+        spring_force.AddForceContribution(node_state, cell_population);
+        retainer_force.AddForceContribution(node_state, cell_population);
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            const c_vector<double, 2>& r_force = p_mesh->GetNode(i)->rGetAppliedForce();
+            TS_ASSERT_DELTA(node_state.GetForces(0)[i], r_force[0], tolerance*(1.0 + fabs(r_force[0])));
+            TS_ASSERT_DELTA(node_state.GetForces(1)[i], r_force[1], tolerance*(1.0 + fabs(r_force[1])));
+            TS_ASSERT_EQUALS(node_state.GetForce(i)[0], (double)node_state.GetForces(0)[i]);
+        }
+        TS_ASSERT_LESS_THAN(0.0, norm_2(node_state.GetForce(0u)));
+        TS_ASSERT_EQUALS(retainer_force.GetForceMagnitude(cells[0]), 10.0);
+        TS_ASSERT_EQUALS(retainer_force.GetForceMagnitude(cells[5]), 0.0);
+
+        // Forces can be copied to and from the nodes
+        node_state.Gather(cell_population);
+        node_state.AddNodeForces(cell_population);
+        NodeStateArrays<2> copied_state(node_state);
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            TS_ASSERT_EQUALS(node_state.GetForce(i)[1], (NodeStateValue)p_mesh->GetNode(i)->rGetAppliedForce()[1]);
+            p_mesh->GetNode(i)->ClearAppliedForce();
+        }
+        copied_state.ScatterForces(cell_population);
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            TS_ASSERT_EQUALS(p_mesh->GetNode(i)->rGetAppliedForce()[0], node_state.GetForce(i)[0]);
+            TS_ASSERT_EQUALS(p_mesh->GetNode(i)->rGetAppliedForce()[1], node_state.GetForce(i)[1]);
+        }
+    }
+
+    void TestLocationsFollowNodes() throw (Exception)
+    {
+        HoneycombMeshGenerator generator(3, 3, 0);
+        MutableMesh<2,2>* p_mesh = generator.GetMesh();
+        std::vector<CellPtr> cells;
+        CellsGenerator<FixedDurationGenerationBasedCellCycleModel, 2> cells_generator;
+        cells_generator.GenerateBasic(cells, p_mesh->GetNumNodes());
+        MeshBasedCellPopulation<2> cell_population(*p_mesh, cells);
+
+        NodeStateArrays<2> node_state;
+        node_state.Gather(cell_population);
+
+        // Moving a node through the arrays moves the Node too
+        c_vector<double, 2> new_location = p_mesh->GetNode(4)->rGetLocation();
+        new_location[0] += 0.25;
+        new_location[1] -= 0.125;
+        node_state.SetLocation(cell_population, 4, new_location);
+        TS_ASSERT_EQUALS(p_mesh->GetNode(4)->rGetLocation()[0], new_location[0]);
+        TS_ASSERT_EQUALS(p_mesh->GetNode(4)->rGetLocation()[1], new_location[1]);
+        TS_ASSERT_EQUALS(node_state.GetLocation(4)[0], new_location[0]);
+        TS_ASSERT_EQUALS(node_state.GetLocation(4)[1], new_location[1]);
+
+        // A Node moved directly can be copied back into the arrays
+        p_mesh->GetNode(2)->rGetModifiableLocation()[1] = 0.5;
+        TS_ASSERT_DIFFERS(node_state.GetLocation(2)[1], 0.5);
+        node_state.CopyLocation(p_mesh->GetNode(2));
+        TS_ASSERT_EQUALS(node_state.GetLocation(2)[1], 0.5);
+    }
+
+    void TestVolumesFromNodeStateMatchTessellation() throw (Exception)
+    {
+        // A jiggled periodic crypt mesh with ghost nodes, as in CryptProliferationModel
+        CylindricalHoneycombMeshGenerator generator(6, 10, 2);
+        Cylindrical2dMesh* p_mesh = generator.GetCylindricalMesh();
+        double width = p_mesh->GetWidth(0);
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            c_vector<double, 2>& r_location = p_mesh->GetNode(i)->rGetModifiableLocation();
+            r_location[0] += 0.2*RandomNumberGenerator::Instance()->ranf() - 0.1;
+            r_location[1] += 0.2*RandomNumberGenerator::Instance()->ranf() - 0.1;
+            if (r_location[0] < 0.0)
+            {
+                r_location[0] += width;
+            }
+            else if (r_location[0] >= width)
+            {
+                r_location[0] -= width;
+            }
+        }
+        std::vector<unsigned> location_indices = generator.GetCellLocationIndices();
+        std::vector<CellPtr> cells;
+        CellsGenerator<FixedDurationGenerationBasedCellCycleModel, 2> cells_generator;
+        cells_generator.GenerateBasic(cells, location_indices.size(), location_indices);
+        MeshBasedCellPopulationWithGhostNodes<2> cell_population(*p_mesh, cells, location_indices);
+
+        // Volumes from the population's own tessellation, once the jiggled nodes have been remeshed
+        cell_population.Update();
+        cell_population.CreateVoronoiTessellation();
+        std::vector<double> tessellation_volumes;
+        for (AbstractCellPopulation<2>::Iterator cell_iter = cell_population.Begin();
+             cell_iter != cell_population.End();
+             ++cell_iter)
+        {
+            tessellation_volumes.push_back(cell_population.GetVolumeOfCell(*cell_iter));
+        }
+
+        boost::shared_ptr<NodeStateArrays<2> > p_node_state(new NodeStateArrays<2>);
+        NodeStateVolumeTrackingModifier modifier;
+        modifier.SetNodeState(p_node_state);
+        modifier.SetupSolve(cell_population, "TestVolumesFromNodeStateMatchTessellation");
+
+        // The areas differ only by rounding, which is that of the stored locations in single precision
+        const double tolerance = (sizeof(NodeStateValue) == sizeof(double)) ? 1e-9 : 1e-4;
+        unsigned i = 0;
+        for (AbstractCellPopulation<2>::Iterator cell_iter = cell_population.Begin();
+             cell_iter != cell_population.End();
+             ++cell_iter, ++i)
+        {
+            TS_ASSERT_LESS_THAN(0.5, tessellation_volumes[i]);
+            TS_ASSERT_LESS_THAN(tessellation_volumes[i], 1.5);
+            TS_ASSERT_DELTA(cell_iter->GetCellData()->GetItem("volume"), tessellation_volumes[i], tolerance);
+        }
+        TS_ASSERT_EQUALS(i, location_indices.size());
+    }
+};
+
+#endif // TESTNODESTATEARRAYS_HPP_
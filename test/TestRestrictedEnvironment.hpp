@@ -73,6 +73,77 @@ public:
         TS_ASSERT_EQUALS(env.Lookup("zero", "TestRestrictedEnvironment"), p_zero);
         TS_ASSERT_EQUALS(env.Lookup("one", "TestRestrictedEnvironment"), p_one);
     }
+
+    void TestDefinitionsAsText() throw (Exception)
+    {
+        std::map<std::string, AbstractValuePtr> initial_values
+            = boost::assign::map_list_of("b", CV(0.1))
+                                        ("a", CV(2.0));
+        RestrictedEnvironment env(initial_values);
+        TS_ASSERT_EQUALS(env.GetDefinitionsAsText(), "a = 2\nb = 0.10000000000000001\n");
+
+        // Changing a value changes the text
+        env.OverwriteDefinition("a", CV(3.0), "TestRestrictedEnvironment");
+        TS_ASSERT_EQUALS(env.GetDefinitionsAsText(), "a = 3\nb = 0.10000000000000001\n");
+    }
+
+    void TestBoundValues() throw (Exception)
+    {
+        std::map<std::string, AbstractValuePtr> initial_values
+            = boost::assign::map_list_of("zero", CV(0.0))
+                                        ("null", AbstractValuePtr(boost::make_shared<NullValue>()));
+        RestrictedEnvironment env(initial_values);
+
+        // Binding sets the variable to the current value, and it tracks later definitions
+        double zero = -1.0;
+        env.BindValue("zero", &zero);
+        TS_ASSERT_EQUALS(zero, 0.0);
+        env.OverwriteDefinition("zero", CV(2.5), "TestRestrictedEnvironment");
+        TS_ASSERT_EQUALS(zero, 2.5);
+        TS_ASSERT_EQUALS(GET_SIMPLE_VALUE(env.Lookup("zero", "TestRestrictedEnvironment")), 2.5);
+
+        // Type checking still applies to bound definitions
+        TS_ASSERT_THROWS_CONTAINS(env.OverwriteDefinition("zero", boost::make_shared<NullValue>(), "TestRestrictedEnvironment"),
+                                  "New definition for 'zero' has a different type.");
+        TS_ASSERT_EQUALS(zero, 2.5);
+
+        // Nor may a bound definition be replaced by anything other than a simple value
+        NdArray<double>::Extents extents(1, 2u);
+        AbstractValuePtr p_array = boost::make_shared<ArrayValue>(NdArray<double>(extents));
+        TS_ASSERT_THROWS_CONTAINS(env.OverwriteDefinition("zero", p_array, "TestRestrictedEnvironment"),
+                                  "New definition for 'zero'");
+        TS_ASSERT_EQUALS(zero, 2.5);
+        TS_ASSERT_EQUALS(GET_SIMPLE_VALUE(env.Lookup("zero", "TestRestrictedEnvironment")), 2.5);
+
+        // Definitions may also be set through a pre-resolved handle
+        RestrictedEnvironment::DefinitionHandle handle = env.GetHandle("zero");
+        env.OverwriteDefinition(handle, CV(4.0), "TestRestrictedEnvironment");
+        TS_ASSERT_EQUALS(zero, 4.0);
+        TS_ASSERT_EQUALS(GET_SIMPLE_VALUE(env.Lookup("zero", "TestRestrictedEnvironment")), 4.0);
+        TS_ASSERT_THROWS_CONTAINS(env.OverwriteDefinition(handle, p_array, "TestRestrictedEnvironment"),
+                                  "New definition for 'zero'");
+        TS_ASSERT_THROWS_CONTAINS(env.GetHandle("missing"), "Name missing is not defined and may not be overwritten.");
+
+        // A handle resolved once stays valid however the definition is set, as for a repeated modifier
+        for (unsigned i=0; i<3u; i++)
+        {
+            env.OverwriteDefinition(handle, CV(i), "TestRestrictedEnvironment");
+            TS_ASSERT_EQUALS(zero, (double)i);
+            env.OverwriteDefinition("zero", CV(i + 0.5), "TestRestrictedEnvironment");
+            TS_ASSERT_EQUALS(zero, i + 0.5);
+        }
+        TS_ASSERT_EQUALS(env.GetHandle("zero"), handle);
+        env.OverwriteDefinition("zero", CV(2.5), "TestRestrictedEnvironment");
+
+        // Once unbound, the variable is no longer updated
+        env.BindValue("zero", NULL);
+        env.OverwriteDefinition("zero", CV(3.0), "TestRestrictedEnvironment");
+        TS_ASSERT_EQUALS(zero, 2.5);
+
+        // Only existing simple values may be bound
+        TS_ASSERT_THROWS_CONTAINS(env.BindValue("missing", &zero), "Name missing is not defined and may not be bound.");
+        TS_ASSERT_THROWS_CONTAINS(env.BindValue("null", &zero), "Only simple values may be bound to a variable");
+    }
 };
 
 #endif // TESTRESTRICTEDENVIRONMENT_HPP_
@@ -0,0 +1,100 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+#ifndef TESTRESULTCACHE_HPP_
+#define TESTRESULTCACHE_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <cstdlib>
+#include <vector>
+
+#include "ResultCache.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestResultCache : public CxxTest::TestSuite
+{
+public:
+    void TestHash() throw (Exception)
+    {
+        // Reference values for 64-bit FNV-1a
+        TS_ASSERT_EQUALS(ResultCache::Hash(""), "cbf29ce484222325");
+        TS_ASSERT_EQUALS(ResultCache::Hash("a"), "af63dc4c8601ec8c");
+        TS_ASSERT_DIFFERS(ResultCache::Hash("end_time = 10\n"), ResultCache::Hash("end_time = 11\n"));
+    }
+
+    void TestStoreAndLookup() throw (Exception)
+    {
+        OutputFileHandler handler("TestResultCache");
+        FileFinder cache_folder = handler.FindFile("cache");
+        out_stream p_file = handler.OpenOutputFile("divisions.dat");
+        *p_file << "0.4 1 2 3" << std::endl;
+        p_file->close();
+        std::vector<FileFinder> files(1, handler.FindFile("divisions.dat"));
+
+        ResultCache cache(cache_folder, "model = A\nend_time = 10\n");
+        TS_ASSERT(!cache.Contains());
+        cache.Store(files);
+        TS_ASSERT(cache.Contains());
+        TS_ASSERT(cache.GetEntryFile("divisions.dat").IsFile());
+        TS_ASSERT_EQUALS(cache.GetEntryFile("divisions.dat").GetParent().GetLeafName(), cache.rGetHash());
+
+        // A different key misses
+        ResultCache other_cache(cache_folder, "model = A\nend_time = 11\n");
+        TS_ASSERT(!other_cache.Contains());
+
+        // Storing again replaces the entry
+        cache.Store(files);
+        TS_ASSERT(cache.Contains());
+    }
+
+    void TestModeFromEnvironment() throw (Exception)
+    {
+        unsetenv("CRYPT_RESULT_CACHE");
+        TS_ASSERT_EQUALS(ResultCache::GetModeFromEnvironment(ResultCache::USE), ResultCache::USE);
+        setenv("CRYPT_RESULT_CACHE", "refresh", 1);
+        TS_ASSERT_EQUALS(ResultCache::GetModeFromEnvironment(ResultCache::USE), ResultCache::REFRESH);
+        setenv("CRYPT_RESULT_CACHE", "bypass", 1);
+        TS_ASSERT_EQUALS(ResultCache::GetModeFromEnvironment(ResultCache::USE), ResultCache::BYPASS);
+        setenv("CRYPT_RESULT_CACHE", "sometimes", 1);
+        TS_ASSERT_THROWS_CONTAINS(ResultCache::GetModeFromEnvironment(ResultCache::USE),
+                                  "CRYPT_RESULT_CACHE must be one of bypass, use or refresh");
+        unsetenv("CRYPT_RESULT_CACHE");
+    }
+};
+
+#endif // TESTRESULTCACHE_HPP_
@@ -0,0 +1,211 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTSEMIIMPLICITSPRINGSOLVER_HPP_
+#define TESTSEMIIMPLICITSPRINGSOLVER_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <cmath>
+#include <vector>
+
+#include "SemiImplicitSpringSolver.hpp"
+#include "NodeStateArrays.hpp"
+
+#include "CellsGenerator.hpp"
+#include "FixedDurationGenerationBasedCellCycleModel.hpp"
+#include "HoneycombMeshGenerator.hpp"
+#include "MeshBasedCellPopulation.hpp"
+#include "NodeStateSpringForce.hpp"
+#include "SimulationTime.hpp"
+
+#include "RandomNumberGenerator.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestSemiImplicitSpringSolver : public CxxTest::TestSuite
+{
+private:
+    /**
+     * Make a honeycomb mesh with jiggled nodes, so springs aren't at their rest length, and a cell for each node.
+     *
+     * @param rGenerator  generates the mesh
+     * @param rCells  filled in with the cells
+     * @return  the mesh
+     */
+    MutableMesh<2,2>* MakeJiggledHoneycomb(HoneycombMeshGenerator& rGenerator, std::vector<CellPtr>& rCells)
+    {
+        MutableMesh<2,2>* p_mesh = rGenerator.GetMesh();
+        for (unsigned i=0; i<p_mesh->GetNumNodes(); i++)
+        {
+            p_mesh->GetNode(i)->rGetModifiableLocation()[0] += 0.2*RandomNumberGenerator::Instance()->ranf() - 0.1;
+            p_mesh->GetNode(i)->rGetModifiableLocation()[1] += 0.2*RandomNumberGenerator::Instance()->ranf() - 0.1;
+        }
+        CellsGenerator<FixedDurationGenerationBasedCellCycleModel, 2> cells_generator;
+        cells_generator.GenerateBasic(rCells, p_mesh->GetNumNodes());
+        return p_mesh;
+    }
+
+public:
+    void setUp()
+    {
+        SimulationTime::Instance()->SetStartTime(0.0);
+        SimulationTime::Instance()->SetEndTimeAndNumberOfTimeSteps(10.0, 100);
+        RandomNumberGenerator::Instance()->Reseed(0);
+    }
+
+    void tearDown()
+    {
+        SimulationTime::Destroy();
+        RandomNumberGenerator::Destroy();
+    }
+
+    void TestSolvesLinearisedSystem() throw (Exception)
+    {
+        HoneycombMeshGenerator generator(6, 6, 0);
+        std::vector<CellPtr> cells;
+        MutableMesh<2,2>* p_mesh = MakeJiggledHoneycomb(generator, cells);
+        MeshBasedCellPopulation<2> cell_population(*p_mesh, cells);
+        unsigned num_nodes = p_mesh->GetNumNodes();
+
+        NodeStateArrays<2> node_state;
+        node_state.Gather(cell_population);
+        SemiImplicitSpringSolver<2> solver;
+        solver.Reset(num_nodes);
+        NodeStateSpringForce<2> force;
+        force.AddForceContribution(node_state, cell_population, &solver);
+        TS_ASSERT_LESS_THAN(0u, solver.GetNumSprings());
+
+        // The last node is held fixed; the rest have a timestep of 1/36 hours
+        const double damping_over_dt = 36.0;
+        for (unsigned i=0; i<num_nodes-1; i++)
+        {
+            solver.SetDampingTerm(i, damping_over_dt);
+        }
+        solver.Solve(node_state);
+        TS_ASSERT_LESS_THAN(0u, solver.GetNumIterations());
+        TS_ASSERT_DELTA(norm_2(solver.GetDisplacement(num_nodes-1)), 0.0, 1e-12);
+
+        // Check the residual of each free node directly, recomputing each spring's stiffness from scratch
+        std::vector<c_vector<double, 2> > residuals(num_nodes);
+        for (unsigned i=0; i<num_nodes; i++)
+        {
+            residuals[i] = damping_over_dt*solver.GetDisplacement(i) - node_state.GetForce(i);
+        }
+        for (MeshBasedCellPopulation<2>::SpringIterator spring_iter = cell_population.SpringsBegin();
+             spring_iter != cell_population.SpringsEnd();
+             ++spring_iter)
+        {
+            unsigned a = spring_iter.GetNodeA()->GetIndex();
+            unsigned b = spring_iter.GetNodeB()->GetIndex();
+            c_vector<double, 2> a_to_b = p_mesh->GetVectorFromAtoB(spring_iter.GetNodeA()->rGetLocation(),
+                                                                   spring_iter.GetNodeB()->rGetLocation());
+            if (norm_2(a_to_b) < force.GetCutOffLength())
+            {
+                c_vector<double, 2> unit = a_to_b/norm_2(a_to_b);
+                double stretch = force.GetMeinekeSpringStiffness()
+                        *inner_prod(unit, solver.GetDisplacement(a) - solver.GetDisplacement(b));
+                residuals[a] += stretch*unit;
+                residuals[b] -= stretch*unit;
+            }
+        }
+        for (unsigned i=0; i<num_nodes-1; i++)
+        {
+            TS_ASSERT_DELTA(norm_2(residuals[i]), 0.0, 1e-6);
+        }
+
+        // With a tiny timestep the displacement is the explicit one
+        node_state.Gather(cell_population);
+        solver.Reset(num_nodes);
+        force.AddForceContribution(node_state, cell_population, &solver);
+        for (unsigned i=0; i<num_nodes; i++)
+        {
+            solver.SetDampingTerm(i, 1e10);
+        }
+        solver.Solve(node_state);
+        for (unsigned i=0; i<num_nodes; i++)
+        {
+            TS_ASSERT_DELTA(1e10*solver.GetDisplacement(i)[0], node_state.GetForce(i)[0], 1e-6*(1.0 + fabs(node_state.GetForce(i)[0])));
+        }
+
+        // Too few iterations to converge
+        solver.SetTolerance(1e-12, 1u);
+        TS_ASSERT_THROWS_CONTAINS(solver.Solve(node_state), "did not converge in 1 iterations");
+    }
+
+    void TestStableForLargeTimesteps() throw (Exception)
+    {
+        // The solver only needs node state of the right size, which comes from a population
+        HoneycombMeshGenerator generator(3, 3, 0);
+        std::vector<CellPtr> cells;
+        MutableMesh<2,2>* p_mesh = MakeJiggledHoneycomb(generator, cells);
+        MeshBasedCellPopulation<2> cell_population(*p_mesh, cells);
+        unsigned num_nodes = p_mesh->GetNumNodes();
+        NodeStateArrays<2> node_state;
+        SemiImplicitSpringSolver<2> solver;
+
+        // Nodes 0 and 1 are joined by a stretched spring, and move with a timestep 50 times the explicit
+        // stability limit of 1/stiffness; all other nodes are held fixed
+        const double stiffness = 100.0;
+        const double dt = 0.5;
+        double left = 0.0;
+        double right = 2.0;
+        c_vector<double, 2> unit_vector = zero_vector<double>(2);
+        unit_vector[0] = 1.0;
+        for (unsigned step=0; step<20u; step++)
+        {
+            node_state.Gather(cell_population);
+            double spring_force = stiffness*(right - left - 1.0);
+            node_state.GetForces(0)[0] = spring_force;
+            node_state.GetForces(0)[1] = -spring_force;
+
+            solver.Reset(num_nodes);
+            solver.SetDampingTerm(0u, 1.0/dt);
+            solver.SetDampingTerm(1u, 1.0/dt);
+            solver.AddSpring(0u, 1u, unit_vector, stiffness);
+            solver.Solve(node_state);
+            left += solver.GetDisplacement(0u)[0];
+            right += solver.GetDisplacement(1u)[0];
+            TS_ASSERT_DELTA(solver.GetDisplacement(0u)[1], 0.0, 1e-12);
+            TS_ASSERT_DELTA(norm_2(solver.GetDisplacement(2u)), 0.0, 1e-12);
+        }
+
+        // The explicit update would multiply the stretch by -99 each step; here it relaxes to the rest length
+        TS_ASSERT_DELTA(right - left, 1.0, 1e-6);
+        TS_ASSERT_DELTA(right + left, 2.0, 1e-12);
+    }
+};
+
+#endif // TESTSEMIIMPLICITSPRINGSOLVER_HPP_
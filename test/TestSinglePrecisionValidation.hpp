@@ -0,0 +1,198 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTSINGLEPRECISIONVALIDATION_HPP_
+#define TESTSINGLEPRECISIONVALIDATION_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/assign/list_of.hpp>
+#include <boost/foreach.hpp>
+
+#include "CryptProliferationModel.hpp"
+#include "CryptSweepRunner.hpp"
+#include "NodeStateArrays.hpp"
+
+#include "ProtocolFileFinder.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "PetscTools.hpp"
+#include "NumericFileComparison.hpp"
+#include "PetscSetupAndFinalize.hpp"
+
+/**
+ * Validates a build with CRYPT_SINGLE_PRECISION_NODE_STATE defined (see NodeStateArrays) against the reference
+ * division histograms in test/data, by re-running the paper's parameter sweep with node state arrays.
+ *
+ * In such a build node locations, radii and forces are all stored in single precision.  Spring forces are
+ * computed from the stored locations, nodes are moved from them, and cell volumes are computed from them, so
+ * rounding to single precision is carried from one timestep to the next rather than only affecting each step's
+ * forces.  Near the top of a 30 cell crypt this rounding is about 2e-6 cell diameters, well below the distance
+ * a cell moves in a timestep.
+ *
+ * In a double precision build the results are identical to the reference, and are checked to the same tolerances
+ * as in TestCryptProliferationLiteratePaper.  In a single precision build, rounding makes trajectories diverge
+ * from the reference run, so the histograms are a different sample of the same steady state; each box's
+ * percentage of divisions must then be within MAX_PERCENTAGE_DIFFERENCE of the reference.  Either way, a report
+ * comparing every box is written to CryptProliferationPrecisionValidation/precision_report.csv.
+ *
+ * This runs every model for 2200 hours at five crypt heights, so is in the Simulations test pack.
+ */
+class TestSinglePrecisionValidation : public CxxTest::TestSuite
+{
+private:
+    /**
+     * Read a CSV file of numbers, as written by the protocol outputs, skipping comment lines.
+     *
+     * @param rFile  the file
+     * @return  each row of the file
+     */
+    std::vector<std::vector<double> > ReadCsv(const FileFinder& rFile)
+    {
+        std::vector<std::vector<double> > rows;
+        std::ifstream file(rFile.GetAbsolutePath().c_str());
+        TS_ASSERT(file.is_open());
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::vector<double> row;
+            std::stringstream line_stream(line);
+            std::string item;
+            while (std::getline(line_stream, item, ','))
+            {
+                row.push_back(atof(item.c_str()));
+            }
+            rows.push_back(row);
+        }
+        return rows;
+    }
+
+public:
+    void TestHistogramsMatchReference() throw (Exception)
+    {
+        // The largest difference allowed between single precision and reference percentages of divisions in a box
+        const double MAX_PERCENTAGE_DIFFERENCE = 3.0;
+
+        FileFinder this_test(__FILE__, RelativeTo::ChasteSourceRoot);
+        ProtocolFileFinder proto_file("protocols/CryptProliferationBenchmark.txt", this_test);
+        std::vector<CryptProliferationModel::ModelType> model_types = boost::assign::list_of
+                (CryptProliferationModel::UNIFORM_WNT)
+                (CryptProliferationModel::VARIABLE_WNT)
+                (CryptProliferationModel::STOCHASTIC_GEN_BASED);
+        std::vector<double> heights = boost::assign::list_of(10)(15)(20)(25)(30);
+
+        // The same sweep as TestCryptProliferationLiteratePaper::TestParameterSweep, using node state arrays.  The
+        // benchmark protocol sets up the crypt as CryptProliferation.txt does, but can enable the optimisations.
+        const std::string output_folder_name = "CryptProliferationPrecisionValidation";
+        CryptSweepRunner runner(proto_file, output_folder_name, model_types);
+        runner.AddSweepAxis("crypt_height", "heights", "Crypt height", heights, true);
+        std::map<std::string, double> protocol_inputs;
+        protocol_inputs["num_boxes"] = 10;
+        protocol_inputs["end_time"] = 2200;
+        protocol_inputs["steady_state_time"] = 200;
+        protocol_inputs["node_state_arrays"] = 1;
+        runner.SetProtocolInputs(protocol_inputs);
+        // A validation must run the simulations, so cached results are only used if CRYPT_RESULT_CACHE asks for them
+        runner.SetResultCacheMode(ResultCache::GetModeFromEnvironment(ResultCache::BYPASS));
+        bool success = runner.Run();
+
+        OutputFileHandler handler(output_folder_name, false);
+        if (PetscTools::AmMaster())
+        {
+            TS_ASSERT(success);
+            bool single_precision = (sizeof(NodeStateValue) != sizeof(double));
+            out_stream p_report = handler.OpenOutputFile("precision_report.csv");
+            *p_report << "# node_state_precision = " << (single_precision ? "single" : "double")
+                      << " (locations, radii and forces)" << std::endl;
+            *p_report << "model,crypt_height,box,reference_percent,percent,difference" << std::endl;
+
+            BOOST_FOREACH(CryptProliferationModel::ModelType model_type, model_types)
+            {
+                std::string sub_folder_name = CryptSweepRunner::GetModelFolderName(model_type);
+                FileFinder new_data = handler.FindFile(sub_folder_name + "/outputs_norm_freqs.csv");
+                FileFinder reference_data("data/" + sub_folder_name + "-outputs_norm_freqs.csv", this_test);
+
+                // Rows are histogram boxes, and columns crypt heights
+                std::vector<std::vector<double> > new_freqs = ReadCsv(new_data);
+                std::vector<std::vector<double> > reference_freqs = ReadCsv(reference_data);
+                TS_ASSERT_EQUALS(new_freqs.size(), reference_freqs.size());
+                double max_difference = 0.0;
+                for (unsigned box=0; box<std::min(new_freqs.size(), reference_freqs.size()); box++)
+                {
+                    TS_ASSERT_EQUALS(new_freqs[box].size(), heights.size());
+                    TS_ASSERT_EQUALS(reference_freqs[box].size(), heights.size());
+                    for (unsigned i=0; i<std::min(new_freqs[box].size(), reference_freqs[box].size()); i++)
+                    {
+                        double difference = new_freqs[box][i] - reference_freqs[box][i];
+                        max_difference = std::max(max_difference, fabs(difference));
+                        *p_report << CryptProliferationModel::GetModelName(model_type) << "," << heights[i] << ","
+                                  << box << "," << reference_freqs[box][i] << "," << new_freqs[box][i] << ","
+                                  << difference << std::endl;
+                    }
+                }
+                std::cout << CryptProliferationModel::GetModelName(model_type)
+                          << ": largest difference from reference " << max_difference << " percentage points" << std::endl;
+
+                if (single_precision)
+                {
+                    TS_ASSERT_LESS_THAN_EQUALS(max_difference, MAX_PERCENTAGE_DIFFERENCE);
+                }
+                else
+                {
+                    // The arguments to CompareFiles are absolute tolerance, number of header lines, relative tolerance
+                    NumericFileComparison comp(new_data, reference_data, false);
+                    TS_ASSERT(comp.CompareFiles(1e-4, 1, 1e-6));
+                }
+            }
+            p_report->close();
+        }
+    }
+};
+
+#endif // TESTSINGLEPRECISIONVALIDATION_HPP_
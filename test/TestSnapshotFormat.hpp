@@ -0,0 +1,311 @@
+/*
+
+Copyright (c) 2005-2012, University of Oxford.
+All rights reserved.
+
+University of Oxford means the Chancellor, Masters and Scholars of the
+University of Oxford, having an administrative office at Wellington
+Square, Oxford OX1 2JD, UK.
+
+This file is part of Chaste.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+ * Redistributions of source code must retain the above copyright notice,
+   this list of conditions and the following disclaimer.
+ * Redistributions in binary form must reproduce the above copyright notice,
+   this list of conditions and the following disclaimer in the documentation
+   and/or other materials provided with the distribution.
+ * Neither the name of the University of Oxford nor the names of its
+   contributors may be used to endorse or promote products derived from this
+   software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE
+GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TESTSNAPSHOTFORMAT_HPP_
+#define TESTSNAPSHOTFORMAT_HPP_
+
+#include <cxxtest/TestSuite.h>
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "SnapshotCodec.hpp"
+#include "SnapshotReader.hpp"
+#include "SnapshotWriter.hpp"
+
+#include "FileFinder.hpp"
+#include "OutputFileHandler.hpp"
+#include "RandomNumberGenerator.hpp"
+#include "FakePetscSetup.hpp"
+
+class TestSnapshotFormat : public CxxTest::TestSuite
+{
+    /**
+     * Make a sequence of frames of a 2d population in which cells jiggle about, divide, die, change colour,
+     * and rearrange their mesh, with cells in a different order each frame.
+     *
+     * @param numFrames  the number of frames to make
+     * @return  the frames
+     */
+    std::vector<SnapshotFrame> MakeFrames(unsigned numFrames)
+    {
+        RandomNumberGenerator* p_gen = RandomNumberGenerator::Instance();
+        p_gen->Reseed(0);
+        std::vector<SnapshotFrame> frames;
+        SnapshotFrame frame;
+        frame.mTime = 0.0;
+        unsigned next_id = 0u;
+        for (unsigned i=0; i<200u; i++)
+        {
+            frame.mCellIds.push_back(next_id++);
+            frame.mColours.push_back(i % 3u);
+            frame.mLocations.push_back(10.0*p_gen->ranf());
+            frame.mLocations.push_back(20.0*p_gen->ranf());
+        }
+        for (unsigned i=0; i<numFrames; i++)
+        {
+            frame.mTime = 0.5*i;
+            for (unsigned j=0; j<frame.mLocations.size(); j++)
+            {
+                frame.mLocations[j] += 0.01*(p_gen->ranf() - 0.5);
+            }
+            if (i % 3u == 1u)
+            {
+                // A cell is sloughed
+                unsigned k = p_gen->randMod(frame.mCellIds.size());
+                frame.mCellIds.erase(frame.mCellIds.begin() + k);
+                frame.mColours.erase(frame.mColours.begin() + k);
+                frame.mLocations.erase(frame.mLocations.begin() + 2*k, frame.mLocations.begin() + 2*k + 2);
+            }
+            if (i % 5u == 2u)
+            {
+                // A cell is born, and put at the front
+                frame.mCellIds.insert(frame.mCellIds.begin(), next_id++);
+                frame.mColours.insert(frame.mColours.begin(), 1);
+                frame.mLocations.insert(frame.mLocations.begin(), 2u, 1.5);
+            }
+            if (i % 7u == 3u)
+            {
+                frame.mColours[5] = 4;
+            }
+            // The mesh only changes now and then
+            if (i % 4u == 0u || frame.mElements.empty())
+            {
+                frame.mElements.clear();
+                for (unsigned e=i%4u; e+2u<frame.mCellIds.size(); e+=3u)
+                {
+                    frame.mElements.push_back(e);
+                    frame.mElements.push_back(e + 1u);
+                    frame.mElements.push_back(e + 2u);
+                }
+            }
+            frames.push_back(frame);
+        }
+        return frames;
+    }
+
+    /**
+     * Check a frame read back matches the one written, allowing for the cells being reordered by id and
+     * locations being rounded.
+     *
+     * @param rRead  the frame read back
+     * @param rWritten  the frame written
+     * @param quantum  the quantum used in writing
+     */
+    void CheckFrame(const SnapshotFrame& rRead, const SnapshotFrame& rWritten, double quantum)
+    {
+        TS_ASSERT_EQUALS(rRead.mTime, rWritten.mTime);
+        TS_ASSERT_EQUALS(rRead.mCellIds.size(), rWritten.mCellIds.size());
+        TS_ASSERT_EQUALS(rRead.mElements.size(), rWritten.mElements.size());
+        std::map<unsigned, unsigned> read_index_of_id;
+        for (unsigned i=0; i<rRead.mCellIds.size(); i++)
+        {
+            read_index_of_id[rRead.mCellIds[i]] = i;
+            if (i > 0u)
+            {
+                TS_ASSERT_LESS_THAN(rRead.mCellIds[i-1], rRead.mCellIds[i]);
+            }
+        }
+        for (unsigned i=0; i<rWritten.mCellIds.size(); i++)
+        {
+            TS_ASSERT_EQUALS(read_index_of_id.count(rWritten.mCellIds[i]), 1u);
+            unsigned j = read_index_of_id[rWritten.mCellIds[i]];
+            TS_ASSERT_EQUALS(rRead.mColours[j], rWritten.mColours[i]);
+            for (unsigned d=0; d<2u; d++)
+            {
+                TS_ASSERT_DELTA(rRead.mLocations[2*j + d], rWritten.mLocations[2*i + d], 0.5001*quantum);
+            }
+        }
+        for (unsigned i=0; i<std::min(rRead.mElements.size(), rWritten.mElements.size()); i++)
+        {
+            TS_ASSERT_EQUALS(rRead.mCellIds[rRead.mElements[i]], rWritten.mCellIds[rWritten.mElements[i]]);
+        }
+    }
+
+public:
+    void TestCodec() throw (Exception)
+    {
+        std::string buffer;
+        SnapshotCodec::AppendUnsigned(buffer, 0u);
+        SnapshotCodec::AppendUnsigned(buffer, 127u);
+        SnapshotCodec::AppendUnsigned(buffer, 128u);
+        SnapshotCodec::AppendSigned(buffer, -1);
+        SnapshotCodec::AppendSigned(buffer, -1000000000000LL);
+        SnapshotCodec::AppendDouble(buffer, -0.1);
+        TS_ASSERT_EQUALS(buffer.size(), 1u + 1u + 2u + 1u + 6u + 8u);
+
+        size_t pos = 0u;
+        TS_ASSERT_EQUALS(SnapshotCodec::ReadUnsigned(buffer, pos), 0u);
+        TS_ASSERT_EQUALS(SnapshotCodec::ReadUnsigned(buffer, pos), 127u);
+        TS_ASSERT_EQUALS(SnapshotCodec::ReadUnsigned(buffer, pos), 128u);
+        TS_ASSERT_EQUALS(SnapshotCodec::ReadSigned(buffer, pos), -1);
+        TS_ASSERT_EQUALS(SnapshotCodec::ReadSigned(buffer, pos), -1000000000000LL);
+        TS_ASSERT_EQUALS(SnapshotCodec::ReadDouble(buffer, pos), -0.1);
+        TS_ASSERT_EQUALS(pos, buffer.size());
+        TS_ASSERT_THROWS_THIS(SnapshotCodec::ReadUnsigned(buffer, pos),
+                              "Corrupt snapshot data: integer runs past the end of the data.");
+
+        TS_ASSERT_EQUALS(SnapshotCodec::Quantise(0.00016, 1e-4), 2);
+        TS_ASSERT_EQUALS(SnapshotCodec::Quantise(-0.00026, 1e-4), -3);
+
+        std::string data(1000u, 'x');
+        std::string compressed = SnapshotCodec::Compress(data);
+        TS_ASSERT_LESS_THAN(compressed.size(), data.size());
+        TS_ASSERT_EQUALS(SnapshotCodec::Decompress(compressed, data.size()), data);
+    }
+
+    void TestWriteAndRead() throw (Exception)
+    {
+        OutputFileHandler handler("TestSnapshotFormat");
+        const std::string path = handler.GetOutputDirectoryFullPath() + "results.snapshots";
+        const double quantum = 1e-4;
+        std::vector<SnapshotFrame> frames = MakeFrames(40u);
+
+        std::stringstream text;
+        {
+            SnapshotWriter writer(path, 2u, quantum, 4u, "MeshWidth\t10\n");
+            for (unsigned i=0; i<frames.size(); i++)
+            {
+                writer.WriteFrame(frames[i]);
+                text << frames[i].mTime << "\t";
+                for (unsigned j=0; j<frames[i].mLocations.size(); j++)
+                {
+                    text << frames[i].mLocations[j] << " ";
+                }
+                text << "\n";
+            }
+            TS_ASSERT_THROWS_THIS(writer.WriteFrame(frames[0]), "Snapshot frames must be written in time order.");
+            writer.Close();
+            TS_ASSERT_EQUALS(writer.GetNumFrames(), frames.size());
+
+            // Even just the node locations as text take several times more space
+            TS_ASSERT_LESS_THAN(3*writer.GetNumBytes(), text.str().size());
+        }
+
+        // Read frames out of order, so some come from keyframes and some follow on from the last frame read
+        SnapshotReader reader(path);
+        TS_ASSERT(!reader.WasIndexRebuilt());
+        TS_ASSERT_EQUALS(reader.GetNumFrames(), frames.size());
+        TS_ASSERT_EQUALS(reader.GetDimension(), 2u);
+        TS_ASSERT_EQUALS(reader.GetQuantum(), quantum);
+        TS_ASSERT_EQUALS(reader.GetFrameTime(7u), 3.5);
+        unsigned order[] = {37u, 3u, 4u, 39u, 0u, 13u, 14u, 12u, 1u};
+        for (unsigned i=0; i<9u; i++)
+        {
+            CheckFrame(reader.rReadFrame(order[i]), frames[order[i]], quantum);
+        }
+        TS_ASSERT_THROWS_CONTAINS(reader.rReadFrame(40u), "there is no frame 40.");
+
+        // Export to the text format
+        reader.ExportVisualizerFiles(handler.GetOutputDirectoryFullPath());
+        std::ifstream nodes_file(handler.FindFile("results.viznodes").GetAbsolutePath().c_str());
+        std::string line;
+        unsigned num_lines = 0u;
+        while (std::getline(nodes_file, line))
+        {
+            std::stringstream line_stream(line);
+            double time;
+            line_stream >> time;
+            TS_ASSERT_EQUALS(time, frames[num_lines].mTime);
+            unsigned num_values = 0u;
+            double value;
+            while (line_stream >> value)
+            {
+                num_values++;
+            }
+            TS_ASSERT_EQUALS(num_values, frames[num_lines].mLocations.size());
+            num_lines++;
+        }
+        TS_ASSERT_EQUALS(num_lines, frames.size());
+        std::ifstream setup_file(handler.FindFile("results.vizsetup").GetAbsolutePath().c_str());
+        std::stringstream setup;
+        setup << setup_file.rdbuf();
+        TS_ASSERT_EQUALS(setup.str(), "MeshWidth\t10\nComplete\n");
+        TS_ASSERT(handler.FindFile("results.vizcelltypes").Exists());
+        TS_ASSERT(handler.FindFile("results.vizelements").Exists());
+    }
+
+    void TestReadUnfinishedFile() throw (Exception)
+    {
+        OutputFileHandler handler("TestSnapshotFormat", false);
+        const std::string path = handler.GetOutputDirectoryFullPath() + "unfinished.snapshots";
+        std::vector<SnapshotFrame> frames = MakeFrames(20u);
+
+        // Simulate a simulation dying part way through writing the last frame, before the index is written
+        uint64_t last_frame_start;
+        uint64_t last_frame_end;
+        {
+            SnapshotWriter writer(path, 2u, 1e-4, 4u);
+            for (unsigned i=0; i<frames.size(); i++)
+            {
+                last_frame_start = writer.GetNumBytes();
+                writer.WriteFrame(frames[i]);
+            }
+            last_frame_end = writer.GetNumBytes();
+        }
+        std::string contents;
+        {
+            std::ifstream complete_file(path.c_str(), std::ios::binary);
+            std::stringstream contents_stream;
+            contents_stream << complete_file.rdbuf();
+            contents = contents_stream.str();
+        }
+        std::ofstream unfinished_file(path.c_str(), std::ios::binary);
+        unfinished_file << contents.substr(0u, (last_frame_start + last_frame_end)/2u);
+        unfinished_file.close();
+
+        SnapshotReader reader(path);
+        TS_ASSERT(reader.WasIndexRebuilt());
+        TS_ASSERT_EQUALS(reader.GetNumFrames(), frames.size() - 1u);
+        for (unsigned i=0; i<reader.GetNumFrames(); i++)
+        {
+            CheckFrame(reader.rReadFrame(i), frames[i], reader.GetQuantum());
+        }
+
+        // Other files are rejected
+        const std::string other_path = handler.GetOutputDirectoryFullPath() + "other.txt";
+        std::ofstream other_file(other_path.c_str());
+        other_file << "Not a snapshot file\n";
+        other_file.close();
+        TS_ASSERT_THROWS_CONTAINS(SnapshotReader other_reader(other_path), "is not a snapshot file.");
+    }
+};
+
+#endif // TESTSNAPSHOTFORMAT_HPP_